@@ -193,7 +193,7 @@ unload_by_write(const char *fpath, off_t offset, cuio_ptr_t *pptr)
 }
 
 static cuio_ptr_t
-mmap_by_uxu(const char *fpath, size_t len, cuio_mode_t mode)
+mmap_by_uxu(const char *fpath, off_t offset, size_t len, cuio_mode_t mode)
 {
 	cuio_ptr_t	ptr;
 	int	flags = UXU_FLAGS_READ;
@@ -209,7 +209,7 @@ mmap_by_uxu(const char *fpath, size_t len, cuio_mode_t mode)
 		flags |= (UXU_FLAGS_WRITE | UXU_FLAGS_CREATE | UXU_FLAGS_VOLATILE);
 		break;
 	}
-	if (uxu_map(fpath, len, flags, (void **)&ptr.ptr_h) != UXU_OK) {
+	if (uxu_map_offset(fpath, offset, len, flags, (void **)&ptr.ptr_h) != UXU_OK) {
 		fprintf(stderr, "Cannot uxu_map %s\n", fpath);
 		exit(EXIT_FAILURE);
 	}
@@ -312,8 +312,7 @@ cuio_load(const char *fname, off_t offset, size_t size, cuio_mode_t mode)
 
 	switch (type) {
 	case CUIO_TYPE_UXU:
-		/* offset not supported yet */
-		return mmap_by_uxu(fpath, size, mode);
+		return mmap_by_uxu(fpath, offset, size, mode);
 	case CUIO_TYPE_HREG:
 		return mmap_by_hostreg(fpath, offset, size, mode);
 	default:
@@ -335,6 +335,12 @@ typedef enum
     UvmEventTypeThrottlingEnd              = 12,
     UvmEventTypeMapRemote                  = 13,
     UvmEventTypeEviction                   = 14,
+    UvmEventTypeUxuBlockLoadStart          = 15,
+    UvmEventTypeUxuBlockLoadEnd            = 16,
+    UvmEventTypeUxuPageCache               = 17,
+    UvmEventTypeUxuFlush                   = 18,
+    UvmEventTypeUxuWriteback               = 19,
+    UvmEventTypeUxuBlockRelease            = 20,
 
     // ---- Add new values above this line
     UvmEventNumTypes,
@@ -367,6 +373,12 @@ typedef enum
 #define UVM_EVENT_ENABLE_THROTTLING_END               ((NvU64)1 << UvmEventTypeThrottlingEnd)
 #define UVM_EVENT_ENABLE_MAP_REMOTE                   ((NvU64)1 << UvmEventTypeMapRemote)
 #define UVM_EVENT_ENABLE_EVICTION                     ((NvU64)1 << UvmEventTypeEviction)
+#define UVM_EVENT_ENABLE_UXU_BLOCK_LOAD_START         ((NvU64)1 << UvmEventTypeUxuBlockLoadStart)
+#define UVM_EVENT_ENABLE_UXU_BLOCK_LOAD_END           ((NvU64)1 << UvmEventTypeUxuBlockLoadEnd)
+#define UVM_EVENT_ENABLE_UXU_PAGE_CACHE               ((NvU64)1 << UvmEventTypeUxuPageCache)
+#define UVM_EVENT_ENABLE_UXU_FLUSH                    ((NvU64)1 << UvmEventTypeUxuFlush)
+#define UVM_EVENT_ENABLE_UXU_WRITEBACK                ((NvU64)1 << UvmEventTypeUxuWriteback)
+#define UVM_EVENT_ENABLE_UXU_BLOCK_RELEASE            ((NvU64)1 << UvmEventTypeUxuBlockRelease)
 #define UVM_EVENT_ENABLE_TEST_ACCESS_COUNTER          ((NvU64)1 << UvmEventTypeTestAccessCounter)
 
 //------------------------------------------------------------------------------
@@ -901,6 +913,167 @@ typedef struct
     NvU64 timeStamp;        // cpu time stamp when eviction starts on the cpu
 } UvmEventEvictionInfo;
 
+//------------------------------------------------------------------------------
+// UXU events. They describe the storage I/O of file-backed va ranges, so that
+// the same tracker can correlate GPU faults with the I/O that satisfied them.
+// All the time stamps use the same cpu clock as the rest of the events.
+//------------------------------------------------------------------------------
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuBlockLoadStart helps to identify
+    // event data in a queue.
+    //
+    NvU8 eventType;
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU8 padding8bits;
+    NvU16 padding16bits;
+    NvU32 padding32bits;
+    NvU64 address;          // virtual address of the block being loaded
+    NvU64 size;             // size of the block being loaded
+    NvU64 timeStamp;        // cpu time stamp when the load starts
+} UvmEventUxuBlockLoadStartInfo;
+
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuBlockLoadEnd helps to identify
+    // event data in a queue.
+    //
+    NvU8 eventType;
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU8 padding8bits;
+    NvU16 padding16bits;
+    NvU32 pageCount;        // number of file pages mapped into the block
+    NvU64 address;          // virtual address of the loaded block
+    NvU64 bytesFromStorage; // bytes that were not in the page cache when the
+                            // load started and had to be read from storage
+    NvU64 beginTimeStamp;   // cpu time stamp when the load started
+    NvU64 endTimeStamp;     // cpu time stamp when the block is loaded
+} UvmEventUxuBlockLoadEndInfo;
+
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuPageCache helps to identify event
+    // data in a queue.
+    //
+    NvU8 eventType;
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU8 padding8bits;
+    NvU16 padding16bits;
+    NvU32 pagesHit;         // pages of the block found up to date in the
+                            // page cache
+    NvU64 address;          // virtual address of the block being loaded
+    NvU32 pagesMissed;      // pages of the block read from storage
+    NvU32 padding32bits;
+    NvU64 timeStamp;        // cpu time stamp when the page cache is looked up
+} UvmEventUxuPageCacheInfo;
+
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuFlush helps to identify event data
+    // in a queue.
+    //
+    NvU8 eventType;
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU8 padding8bits;
+    NvU16 padding16bits;
+    NvU32 padding32bits;
+    NvU64 address;          // virtual address of the flushed block
+    NvU64 size;             // bytes copied from the gpus back to the page
+                            // cache
+    NvU64 beginTimeStamp;   // cpu time stamp when the flush starts
+    NvU64 endTimeStamp;     // cpu time stamp when the copies have completed
+} UvmEventUxuFlushInfo;
+
+typedef enum
+{
+    UvmEventUxuWritebackCauseInvalid = 0,
+
+    // The block was released and its dirty page cache pages were handed over
+    // to the kernel writeback
+    UvmEventUxuWritebackCauseRelease = 1,
+
+    // The va range was destroyed and its file is synced
+    UvmEventUxuWritebackCauseUnmap   = 2,
+} UvmEventUxuWritebackCause;
+
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuWriteback helps to identify event
+    // data in a queue.
+    //
+    NvU8 eventType;
+    NvU8 writebackCause;    // field of type UvmEventUxuWritebackCause
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU16 padding16bits;
+    NvU32 padding32bits;
+    NvU64 address;          // virtual address of the block written back
+    NvU64 size;             // bytes of the block written back to the file
+    NvU64 timeStamp;        // cpu time stamp when the pages are handed over
+} UvmEventUxuWritebackInfo;
+
+typedef enum
+{
+    UvmEventUxuBlockReleaseCauseInvalid = 0,
+
+    // The reclaim service released the block because the system or the memory
+    // cgroup of the va space was short of memory
+    UvmEventUxuBlockReleaseCauseReclaim = 1,
+
+    // The range was remapped and its blocks have to be loaded again
+    UvmEventUxuBlockReleaseCauseRemap   = 2,
+} UvmEventUxuBlockReleaseCause;
+
+typedef struct
+{
+    //
+    // eventType has to be the 1st argument of this structure.
+    // Setting eventType = UvmEventTypeUxuBlockRelease helps to identify event
+    // data in a queue.
+    //
+    NvU8 eventType;
+    NvU8 releaseCause;      // field of type UvmEventUxuBlockReleaseCause
+    //
+    // This structure is shared between UVM kernel and tools.
+    // Manually padding the structure so that compiler options like pragma pack
+    // or malign-double will have no effect on the field offsets
+    //
+    NvU16 padding16bits;
+    NvU32 padding32bits;
+    NvU64 address;          // virtual address of the released block
+    NvU64 size;             // size of the released block
+    NvU64 timeStamp;        // cpu time stamp when the block is released
+} UvmEventUxuBlockReleaseInfo;
+
 // TODO: Bug 1870362: [uvm] Provide virtual address and processor index in
 // AccessCounter events
 //
@@ -985,6 +1158,12 @@ typedef struct
             UvmEventThrottlingEndInfo throttlingEnd;
             UvmEventMapRemoteInfo mapRemote;
             UvmEventEvictionInfo eviction;
+            UvmEventUxuBlockLoadStartInfo uxuBlockLoadStart;
+            UvmEventUxuBlockLoadEndInfo uxuBlockLoadEnd;
+            UvmEventUxuPageCacheInfo uxuPageCache;
+            UvmEventUxuFlushInfo uxuFlush;
+            UvmEventUxuWritebackInfo uxuWriteback;
+            UvmEventUxuBlockReleaseInfo uxuBlockRelease;
         } eventData;
 
         union
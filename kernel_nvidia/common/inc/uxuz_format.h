@@ -0,0 +1,73 @@
+#ifndef _UXUZ_FORMAT_H_
+#define _UXUZ_FORMAT_H_
+
+/*
+ * Compressed container of uxu, mapped with UVM_UXU_FLAG_COMPRESSED. This
+ * header is shared by the kernel module and library/uxuz.h.
+ *
+ * The data is cut in chunks of 2^chunk_shift bytes, each compressed on its
+ * own with the LZ4 block format, so that the kernel reads and writes back a
+ * block chunk by chunk. The file holds, in little endian:
+ *
+ *   offset 0             header, padded with zeros to UXUZ_HEADER_SIZE bytes
+ *   offset index_offset  nr_chunks index entries
+ *   after the index      chunk data, in any order, with gaps
+ *
+ * An index entry with a zero length is a chunk of zeros, it takes no space.
+ * A chunk with UXUZ_CHUNK_STORED is stored uncompressed, every chunk is when
+ * the algorithm is UXUZ_ALGO_NONE. The last chunk holds the rest of the data
+ * and may be shorter. No two entries overlap, and every entry lies within
+ * the file.
+ *
+ * The kernel never overwrites the data an entry points to. A chunk written
+ * back goes to a gap left by the chunks written before, or to the end of the
+ * file. The data is flushed before the index entries are updated, and the
+ * old space is only reused once the new entries are flushed, so that a crash
+ * leaves each chunk either old or new. The gaps are found again when the
+ * container is mapped. Unpacking and packing again compacts the file.
+ *
+ * chunk_shift ranges from the page shift to 21, the 2MB UVM block size. A
+ * mapping of a container starts on a chunk boundary, which cudaMallocManaged
+ * allocations always do.
+ */
+
+#if defined(__KERNEL__)
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#define UXUZ_MAGIC		0x5a555855	/* "UXUZ" */
+#define UXUZ_VERSION		1
+#define UXUZ_HEADER_SIZE	4096
+
+#define UXUZ_ALGO_NONE		0
+#define UXUZ_ALGO_LZ4		1
+
+/* The chunk is stored uncompressed */
+#define UXUZ_CHUNK_STORED	0x1
+
+#define UXUZ_MIN_CHUNK_SHIFT	12
+#define UXUZ_MAX_CHUNK_SHIFT	21
+/* 64KB chunks */
+#define UXUZ_DEFAULT_CHUNK_SHIFT	16
+
+typedef struct {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	algorithm;
+	uint32_t	chunk_shift;
+	uint32_t	reserved;
+	/* uncompressed size of the data */
+	uint64_t	size;
+	uint64_t	nr_chunks;
+	uint64_t	index_offset;
+} uxuz_header_t;
+
+typedef struct {
+	uint64_t	offset;
+	uint32_t	length;
+	uint32_t	flags;
+} uxuz_chunk_t;
+
+#endif
@@ -136,6 +136,7 @@ test_headers() {
     FILES="$FILES linux/sched/signal.h"
     FILES="$FILES linux/sched/task.h"
     FILES="$FILES linux/sched/task_stack.h"
+    FILES="$FILES linux/sched/mm.h"
     FILES="$FILES xen/ioemu.h"
     FILES="$FILES linux/fence.h"
     FILES="$FILES linux/dma-resv.h"
@@ -3620,6 +3621,166 @@ compile_test() {
             compile_check_conftest "$CODE" "NV_KTIME_GET_RAW_TS64_PRESENT" "" "functions"
         ;;
 
+        set_active_memcg)
+            #
+            # Determine if set_active_memcg() is present
+            #
+            # Renamed from memalloc_use_memcg() by commit b87d8cefe43c7
+            # ("mm, memcg: rework remote charging API to support nesting")
+            # in 5.10 (2020-08-07)
+            #
+        CODE="
+        #if defined(NV_LINUX_SCHED_MM_H_PRESENT)
+        #include <linux/sched/mm.h>
+        #endif
+        void conftest_set_active_memcg(void){
+            set_active_memcg();
+        }"
+            compile_check_conftest "$CODE" "NV_SET_ACTIVE_MEMCG_PRESENT" "" "functions"
+        ;;
+
+        memalloc_use_memcg)
+            #
+            # Determine if memalloc_use_memcg() is present
+            #
+            # Added by commit d46eb14b735b ("fs: fsnotify: account fsnotify
+            # metadata to kmemcg") in 4.19 (2018-08-17), and renamed to
+            # set_active_memcg() in 5.10.
+            #
+        CODE="
+        #if defined(NV_LINUX_SCHED_MM_H_PRESENT)
+        #include <linux/sched/mm.h>
+        #endif
+        void conftest_memalloc_use_memcg(void){
+            memalloc_use_memcg();
+        }"
+            compile_check_conftest "$CODE" "NV_MEMALLOC_USE_MEMCG_PRESENT" "" "functions"
+        ;;
+
+        mem_cgroup_get_max)
+            #
+            # Determine if mem_cgroup_get_max() is present
+            #
+            # Renamed from mem_cgroup_get_limit() by commit bbec2e15170a
+            # ("mm: rename page_counter's count/limit into usage/max") in
+            # 4.19 (2018-06-07)
+            #
+        CODE="
+        #include <linux/memcontrol.h>
+        void conftest_mem_cgroup_get_max(void){
+            mem_cgroup_get_max();
+        }"
+            compile_check_conftest "$CODE" "NV_MEM_CGROUP_GET_MAX_PRESENT" "" "functions"
+        ;;
+
+        iov_iter_type)
+            #
+            # Determine if iov_iter_type() is present
+            #
+            # Added by commit aa563d7bca6e ("iov_iter: Separate type from
+            # direction and use accessor functions") in 4.20 (2018-10-20),
+            # which also made iov_iter_bvec() and friends take only the
+            # direction instead of the iterator type ORed with it.
+            #
+        CODE="
+        #include <linux/uio.h>
+        void conftest_iov_iter_type(void){
+            iov_iter_type();
+        }"
+            compile_check_conftest "$CODE" "NV_IOV_ITER_TYPE_PRESENT" "" "functions"
+        ;;
+
+        vfs_getxattr_has_userns_arg)
+            #
+            # Determine if vfs_getxattr() takes the user namespace of the
+            # mount.
+            #
+            # Added by commit c7c7a1a18af4 ("xattr: handle idmapped mounts")
+            # in 5.12 (2021-01-21).
+            #
+            CODE="
+            #include <linux/xattr.h>
+            ssize_t vfs_getxattr(struct user_namespace *mnt_userns,
+                                 struct dentry *dentry, const char *name,
+                                 void *value, size_t size) {
+                return 0;
+            }"
+
+            compile_check_conftest "$CODE" "NV_VFS_GETXATTR_HAS_USERNS_ARG" "" "types"
+        ;;
+
+        vfs_getxattr_has_mnt_idmap_arg)
+            #
+            # Determine if vfs_getxattr() takes the idmap of the mount.
+            #
+            # The user namespace was replaced by commit 4609e1f18e19 ("fs:
+            # port ->permission() to pass mnt_idmap") in 6.3 (2023-01-13).
+            #
+            CODE="
+            #include <linux/xattr.h>
+            ssize_t vfs_getxattr(struct mnt_idmap *idmap,
+                                 struct dentry *dentry, const char *name,
+                                 void *value, size_t size) {
+                return 0;
+            }"
+
+            compile_check_conftest "$CODE" "NV_VFS_GETXATTR_HAS_MNT_IDMAP_ARG" "" "types"
+        ;;
+
+        vfs_setxattr_has_userns_arg)
+            #
+            # Determine if vfs_setxattr() takes the user namespace of the
+            # mount.
+            #
+            # Added by commit c7c7a1a18af4 ("xattr: handle idmapped mounts")
+            # in 5.12 (2021-01-21).
+            #
+            CODE="
+            #include <linux/xattr.h>
+            int vfs_setxattr(struct user_namespace *mnt_userns,
+                             struct dentry *dentry, const char *name,
+                             const void *value, size_t size, int flags) {
+                return 0;
+            }"
+
+            compile_check_conftest "$CODE" "NV_VFS_SETXATTR_HAS_USERNS_ARG" "" "types"
+        ;;
+
+        vfs_setxattr_has_mnt_idmap_arg)
+            #
+            # Determine if vfs_setxattr() takes the idmap of the mount.
+            #
+            # The user namespace was replaced by commit 4609e1f18e19 ("fs:
+            # port ->permission() to pass mnt_idmap") in 6.3 (2023-01-13).
+            #
+            CODE="
+            #include <linux/xattr.h>
+            int vfs_setxattr(struct mnt_idmap *idmap,
+                             struct dentry *dentry, const char *name,
+                             const void *value, size_t size, int flags) {
+                return 0;
+            }"
+
+            compile_check_conftest "$CODE" "NV_VFS_SETXATTR_HAS_MNT_IDMAP_ARG" "" "types"
+        ;;
+
+        bmap_has_sector_ptr_arg)
+            #
+            # Determine if bmap() takes a pointer to the block and returns
+            # an error code.
+            #
+            # Changed by commit 30460e1ea3e6 ("fs: Enable bmap() function to
+            # properly return errors") in 5.6.
+            #
+            CODE="
+            #include <linux/fs.h>
+            int bmap(struct inode *inode, sector_t *block) {
+                return 0;
+            }"
+
+            compile_check_conftest "$CODE" "NV_BMAP_HAS_SECTOR_PTR_ARG" "" "types"
+        ;;
+
         ktime_get_real_ts64)
             #
             # Determine if ktime_get_real_ts64() is present
@@ -940,6 +940,7 @@ static long uvm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_UXU_INITIALIZE,                 uvm_api_uxu_initialize);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_UXU_MAP,                        uvm_api_uxu_map);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_UXU_REMAP,                      uvm_api_uxu_remap);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_UXU_FLUSH,                      uvm_api_uxu_flush);
     }
 
     // Try the test ioctls if none of the above matched
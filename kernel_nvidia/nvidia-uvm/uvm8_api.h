@@ -256,5 +256,6 @@ NV_STATUS uvm_api_populate_pageable(const UVM_POPULATE_PAGEABLE_PARAMS *params,
 NV_STATUS uvm_api_uxu_initialize(UVM_UXU_INITIALIZE_PARAMS *params, struct file *filp);
 NV_STATUS uvm_api_uxu_map(UVM_UXU_MAP_PARAMS *params, struct file *filp);
 NV_STATUS uvm_api_uxu_remap(UVM_UXU_REMAP_PARAMS *params, struct file *filp);
+NV_STATUS uvm_api_uxu_flush(UVM_UXU_FLUSH_PARAMS *params, struct file *filp);
 
 #endif // __UVM8_API_H__
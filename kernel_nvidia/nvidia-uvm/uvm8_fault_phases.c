@@ -0,0 +1,146 @@
+/*******************************************************************************
+    Copyright (c) 2021 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN hint OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+
+#include "uvm_linux.h"
+#include "uvm8_fault_phases.h"
+#include "uvm8_global.h"
+#include "uvm8_gpu.h"
+#include "uvm8_procfs.h"
+#include "uvm8_test.h"
+#include "uvm8_va_space.h"
+
+// Enable the recording of the fault service phases at load time
+static unsigned uvm_fault_phases = 0;
+module_param(uvm_fault_phases, uint, S_IRUGO);
+
+#if defined(DECLARE_STATIC_KEY_FALSE)
+DEFINE_STATIC_KEY_FALSE(g_uvm_fault_phases_key);
+
+static void fault_phases_set_enabled(bool enabled)
+{
+    if (enabled)
+        static_branch_enable(&g_uvm_fault_phases_key);
+    else
+        static_branch_disable(&g_uvm_fault_phases_key);
+}
+#else
+bool g_uvm_fault_phases_key;
+
+static void fault_phases_set_enabled(bool enabled)
+{
+    WRITE_ONCE(g_uvm_fault_phases_key, enabled);
+}
+#endif
+
+static const char *g_fault_phase_names[UVM_FAULT_PHASE_COUNT] = {
+    [UVM_FAULT_PHASE_SERVICE] = "service",
+    [UVM_FAULT_PHASE_IO]      = "io",
+    [UVM_FAULT_PHASE_DMA_MAP] = "dma_map",
+    [UVM_FAULT_PHASE_COPY]    = "copy",
+    [UVM_FAULT_PHASE_PTE]     = "pte",
+    [UVM_FAULT_PHASE_REPLAY]  = "replay",
+};
+
+NV_STATUS uvm_fault_phases_init(void)
+{
+    fault_phases_set_enabled(uvm_fault_phases != 0);
+
+    return NV_OK;
+}
+
+void uvm_fault_phase_record(uvm_gpu_t *gpu, uvm_fault_phase_t phase, NvU64 ns)
+{
+    unsigned bucket = ns ? min((unsigned)ilog2(ns), (unsigned)UVM_FAULT_PHASE_BUCKETS - 1) : 0;
+
+    UVM_ASSERT(phase < UVM_FAULT_PHASE_COUNT);
+
+    atomic64_inc(&gpu->fault_phases.count[phase][bucket]);
+    atomic64_add(ns, &gpu->fault_phases.total_ns[phase]);
+}
+
+void uvm_fault_phase_record_id(uvm_va_space_t *va_space, uvm_processor_id_t id, uvm_fault_phase_t phase, NvU64 ns)
+{
+    if (UVM_ID_IS_GPU(id))
+        uvm_fault_phase_record(uvm_va_space_get_gpu(va_space, id), phase, ns);
+}
+
+void uvm_fault_phases_reset(uvm_gpu_t *gpu)
+{
+    int i, j;
+
+    for (i = 0; i < UVM_FAULT_PHASE_COUNT; i++) {
+        for (j = 0; j < UVM_FAULT_PHASE_BUCKETS; j++)
+            atomic64_set(&gpu->fault_phases.count[i][j], 0);
+        atomic64_set(&gpu->fault_phases.total_ns[i], 0);
+    }
+}
+
+void uvm_fault_phases_print(uvm_gpu_t *gpu, struct seq_file *s)
+{
+    int i, j;
+
+    UVM_SEQ_OR_DBG_PRINT(s, "enabled                %u\n", uvm_fault_phases_enabled() ? 1 : 0);
+
+    for (i = 0; i < UVM_FAULT_PHASE_COUNT; i++) {
+        NvU64 count = 0;
+
+        for (j = 0; j < UVM_FAULT_PHASE_BUCKETS; j++)
+            count += atomic64_read(&gpu->fault_phases.count[i][j]);
+
+        UVM_SEQ_OR_DBG_PRINT(s, "%s:\n", g_fault_phase_names[i]);
+        UVM_SEQ_OR_DBG_PRINT(s, "  count                %llu\n", count);
+        UVM_SEQ_OR_DBG_PRINT(s, "  total_ns             %llu\n", (NvU64)atomic64_read(&gpu->fault_phases.total_ns[i]));
+
+        for (j = 0; j < UVM_FAULT_PHASE_BUCKETS; j++) {
+            NvU64 bucket_count = atomic64_read(&gpu->fault_phases.count[i][j]);
+
+            if (bucket_count == 0)
+                continue;
+
+            UVM_SEQ_OR_DBG_PRINT(s, "  <%-19llu %llu\n", 1ULL << (j + 1), bucket_count);
+        }
+    }
+}
+
+NV_STATUS uvm8_test_fault_phases(UVM_TEST_FAULT_PHASES_PARAMS *params, struct file *filp)
+{
+    uvm_gpu_t *gpu;
+
+    if (params->enable > UVM_TEST_FAULT_PHASES_DISABLE)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (params->enable == UVM_TEST_FAULT_PHASES_ENABLE)
+        fault_phases_set_enabled(true);
+    else if (params->enable == UVM_TEST_FAULT_PHASES_DISABLE)
+        fault_phases_set_enabled(false);
+
+    if (params->reset) {
+        uvm_mutex_lock(&g_uvm_global.global_lock);
+        for_each_global_gpu(gpu)
+            uvm_fault_phases_reset(gpu);
+        uvm_mutex_unlock(&g_uvm_global.global_lock);
+    }
+
+    return NV_OK;
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+    Copyright (c) 2021 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN hint OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+
+#ifndef __UVM8_FAULT_PHASES_H__
+#define __UVM8_FAULT_PHASES_H__
+
+#include "uvm_linux.h"
+#include "uvm8_forward_decl.h"
+#include "uvm8_processors.h"
+#include <linux/jump_label.h>
+
+// Breakdown of the time spent servicing faults, recorded per GPU into log2
+// histograms of nanoseconds. Recording is off by default and costs a patched
+// out branch per phase boundary when disabled. It is enabled with the
+// uvm_fault_phases module parameter or the UVM_TEST_FAULT_PHASES ioctl, and
+// the histograms are read from /proc/driver/nvidia-uvm/gpus/<gpu>/fault_phases.
+typedef enum
+{
+    // service_batch_managed_faults_in_block_locked(), i.e. everything done
+    // for a block of a replayable fault batch.
+    UVM_FAULT_PHASE_SERVICE,
+
+    // Loading UXU blocks from storage, excluding the DMA mapping of the page
+    // cache pages. Includes the wait for the I/O started on the replayable
+    // fault path.
+    UVM_FAULT_PHASE_IO,
+
+    // DMA mapping of the page cache pages of UXU blocks to the GPUs
+    UVM_FAULT_PHASE_DMA_MAP,
+
+    // uvm_va_block_make_resident() calls, which push the copies
+    UVM_FAULT_PHASE_COPY,
+
+    // Mapping the faulting GPU
+    UVM_FAULT_PHASE_PTE,
+
+    // Pushing a replay
+    UVM_FAULT_PHASE_REPLAY,
+
+    UVM_FAULT_PHASE_COUNT
+} uvm_fault_phase_t;
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns, the last one everything above
+#define UVM_FAULT_PHASE_BUCKETS 32
+
+typedef struct
+{
+    atomic64_t count[UVM_FAULT_PHASE_COUNT][UVM_FAULT_PHASE_BUCKETS];
+
+    atomic64_t total_ns[UVM_FAULT_PHASE_COUNT];
+} uvm_fault_phases_t;
+
+#if defined(DECLARE_STATIC_KEY_FALSE)
+DECLARE_STATIC_KEY_FALSE(g_uvm_fault_phases_key);
+#define uvm_fault_phases_enabled() static_branch_unlikely(&g_uvm_fault_phases_key)
+#else
+extern bool g_uvm_fault_phases_key;
+#define uvm_fault_phases_enabled() unlikely(READ_ONCE(g_uvm_fault_phases_key))
+#endif
+
+NV_STATUS uvm_fault_phases_init(void);
+
+void uvm_fault_phase_record(uvm_gpu_t *gpu, uvm_fault_phase_t phase, NvU64 ns);
+
+// Same as uvm_fault_phase_record() for the GPU with the given id in va_space.
+// Nothing is recorded for the CPU.
+void uvm_fault_phase_record_id(uvm_va_space_t *va_space, uvm_processor_id_t id, uvm_fault_phase_t phase, NvU64 ns);
+
+// Returns the start time of a phase, or 0 if recording is disabled
+static inline NvU64 uvm_fault_phase_start(void)
+{
+    if (uvm_fault_phases_enabled())
+        return NV_GETTIME();
+
+    return 0;
+}
+
+// Record a phase started at start. Nothing is recorded if recording was
+// disabled at the start.
+static inline void uvm_fault_phase_end(uvm_gpu_t *gpu, uvm_fault_phase_t phase, NvU64 start)
+{
+    if (start != 0)
+        uvm_fault_phase_record(gpu, phase, NV_GETTIME() - start);
+}
+
+static inline void uvm_fault_phase_end_id(uvm_va_space_t *va_space,
+                                          uvm_processor_id_t id,
+                                          uvm_fault_phase_t phase,
+                                          NvU64 start)
+{
+    if (start != 0)
+        uvm_fault_phase_record_id(va_space, id, phase, NV_GETTIME() - start);
+}
+
+void uvm_fault_phases_reset(uvm_gpu_t *gpu);
+
+void uvm_fault_phases_print(uvm_gpu_t *gpu, struct seq_file *s);
+
+#endif
@@ -54,8 +54,10 @@ typedef struct uvm_va_range_struct uvm_va_range_t;
 typedef struct uvm_va_block_struct uvm_va_block_t;
 typedef struct uvm_va_block_test_struct uvm_va_block_test_t;
 typedef struct uvm_va_block_wrapper_struct uvm_va_block_wrapper_t;
+typedef struct uvm_va_block_kill_batch_struct uvm_va_block_kill_batch_t;
 typedef struct uvm_va_space_struct uvm_va_space_t;
 typedef struct uvm_va_space_mm_struct uvm_va_space_mm_t;
+typedef struct uvm_uxu_io_batch_struct uvm_uxu_io_batch_t;
 
 typedef struct uvm_make_resident_context_struct uvm_make_resident_context_t;
 
@@ -78,6 +80,7 @@ typedef struct uvm_tlb_batch_struct uvm_tlb_batch_t;
 
 typedef struct uvm_fault_service_batch_context_struct uvm_fault_service_batch_context_t;
 typedef struct uvm_service_block_context_struct uvm_service_block_context_t;
+typedef struct uvm_fault_service_stats_struct uvm_fault_service_stats_t;
 
 typedef struct uvm_ats_fault_invalidate_struct uvm_ats_fault_invalidate_t;
 
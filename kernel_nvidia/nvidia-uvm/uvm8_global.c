@@ -38,6 +38,7 @@
 #include "uvm8_gpu_access_counters.h"
 #include "nv_uvm_interface.h"
 #include "uvm8_uxu.h"
+#include "uvm8_fault_phases.h"
 
 static int uvm8_ats_mode = 1;
 module_param(uvm8_ats_mode, int, S_IRUGO);
@@ -123,6 +124,12 @@ NV_STATUS uvm_global_init(void)
         goto error;
     }
 
+    status = uvm_lock_stats_init();
+    if (status != NV_OK) {
+        UVM_ERR_PRINT("uvm_lock_stats_init() failed: %s\n", nvstatusToString(status));
+        goto error;
+    }
+
     status = uvm_rm_locked_call(nvUvmInterfaceSessionCreate(&g_uvm_global.rm_session_handle, &platform_info));
     if (status != NV_OK) {
         UVM_ERR_PRINT("nvUvmInterfaceSessionCreate() failed: %s\n", nvstatusToString(status));
@@ -192,6 +199,12 @@ NV_STATUS uvm_global_init(void)
         goto error;
     }
 
+    status = uvm_fault_phases_init();
+    if (status != NV_OK) {
+        UVM_ERR_PRINT("uvm_fault_phases_init() failed: %s\n", nvstatusToString(status));
+        goto error;
+    }
+
     // This sets up the ISR (interrupt service routine), by hooking into RM's top-half ISR callback. As soon as this
     // call completes, GPU interrupts will start arriving, so it's important to be prepared to receive interrupts before
     // this point:
@@ -230,6 +243,7 @@ void uvm_global_exit(void)
     if (g_uvm_global.rm_session_handle != 0)
         uvm_rm_locked_call_void(nvUvmInterfaceSessionDestroy(g_uvm_global.rm_session_handle));
 
+    uvm_lock_stats_exit();
     uvm_procfs_exit();
 
     nv_kthread_q_stop(&g_uvm_global.deferred_release_q);
@@ -487,9 +487,29 @@ static int nv_procfs_read_gpu_access_counters_entry(struct seq_file *s, void *v)
     UVM_ENTRY_RET(nv_procfs_read_gpu_access_counters(s, v));
 }
 
+static int nv_procfs_read_gpu_fault_phases(struct seq_file *s, void *v)
+{
+    uvm_gpu_t *gpu = (uvm_gpu_t *)s->private;
+
+    if (!uvm_down_read_trylock(&g_uvm_global.pm.lock))
+            return -EAGAIN;
+
+    uvm_fault_phases_print(gpu, s);
+
+    uvm_up_read(&g_uvm_global.pm.lock);
+
+    return 0;
+}
+
+static int nv_procfs_read_gpu_fault_phases_entry(struct seq_file *s, void *v)
+{
+    UVM_ENTRY_RET(nv_procfs_read_gpu_fault_phases(s, v));
+}
+
 UVM_DEFINE_SINGLE_PROCFS_FILE(gpu_info_entry);
 UVM_DEFINE_SINGLE_PROCFS_FILE(gpu_fault_stats_entry);
 UVM_DEFINE_SINGLE_PROCFS_FILE(gpu_access_counters_entry);
+UVM_DEFINE_SINGLE_PROCFS_FILE(gpu_fault_phases_entry);
 
 static NV_STATUS init_procfs_dirs(uvm_gpu_t *gpu)
 {
@@ -541,6 +561,10 @@ static NV_STATUS init_procfs_files(uvm_gpu_t *gpu)
     if (gpu->procfs.info_file == NULL)
         return NV_ERR_OPERATING_SYSTEM;
 
+    gpu->procfs.fault_phases_file = NV_CREATE_PROC_FILE("fault_phases", gpu->procfs.dir, gpu_fault_phases_entry, gpu);
+    if (gpu->procfs.fault_phases_file == NULL)
+        return NV_ERR_OPERATING_SYSTEM;
+
     // Fault and access counter files are debug only
     if (!uvm_procfs_is_debug_enabled())
         return NV_OK;
@@ -563,6 +587,7 @@ static void deinit_procfs_files(uvm_gpu_t *gpu)
 {
     uvm_procfs_destroy_entry(gpu->procfs.access_counters_file);
     uvm_procfs_destroy_entry(gpu->procfs.fault_stats_file);
+    uvm_procfs_destroy_entry(gpu->procfs.fault_phases_file);
     uvm_procfs_destroy_entry(gpu->procfs.info_file);
 }
 
@@ -1176,7 +1201,18 @@ void uvm_gpu_kref_put(uvm_gpu_t *gpu)
     nv_kref_put(&gpu->gpu_kref, uvm_gpu_destroy);
 }
 
+void uvm_gpu_add_fault_service_stats(uvm_gpu_t *gpu, const uvm_fault_service_stats_t *stats)
+{
+    gpu->fault_buffer_info.replayable.stats.num_prefetch_faults += stats->num_prefetch_faults;
+    gpu->fault_buffer_info.replayable.stats.num_read_faults += stats->num_read_faults;
+    gpu->fault_buffer_info.replayable.stats.num_write_faults += stats->num_write_faults;
+    gpu->fault_buffer_info.replayable.stats.num_atomic_faults += stats->num_atomic_faults;
+    gpu->fault_buffer_info.replayable.stats.num_duplicate_faults += stats->num_duplicate_faults;
+    gpu->stats.num_replayable_faults += stats->num_faults;
+}
+
 static void update_stats_gpu_fault_instance(uvm_gpu_t *gpu,
+                                            uvm_fault_service_stats_t *service_stats,
                                             const uvm_fault_buffer_entry_t *fault_entry,
                                             bool is_duplicate)
 {
@@ -1211,31 +1247,33 @@ static void update_stats_gpu_fault_instance(uvm_gpu_t *gpu,
     switch (fault_entry->fault_access_type)
     {
         case UVM_FAULT_ACCESS_TYPE_PREFETCH:
-            ++gpu->fault_buffer_info.replayable.stats.num_prefetch_faults;
+            ++service_stats->num_prefetch_faults;
             break;
         case UVM_FAULT_ACCESS_TYPE_READ:
-            ++gpu->fault_buffer_info.replayable.stats.num_read_faults;
+            ++service_stats->num_read_faults;
             break;
         case UVM_FAULT_ACCESS_TYPE_WRITE:
-            ++gpu->fault_buffer_info.replayable.stats.num_write_faults;
+            ++service_stats->num_write_faults;
             break;
         case UVM_FAULT_ACCESS_TYPE_ATOMIC_WEAK:
         case UVM_FAULT_ACCESS_TYPE_ATOMIC_STRONG:
-            ++gpu->fault_buffer_info.replayable.stats.num_atomic_faults;
+            ++service_stats->num_atomic_faults;
             break;
         default:
             break;
     }
     if (is_duplicate || fault_entry->filtered)
-        ++gpu->fault_buffer_info.replayable.stats.num_duplicate_faults;
+        ++service_stats->num_duplicate_faults;
 
-    ++gpu->stats.num_replayable_faults;
+    ++service_stats->num_faults;
 }
 
 static void update_stats_fault_cb(uvm_perf_event_t event_id, uvm_perf_event_data_t *event_data)
 {
     uvm_gpu_t *gpu;
     const uvm_fault_buffer_entry_t *fault_entry, *fault_instance;
+    uvm_fault_service_stats_t local_stats = { 0 };
+    uvm_fault_service_stats_t *service_stats;
 
     UVM_ASSERT(event_id == UVM_PERF_EVENT_FAULT);
 
@@ -1249,12 +1287,18 @@ static void update_stats_fault_cb(uvm_perf_event_t event_id, uvm_perf_event_data
 
     fault_entry = event_data->fault.gpu.buffer_entry;
 
+    // Fault service workers count the replayable faults in their own stats
+    service_stats = event_data->fault.gpu.stats ? event_data->fault.gpu.stats : &local_stats;
+
     // Update the stats using the representative fault entry and the rest of
     // instances
-    update_stats_gpu_fault_instance(gpu, fault_entry, event_data->fault.gpu.is_duplicate);
+    update_stats_gpu_fault_instance(gpu, service_stats, fault_entry, event_data->fault.gpu.is_duplicate);
 
     list_for_each_entry(fault_instance, &fault_entry->merged_instances_list, merged_instances_list)
-        update_stats_gpu_fault_instance(gpu, fault_instance, event_data->fault.gpu.is_duplicate);
+        update_stats_gpu_fault_instance(gpu, service_stats, fault_instance, event_data->fault.gpu.is_duplicate);
+
+    if (service_stats == &local_stats)
+        uvm_gpu_add_fault_service_stats(gpu, &local_stats);
 }
 
 static void update_stats_migration_cb(uvm_perf_event_t event_id, uvm_perf_event_data_t *event_data)
@@ -43,6 +43,7 @@
 #include "uvm8_hmm.h"
 #include "uvm8_va_block_types.h"
 #include "uvm8_perf_module.h"
+#include "uvm8_fault_phases.h"
 #include "uvm8_ats_ibm.h"
 #include "nv-kthread-q.h"
 
@@ -159,6 +160,44 @@ struct uvm_service_block_context_struct
 
     // State used by the VA block routines called by the servicing routine
     uvm_va_block_context_t block_context;
+
+    // UXU storage reads queued while servicing a replayable fault batch. They
+    // are submitted before the deferred blocks are serviced. NULL if the
+    // reads are submitted at once.
+    uvm_uxu_io_batch_t *uxu_io_batch;
+
+    // Whether the faults being serviced were already accounted when their
+    // block returned NV_ERR_BUSY_RETRY earlier in the same batch. Only used
+    // when servicing replayable faults.
+    bool deferred;
+};
+
+// UXU block whose storage I/O was started while servicing a fault batch. The
+// faults of the block are serviced once the I/O completes.
+typedef struct
+{
+    uvm_va_block_t *va_block;
+
+    // Index of the first fault of the block in ordered_fault_cache
+    NvU32 first_fault_index;
+} uvm_fault_deferred_block_t;
+
+// Counters of the replayable faults serviced by a fault service worker. They
+// are added to the statistics of the GPU when the partition of the worker is
+// merged back into the batch.
+struct uvm_fault_service_stats_struct
+{
+    NvU64 num_prefetch_faults;
+
+    NvU64 num_read_faults;
+
+    NvU64 num_write_faults;
+
+    NvU64 num_atomic_faults;
+
+    NvU64 num_duplicate_faults;
+
+    NvU64 num_faults;
 };
 
 struct uvm_fault_service_batch_context_struct
@@ -205,8 +244,60 @@ struct uvm_fault_service_batch_context_struct
 
     // Last fetched fault. Used for fault filtering.
     uvm_fault_buffer_entry_t *last_fault;
+
+    // UXU blocks waiting for storage I/O. They are serviced before the VA
+    // space lock is dropped. The number of elements in this array is exactly
+    // max_batch_size
+    uvm_fault_deferred_block_t *deferred_blocks;
+
+    NvU32 num_deferred_blocks;
+
+    // Counters of the faults serviced with this context. NULL if they are
+    // added to the statistics of the GPU directly.
+    uvm_fault_service_stats_t *stats;
 };
 
+// Kernel worker servicing a partition of a fault batch concurrently with the
+// bottom half. Partitions never split the faults of a VA block.
+typedef struct
+{
+    uvm_gpu_t *gpu;
+
+    nv_kthread_q_t q;
+
+    nv_kthread_q_item_t q_item;
+
+    // Signaled when the partition has been serviced
+    struct completion done;
+
+    // Partition of the ordered fault cache assigned to the worker. The VA
+    // space lock and mmap_sem are held by the bottom half on behalf of the
+    // worker until the partition is serviced.
+    uvm_va_space_t *va_space;
+
+    uvm_gpu_va_space_t *gpu_va_space;
+
+    struct mm_struct *mm;
+
+    NvU32 first_fault_index;
+
+    NvU32 end_fault_index;
+
+    // Private batch state. The fault cache arrays are shared with the batch
+    // being serviced. The uTLB state is a copy, whose fatal fault flags are
+    // merged back into the batch with the counters and the tracker before the
+    // replay is issued.
+    uvm_fault_service_batch_context_t batch_context;
+
+    // Fault statistics of the partition
+    uvm_fault_service_stats_t stats;
+
+    // Private context used to coalesce fault servicing in a VA block
+    uvm_service_block_context_t block_service_context;
+
+    NV_STATUS status;
+} uvm_fault_service_worker_t;
+
 struct uvm_ats_fault_invalidate_struct
 {
     // Whether the TLB batch contains any information
@@ -254,7 +345,8 @@ typedef struct
         // Fault statistics. These fields are per-GPU and most of them are only
         // updated during fault servicing, and can be safely incremented.
         // Migrations may be triggered by different GPUs and need to be
-        // incremented using atomics
+        // incremented using atomics. Fault service workers count their faults
+        // separately and the bottom half adds them here.
         struct
         {
             NvU64 num_prefetch_faults;
@@ -287,6 +379,12 @@ typedef struct
 
         // Information required to invalidate stale ATS PTEs from the GPU TLBs
         uvm_ats_fault_invalidate_t ats_invalidate;
+
+        // Workers that service partitions of a fault batch in parallel with
+        // the bottom half. See uvm_perf_fault_service_workers.
+        uvm_fault_service_worker_t *service_workers;
+
+        NvU32 num_service_workers;
     } replayable;
 
     struct uvm_non_replayable_fault_buffer_info_struct
@@ -824,9 +922,14 @@ struct uvm_gpu_struct
 
         struct proc_dir_entry *access_counters_file;
 
+        struct proc_dir_entry *fault_phases_file;
+
         struct proc_dir_entry *dir_peers;
     } procfs;
 
+    // Histograms of the time spent in each phase of fault servicing
+    uvm_fault_phases_t fault_phases;
+
     uvm_pmm_gpu_t pmm;
 
     uvm_pmm_sysmem_mappings_t pmm_sysmem_mappings;
@@ -1216,6 +1319,10 @@ NV_STATUS uvm_gpu_access_counter_entry_to_va_space(uvm_gpu_t *gpu,
                                                    uvm_access_counter_buffer_entry_t *entry,
                                                    uvm_va_space_t **out_va_space);
 
+// Add the counters of a fault service worker to the replayable fault
+// statistics of the GPU. Only called from the bottom half.
+void uvm_gpu_add_fault_service_stats(uvm_gpu_t *gpu, const uvm_fault_service_stats_t *stats);
+
 typedef enum
 {
     UVM_GPU_SWIZZLE_OP_SWIZZLE,
@@ -273,7 +273,8 @@ static NV_STATUS service_managed_fault_in_block_locked(uvm_gpu_t *gpu,
                                         gpu->id,
                                         fault_entry,
                                         ++non_replayable_faults->batch_id,
-                                        false);
+                                        false,
+                                        NULL);
     }
 
     // Check logical permissions
@@ -442,7 +443,8 @@ static NV_STATUS service_non_managed_fault(uvm_gpu_va_space_t *gpu_va_space,
                                     gpu->id,
                                     fault_entry,
                                     ++non_replayable_faults->batch_id,
-                                    false);
+                                    false,
+                                    NULL);
 
     if (status != NV_ERR_INVALID_ADDRESS)
         return status;
@@ -39,6 +39,7 @@
 #include "uvm8_ats_ibm.h"
 #include "uvm8_ats_faults.h"
 #include "uvm8_test.h"
+#include "uvm8_uxu.h"
 
 // TODO: Bug 1881601: [uvm] Add fault handling overview for replayable and
 // non-replayable faults
@@ -96,6 +97,106 @@ module_param(uvm_perf_fault_max_throttle_per_service, uint, S_IRUGO);
 static unsigned uvm_perf_fault_coalesce = 1;
 module_param(uvm_perf_fault_coalesce, uint, S_IRUGO);
 
+#define UVM_PERF_FAULT_SERVICE_WORKERS_DEFAULT 0
+#define UVM_PERF_FAULT_SERVICE_WORKERS_MAX 32
+
+// Number of kernel workers per GPU that service partitions of a fault batch
+// concurrently with the bottom half. Partitions are split at VA block
+// boundaries after the batch has been sorted. 0 services batches serially.
+// Workers are not used with UVM_PERF_FAULT_REPLAY_POLICY_BLOCK, which needs a
+// replay after each VA block, nor on GPUs without VA-wide fault cancel.
+static unsigned uvm_perf_fault_service_workers = UVM_PERF_FAULT_SERVICE_WORKERS_DEFAULT;
+module_param(uvm_perf_fault_service_workers, uint, S_IRUGO);
+
+static void fault_service_worker_entry(void *args);
+
+// Free the state of a worker whose queue is stopped or was never started
+static void fault_service_worker_free(uvm_fault_service_worker_t *worker)
+{
+    uxu_io_batch_destroy(worker->block_service_context.uxu_io_batch);
+    uvm_kvfree(worker->batch_context.deferred_blocks);
+    uvm_kvfree(worker->batch_context.utlbs);
+}
+
+static NV_STATUS fault_service_workers_init(uvm_gpu_t *gpu)
+{
+    uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
+    NvU32 num_workers = min(uvm_perf_fault_service_workers, (unsigned)UVM_PERF_FAULT_SERVICE_WORKERS_MAX);
+    NvU32 i;
+
+    if (num_workers != uvm_perf_fault_service_workers) {
+        pr_info("Invalid uvm_perf_fault_service_workers value on GPU %s: %u. Using %u instead\n",
+                gpu->name, uvm_perf_fault_service_workers, num_workers);
+    }
+
+    replayable_faults->num_service_workers = 0;
+    if (num_workers == 0)
+        return NV_OK;
+
+    replayable_faults->service_workers = uvm_kvmalloc_zero(num_workers * sizeof(*replayable_faults->service_workers));
+    if (!replayable_faults->service_workers)
+        return NV_ERR_NO_MEMORY;
+
+    for (i = 0; i < num_workers; ++i) {
+        uvm_fault_service_worker_t *worker = &replayable_faults->service_workers[i];
+        char kthread_name[TASK_COMM_LEN + 1];
+        NV_STATUS status;
+
+        // The uTLB state is copied from the batch, so that the fatal fault
+        // flags set by the worker are merged back without racing with the
+        // other threads
+        worker->batch_context.utlbs = uvm_kvmalloc_zero(replayable_faults->utlb_count *
+                                                        sizeof(*worker->batch_context.utlbs));
+        worker->batch_context.deferred_blocks = uvm_kvmalloc_zero(replayable_faults->max_faults *
+                                                                  sizeof(*worker->batch_context.deferred_blocks));
+        if (!worker->batch_context.utlbs || !worker->batch_context.deferred_blocks) {
+            fault_service_worker_free(worker);
+            return NV_ERR_NO_MEMORY;
+        }
+
+        status = uxu_io_batch_create(&worker->block_service_context.uxu_io_batch);
+        if (status != NV_OK) {
+            fault_service_worker_free(worker);
+            return status;
+        }
+
+        snprintf(kthread_name, sizeof(kthread_name), "UVM GPU%u FW%u", uvm_id_value(gpu->id), i);
+        status = errno_to_nv_status(nv_kthread_q_init(&worker->q, kthread_name));
+        if (status != NV_OK) {
+            fault_service_worker_free(worker);
+            return status;
+        }
+
+        worker->gpu = gpu;
+        worker->batch_context.stats = &worker->stats;
+        uvm_tracker_init(&worker->batch_context.tracker);
+        init_completion(&worker->done);
+        nv_kthread_q_item_init(&worker->q_item, fault_service_worker_entry, worker);
+
+        ++replayable_faults->num_service_workers;
+    }
+
+    return NV_OK;
+}
+
+static void fault_service_workers_deinit(uvm_gpu_t *gpu)
+{
+    uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
+    NvU32 i;
+
+    for (i = 0; i < replayable_faults->num_service_workers; ++i) {
+        uvm_fault_service_worker_t *worker = &replayable_faults->service_workers[i];
+
+        nv_kthread_q_stop(&worker->q);
+        uvm_tracker_deinit(&worker->batch_context.tracker);
+        fault_service_worker_free(worker);
+    }
+
+    uvm_kvfree(replayable_faults->service_workers);
+    replayable_faults->service_workers = NULL;
+    replayable_faults->num_service_workers = 0;
+}
+
 // This function is used for both the initial fault buffer initialization and
 // the power management resume path.
 static void fault_buffer_reinit_replayable_faults(uvm_gpu_t *gpu)
@@ -164,6 +265,19 @@ static NV_STATUS fault_buffer_init_replayable_faults(uvm_gpu_t *gpu)
     if (!batch_context->utlbs)
         return NV_ERR_NO_MEMORY;
 
+    batch_context->deferred_blocks = uvm_kvmalloc_zero(replayable_faults->max_faults *
+                                                       sizeof(*batch_context->deferred_blocks));
+    if (!batch_context->deferred_blocks)
+        return NV_ERR_NO_MEMORY;
+
+    status = uxu_io_batch_create(&replayable_faults->block_service_context.uxu_io_batch);
+    if (status != NV_OK)
+        return status;
+
+    status = fault_service_workers_init(gpu);
+    if (status != NV_OK)
+        return status;
+
     batch_context->max_utlb_id = 0;
 
     status = uvm_rm_locked_call(nvUvmInterfaceOwnPageFaultIntr(gpu->rm_device, NV_TRUE));
@@ -214,12 +328,18 @@ static void fault_buffer_deinit_replayable_faults(uvm_gpu_t *gpu)
             gpu->arch_hal->enable_prefetch_faults(gpu);
     }
 
+    fault_service_workers_deinit(gpu);
+
     uvm_kvfree(batch_context->fault_cache);
     uvm_kvfree(batch_context->ordered_fault_cache);
     uvm_kvfree(batch_context->utlbs);
+    uvm_kvfree(batch_context->deferred_blocks);
+    uxu_io_batch_destroy(replayable_faults->block_service_context.uxu_io_batch);
+    replayable_faults->block_service_context.uxu_io_batch = NULL;
     batch_context->fault_cache         = NULL;
     batch_context->ordered_fault_cache = NULL;
     batch_context->utlbs               = NULL;
+    batch_context->deferred_blocks     = NULL;
 }
 
 NV_STATUS uvm_gpu_fault_buffer_init(uvm_gpu_t *gpu)
@@ -435,6 +555,7 @@ static NV_STATUS push_replay_on_gpu(uvm_gpu_t *gpu, uvm_fault_replay_type_t type
     uvm_push_t push;
     uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
     uvm_tracker_t *tracker = NULL;
+    NvU64 phase_start = uvm_fault_phase_start();
 
     if (batch_context)
         tracker = &batch_context->tracker;
@@ -460,6 +581,8 @@ static NV_STATUS push_replay_on_gpu(uvm_gpu_t *gpu, uvm_fault_replay_type_t type
     // Add this push to the GPU's replay_tracker so cancel can wait on it.
     status = uvm_tracker_add_push_safe(&replayable_faults->replay_tracker, &push);
 
+    uvm_fault_phase_end(gpu, UVM_FAULT_PHASE_REPLAY, phase_start);
+
     if (uvm_procfs_is_debug_enabled()) {
         if (type == UVM_FAULT_REPLAY_TYPE_START)
             ++replayable_faults->stats.num_replays;
@@ -1069,6 +1192,8 @@ static uvm_fault_access_type_t check_fault_access_permissions(uvm_gpu_t *gpu,
 // Return codes:
 // - NV_OK if all faults were handled (both fatal and non-fatal)
 // - NV_ERR_MORE_PROCESSING_REQUIRED if servicing needs allocation retry
+// - NV_ERR_BUSY_RETRY if the block is a UXU block whose storage I/O has been
+//   started. No fault in the block has been serviced
 // - NV_ERR_NO_MEMORY if the faults could not be serviced due to OOM
 // - Any other value is a UVM-global error
 static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
@@ -1076,6 +1201,7 @@ static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
                                                               uvm_va_block_retry_t *va_block_retry,
                                                               NvU32 first_fault_index,
                                                               uvm_fault_service_batch_context_t *batch_context,
+                                                              uvm_service_block_context_t *block_context,
                                                               NvU32 *block_faults)
 {
     NV_STATUS status = NV_OK;
@@ -1084,9 +1210,7 @@ static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
     uvm_page_index_t last_page_index;
     NvU32 page_fault_count = 0;
     uvm_range_group_range_iter_t iter;
-    uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
     uvm_fault_buffer_entry_t **ordered_fault_cache = batch_context->ordered_fault_cache;
-    uvm_service_block_context_t *block_context = &replayable_faults->block_service_context;
     uvm_va_space_t *va_space;
 
     // Check that all uvm_fault_access_type_t values can fit into an NvU8
@@ -1144,13 +1268,14 @@ static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
             is_duplicate = current_entry->fault_address == previous_entry->fault_address;
         }
 
-        if (block_context->num_retries == 0) {
+        if (block_context->num_retries == 0 && !block_context->deferred) {
             uvm_perf_event_notify_gpu_fault(&va_space->perf_events,
                                             va_block,
                                             gpu->id,
                                             current_entry,
                                             batch_context->batch_id,
-                                            is_duplicate);
+                                            is_duplicate,
+                                            batch_context->stats);
         }
 
         // Service the most intrusive fault per page, only. Waive the rest
@@ -1250,7 +1375,7 @@ static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
         // Only update counters the first time since logical permissions cannot
         // change while we hold the VA space lock
         // TODO: Bug 1750144: That might not be true with HMM.
-        if (block_context->num_retries == 0) {
+        if (block_context->num_retries == 0 && !block_context->deferred) {
             uvm_fault_utlb_info_t *utlb = &batch_context->utlbs[current_entry->fault_source.utlb_id];
 
             if (current_entry->is_invalid_prefetch)
@@ -1295,20 +1420,27 @@ static NV_STATUS service_batch_managed_faults_in_block_locked(uvm_gpu_t *gpu,
 //
 // See the comments for function service_fault_batch_block_locked for
 // implementation details and error codes.
+//
+// is_deferred must be set when servicing a block that previously returned
+// NV_ERR_BUSY_RETRY in the same batch, so that fault events and statistics are
+// not accounted twice.
 static NV_STATUS service_batch_managed_faults_in_block(uvm_gpu_t *gpu,
                                                        struct mm_struct *mm,
                                                        uvm_va_block_t *va_block,
                                                        NvU32 first_fault_index,
                                                        uvm_fault_service_batch_context_t *batch_context,
+                                                       uvm_service_block_context_t *fault_block_context,
+                                                       bool is_deferred,
                                                        NvU32 *block_faults)
 {
     NV_STATUS status;
     uvm_va_block_retry_t va_block_retry;
     NV_STATUS tracker_status;
-    uvm_service_block_context_t *fault_block_context = &gpu->fault_buffer_info.replayable.block_service_context;
+    NvU64 phase_start = uvm_fault_phase_start();
 
     fault_block_context->operation = UVM_SERVICE_OPERATION_REPLAYABLE_FAULTS;
     fault_block_context->num_retries = 0;
+    fault_block_context->deferred = is_deferred;
     fault_block_context->block_context.mm = mm;
 
     uvm_mutex_lock(&va_block->lock);
@@ -1319,12 +1451,16 @@ static NV_STATUS service_batch_managed_faults_in_block(uvm_gpu_t *gpu,
                                                                                     &va_block_retry,
                                                                                     first_fault_index,
                                                                                     batch_context,
+                                                                                    fault_block_context,
                                                                                     block_faults));
 
     tracker_status = uvm_tracker_add_tracker_safe(&batch_context->tracker, &va_block->tracker);
 
     uvm_mutex_unlock(&va_block->lock);
 
+    if (status == NV_OK)
+        uvm_fault_phase_end(gpu, UVM_FAULT_PHASE_SERVICE, phase_start);
+
     return status == NV_OK? tracker_status: status;
 }
 
@@ -1338,6 +1474,58 @@ typedef enum
     FAULT_SERVICE_MODE_CANCEL,
 } fault_service_mode_t;
 
+// Service the UXU blocks whose storage I/O was started earlier in the batch.
+// The I/O has been overlapping with the servicing of the rest of the batch, and
+// it is waited for here without holding the block lock.
+//
+// This must be called before the VA space lock of the blocks is dropped, since
+// the lock keeps the deferred blocks alive.
+static NV_STATUS service_deferred_blocks(uvm_gpu_t *gpu,
+                                         struct mm_struct *mm,
+                                         uvm_fault_service_batch_context_t *batch_context,
+                                         uvm_service_block_context_t *block_context,
+                                         bool replay_per_va_block)
+{
+    NV_STATUS status = NV_OK;
+    NvU32 i;
+
+    // Start the reads of all the deferred blocks at once, in the order of
+    // their location on the storage
+    uxu_io_batch_submit(block_context->uxu_io_batch);
+
+    for (i = 0; i < batch_context->num_deferred_blocks; ++i) {
+        uvm_fault_deferred_block_t *deferred = &batch_context->deferred_blocks[i];
+        NvU32 block_faults;
+        NvU64 phase_start = uvm_fault_phase_start();
+
+        uxu_wait_block_io(deferred->va_block);
+        uvm_fault_phase_end(gpu, UVM_FAULT_PHASE_IO, phase_start);
+
+        status = service_batch_managed_faults_in_block(gpu,
+                                                       mm,
+                                                       deferred->va_block,
+                                                       deferred->first_fault_index,
+                                                       batch_context,
+                                                       block_context,
+                                                       true,
+                                                       &block_faults);
+        if (status != NV_OK)
+            break;
+
+        if (replay_per_va_block) {
+            status = push_replay_on_gpu(gpu, UVM_FAULT_REPLAY_TYPE_START, batch_context);
+            if (status != NV_OK)
+                break;
+
+            ++batch_context->batch_id;
+        }
+    }
+
+    batch_context->num_deferred_blocks = 0;
+
+    return status;
+}
+
 static NV_STATUS service_non_managed_fault(uvm_fault_buffer_entry_t *current_entry,
                                            const uvm_fault_buffer_entry_t *previous_entry,
                                            NV_STATUS lookup_status,
@@ -1374,7 +1562,8 @@ static NV_STATUS service_non_managed_fault(uvm_fault_buffer_entry_t *current_ent
                                     gpu_va_space->gpu->id,
                                     current_entry,
                                     batch_context->batch_id,
-                                    is_duplicate);
+                                    is_duplicate,
+                                    batch_context->stats);
 
     if (status != NV_ERR_INVALID_ADDRESS)
         return status;
@@ -1423,6 +1612,341 @@ static NV_STATUS service_non_managed_fault(uvm_fault_buffer_entry_t *current_ent
     return status;
 }
 
+// Scan the faults in ordered_fault_cache[first_index, end_index) and group them
+// by different va_blocks. Service faults for each va_block, in batch. All the
+// faults must belong to va_space, which must be locked in read mode.
+static NV_STATUS service_fault_batch_range(uvm_gpu_t *gpu,
+                                           uvm_va_space_t *va_space,
+                                           uvm_gpu_va_space_t *gpu_va_space,
+                                           struct mm_struct *mm,
+                                           uvm_fault_service_batch_context_t *batch_context,
+                                           uvm_service_block_context_t *block_context,
+                                           NvU32 first_index,
+                                           NvU32 end_index,
+                                           bool replay_per_va_block)
+{
+    NV_STATUS status = NV_OK;
+    NvU32 i;
+    uvm_ats_fault_invalidate_t *ats_invalidate = &gpu->fault_buffer_info.replayable.ats_invalidate;
+
+    batch_context->num_deferred_blocks = 0;
+
+    for (i = first_index; i < end_index;) {
+        uvm_va_block_t *va_block;
+        NvU32 block_faults;
+        uvm_fault_buffer_entry_t *current_entry = batch_context->ordered_fault_cache[i];
+        uvm_fault_utlb_info_t *utlb = &batch_context->utlbs[current_entry->fault_source.utlb_id];
+
+        UVM_ASSERT(current_entry->va_space == va_space);
+
+        // Some faults could be already fatal if they cannot be handled by
+        // the UVM driver
+        if (current_entry->is_fatal) {
+            ++i;
+            batch_context->has_fatal_faults = true;
+            utlb->has_fatal_faults = true;
+            UVM_ASSERT(utlb->num_pending_faults > 0);
+            continue;
+        }
+
+        if (!uvm_processor_mask_test(&va_space->registered_gpu_va_spaces, gpu->id)) {
+            // If there is no GPU VA space for the GPU, ignore the fault. This
+            // can happen if a GPU VA space is destroyed without explicitly
+            // freeing all memory ranges (destroying the VA range triggers a
+            // flush of the fault buffer) and there are stale entries in the
+            // buffer that got fixed by the servicing in a previous batch.
+            ++i;
+            continue;
+        }
+
+        // TODO: Bug 2103669: Service more than one ATS fault at a time so we
+        //       don't do an unconditional VA range lookup for every ATS fault.
+        status = uvm_va_block_find_create(current_entry->va_space, current_entry->fault_address, &va_block);
+        if (status == NV_OK) {
+            status = service_batch_managed_faults_in_block(gpu,
+                                                           mm,
+                                                           va_block,
+                                                           i,
+                                                           batch_context,
+                                                           block_context,
+                                                           false,
+                                                           &block_faults);
+
+            // Storage I/O is in flight for this UXU block. Move on to the
+            // next block and come back once the rest of the range is done.
+            if (status == NV_ERR_BUSY_RETRY) {
+                uvm_fault_deferred_block_t *deferred = &batch_context->deferred_blocks[batch_context->num_deferred_blocks++];
+
+                deferred->va_block = va_block;
+                deferred->first_fault_index = i;
+
+                i += block_faults;
+                status = NV_OK;
+                continue;
+            }
+
+            // When service_batch_managed_faults_in_block returns != NV_OK
+            // something really bad happened
+            if (status != NV_OK)
+                goto fail;
+
+            i += block_faults;
+        }
+        else {
+            const uvm_fault_buffer_entry_t *previous_entry = i == first_index? NULL : batch_context->ordered_fault_cache[i - 1];
+
+            status = service_non_managed_fault(current_entry,
+                                               previous_entry,
+                                               status,
+                                               gpu_va_space,
+                                               mm,
+                                               batch_context,
+                                               ats_invalidate,
+                                               utlb);
+
+            // When service_non_managed_fault returns != NV_OK something really
+            // bad happened
+            if (status != NV_OK)
+                goto fail;
+
+            ++i;
+            continue;
+        }
+
+        // Don't issue replays in cancel mode
+        if (replay_per_va_block) {
+            status = push_replay_on_gpu(gpu, UVM_FAULT_REPLAY_TYPE_START, batch_context);
+            if (status != NV_OK)
+                goto fail;
+
+            // Increment the batch id if UVM_PERF_FAULT_REPLAY_POLICY_BLOCK
+            // is used, as we issue a replay after servicing each VA block
+            // and we can service a number of VA blocks before returning.
+            ++batch_context->batch_id;
+        }
+    }
+
+    return service_deferred_blocks(gpu, mm, batch_context, block_context, replay_per_va_block);
+
+fail:
+    // Faults of blocks that were not serviced are left for the GPU to refault.
+    // Their reads are still started, the refaults will need the data.
+    uxu_io_batch_submit(block_context->uxu_io_batch);
+    batch_context->num_deferred_blocks = 0;
+
+    return status;
+}
+
+static void fault_service_worker(uvm_fault_service_worker_t *worker)
+{
+    uvm_va_space_t *va_space = worker->va_space;
+
+    // The locks are held by the bottom half, which waits for this partition
+    // to be serviced before dropping them
+    if (worker->mm)
+        uvm_record_lock_mmap_sem_read_inherited(&worker->mm->mmap_sem);
+    uvm_record_lock_read_inherited(&va_space->lock);
+
+    worker->status = service_fault_batch_range(worker->gpu,
+                                               va_space,
+                                               worker->gpu_va_space,
+                                               worker->mm,
+                                               &worker->batch_context,
+                                               &worker->block_service_context,
+                                               worker->first_fault_index,
+                                               worker->end_fault_index,
+                                               false);
+
+    uvm_record_unlock_read_inherited(&va_space->lock);
+    if (worker->mm)
+        uvm_record_unlock_mmap_sem_read_inherited(&worker->mm->mmap_sem);
+
+    complete(&worker->done);
+}
+
+static void fault_service_worker_entry(void *args)
+{
+    UVM_ENTRY_VOID(fault_service_worker((uvm_fault_service_worker_t *)args));
+}
+
+static void fault_service_worker_dispatch(uvm_fault_service_worker_t *worker,
+                                          uvm_va_space_t *va_space,
+                                          uvm_gpu_va_space_t *gpu_va_space,
+                                          struct mm_struct *mm,
+                                          uvm_fault_service_batch_context_t *batch_context,
+                                          NvU32 first_index,
+                                          NvU32 end_index)
+{
+    uvm_fault_service_batch_context_t *worker_batch = &worker->batch_context;
+    NvU32 i;
+
+    worker->va_space = va_space;
+    worker->gpu_va_space = gpu_va_space;
+    worker->mm = mm;
+    worker->first_fault_index = first_index;
+    worker->end_fault_index = end_index;
+
+    worker_batch->fault_cache = batch_context->fault_cache;
+    worker_batch->ordered_fault_cache = batch_context->ordered_fault_cache;
+    worker_batch->max_utlb_id = batch_context->max_utlb_id;
+    worker_batch->batch_id = batch_context->batch_id;
+
+    // The pending fault counts are only read by the worker
+    memcpy(worker_batch->utlbs, batch_context->utlbs, (batch_context->max_utlb_id + 1) * sizeof(*worker_batch->utlbs));
+    for (i = 0; i <= worker_batch->max_utlb_id; ++i)
+        worker_batch->utlbs[i].has_fatal_faults = false;
+    memset(&worker->stats, 0, sizeof(worker->stats));
+
+    // The block scan in service_batch_managed_faults_in_block_locked stops at
+    // the end of the partition
+    worker_batch->num_coalesced_faults = end_index;
+
+    worker_batch->has_fatal_faults = false;
+    worker_batch->has_throttled_faults = false;
+    worker_batch->num_invalid_prefetch_faults = 0;
+    worker_batch->num_duplicate_faults = 0;
+    uvm_tracker_clear(&worker_batch->tracker);
+
+    reinit_completion(&worker->done);
+    nv_kthread_q_schedule_q_item(&worker->q, &worker->q_item);
+}
+
+// Wait for the worker and merge its results into the batch
+static NV_STATUS fault_service_worker_merge(uvm_fault_service_worker_t *worker,
+                                            uvm_fault_service_batch_context_t *batch_context)
+{
+    uvm_fault_service_batch_context_t *worker_batch = &worker->batch_context;
+    NV_STATUS tracker_status;
+    NvU32 i;
+
+    wait_for_completion(&worker->done);
+
+    for (i = 0; i <= worker_batch->max_utlb_id; ++i) {
+        if (worker_batch->utlbs[i].has_fatal_faults)
+            batch_context->utlbs[i].has_fatal_faults = true;
+    }
+
+    uvm_gpu_add_fault_service_stats(worker->gpu, &worker->stats);
+
+    if (worker_batch->has_fatal_faults)
+        batch_context->has_fatal_faults = true;
+    if (worker_batch->has_throttled_faults)
+        batch_context->has_throttled_faults = true;
+    batch_context->num_invalid_prefetch_faults += worker_batch->num_invalid_prefetch_faults;
+    batch_context->num_duplicate_faults += worker_batch->num_duplicate_faults;
+
+    tracker_status = uvm_tracker_add_tracker_safe(&batch_context->tracker, &worker_batch->tracker);
+    uvm_tracker_clear(&worker_batch->tracker);
+
+    return worker->status == NV_OK? tracker_status : worker->status;
+}
+
+// Compute the end of a partition of about partition_size faults starting at
+// first_index. Faults in the same VA block alignment window are kept in the
+// same partition so that a VA block is only serviced by one thread.
+static NvU32 fault_batch_partition_end(uvm_fault_service_batch_context_t *batch_context,
+                                       NvU32 first_index,
+                                       NvU32 end_index,
+                                       NvU32 partition_size)
+{
+    uvm_fault_buffer_entry_t **ordered_fault_cache = batch_context->ordered_fault_cache;
+    NvU32 i = min(first_index + partition_size, end_index);
+
+    while (i < end_index &&
+           UVM_VA_BLOCK_ALIGN_DOWN(ordered_fault_cache[i]->fault_address) ==
+           UVM_VA_BLOCK_ALIGN_DOWN(ordered_fault_cache[i - 1]->fault_address)) {
+        ++i;
+    }
+
+    return i;
+}
+
+// Same as service_fault_batch_range, but the range is partitioned and the
+// partitions are serviced concurrently by the bottom half and the GPU fault
+// service workers. All the results are merged back into batch_context before
+// returning.
+static NV_STATUS service_fault_batch_range_parallel(uvm_gpu_t *gpu,
+                                                    uvm_va_space_t *va_space,
+                                                    uvm_gpu_va_space_t *gpu_va_space,
+                                                    struct mm_struct *mm,
+                                                    uvm_fault_service_batch_context_t *batch_context,
+                                                    NvU32 first_index,
+                                                    NvU32 end_index)
+{
+    uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
+    NvU32 num_partitions = min(replayable_faults->num_service_workers + 1, end_index - first_index);
+    NvU32 partition_size = DIV_ROUND_UP(end_index - first_index, num_partitions);
+    NvU32 own_end_index = fault_batch_partition_end(batch_context, first_index, end_index, partition_size);
+    NvU32 start_index = own_end_index;
+    NvU32 num_dispatched = 0;
+    NV_STATUS status;
+    NvU32 i;
+
+    while (start_index < end_index) {
+        uvm_fault_service_worker_t *worker = &replayable_faults->service_workers[num_dispatched++];
+        NvU32 worker_end_index = end_index;
+
+        if (num_dispatched < replayable_faults->num_service_workers)
+            worker_end_index = fault_batch_partition_end(batch_context, start_index, end_index, partition_size);
+
+        fault_service_worker_dispatch(worker,
+                                      va_space,
+                                      gpu_va_space,
+                                      mm,
+                                      batch_context,
+                                      start_index,
+                                      worker_end_index);
+        start_index = worker_end_index;
+    }
+
+    status = service_fault_batch_range(gpu,
+                                       va_space,
+                                       gpu_va_space,
+                                       mm,
+                                       batch_context,
+                                       &replayable_faults->block_service_context,
+                                       first_index,
+                                       own_end_index,
+                                       false);
+
+    // Always wait for all the workers, since they rely on the locks held by
+    // this thread
+    for (i = 0; i < num_dispatched; ++i) {
+        NV_STATUS worker_status = fault_service_worker_merge(&replayable_faults->service_workers[i], batch_context);
+        if (status == NV_OK)
+            status = worker_status;
+    }
+
+    return status;
+}
+
+static bool fault_batch_use_service_workers(uvm_gpu_t *gpu,
+                                            fault_service_mode_t service_mode,
+                                            uvm_gpu_va_space_t *gpu_va_space,
+                                            struct mm_struct *mm)
+{
+    uvm_replayable_fault_buffer_info_t *replayable_faults = &gpu->fault_buffer_info.replayable;
+
+    if (replayable_faults->num_service_workers == 0)
+        return false;
+
+    // Replays are issued per VA block in these modes
+    if (service_mode == FAULT_SERVICE_MODE_CANCEL ||
+        replayable_faults->replay_policy == UVM_PERF_FAULT_REPLAY_POLICY_BLOCK)
+        return false;
+
+    // Without VA-wide cancel, fatal faults in any block of the batch require
+    // splitting the PTEs of the blocks serviced after them
+    if (!gpu->fault_cancel_va_supported)
+        return false;
+
+    // ATS faults share the per-GPU TLB invalidation batch
+    if (!gpu_va_space || uvm_can_ats_service_faults(gpu_va_space, mm))
+        return false;
+
+    return true;
+}
+
 // Scan the ordered view of faults and group them by different va_blocks.
 // Service faults for each va_block, in batch.
 //
@@ -1447,10 +1971,8 @@ static NV_STATUS service_fault_batch(uvm_gpu_t *gpu,
     ats_invalidate->write_faults_in_batch = false;
 
     for (i = 0; i < batch_context->num_coalesced_faults;) {
-        uvm_va_block_t *va_block;
-        NvU32 block_faults;
+        NvU32 end_index;
         uvm_fault_buffer_entry_t *current_entry = batch_context->ordered_fault_cache[i];
-        uvm_fault_utlb_info_t *utlb = &batch_context->utlbs[current_entry->fault_source.utlb_id];
 
         UVM_ASSERT(current_entry->va_space);
 
@@ -1506,76 +2028,39 @@ static NV_STATUS service_fault_batch(uvm_gpu_t *gpu,
             // VA space is handled next
         }
 
-        // Some faults could be already fatal if they cannot be handled by
-        // the UVM driver
-        if (current_entry->is_fatal) {
-            ++i;
-            batch_context->has_fatal_faults = true;
-            utlb->has_fatal_faults = true;
-            UVM_ASSERT(utlb->num_pending_faults > 0);
-            continue;
-        }
-
-        if (!uvm_processor_mask_test(&va_space->registered_gpu_va_spaces, gpu->id)) {
-            // If there is no GPU VA space for the GPU, ignore the fault. This
-            // can happen if a GPU VA space is destroyed without explicitly
-            // freeing all memory ranges (destroying the VA range triggers a
-            // flush of the fault buffer) and there are stale entries in the
-            // buffer that got fixed by the servicing in a previous batch.
-            ++i;
-            continue;
-        }
-
-        // TODO: Bug 2103669: Service more than one ATS fault at a time so we
-        //       don't do an unconditional VA range lookup for every ATS fault.
-        status = uvm_va_block_find_create(current_entry->va_space, current_entry->fault_address, &va_block);
-        if (status == NV_OK) {
-            status = service_batch_managed_faults_in_block(gpu,
-                                                           mm,
-                                                           va_block,
-                                                           i,
-                                                           batch_context,
-                                                           &block_faults);
-
-            // When service_batch_managed_faults_in_block returns != NV_OK
-            // something really bad happened
-            if (status != NV_OK)
-                goto fail;
-
-            i += block_faults;
+        // Faults are sorted by VA space, so all the faults of this VA space
+        // are contiguous
+        for (end_index = i + 1;
+             end_index < batch_context->num_coalesced_faults &&
+             batch_context->ordered_fault_cache[end_index]->va_space == va_space;
+             ++end_index)
+            ;
+
+        if (fault_batch_use_service_workers(gpu, service_mode, gpu_va_space, mm)) {
+            status = service_fault_batch_range_parallel(gpu,
+                                                        va_space,
+                                                        gpu_va_space,
+                                                        mm,
+                                                        batch_context,
+                                                        i,
+                                                        end_index);
         }
         else {
-            const uvm_fault_buffer_entry_t *previous_entry = i == 0? NULL : batch_context->ordered_fault_cache[i - 1];
-
-            status = service_non_managed_fault(current_entry,
-                                               previous_entry,
-                                               status,
+            status = service_fault_batch_range(gpu,
+                                               va_space,
                                                gpu_va_space,
                                                mm,
                                                batch_context,
-                                               ats_invalidate,
-                                               utlb);
-
-            // When service_non_managed_fault returns != NV_OK something really
-            // bad happened
-            if (status != NV_OK)
-                goto fail;
-
-            ++i;
-            continue;
+                                               &gpu->fault_buffer_info.replayable.block_service_context,
+                                               i,
+                                               end_index,
+                                               replay_per_va_block);
         }
 
-        // Don't issue replays in cancel mode
-        if (replay_per_va_block) {
-            status = push_replay_on_gpu(gpu, UVM_FAULT_REPLAY_TYPE_START, batch_context);
-            if (status != NV_OK)
-                goto fail;
+        if (status != NV_OK)
+            goto fail;
 
-            // Increment the batch id if UVM_PERF_FAULT_REPLAY_POLICY_BLOCK
-            // is used, as we issue a replay after servicing each VA block
-            // and we can service a number of VA blocks before returning.
-            ++batch_context->batch_id;
-        }
+        i = end_index;
     }
 
     // Only clobber status if invalidate_status != NV_OK, since status may also
@@ -24,6 +24,7 @@
 #include "uvm_common.h"
 #include "uvm_linux.h"
 #include "uvm8_kvmalloc.h"
+#include "uvm8_procfs.h"
 
 // To implement realloc for vmalloc-based allocations we need to track the size
 // of the original allocation. We can do that by allocating a header along with
@@ -75,6 +76,10 @@ static struct
     struct radix_tree_root allocation_info;
 
     struct kmem_cache *info_cache;
+
+    // List of all the object pools, protected by pools_lock
+    struct list_head pools;
+    spinlock_t pools_lock;
 } g_uvm_leak_checker;
 
 // Default to byte-count-only leak checking for non-release builds. This can
@@ -90,6 +95,9 @@ MODULE_PARM_DESC(uvm_leak_checker,
 
 NV_STATUS uvm_kvmalloc_init(void)
 {
+    INIT_LIST_HEAD(&g_uvm_leak_checker.pools);
+    spin_lock_init(&g_uvm_leak_checker.pools_lock);
+
     if (uvm_leak_checker >= UVM_KVMALLOC_LEAK_CHECK_ORIGIN) {
         spin_lock_init(&g_uvm_leak_checker.lock);
         uvm_init_radix_tree_preloadable(&g_uvm_leak_checker.allocation_info);
@@ -108,6 +116,10 @@ void uvm_kvmalloc_exit(void)
     if (!g_malloc_initialized)
         return;
 
+    // All pools are expected to be destroyed by their owners by now. Leaked
+    // pool objects are reported by uvm_kvmalloc_pool_destroy.
+    UVM_ASSERT(list_empty(&g_uvm_leak_checker.pools));
+
     if (atomic_long_read(&g_uvm_leak_checker.bytes_allocated) > 0) {
         printk(KERN_ERR NVIDIA_UVM_PRETTY_PRINTING_PREFIX "!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
         printk(KERN_ERR NVIDIA_UVM_PRETTY_PRINTING_PREFIX "Memory leak of %lu bytes detected.%s\n",
@@ -410,3 +422,109 @@ size_t uvm_kvsize(void *p)
         return get_hdr(p)->alloc_size;
     return ksize(p);
 }
+
+NV_STATUS uvm_kvmalloc_pool_create(uvm_kvmalloc_pool_t *pool, const char *name, size_t object_size, void (*ctor)(void *))
+{
+    UVM_ASSERT(g_malloc_initialized);
+    UVM_ASSERT(!pool->cache);
+
+    pool->name = name;
+    pool->object_size = object_size;
+    pool->has_ctor = ctor != NULL;
+    atomic_long_set(&pool->objects_in_use, 0);
+    atomic_long_set(&pool->allocations, 0);
+
+    // Caches with a constructor can't be merged, so use the dummy constructor
+    // in the same way as NV_KMEM_CACHE_CREATE when none is provided.
+    pool->cache = kmem_cache_create(name, object_size, 0, 0, ctor ? ctor : nv_kmem_ctor_dummy);
+    if (!pool->cache)
+        return NV_ERR_NO_MEMORY;
+
+    spin_lock(&g_uvm_leak_checker.pools_lock);
+    list_add_tail(&pool->list_node, &g_uvm_leak_checker.pools);
+    spin_unlock(&g_uvm_leak_checker.pools_lock);
+
+    return NV_OK;
+}
+
+void uvm_kvmalloc_pool_destroy(uvm_kvmalloc_pool_t *pool)
+{
+    long in_use;
+
+    if (!pool->cache)
+        return;
+
+    spin_lock(&g_uvm_leak_checker.pools_lock);
+    list_del(&pool->list_node);
+    spin_unlock(&g_uvm_leak_checker.pools_lock);
+
+    in_use = atomic_long_read(&pool->objects_in_use);
+    if (in_use != 0) {
+        printk(KERN_ERR NVIDIA_UVM_PRETTY_PRINTING_PREFIX "!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+        printk(KERN_ERR NVIDIA_UVM_PRETTY_PRINTING_PREFIX "Memory leak of %ld objects (%zu bytes each) detected in pool %s.\n",
+               in_use,
+               pool->object_size,
+               pool->name);
+        printk(KERN_ERR NVIDIA_UVM_PRETTY_PRINTING_PREFIX "!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+    }
+
+    kmem_cache_destroy_safe(&pool->cache);
+}
+
+void *uvm_kvmalloc_pool_alloc(uvm_kvmalloc_pool_t *pool)
+{
+    void *p = kmem_cache_alloc(pool->cache, NV_UVM_GFP_FLAGS);
+
+    if (p) {
+        atomic_long_inc(&pool->objects_in_use);
+        atomic_long_inc(&pool->allocations);
+    }
+
+    return p;
+}
+
+void *uvm_kvmalloc_pool_alloc_zero(uvm_kvmalloc_pool_t *pool)
+{
+    void *p;
+
+    // Zeroing would override the state set up by the constructor
+    UVM_ASSERT(!pool->has_ctor);
+
+    p = nv_kmem_cache_zalloc(pool->cache, NV_UVM_GFP_FLAGS);
+    if (p) {
+        atomic_long_inc(&pool->objects_in_use);
+        atomic_long_inc(&pool->allocations);
+    }
+
+    return p;
+}
+
+void uvm_kvmalloc_pool_free(uvm_kvmalloc_pool_t *pool, void *p)
+{
+    if (!p)
+        return;
+
+    UVM_ASSERT(atomic_long_read(&pool->objects_in_use) > 0);
+    atomic_long_dec(&pool->objects_in_use);
+
+    kmem_cache_free(pool->cache, p);
+}
+
+void uvm_kvmalloc_pools_print(struct seq_file *s)
+{
+    uvm_kvmalloc_pool_t *pool;
+
+    UVM_SEQ_OR_DBG_PRINT(s, "kvmalloc_bytes        %ld\n", atomic_long_read(&g_uvm_leak_checker.bytes_allocated));
+
+    spin_lock(&g_uvm_leak_checker.pools_lock);
+    list_for_each_entry(pool, &g_uvm_leak_checker.pools, list_node) {
+        long in_use = atomic_long_read(&pool->objects_in_use);
+
+        UVM_SEQ_OR_DBG_PRINT(s, "pool %s\n", pool->name);
+        UVM_SEQ_OR_DBG_PRINT(s, "  object_size         %zu\n", pool->object_size);
+        UVM_SEQ_OR_DBG_PRINT(s, "  objects_in_use      %ld\n", in_use);
+        UVM_SEQ_OR_DBG_PRINT(s, "  bytes_in_use        %ld\n", in_use * (long)pool->object_size);
+        UVM_SEQ_OR_DBG_PRINT(s, "  allocations         %ld\n", atomic_long_read(&pool->allocations));
+    }
+    spin_unlock(&g_uvm_leak_checker.pools_lock);
+}
@@ -70,6 +70,54 @@ void *__uvm_kvrealloc(void *p, size_t new_size, const char *file, int line, cons
 // p must not be NULL.
 size_t uvm_kvsize(void *p);
 
+// Object pools for fixed-size objects which are allocated and freed at a high
+// rate, like VA blocks which UXU reclaims and recreates continuously. Each pool
+// is backed by a dedicated kmem_cache, so objects are recycled through the
+// slab allocator's per-CPU freelists instead of the general-purpose kmalloc
+// caches. Pool occupancy is tracked and reported by the leak checker.
+//
+// If a constructor is provided, it is called only when the slab allocator
+// populates a new slab page, not on every allocation. In that case objects
+// must be returned to the pool in the state left by the constructor, which
+// allows for example to hand out zeroed objects without clearing them on
+// every allocation.
+typedef struct
+{
+    const char *name;
+
+    size_t object_size;
+
+    struct kmem_cache *cache;
+
+    bool has_ctor;
+
+    // Objects currently allocated from the pool
+    atomic_long_t objects_in_use;
+
+    // Total number of allocations from the pool
+    atomic_long_t allocations;
+
+    // Entry in the global list of pools
+    struct list_head list_node;
+} uvm_kvmalloc_pool_t;
+
+// The name must remain valid until the pool is destroyed.
+NV_STATUS uvm_kvmalloc_pool_create(uvm_kvmalloc_pool_t *pool, const char *name, size_t object_size, void (*ctor)(void *));
+
+// Destroying a pool which has not been created is a no-op
+void uvm_kvmalloc_pool_destroy(uvm_kvmalloc_pool_t *pool);
+
+void *uvm_kvmalloc_pool_alloc(uvm_kvmalloc_pool_t *pool);
+
+// Not supported for pools with a constructor
+void *uvm_kvmalloc_pool_alloc_zero(uvm_kvmalloc_pool_t *pool);
+
+void uvm_kvmalloc_pool_free(uvm_kvmalloc_pool_t *pool, void *p);
+
+// Print the occupancy of all the pools to the given seq_file, or to the kernel
+// log if s is NULL.
+void uvm_kvmalloc_pools_print(struct seq_file *s);
+
 NV_STATUS uvm8_test_kvmalloc(UVM_TEST_KVMALLOC_PARAMS *params, struct file *filp);
 
 #endif // __UVM8_KVMALLOC_H__
@@ -24,6 +24,8 @@
 #include "uvm8_lock.h"
 #include "uvm8_thread_context.h"
 #include "uvm8_kvmalloc.h"
+#include "uvm8_global.h"
+#include "uvm8_procfs.h"
 
 const char *uvm_lock_order_to_string(uvm_lock_order_t lock_order)
 {
@@ -369,3 +371,168 @@ void uvm_bit_locks_deinit(uvm_bit_locks_t *bit_locks)
     kfree(bit_locks->bits);
     memset(bit_locks, 0, sizeof(*bit_locks));
 }
+
+#if UVM_LOCK_STATS
+
+// Enable the accounting of lock acquisitions at load time
+static unsigned uvm_lock_stats = 0;
+module_param(uvm_lock_stats, uint, S_IRUGO);
+
+#if defined(DECLARE_STATIC_KEY_FALSE)
+DEFINE_STATIC_KEY_FALSE(g_uvm_lock_stats_key);
+
+static void lock_stats_set_enabled(bool enabled)
+{
+    if (enabled)
+        static_branch_enable(&g_uvm_lock_stats_key);
+    else
+        static_branch_disable(&g_uvm_lock_stats_key);
+}
+#else
+bool g_uvm_lock_stats_key;
+
+static void lock_stats_set_enabled(bool enabled)
+{
+    WRITE_ONCE(g_uvm_lock_stats_key, enabled);
+}
+#endif
+
+typedef struct
+{
+    NvU64 acquisitions;
+    NvU64 contended;
+    NvU64 wait_ns;
+    NvU64 max_wait_ns;
+    NvU64 holds;
+    NvU64 hold_ns;
+    NvU64 max_hold_ns;
+} uvm_lock_stats_t;
+
+// The statistics are kept per CPU so that the accounting does not add
+// contention of its own. Spinlocks are also taken from interrupt context, so
+// the updates are done with interrupts disabled.
+static DEFINE_PER_CPU(uvm_lock_stats_t, g_uvm_lock_stats[UVM_LOCK_ORDER_COUNT]);
+
+static struct proc_dir_entry *g_uvm_lock_stats_procfs_file;
+
+NvU64 __uvm_lock_stats_acquired(uvm_lock_order_t lock_order, NvU64 wait_start)
+{
+    NvU64 now = NV_GETTIME();
+    uvm_lock_stats_t *stats;
+    unsigned long flags;
+
+    if (lock_order >= UVM_LOCK_ORDER_COUNT)
+        return 0;
+
+    local_irq_save(flags);
+    stats = &this_cpu_ptr(g_uvm_lock_stats)[lock_order];
+    stats->acquisitions++;
+    if (wait_start != 0) {
+        NvU64 wait_ns = now - wait_start;
+
+        stats->contended++;
+        stats->wait_ns += wait_ns;
+        stats->max_wait_ns = max(stats->max_wait_ns, wait_ns);
+    }
+    local_irq_restore(flags);
+
+    return now;
+}
+
+void __uvm_lock_stats_released(uvm_lock_order_t lock_order, NvU64 acquired)
+{
+    uvm_lock_stats_t *stats;
+    unsigned long flags;
+    NvU64 hold_ns;
+
+    // Acquired while the statistics were disabled
+    if (acquired == 0 || lock_order >= UVM_LOCK_ORDER_COUNT)
+        return;
+
+    hold_ns = NV_GETTIME() - acquired;
+
+    local_irq_save(flags);
+    stats = &this_cpu_ptr(g_uvm_lock_stats)[lock_order];
+    stats->holds++;
+    stats->hold_ns += hold_ns;
+    stats->max_hold_ns = max(stats->max_hold_ns, hold_ns);
+    local_irq_restore(flags);
+}
+
+static int nv_procfs_read_lock_stats(struct seq_file *s, void *v)
+{
+    uvm_lock_order_t lock_order;
+
+    if (!uvm_down_read_trylock(&g_uvm_global.pm.lock))
+        return -EAGAIN;
+
+    UVM_SEQ_OR_DBG_PRINT(s, "enabled %u\n", uvm_lock_stats_enabled() ? 1 : 0);
+    UVM_SEQ_OR_DBG_PRINT(s, "%-60s %12s %12s %14s %12s %14s %12s\n",
+                         "lock_order", "acquired", "contended", "wait_ns", "max_wait_ns", "hold_ns", "max_hold_ns");
+
+    for (lock_order = UVM_LOCK_ORDER_INVALID + 1; lock_order < UVM_LOCK_ORDER_COUNT; lock_order++) {
+        uvm_lock_stats_t total = {0};
+        int cpu;
+
+        for_each_possible_cpu(cpu) {
+            uvm_lock_stats_t *stats = &per_cpu_ptr(g_uvm_lock_stats, cpu)[lock_order];
+
+            total.acquisitions += READ_ONCE(stats->acquisitions);
+            total.contended += READ_ONCE(stats->contended);
+            total.wait_ns += READ_ONCE(stats->wait_ns);
+            total.max_wait_ns = max(total.max_wait_ns, READ_ONCE(stats->max_wait_ns));
+            total.holds += READ_ONCE(stats->holds);
+            total.hold_ns += READ_ONCE(stats->hold_ns);
+            total.max_hold_ns = max(total.max_hold_ns, READ_ONCE(stats->max_hold_ns));
+        }
+
+        if (total.acquisitions == 0)
+            continue;
+
+        UVM_SEQ_OR_DBG_PRINT(s, "%-60s %12llu %12llu %14llu %12llu %14llu %12llu\n",
+                             uvm_lock_order_to_string(lock_order),
+                             total.acquisitions,
+                             total.contended,
+                             total.wait_ns,
+                             total.max_wait_ns,
+                             total.hold_ns,
+                             total.max_hold_ns);
+    }
+
+    uvm_up_read(&g_uvm_global.pm.lock);
+
+    return 0;
+}
+
+static int nv_procfs_read_lock_stats_entry(struct seq_file *s, void *v)
+{
+    UVM_ENTRY_RET(nv_procfs_read_lock_stats(s, v));
+}
+
+UVM_DEFINE_SINGLE_PROCFS_FILE(lock_stats_entry);
+
+NV_STATUS uvm_lock_stats_init(void)
+{
+    lock_stats_set_enabled(uvm_lock_stats != 0);
+
+    if (!uvm_procfs_is_enabled())
+        return NV_OK;
+
+    g_uvm_lock_stats_procfs_file = NV_CREATE_PROC_FILE("lock_stats",
+                                                       uvm_procfs_get_cpu_base_dir(),
+                                                       lock_stats_entry,
+                                                       NULL);
+    if (g_uvm_lock_stats_procfs_file == NULL)
+        return NV_ERR_OPERATING_SYSTEM;
+
+    return NV_OK;
+}
+
+void uvm_lock_stats_exit(void)
+{
+    uvm_procfs_destroy_entry(g_uvm_lock_stats_procfs_file);
+    g_uvm_lock_stats_procfs_file = NULL;
+    lock_stats_set_enabled(false);
+}
+
+#endif // UVM_LOCK_STATS
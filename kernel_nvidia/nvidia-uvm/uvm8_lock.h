@@ -27,6 +27,7 @@
 #include "uvm8_forward_decl.h"
 #include "uvm_linux.h"
 #include "uvm_common.h"
+#include <linux/jump_label.h>
 
 // --------------------------- UVM Locking Order ---------------------------- //
 //
@@ -429,6 +430,103 @@ bool __uvm_thread_check_all_unlocked(void);
 // Check that the locking infrastructure has been initialized
 bool __uvm_locking_initialized(void);
 
+// Lock statistics
+//
+// When built with UVM_LOCK_STATS=1, the acquisitions of uvm_mutex_t,
+// uvm_rw_semaphore_t and uvm_spinlock_t are accounted per lock order: number
+// of acquisitions, how many of them had to wait, total and max wait time, and
+// total and max hold time. Hold times are only known for exclusive
+// acquisitions, and successful trylocks are accounted as uncontended. The
+// accounting is enabled at runtime with the uvm_lock_stats module parameter and
+// the statistics are read from /proc/driver/nvidia-uvm/cpu/lock_stats.
+//
+// uvm_spinlock_irqsave_t, uvm_rwlock_irqsave_t and uvm_semaphore_t are not
+// accounted, so the statistics do not cover the contention on their lock
+// orders.
+//
+// Without UVM_LOCK_STATS the wrappers are unchanged, and when it is disabled at
+// runtime each acquisition only costs a patched out branch.
+#ifndef UVM_LOCK_STATS
+#define UVM_LOCK_STATS 0
+#endif
+
+#if UVM_LOCK_STATS
+  #if defined(DECLARE_STATIC_KEY_FALSE)
+    DECLARE_STATIC_KEY_FALSE(g_uvm_lock_stats_key);
+    #define uvm_lock_stats_enabled() static_branch_unlikely(&g_uvm_lock_stats_key)
+  #else
+    extern bool g_uvm_lock_stats_key;
+    #define uvm_lock_stats_enabled() unlikely(READ_ONCE(g_uvm_lock_stats_key))
+  #endif
+
+  NV_STATUS uvm_lock_stats_init(void);
+  void uvm_lock_stats_exit(void);
+
+  // Account an acquisition of a lock of the given order. wait_start is the time
+  // the acquisition started to wait, or 0 if the lock was free. Returns the
+  // acquisition time.
+  NvU64 __uvm_lock_stats_acquired(uvm_lock_order_t lock_order, NvU64 wait_start);
+
+  // Account the release of a lock of the given order acquired at acquired. Zero
+  // means that the acquisition was not accounted.
+  void __uvm_lock_stats_released(uvm_lock_order_t lock_order, NvU64 acquired);
+
+  // Acquire the lock with lock_expr and returns the acquisition time, or 0 if
+  // the statistics are disabled. try_lock_expr is tried first to find out
+  // whether the acquisition is contended.
+  #define uvm_lock_stats_lock(lock, try_lock_expr, lock_expr) ({                          \
+          NvU64 _acquired = 0;                                                            \
+          if (uvm_lock_stats_enabled()) {                                                 \
+              NvU64 _wait_start = 0;                                                      \
+              if (!(try_lock_expr)) {                                                     \
+                  _wait_start = NV_GETTIME();                                             \
+                  lock_expr;                                                              \
+              }                                                                           \
+              _acquired = __uvm_lock_stats_acquired((lock)->lock_order, _wait_start);     \
+          }                                                                               \
+          else {                                                                          \
+              lock_expr;                                                                  \
+          }                                                                               \
+          _acquired;                                                                      \
+      })
+
+  #define uvm_lock_stats_lock_shared(lock, try_lock_expr, lock_expr) \
+          ((void)uvm_lock_stats_lock((lock), (try_lock_expr), lock_expr))
+
+  #define uvm_lock_stats_lock_exclusive(lock, try_lock_expr, lock_expr) \
+          ((lock)->stats_acquired = uvm_lock_stats_lock((lock), (try_lock_expr), lock_expr))
+
+  // Account a successful trylock, which never waits
+  #define uvm_lock_stats_trylocked_shared(lock) \
+          ((void)(uvm_lock_stats_enabled() && __uvm_lock_stats_acquired((lock)->lock_order, 0)))
+
+  #define uvm_lock_stats_trylocked_exclusive(lock) \
+          ((lock)->stats_acquired = uvm_lock_stats_enabled() ? __uvm_lock_stats_acquired((lock)->lock_order, 0) : 0)
+
+  // The acquisition time is read before unlock_expr, since the lock may be
+  // taken again right after it.
+  #define uvm_lock_stats_unlock_exclusive(lock, unlock_expr) ({             \
+          NvU64 _acquired = (lock)->stats_acquired;                         \
+          unlock_expr;                                                      \
+          __uvm_lock_stats_released((lock)->lock_order, _acquired);         \
+      })
+#else
+  static inline NV_STATUS uvm_lock_stats_init(void)
+  {
+      return NV_OK;
+  }
+
+  static inline void uvm_lock_stats_exit(void)
+  {
+  }
+
+  #define uvm_lock_stats_lock_shared(lock, try_lock_expr, lock_expr)    lock_expr
+  #define uvm_lock_stats_lock_exclusive(lock, try_lock_expr, lock_expr) lock_expr
+  #define uvm_lock_stats_trylocked_shared(lock)                         ((void)(lock))
+  #define uvm_lock_stats_trylocked_exclusive(lock)                      ((void)(lock))
+  #define uvm_lock_stats_unlock_exclusive(lock, unlock_expr)            unlock_expr
+#endif
+
 #if UVM_IS_DEBUG()
   // These macros are intended to be expanded on the call site directly and will print
   // the precise location of the violation while the __uvm_record* functions will error print the details.
@@ -573,6 +671,20 @@ bool __uvm_locking_initialized(void);
         uvm_record_unlock_mmap_sem_write(_sem);         \
     })
 
+// Record mmap_sem as held in read mode by the calling thread while another
+// thread holds it on its behalf. See uvm_record_lock_read_inherited().
+#define uvm_record_lock_mmap_sem_read_inherited(mmap_sem) ({    \
+        typeof(mmap_sem) _sem = (mmap_sem);                     \
+        UVM_ASSERT(rwsem_is_locked(_sem));                      \
+        uvm_record_lock_mmap_sem_read(_sem);                    \
+    })
+
+#define uvm_record_unlock_mmap_sem_read_inherited(mmap_sem) ({  \
+        typeof(mmap_sem) _sem = (mmap_sem);                     \
+        uvm_assert_mmap_sem_locked_read(_sem);                  \
+        uvm_record_unlock_mmap_sem_read(_sem);                  \
+    })
+
 // Helper for calling a UVM-RM interface function with lock recording
 #define uvm_rm_locked_call(call) ({                     \
         typeof(call) ret;                               \
@@ -592,9 +704,12 @@ bool __uvm_locking_initialized(void);
 typedef struct
 {
     struct rw_semaphore sem;
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_lock_order_t lock_order;
 #endif
+#if UVM_LOCK_STATS
+    NvU64 stats_acquired;
+#endif
 } uvm_rw_semaphore_t;
 
 //
@@ -622,9 +737,12 @@ typedef struct
 static void uvm_init_rwsem(uvm_rw_semaphore_t *uvm_sem, uvm_lock_order_t lock_order)
 {
     init_rwsem(&uvm_sem->sem);
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_locking_assert_initialized();
     uvm_sem->lock_order = lock_order;
+#endif
+#if UVM_LOCK_STATS
+    uvm_sem->stats_acquired = 0;
 #endif
     uvm_assert_rwsem_unlocked(uvm_sem);
 }
@@ -632,7 +750,9 @@ static void uvm_init_rwsem(uvm_rw_semaphore_t *uvm_sem, uvm_lock_order_t lock_or
 #define uvm_down_read(uvm_sem) ({                          \
         typeof(uvm_sem) _sem = (uvm_sem);                  \
         uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_SHARED); \
-        down_read(&_sem->sem);                             \
+        uvm_lock_stats_lock_shared(_sem,                   \
+                                   down_read_trylock(&_sem->sem), \
+                                   down_read(&_sem->sem)); \
         uvm_assert_rwsem_locked_read(_sem);                \
     })
 
@@ -653,10 +773,31 @@ static void uvm_init_rwsem(uvm_rw_semaphore_t *uvm_sem, uvm_lock_order_t lock_or
         up_read(&_sem->sem);                                 \
     })
 
+// Record the lock as held in read mode by the calling thread, while it is
+// actually held by another thread on its behalf. The owner must not release
+// the lock before the calling thread records the release with
+// uvm_record_unlock_read_inherited(), typically by waiting for it to complete.
+// Lock tracking then checks the order of the locks taken by the calling thread
+// and its lock assertions hold, without taking the lock a second time, which
+// could deadlock behind a waiting writer.
+#define uvm_record_lock_read_inherited(uvm_sem) ({           \
+        typeof(uvm_sem) _sem = (uvm_sem);                    \
+        UVM_ASSERT(rwsem_is_locked(&_sem->sem));             \
+        uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_SHARED);   \
+    })
+
+#define uvm_record_unlock_read_inherited(uvm_sem) ({         \
+        typeof(uvm_sem) _sem = (uvm_sem);                    \
+        uvm_assert_rwsem_locked_read(_sem);                  \
+        uvm_record_unlock(_sem, UVM_LOCK_FLAGS_MODE_SHARED); \
+    })
+
 #define uvm_down_write(uvm_sem) ({                            \
         typeof (uvm_sem) _sem = (uvm_sem);                    \
         uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
-        down_write(&_sem->sem);                               \
+        uvm_lock_stats_lock_exclusive(_sem,                   \
+                                      down_write_trylock(&_sem->sem), \
+                                      down_write(&_sem->sem)); \
         uvm_assert_rwsem_locked_write(_sem);                  \
     })
 
@@ -670,10 +811,13 @@ static void uvm_init_rwsem(uvm_rw_semaphore_t *uvm_sem, uvm_lock_order_t lock_or
         int locked;                                                                 \
         uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_SHARED | UVM_LOCK_FLAGS_TRYLOCK); \
         locked = down_read_trylock(&_sem->sem);                                     \
-        if (locked == 0)                                                            \
+        if (locked == 0) {                                                          \
             uvm_record_unlock(_sem, UVM_LOCK_FLAGS_MODE_SHARED);                    \
-        else                                                                        \
+        }                                                                           \
+        else {                                                                      \
+            uvm_lock_stats_trylocked_shared(_sem);                                  \
             uvm_assert_rwsem_locked_read(_sem);                                     \
+        }                                                                           \
         locked;                                                                     \
     })
 
@@ -697,33 +841,39 @@ static void uvm_init_rwsem(uvm_rw_semaphore_t *uvm_sem, uvm_lock_order_t lock_or
         int locked;                                                                    \
         uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_EXCLUSIVE | UVM_LOCK_FLAGS_TRYLOCK); \
         locked = down_write_trylock(&_sem->sem);                                       \
-        if (locked == 0)                                                               \
+        if (locked == 0) {                                                             \
             uvm_record_unlock(_sem, UVM_LOCK_FLAGS_MODE_EXCLUSIVE);                    \
-        else                                                                           \
+        }                                                                              \
+        else {                                                                         \
+            uvm_lock_stats_trylocked_exclusive(_sem);                                  \
             uvm_assert_rwsem_locked_write(_sem);                                       \
+        }                                                                              \
         locked;                                                                        \
     })
 
 #define uvm_up_write(uvm_sem) ({                                \
         typeof(uvm_sem) _sem = (uvm_sem);                       \
         uvm_assert_rwsem_locked_write(_sem);                    \
-        up_write(&_sem->sem);                                   \
+        uvm_lock_stats_unlock_exclusive(_sem, up_write(&_sem->sem)); \
         uvm_record_unlock(_sem, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
     })
 
 #define uvm_downgrade_write(uvm_sem) ({                 \
         typeof(uvm_sem) _sem = (uvm_sem);               \
         uvm_assert_rwsem_locked_write(_sem);            \
-        downgrade_write(&_sem->sem);                    \
+        uvm_lock_stats_unlock_exclusive(_sem, downgrade_write(&_sem->sem)); \
         uvm_record_downgrade(_sem);                     \
     })
 
 typedef struct
 {
     struct mutex m;
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_lock_order_t lock_order;
 #endif
+#if UVM_LOCK_STATS
+    NvU64 stats_acquired;
+#endif
 } uvm_mutex_t;
 
 //
@@ -744,9 +894,12 @@ typedef struct
 static void uvm_mutex_init(uvm_mutex_t *mutex, uvm_lock_order_t lock_order)
 {
     mutex_init(&mutex->m);
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_locking_assert_initialized();
     mutex->lock_order = lock_order;
+#endif
+#if UVM_LOCK_STATS
+    mutex->stats_acquired = 0;
 #endif
     uvm_assert_mutex_unlocked(mutex);
 }
@@ -754,7 +907,9 @@ static void uvm_mutex_init(uvm_mutex_t *mutex, uvm_lock_order_t lock_order)
 #define uvm_mutex_lock(mutex) ({                                \
         typeof(mutex) _mutex = (mutex);                         \
         uvm_record_lock(_mutex, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
-        mutex_lock(&_mutex->m);                                 \
+        uvm_lock_stats_lock_exclusive(_mutex,                   \
+                                      mutex_trylock(&_mutex->m), \
+                                      mutex_lock(&_mutex->m));  \
         uvm_assert_mutex_locked(_mutex);                        \
     })
 
@@ -765,13 +920,13 @@ static void uvm_mutex_init(uvm_mutex_t *mutex, uvm_lock_order_t lock_order)
 #define uvm_mutex_unlock(mutex) ({                                \
         typeof(mutex) _mutex = (mutex);                           \
         uvm_assert_mutex_locked(_mutex);                          \
-        mutex_unlock(&_mutex->m);                                 \
+        uvm_lock_stats_unlock_exclusive(_mutex, mutex_unlock(&_mutex->m)); \
         uvm_record_unlock(_mutex, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
     })
 #define uvm_mutex_unlock_out_of_order(mutex) ({                                \
         typeof(mutex) _mutex = (mutex);                                        \
         uvm_assert_mutex_locked(_mutex);                                       \
-        mutex_unlock(&_mutex->m);                                              \
+        uvm_lock_stats_unlock_exclusive(_mutex, mutex_unlock(&_mutex->m));     \
         uvm_record_unlock_out_of_order(_mutex, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
     })
 
@@ -818,9 +973,12 @@ static void uvm_sema_init(uvm_semaphore_t *semaphore, int val, uvm_lock_order_t
 typedef struct
 {
     spinlock_t lock;
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_lock_order_t lock_order;
 #endif
+#if UVM_LOCK_STATS
+    NvU64 stats_acquired;
+#endif
 } uvm_spinlock_t;
 
 // A separate spinlock type for spinlocks that need to disable interrupts. For
@@ -855,9 +1013,12 @@ typedef struct
 static void uvm_spin_lock_init(uvm_spinlock_t *spinlock, uvm_lock_order_t lock_order)
 {
     spin_lock_init(&spinlock->lock);
-#if UVM_IS_DEBUG()
+#if UVM_IS_DEBUG() || UVM_LOCK_STATS
     uvm_locking_assert_initialized();
     spinlock->lock_order = lock_order;
+#endif
+#if UVM_LOCK_STATS
+    spinlock->stats_acquired = 0;
 #endif
     uvm_assert_spinlock_unlocked(spinlock);
 }
@@ -865,14 +1026,16 @@ static void uvm_spin_lock_init(uvm_spinlock_t *spinlock, uvm_lock_order_t lock_o
 #define uvm_spin_lock(uvm_lock) ({                             \
         typeof(uvm_lock) _lock = (uvm_lock);                   \
         uvm_record_lock(_lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
-        spin_lock(&_lock->lock);                               \
+        uvm_lock_stats_lock_exclusive(_lock,                   \
+                                      spin_trylock(&_lock->lock), \
+                                      spin_lock(&_lock->lock)); \
         uvm_assert_spinlock_locked(_lock);                     \
     })
 
 #define uvm_spin_unlock(uvm_lock) ({                             \
         typeof(uvm_lock) _lock = (uvm_lock);                     \
         uvm_assert_spinlock_locked(_lock);                       \
-        spin_unlock(&_lock->lock);                               \
+        uvm_lock_stats_unlock_exclusive(_lock, spin_unlock(&_lock->lock)); \
         uvm_record_unlock(_lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE); \
     })
 
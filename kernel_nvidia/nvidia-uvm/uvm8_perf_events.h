@@ -126,6 +126,10 @@ typedef union
                 NvU32 batch_id;
 
                 bool is_duplicate;
+
+                // Counters of the thread servicing the fault. NULL if the
+                // statistics of the GPU are updated directly.
+                uvm_fault_service_stats_t *stats;
             } gpu;
 
             struct
@@ -291,7 +295,8 @@ static inline void uvm_perf_event_notify_gpu_fault(uvm_perf_va_space_events_t *v
                                                    uvm_gpu_id_t gpu_id,
                                                    uvm_fault_buffer_entry_t *buffer_entry,
                                                    NvU32 batch_id,
-                                                   bool is_duplicate)
+                                                   bool is_duplicate,
+                                                   uvm_fault_service_stats_t *stats)
 {
     uvm_perf_event_data_t event_data =
         {
@@ -306,6 +311,7 @@ static inline void uvm_perf_event_notify_gpu_fault(uvm_perf_va_space_events_t *v
     event_data.fault.gpu.buffer_entry = buffer_entry;
     event_data.fault.gpu.batch_id     = batch_id;
     event_data.fault.gpu.is_duplicate = is_duplicate;
+    event_data.fault.gpu.stats        = stats;
 
     uvm_perf_event_notify(va_space_events, UVM_PERF_EVENT_FAULT, &event_data);
 }
@@ -25,6 +25,7 @@
 #include "uvm8_perf_heuristics.h"
 #include "uvm8_perf_thrashing.h"
 #include "uvm8_perf_prefetch.h"
+#include "uvm8_perf_stride.h"
 #include "uvm8_gpu_access_counters.h"
 #include "uvm8_va_space.h"
 
@@ -40,6 +41,10 @@ NV_STATUS uvm_perf_heuristics_init()
     if (status != NV_OK)
         return status;
 
+    status = uvm_perf_stride_init();
+    if (status != NV_OK)
+        return status;
+
     status = uvm_perf_access_counters_init();
     if (status != NV_OK)
         return status;
@@ -50,6 +55,7 @@ NV_STATUS uvm_perf_heuristics_init()
 void uvm_perf_heuristics_exit()
 {
     uvm_perf_access_counters_exit();
+    uvm_perf_stride_exit();
     uvm_perf_prefetch_exit();
     uvm_perf_thrashing_exit();
 }
@@ -76,6 +82,9 @@ NV_STATUS uvm_perf_heuristics_load(uvm_va_space_t *va_space)
     if (status != NV_OK)
         return status;
     status = uvm_perf_prefetch_load(va_space);
+    if (status != NV_OK)
+        return status;
+    status = uvm_perf_stride_load(va_space);
     if (status != NV_OK)
         return status;
     status = uvm_perf_access_counters_load(va_space);
@@ -105,6 +114,7 @@ void uvm_perf_heuristics_unload(uvm_va_space_t *va_space)
     uvm_assert_rwsem_locked_write(&va_space->lock);
 
     uvm_perf_access_counters_unload(va_space);
+    uvm_perf_stride_unload(va_space);
     uvm_perf_prefetch_unload(va_space);
     uvm_perf_thrashing_unload(va_space);
 }
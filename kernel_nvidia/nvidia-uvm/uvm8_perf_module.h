@@ -48,6 +48,8 @@
 // - UVM_PERF_MODULE_TYPE_PREFETCH: detects memory prefetching opportunities
 // - UVM_PERF_MODULE_TYPE_ACCESS_COUNTERS: migrates memory using access counter
 // notifications
+// - UVM_PERF_MODULE_TYPE_STRIDE: detects strides and periodic patterns between migrations
+// in a VA range and prefetches the pages ahead of them
 typedef enum
 {
     UVM_PERF_MODULE_FIRST_TYPE     = 0,
@@ -56,6 +58,7 @@ typedef enum
     UVM_PERF_MODULE_TYPE_THRASHING,
     UVM_PERF_MODULE_TYPE_PREFETCH,
     UVM_PERF_MODULE_TYPE_ACCESS_COUNTERS,
+    UVM_PERF_MODULE_TYPE_STRIDE,
 
     UVM_PERF_MODULE_TYPE_COUNT,
 } uvm_perf_module_type_t;
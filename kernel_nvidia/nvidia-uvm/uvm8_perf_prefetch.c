@@ -25,6 +25,7 @@
 #include "uvm8_perf_events.h"
 #include "uvm8_perf_module.h"
 #include "uvm8_perf_prefetch.h"
+#include "uvm8_perf_stride.h"
 #include "uvm8_kvmalloc.h"
 #include "uvm8_va_block.h"
 #include "uvm8_va_range.h"
@@ -344,6 +345,10 @@ void uvm_perf_prefetch_prenotify_fault_migrations(uvm_va_block_t *va_block,
     }
 
 done:
+    // Add the pages predicted by the stride detector, which catches regular
+    // accesses too sparse to reach the threshold in any subregion
+    uvm_perf_stride_prenotify_fault_migrations(va_block, faulted_pages, region, &prefetch_info->prefetch_pages);
+
     // Do not prefetch pages that are going to be migrated/populated due to a
     // fault
     uvm_page_mask_andnot(&prefetch_info->prefetch_pages,
@@ -498,6 +503,13 @@ NV_STATUS uvm_perf_prefetch_init()
     return NV_OK;
 }
 
+size_t uvm_perf_prefetch_block_memory_usage(uvm_va_block_t *va_block)
+{
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    return prefetch_info_get(va_block) ? sizeof(block_prefetch_info_t) : 0;
+}
+
 void uvm_perf_prefetch_exit()
 {
     if (!g_uvm_perf_prefetch_enable)
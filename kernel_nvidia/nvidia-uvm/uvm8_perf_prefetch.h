@@ -55,6 +55,10 @@ void uvm_perf_prefetch_prenotify_fault_migrations(uvm_va_block_t *va_block,
                                                   const uvm_page_mask_t *migrate_pages,
                                                   uvm_va_block_region_t region);
 
+// Host memory in bytes used by the prefetch state of the given block. The
+// caller must hold the block lock.
+size_t uvm_perf_prefetch_block_memory_usage(uvm_va_block_t *va_block);
+
 #define UVM_PERF_PREFETCH_HINT_NONE()                       \
     (uvm_perf_prefetch_hint_t){ NULL, UVM_ID_INVALID }
 
@@ -0,0 +1,476 @@
+/*******************************************************************************
+    Copyright (c) 2021 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#include "uvm_linux.h"
+#include "uvm8_perf_events.h"
+#include "uvm8_perf_module.h"
+#include "uvm8_perf_stride.h"
+#include "uvm8_kvmalloc.h"
+#include "uvm8_va_block.h"
+#include "uvm8_va_range.h"
+#include "uvm8_va_space.h"
+#include "uvm8_test.h"
+#include "uvm8_uxu.h"
+
+// Number of predictions for other blocks remembered per VA range
+#define UVM_STRIDE_PENDING_COUNT 16
+
+#define UVM_STRIDE_DEPTH_MIN     1
+#define UVM_STRIDE_DEPTH_DEFAULT 4
+#define UVM_STRIDE_DEPTH_MAX     UVM_STRIDE_PENDING_COUNT
+
+// Number of distances between migrations remembered per VA range. Patterns
+// repeating every up to UVM_STRIDE_HISTORY_COUNT / 2 migrations are detected.
+#define UVM_STRIDE_HISTORY_COUNT 16
+
+// Per-VA range stride detection structure. Faults on different blocks of the
+// same range are serviced concurrently, so it is protected by its own lock.
+typedef struct
+{
+    uvm_spinlock_t lock;
+
+    // Address of the first faulted page of the last fault-driven migration
+    NvU64 last_address;
+
+    // Distances between the last migrations, in a ring buffer whose most
+    // recent entry is before next_delta
+    NvS64 deltas[UVM_STRIDE_HISTORY_COUNT];
+
+    unsigned num_deltas;
+
+    unsigned next_delta;
+
+    // Number of migrations after which the distances repeat, 0 if no pattern
+    // is detected. A constant stride has a period of 1. A sweep over 2D tiles
+    // has the number of migrations per tile: a few rows one stride apart, and
+    // a jump to the next tile.
+    unsigned period;
+
+    // Distance covered by one period
+    NvS64 stride;
+
+    // Number of consecutive repetitions of the period
+    unsigned confidence;
+
+    // Page addresses predicted by the last migration, and the one following
+    // them, which the next migration is checked against
+    NvU64 predicted[UVM_STRIDE_DEPTH_MAX + 1];
+
+    unsigned num_predicted;
+
+    // Predicted page addresses outside of the block that was migrating when
+    // they were predicted. 0 means empty, since VA ranges never start at 0.
+    NvU64 pending[UVM_STRIDE_PENDING_COUNT];
+
+    unsigned next_pending;
+
+    // Statistics. Accuracy is hits / predictions.
+    NvU64 predictions;
+
+    NvU64 hits;
+
+    NvU64 prefetch_pages;
+} range_stride_info_t;
+
+//
+// Tunables for stride detection (configurable via module parameters)
+//
+
+// Enable/disable stride prefetch heuristics
+static unsigned uvm_perf_stride_enable = 1;
+
+#define UVM_STRIDE_CONFIDENCE_MIN     1
+#define UVM_STRIDE_CONFIDENCE_DEFAULT 2
+#define UVM_STRIDE_CONFIDENCE_MAX     16
+
+// Number of consecutive repetitions of the pattern of distances between
+// migrations needed to start prefetching. A constant stride repeats on every
+// migration.
+static unsigned uvm_perf_stride_confidence = UVM_STRIDE_CONFIDENCE_DEFAULT;
+
+// Number of predicted migrations ahead of the last one to prefetch
+static unsigned uvm_perf_stride_depth = UVM_STRIDE_DEPTH_DEFAULT;
+
+// Module parameters for the tunables
+module_param(uvm_perf_stride_enable, uint, S_IRUGO);
+module_param(uvm_perf_stride_confidence, uint, S_IRUGO);
+module_param(uvm_perf_stride_depth, uint, S_IRUGO);
+
+static bool g_uvm_perf_stride_enable;
+static unsigned g_uvm_perf_stride_confidence;
+static unsigned g_uvm_perf_stride_depth;
+
+// Callback declaration for the performance heuristics events
+static void stride_range_destroy_cb(uvm_perf_event_t event_id, uvm_perf_event_data_t *event_data);
+
+// Performance heuristics module for stride prefetch
+static uvm_perf_module_t g_module_stride;
+
+static uvm_perf_module_event_callback_desc_t g_callbacks_stride[] = {
+    { UVM_PERF_EVENT_RANGE_DESTROY, stride_range_destroy_cb },
+    { UVM_PERF_EVENT_RANGE_SHRINK,  stride_range_destroy_cb },
+    { UVM_PERF_EVENT_MODULE_UNLOAD, stride_range_destroy_cb }
+};
+
+// Get the stride detection struct for the given range
+static range_stride_info_t *stride_info_get(uvm_va_range_t *va_range)
+{
+    return uvm_perf_module_type_data(va_range->perf_modules_data, UVM_PERF_MODULE_TYPE_STRIDE);
+}
+
+static void stride_info_destroy(uvm_va_range_t *va_range)
+{
+    range_stride_info_t *stride_info = stride_info_get(va_range);
+    if (stride_info) {
+        uvm_kvfree(stride_info);
+        uvm_perf_module_type_unset_data(va_range->perf_modules_data, UVM_PERF_MODULE_TYPE_STRIDE);
+    }
+}
+
+// Get the stride detection struct for the given range or create it if it
+// does not exist. Only the va_space lock in read mode is held, so concurrent
+// creations are resolved by keeping the first one installed.
+static range_stride_info_t *stride_info_get_create(uvm_va_range_t *va_range)
+{
+    range_stride_info_t *stride_info = stride_info_get(va_range);
+    range_stride_info_t *old;
+
+    if (stride_info)
+        return stride_info;
+
+    stride_info = uvm_kvmalloc_zero(sizeof(*stride_info));
+    if (!stride_info)
+        return NULL;
+
+    uvm_spin_lock_init(&stride_info->lock, UVM_LOCK_ORDER_LEAF);
+
+    old = cmpxchg(&va_range->perf_modules_data[UVM_PERF_MODULE_TYPE_STRIDE].data, NULL, stride_info);
+    if (old) {
+        uvm_kvfree(stride_info);
+        return old;
+    }
+
+    return stride_info;
+}
+
+// Get the distance between the migrations age and age + 1 migrations before
+// the last one
+static NvS64 stride_delta(range_stride_info_t *stride_info, unsigned age)
+{
+    return stride_info->deltas[(stride_info->next_delta + UVM_STRIDE_HISTORY_COUNT - 1 - age) %
+                               UVM_STRIDE_HISTORY_COUNT];
+}
+
+// Look for the period after which the most recent distances repeat. The
+// period repeated over the most migrations is kept, the shortest one on ties,
+// so that a constant stride is not taken for a longer pattern.
+static void stride_detect(range_stride_info_t *stride_info)
+{
+    unsigned best_period = 0;
+    unsigned best_run = 0;
+    unsigned period;
+    unsigned i;
+
+    for (period = 1; period <= stride_info->num_deltas / 2; ++period) {
+        unsigned run;
+
+        for (run = 0; run + period < stride_info->num_deltas; ++run) {
+            if (stride_delta(stride_info, run) != stride_delta(stride_info, run + period))
+                break;
+        }
+
+        if (run >= period && run > best_run) {
+            best_period = period;
+            best_run = run;
+        }
+    }
+
+    stride_info->period = best_period;
+    stride_info->confidence = best_period ? best_run / best_period + 1 : 0;
+    stride_info->stride = 0;
+    for (i = 0; i < best_period; ++i)
+        stride_info->stride += stride_delta(stride_info, i);
+}
+
+// Update the detector with the address of a new migration. Each migration
+// following a prediction counts as a prediction, which is a hit if it is one
+// of the pages predicted or the one following them. Pages prefetched do not
+// fault, so the next migration may skip some of the predicted pages.
+static void stride_observe(range_stride_info_t *stride_info, NvU64 address)
+{
+    NvS64 delta = (NvS64)(address - stride_info->last_address);
+    unsigned i;
+
+    if (stride_info->last_address == 0) {
+        stride_info->last_address = address;
+        return;
+    }
+
+    if (delta == 0)
+        return;
+
+    if (stride_info->num_predicted > 0) {
+        ++stride_info->predictions;
+
+        for (i = 0; i < stride_info->num_predicted; ++i) {
+            if (stride_info->predicted[i] == address) {
+                ++stride_info->hits;
+                break;
+            }
+        }
+
+        stride_info->num_predicted = 0;
+    }
+
+    stride_info->deltas[stride_info->next_delta] = delta;
+    stride_info->next_delta = (stride_info->next_delta + 1) % UVM_STRIDE_HISTORY_COUNT;
+    if (stride_info->num_deltas < UVM_STRIDE_HISTORY_COUNT)
+        ++stride_info->num_deltas;
+
+    stride_detect(stride_info);
+
+    stride_info->last_address = address;
+}
+
+void uvm_perf_stride_prenotify_fault_migrations(uvm_va_block_t *va_block,
+                                                const uvm_page_mask_t *faulted_pages,
+                                                uvm_va_block_region_t region,
+                                                uvm_page_mask_t *prefetch_pages)
+{
+    uvm_va_range_t *va_range = va_block->va_range;
+    range_stride_info_t *stride_info;
+    uvm_page_index_t page_index;
+    NvU64 address;
+    NvU64 remote_addresses[UVM_STRIDE_DEPTH_MAX];
+    unsigned num_remote = 0;
+    unsigned i;
+
+    uvm_assert_rwsem_locked(&va_range->va_space->lock);
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    if (!g_uvm_perf_stride_enable)
+        return;
+
+    page_index = uvm_va_block_first_page_in_mask(region, faulted_pages);
+    if (page_index >= region.outer)
+        return;
+
+    stride_info = stride_info_get_create(va_range);
+    if (!stride_info)
+        return;
+
+    address = uvm_va_block_cpu_page_address(va_block, page_index);
+
+    uvm_spin_lock(&stride_info->lock);
+
+    // Apply the predictions made by earlier migrations in other blocks
+    for (i = 0; i < UVM_STRIDE_PENDING_COUNT; ++i) {
+        NvU64 pending = stride_info->pending[i];
+
+        if (pending >= va_block->start && pending <= va_block->end) {
+            uvm_page_mask_set(prefetch_pages, uvm_va_block_cpu_page_index(va_block, pending));
+            stride_info->pending[i] = 0;
+            ++stride_info->prefetch_pages;
+        }
+    }
+
+    stride_observe(stride_info, address);
+
+    stride_info->num_predicted = 0;
+
+    if (stride_info->confidence >= g_uvm_perf_stride_confidence) {
+        NvU64 predicted = address;
+
+        // The distances of the period follow each other in the order they
+        // were seen. The page after the last one predicted is only used to
+        // check the next migration.
+        for (i = 0; i <= g_uvm_perf_stride_depth; ++i) {
+            predicted += stride_delta(stride_info, stride_info->period - 1 - i % stride_info->period);
+
+            if (predicted < va_range->node.start || predicted > va_range->node.end)
+                break;
+
+            stride_info->predicted[stride_info->num_predicted++] = predicted;
+            if (i == g_uvm_perf_stride_depth)
+                break;
+
+            if (predicted >= va_block->start && predicted <= va_block->end) {
+                uvm_page_mask_set(prefetch_pages, uvm_va_block_cpu_page_index(va_block, predicted));
+                ++stride_info->prefetch_pages;
+                continue;
+            }
+
+            stride_info->pending[stride_info->next_pending] = predicted;
+            stride_info->next_pending = (stride_info->next_pending + 1) % UVM_STRIDE_PENDING_COUNT;
+            remote_addresses[num_remote++] = predicted;
+        }
+    }
+
+    uvm_spin_unlock(&stride_info->lock);
+
+    // Storage reads take much longer than migrations, so start them as soon as
+    // the blocks are predicted
+    if (uvm_is_uxu_range(va_range)) {
+        for (i = 0; i < num_remote; ++i)
+            uxu_prefetch_address(va_range, remote_addresses[i]);
+    }
+}
+
+void uvm_perf_stride_range_stats(uvm_va_range_t *va_range, NvU64 *predictions, NvU64 *hits, NvU64 *prefetch_pages)
+{
+    range_stride_info_t *stride_info;
+
+    uvm_assert_rwsem_locked(&va_range->va_space->lock);
+
+    *predictions = 0;
+    *hits = 0;
+    *prefetch_pages = 0;
+
+    stride_info = stride_info_get(va_range);
+    if (!stride_info)
+        return;
+
+    uvm_spin_lock(&stride_info->lock);
+    *predictions = stride_info->predictions;
+    *hits = stride_info->hits;
+    *prefetch_pages = stride_info->prefetch_pages;
+    uvm_spin_unlock(&stride_info->lock);
+}
+
+void stride_range_destroy_cb(uvm_perf_event_t event_id, uvm_perf_event_data_t *event_data)
+{
+    uvm_va_range_t *va_range;
+
+    UVM_ASSERT(g_uvm_perf_stride_enable);
+
+    UVM_ASSERT(event_id == UVM_PERF_EVENT_RANGE_DESTROY ||
+               event_id == UVM_PERF_EVENT_RANGE_SHRINK ||
+               event_id == UVM_PERF_EVENT_MODULE_UNLOAD);
+
+    if (event_id == UVM_PERF_EVENT_RANGE_DESTROY)
+        va_range = event_data->range_destroy.range;
+    else if (event_id == UVM_PERF_EVENT_RANGE_SHRINK)
+        va_range = event_data->range_shrink.range;
+    else
+        va_range = event_data->module_unload.range;
+
+    if (!va_range)
+        return;
+
+    stride_info_destroy(va_range);
+}
+
+NV_STATUS uvm_perf_stride_load(uvm_va_space_t *va_space)
+{
+    if (!g_uvm_perf_stride_enable)
+        return NV_OK;
+
+    return uvm_perf_module_load(&g_module_stride, va_space);
+}
+
+void uvm_perf_stride_unload(uvm_va_space_t *va_space)
+{
+    if (!g_uvm_perf_stride_enable)
+        return;
+
+    uvm_perf_module_unload(&g_module_stride, va_space);
+}
+
+NV_STATUS uvm_perf_stride_init()
+{
+    g_uvm_perf_stride_enable = uvm_perf_stride_enable != 0;
+
+    if (!g_uvm_perf_stride_enable)
+        return NV_OK;
+
+    uvm_perf_module_init("perf_stride", UVM_PERF_MODULE_TYPE_STRIDE, g_callbacks_stride,
+                         ARRAY_SIZE(g_callbacks_stride), &g_module_stride);
+
+    if (uvm_perf_stride_confidence >= UVM_STRIDE_CONFIDENCE_MIN &&
+        uvm_perf_stride_confidence <= UVM_STRIDE_CONFIDENCE_MAX) {
+        g_uvm_perf_stride_confidence = uvm_perf_stride_confidence;
+    }
+    else {
+        pr_info("Invalid value %u for uvm_perf_stride_confidence. Using %u instead\n",
+                uvm_perf_stride_confidence, UVM_STRIDE_CONFIDENCE_DEFAULT);
+
+        g_uvm_perf_stride_confidence = UVM_STRIDE_CONFIDENCE_DEFAULT;
+    }
+
+    if (uvm_perf_stride_depth >= UVM_STRIDE_DEPTH_MIN &&
+        uvm_perf_stride_depth <= UVM_STRIDE_DEPTH_MAX) {
+        g_uvm_perf_stride_depth = uvm_perf_stride_depth;
+    }
+    else {
+        pr_info("Invalid value %u for uvm_perf_stride_depth. Using %u instead\n",
+                uvm_perf_stride_depth, UVM_STRIDE_DEPTH_DEFAULT);
+
+        g_uvm_perf_stride_depth = UVM_STRIDE_DEPTH_DEFAULT;
+    }
+
+    return NV_OK;
+}
+
+void uvm_perf_stride_exit()
+{
+}
+
+NV_STATUS uvm8_test_perf_stride_range_info(UVM_TEST_PERF_STRIDE_RANGE_INFO_PARAMS *params, struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    uvm_va_range_t *va_range;
+    range_stride_info_t *stride_info;
+    NV_STATUS status = NV_OK;
+
+    uvm_va_space_down_read(va_space);
+
+    va_range = uvm_va_range_find(va_space, params->lookup_address);
+    if (!va_range || va_range->type != UVM_VA_RANGE_TYPE_MANAGED) {
+        status = NV_ERR_INVALID_ADDRESS;
+        goto out;
+    }
+
+    stride_info = stride_info_get(va_range);
+    if (!stride_info) {
+        params->stride         = 0;
+        params->period         = 0;
+        params->confidence     = 0;
+        params->predictions    = 0;
+        params->hits           = 0;
+        params->prefetch_pages = 0;
+        goto out;
+    }
+
+    uvm_spin_lock(&stride_info->lock);
+    params->stride         = stride_info->stride;
+    params->period         = stride_info->period;
+    params->confidence     = stride_info->confidence;
+    params->predictions    = stride_info->predictions;
+    params->hits           = stride_info->hits;
+    params->prefetch_pages = stride_info->prefetch_pages;
+    uvm_spin_unlock(&stride_info->lock);
+
+out:
+    uvm_va_space_up_read(va_space);
+    return status;
+}
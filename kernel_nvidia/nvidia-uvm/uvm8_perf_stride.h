@@ -0,0 +1,64 @@
+/*******************************************************************************
+    Copyright (c) 2021 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#ifndef __UVM8_PERF_STRIDE_H__
+#define __UVM8_PERF_STRIDE_H__
+
+#include "uvm_linux.h"
+#include "uvm8_va_block_types.h"
+
+// The stride prefetcher complements the density-based prefetcher in
+// uvm8_perf_prefetch.c. It keeps the distances between the last fault-driven
+// migrations of each VA range and detects when they repeat with a period:
+// every migration for a constant stride, or every few migrations for a sweep
+// over 2D tiles, which moves a few rows down the tile and jumps to the next
+// one. This catches patterns that touch a few pages in many VA blocks, such
+// as column sweeps over a row-major array, which never reach the density
+// threshold of any single block.
+
+// Global initialization/cleanup functions
+NV_STATUS uvm_perf_stride_init(void);
+void uvm_perf_stride_exit(void);
+
+// VA space Initialization/cleanup functions
+NV_STATUS uvm_perf_stride_load(uvm_va_space_t *va_space);
+void uvm_perf_stride_unload(uvm_va_space_t *va_space);
+
+// Notify that the given mask of pages within region is going to migrate due
+// to a fault. Predicted pages within va_block are added to prefetch_pages.
+// Predicted pages in other blocks of the range are remembered and added when
+// those blocks migrate, and their storage is read ahead for UXU ranges.
+//
+// Locking: the caller must hold the va_space lock and the va_block lock.
+void uvm_perf_stride_prenotify_fault_migrations(uvm_va_block_t *va_block,
+                                                const uvm_page_mask_t *faulted_pages,
+                                                uvm_va_block_region_t region,
+                                                uvm_page_mask_t *prefetch_pages);
+
+// Get the statistics of the prefetcher for the given VA range, all zero if it
+// did not see any migration. Accuracy is hits / predictions.
+//
+// Locking: the caller must hold the va_space lock.
+void uvm_perf_stride_range_stats(uvm_va_range_t *va_range, NvU64 *predictions, NvU64 *hits, NvU64 *prefetch_pages);
+
+#endif
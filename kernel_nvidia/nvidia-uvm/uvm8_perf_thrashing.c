@@ -1811,6 +1811,21 @@ const uvm_page_mask_t *uvm_perf_thrashing_get_thrashing_pages(uvm_va_block_t *va
     return &block_thrashing->thrashing_pages;
 }
 
+size_t uvm_perf_thrashing_block_memory_usage(uvm_va_block_t *va_block)
+{
+    block_thrashing_info_t *block_thrashing = thrashing_info_get(va_block);
+    size_t bytes;
+
+    if (!block_thrashing)
+        return 0;
+
+    bytes = sizeof(*block_thrashing);
+    if (block_thrashing->pages)
+        bytes += uvm_va_block_num_cpu_pages(va_block) * sizeof(*block_thrashing->pages);
+
+    return bytes;
+}
+
 bool uvm_perf_thrashing_is_block_thrashing(uvm_va_block_t *va_block)
 {
     uvm_va_space_t *va_space = va_block->va_range->va_space;
@@ -87,6 +87,10 @@ const uvm_page_mask_t *uvm_perf_thrashing_get_thrashing_pages(uvm_va_block_t *va
 // Returns true if any page in the block is thrashing, or false otherwise
 bool uvm_perf_thrashing_is_block_thrashing(uvm_va_block_t *va_block);
 
+// Host memory in bytes used by the thrashing detection state of the given
+// block. The caller must hold the block lock.
+size_t uvm_perf_thrashing_block_memory_usage(uvm_va_block_t *va_block);
+
 // Global initialization/cleanup functions
 NV_STATUS uvm_perf_thrashing_init(void);
 void uvm_perf_thrashing_exit(void);
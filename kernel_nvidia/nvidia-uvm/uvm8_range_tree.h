@@ -27,11 +27,78 @@
 #include "uvm_linux.h"
 #include "nvstatus.h"
 
+// Part of a file backing a UXU range
+typedef struct uvm_uxu_extent_struct
+{
+    struct file *filp;
+
+    // Private read-only open of the same file, which UXU seeks to find the
+    // holes without touching the file position of the user. NULL if it
+    // could not be opened, the holes are not looked for then.
+    struct file *seek_filp;
+
+    // Offset of the extent in the range
+    NvU64 start;
+
+    // Page aligned offset of the extent in the file
+    NvU64 offset;
+
+    NvU64 length;
+
+    // Physical layout of the extent in its file, read when the range is
+    // mapped or remapped. NULL if the file system does not report it.
+    struct uvm_uxu_fiemap_struct *fiemap;
+
+    // Read ahead state of UXU's reads of the extent, kept apart from the
+    // one of the user's file
+    struct file_ra_state ra;
+
+    // Bytes read from and written back to the file, reported in procfs for
+    // striped ranges
+    atomic64_t read_bytes;
+    atomic64_t writeback_bytes;
+} uvm_uxu_extent_t;
+
 typedef struct uvm_uxu_range_tree_node_t
 {
+    // File of the first extent, non-NULL for UXU ranges
     struct file *filp;
     unsigned short flags;
     size_t size;
+
+    // Files backing the range, sorted by start. A range mapped from a single
+    // file has one extent. The extents can be shorter than their files, so
+    // that several ranges can be backed by one packed file.
+    uvm_uxu_extent_t *extents;
+    NvU32 nr_extents;
+
+    // If not 0, the range is striped over the files of the extents instead,
+    // round robin in units of stripe_unit bytes. The length of an extent is
+    // then the size of the data of the range stored in its file.
+    NvU64 stripe_unit;
+
+    // Access profile recorded for the backing file, if the range has been
+    // mapped with UVM_UXU_FLAG_PROFILE
+    struct uvm_uxu_profile_struct *profile;
+
+    // Index of the compressed chunks of the file, if the range has been
+    // mapped with UVM_UXU_FLAG_COMPRESSED
+    struct uvm_uxu_container_struct *container;
+
+    // Per-CPU statistics of the range, reported in procfs. NULL if they could
+    // not be allocated.
+    struct uvm_uxu_stats_struct __percpu *stats;
+
+    // Blocks loaded from storage at least once, indexed by block index in the
+    // range. Used to count blocks reloaded after being released.
+    unsigned long *loaded_blocks;
+
+    // Entries of the blocks of the range in the compressed block pool of the
+    // va_space, in chunks of UVM_VA_RANGE_BLOCKS_PER_CHUNK entries indexed by
+    // block index in the range. The chunks are allocated when their first
+    // entry is stored. NULL if the va_space has no pool or the range is not
+    // read from storage into host buffers.
+    struct uvm_uxu_zentry_struct ***zentries;
 } uvm_uxu_range_tree_node_t;
 
 // Tree-based data structure for looking up and iterating over objects with
@@ -306,6 +306,8 @@ long uvm8_test_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_THREAD_CONTEXT_SANITY,        uvm8_test_thread_context_sanity);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_THREAD_CONTEXT_PERF,          uvm8_test_thread_context_perf);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_GET_PAGEABLE_MEM_ACCESS_TYPE, uvm8_test_get_pageable_mem_access_type);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_PERF_STRIDE_RANGE_INFO,       uvm8_test_perf_stride_range_info);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_FAULT_PHASES,                 uvm8_test_fault_phases);
     }
 
     return -EINVAL;
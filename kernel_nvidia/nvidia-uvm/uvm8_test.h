@@ -157,6 +157,8 @@ NV_STATUS uvm8_test_flush_deferred_work(UVM_TEST_FLUSH_DEFERRED_WORK_PARAMS *par
 NV_STATUS uvm8_test_set_page_prefetch_policy(UVM_TEST_SET_PAGE_PREFETCH_POLICY_PARAMS *params, struct file *filp);
 NV_STATUS uvm8_test_get_page_thrashing_policy(UVM_TEST_GET_PAGE_THRASHING_POLICY_PARAMS *params, struct file *filp);
 NV_STATUS uvm8_test_set_page_thrashing_policy(UVM_TEST_SET_PAGE_THRASHING_POLICY_PARAMS *params, struct file *filp);
+NV_STATUS uvm8_test_perf_stride_range_info(UVM_TEST_PERF_STRIDE_RANGE_INFO_PARAMS *params, struct file *filp);
+NV_STATUS uvm8_test_fault_phases(UVM_TEST_FAULT_PHASES_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm8_test_range_group_tree(UVM_TEST_RANGE_GROUP_TREE_PARAMS *params, struct file *filp);
 NV_STATUS uvm8_test_range_group_range_info(UVM_TEST_RANGE_GROUP_RANGE_INFO_PARAMS *params, struct file *filp);
@@ -1282,6 +1282,39 @@ typedef struct
     NV_STATUS                       rmStatus;                                           // Out
 } UVM_TEST_GET_PAGEABLE_MEM_ACCESS_TYPE_PARAMS;
 
+// Return the state and the statistics of the stride prefetcher for the VA
+// range containing lookup_address. stride is the distance covered by one
+// period of period migrations. Accuracy is hits / predictions.
+#define UVM_TEST_PERF_STRIDE_RANGE_INFO                 UVM8_TEST_IOCTL_BASE(84)
+typedef struct
+{
+    NvU64                           lookup_address                      NV_ALIGN_BYTES(8);  // In
+    NvS64                           stride                              NV_ALIGN_BYTES(8);  // Out
+    NvU32                           period;                                                 // Out
+    NvU32                           confidence;                                             // Out
+    NvU64                           predictions                         NV_ALIGN_BYTES(8);  // Out
+    NvU64                           hits                                NV_ALIGN_BYTES(8);  // Out
+    NvU64                           prefetch_pages                      NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS                       rmStatus;                                               // Out
+} UVM_TEST_PERF_STRIDE_RANGE_INFO_PARAMS;
+
+typedef enum
+{
+    UVM_TEST_FAULT_PHASES_KEEP = 0,
+    UVM_TEST_FAULT_PHASES_ENABLE,
+    UVM_TEST_FAULT_PHASES_DISABLE,
+} UVM_TEST_FAULT_PHASES_MODE;
+
+// Enable or disable the recording of the fault service phase histograms, and
+// optionally clear the histograms of all the GPUs. See uvm8_fault_phases.h.
+#define UVM_TEST_FAULT_PHASES                           UVM8_TEST_IOCTL_BASE(85)
+typedef struct
+{
+    NvU32                           enable;                                                 // In (UVM_TEST_FAULT_PHASES_MODE)
+    NvBool                          reset;                                                  // In
+    NV_STATUS                       rmStatus;                                               // Out
+} UVM_TEST_FAULT_PHASES_PARAMS;
+
 #ifdef __cplusplus
 }
 #endif
@@ -131,3 +131,29 @@ void uvm_tlb_batch_invalidate(uvm_tlb_batch_t *batch, NvU64 start, NvU64 size, N
     new_entry->size = size;
     new_entry->page_sizes = page_sizes;
 }
+
+void uvm_tlb_batch_merge(uvm_tlb_batch_t *batch, const uvm_tlb_batch_t *other, uvm_membar_t tlb_membar)
+{
+    NvU32 i;
+
+    UVM_ASSERT(batch->tree == other->tree);
+
+    if (other->count == 0)
+        return;
+
+    batch->membar = uvm_membar_max(batch->membar, uvm_membar_max(other->membar, tlb_membar));
+
+    // other already fell back to an invalidate all, so its ranges are not all
+    // tracked. Make batch invalidate everything, too.
+    if (tlb_batch_should_invalidate_all((uvm_tlb_batch_t *)other)) {
+        batch->count = max(batch->count, (NvU32)UVM_TLB_BATCH_MAX_ENTRIES) + 1;
+        batch->biggest_page_size = max(batch->biggest_page_size, other->biggest_page_size);
+        return;
+    }
+
+    for (i = 0; i < other->count; i++) {
+        const uvm_tlb_batch_range_t *entry = &other->ranges[i];
+
+        uvm_tlb_batch_invalidate(batch, entry->start, entry->size, entry->page_sizes, UVM_MEMBAR_NONE);
+    }
+}
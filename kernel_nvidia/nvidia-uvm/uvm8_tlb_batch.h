@@ -94,6 +94,12 @@ void uvm_tlb_batch_invalidate(uvm_tlb_batch_t *batch, NvU64 start, NvU64 size, N
 // batch.
 void uvm_tlb_batch_end(uvm_tlb_batch_t *batch, uvm_push_t *push, uvm_membar_t tlb_membar);
 
+// Queue up all the invalidates of other into batch, so that they are pushed
+// when batch ends. other must use the same page tree and must not be ended.
+//
+// The tlb_membar argument is the membar other would have been ended with.
+void uvm_tlb_batch_merge(uvm_tlb_batch_t *batch, const uvm_tlb_batch_t *other, uvm_membar_t tlb_membar);
+
 // Helper for invalidating a single range immediately.
 //
 // Internally begins and ends a TLB batch.
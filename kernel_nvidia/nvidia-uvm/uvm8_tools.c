@@ -1437,6 +1437,140 @@ void uvm_tools_record_throttling_end(uvm_va_space_t *va_space, NvU64 address, uv
     uvm_up_read(&va_space->tools.lock);
 }
 
+// Common prologue of the UXU events. Returns false if the event is not
+// enabled, otherwise the tools lock is held in read mode and entry is cleared.
+static bool uxu_event_begin(uvm_va_space_t *va_space, UvmEventType event, UvmEventEntry *entry)
+{
+    if (!va_space->tools.enabled)
+        return false;
+
+    uvm_down_read(&va_space->tools.lock);
+    if (!tools_is_event_enabled(va_space, event)) {
+        uvm_up_read(&va_space->tools.lock);
+        return false;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->eventData.eventType = event;
+
+    return true;
+}
+
+static void uxu_event_end(uvm_va_space_t *va_space, UvmEventEntry *entry)
+{
+    uvm_tools_record_event(va_space, entry);
+    uvm_up_read(&va_space->tools.lock);
+}
+
+void uvm_tools_record_uxu_block_load_start(uvm_va_block_t *va_block)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuBlockLoadStartInfo *info = &entry.eventData.uxuBlockLoadStart;
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuBlockLoadStart, &entry))
+        return;
+
+    info->address   = va_block->start;
+    info->size      = uvm_va_block_size(va_block);
+    info->timeStamp = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
+void uvm_tools_record_uxu_block_load_end(uvm_va_block_t *va_block,
+                                         NvU32 page_count,
+                                         NvU64 bytes_from_storage,
+                                         NvU64 begin_time_stamp)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuBlockLoadEndInfo *info = &entry.eventData.uxuBlockLoadEnd;
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuBlockLoadEnd, &entry))
+        return;
+
+    info->pageCount        = page_count;
+    info->address          = va_block->start;
+    info->bytesFromStorage = bytes_from_storage;
+    info->beginTimeStamp   = begin_time_stamp;
+    info->endTimeStamp     = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
+void uvm_tools_record_uxu_page_cache(uvm_va_block_t *va_block, NvU32 pages_hit, NvU32 pages_missed)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuPageCacheInfo *info = &entry.eventData.uxuPageCache;
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuPageCache, &entry))
+        return;
+
+    info->pagesHit    = pages_hit;
+    info->address     = va_block->start;
+    info->pagesMissed = pages_missed;
+    info->timeStamp   = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
+void uvm_tools_record_uxu_flush(uvm_va_block_t *va_block, NvU64 size, NvU64 begin_time_stamp)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuFlushInfo *info = &entry.eventData.uxuFlush;
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuFlush, &entry))
+        return;
+
+    info->address        = va_block->start;
+    info->size           = size;
+    info->beginTimeStamp = begin_time_stamp;
+    info->endTimeStamp   = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
+void uvm_tools_record_uxu_writeback(uvm_va_block_t *va_block, NvU64 size, UvmEventUxuWritebackCause cause)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuWritebackInfo *info = &entry.eventData.uxuWriteback;
+
+    UVM_ASSERT(cause != UvmEventUxuWritebackCauseInvalid);
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuWriteback, &entry))
+        return;
+
+    info->writebackCause = cause;
+    info->address        = va_block->start;
+    info->size           = size;
+    info->timeStamp      = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
+void uvm_tools_record_uxu_block_release(uvm_va_block_t *va_block, UvmEventUxuBlockReleaseCause cause)
+{
+    uvm_va_space_t *va_space = va_block->va_range->va_space;
+    UvmEventEntry entry;
+    UvmEventUxuBlockReleaseInfo *info = &entry.eventData.uxuBlockRelease;
+
+    UVM_ASSERT(cause != UvmEventUxuBlockReleaseCauseInvalid);
+
+    if (!uxu_event_begin(va_space, UvmEventTypeUxuBlockRelease, &entry))
+        return;
+
+    info->releaseCause = cause;
+    info->address      = va_block->start;
+    info->size         = uvm_va_block_size(va_block);
+    info->timeStamp    = NV_GETTIME();
+
+    uxu_event_end(va_space, &entry);
+}
+
 static void record_map_remote_events(void *args)
 {
     block_map_remote_data_t *block_map_remote = (block_map_remote_data_t *)args;
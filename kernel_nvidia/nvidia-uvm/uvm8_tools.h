@@ -76,6 +76,22 @@ void uvm_tools_record_throttling_start(uvm_va_space_t *va_space, NvU64 address,
 
 void uvm_tools_record_throttling_end(uvm_va_space_t *va_space, NvU64 address, uvm_processor_id_t processor);
 
+// UXU storage I/O events. All of them take a block of a UXU va range.
+void uvm_tools_record_uxu_block_load_start(uvm_va_block_t *va_block);
+
+void uvm_tools_record_uxu_block_load_end(uvm_va_block_t *va_block,
+                                         NvU32 page_count,
+                                         NvU64 bytes_from_storage,
+                                         NvU64 begin_time_stamp);
+
+void uvm_tools_record_uxu_page_cache(uvm_va_block_t *va_block, NvU32 pages_hit, NvU32 pages_missed);
+
+void uvm_tools_record_uxu_flush(uvm_va_block_t *va_block, NvU64 size, NvU64 begin_time_stamp);
+
+void uvm_tools_record_uxu_writeback(uvm_va_block_t *va_block, NvU64 size, UvmEventUxuWritebackCause cause);
+
+void uvm_tools_record_uxu_block_release(uvm_va_block_t *va_block, UvmEventUxuBlockReleaseCause cause);
+
 void uvm_tools_record_map_remote(uvm_va_block_t *va_block,
                                  uvm_push_t *push,
                                  uvm_processor_id_t processor,
@@ -7,6 +7,14 @@
 #include <linux/backing-dev.h>
 #include <linux/uio.h>
 #include <linux/buffer_head.h>
+#include <linux/xattr.h>
+#include <linux/percpu.h>
+#include <linux/memcontrol.h>
+#include <linux/crc32.h>
+#include <linux/highmem.h>
+#include <linux/sort.h>
+#include <linux/blkdev.h>
+#include <linux/uaccess.h>
 
 #include "nv_uvm_interface.h"
 #include "uvm8_api.h"
@@ -33,258 +41,3470 @@
 #include "uvm8_push.h"
 #include "uvm8_perf_thrashing.h"
 #include "uvm8_perf_prefetch.h"
+#include "uvm8_perf_stride.h"
 #include "uvm8_mem.h"
+#include "uvm8_tools.h"
 #include "uvm8_uxu.h"
+#include "uxuz_format.h"
 
-#define UXU_FILE_FROM_RANGE(range)	((range)->node.uxu_rtn.filp)
-#define UXU_FILE_FROM_BLOCK(block)	UXU_FILE_FROM_RANGE((block)->va_range)
-#define BLOCK_START_OFFSET(block)	((block)->start - (block)->va_range->node.start)
+#if IS_ENABLED(CONFIG_LZ4_COMPRESS) && IS_ENABLED(CONFIG_LZ4_DECOMPRESS)
+#include <linux/lz4.h>
+#define UXU_LZ4_SUPPORTED	1
+#else
+#define UXU_LZ4_SUPPORTED	0
+#endif
+
+/* Maximum number of runs of the physical layout kept for an extent of a range */
+#define UXU_FIEMAP_MAX_EXTENTS	512
+
+/* Part of a file whose location on the storage device is known */
+typedef struct {
+	NvU64	logical;
+	NvU64	physical;
+	NvU64	length;
+} uvm_uxu_fiemap_extent_t;
+
+/* Physical layout of an extent of a range, sorted by logical offset */
+typedef struct uvm_uxu_fiemap_struct {
+	NvU32	nr_extents;
+	uvm_uxu_fiemap_extent_t	extents[];
+} uvm_uxu_fiemap_t;
+
+/* Physical location of file data which is not allocated or not known */
+#define UXU_PHYSICAL_UNKNOWN	(~0ULL)
+
+/* Maximum number of gaps of a container tracked for reuse, the others are lost until it is repacked */
+#define UXU_CONTAINER_MAX_FREE	1024
+
+/* Space of a container file */
+typedef struct {
+	loff_t	offset;
+	loff_t	length;
+} uvm_uxu_container_space_t;
+
+/*
+ * Compressed container backing a COMPRESSED range. Its format is described in
+ * uxuz_format.h, shared with the library and the tool creating containers.
+ */
+typedef struct uvm_uxu_container_struct {
+	unsigned	algorithm;
+	unsigned	chunk_shift;
+	NvU64	size;
+	NvU64	nr_chunks;
+	loff_t	index_offset;
+	/* Copy of the index of the file, in the byte order of the file */
+	uxuz_chunk_t	*index;
+	/* Checksums of the chunks as last read or written, so that clean chunks are not written back */
+	NvU32	*sums;
+	unsigned long	*summed;
+	/* End of the chunk data, where the chunks not fitting a gap are appended */
+	loff_t	data_end;
+	/* Gaps between the chunks, unsorted */
+	uvm_uxu_container_space_t	*free;
+	unsigned	nr_free;
+	/* Protects the index, data_end and the gaps */
+	uvm_spinlock_t	lock;
+} uvm_uxu_container_t;
+
+/**
+ * Get the length of the part of the extent which can be read from its file.
+ * It is shorter than the extent if the file ends before the extent.
+ *
+ * @param extent: extent of a uxu range.
+ *
+ * @return: the number of readable bytes from the start of the extent.
+ */
+static inline NvU64
+uxu_extent_readable_length(uvm_uxu_extent_t *extent)
+{
+	loff_t	i_size = i_size_read(extent->filp->f_mapping->host);
+
+	if (i_size <= extent->offset)
+		return 0;
+	return min_t(NvU64, i_size - extent->offset, extent->length);
+}
+
+/**
+ * Find the extent containing an offset of the range.
+ *
+ * @param range: uxu va range.
+ * @param range_offset: offset from the start of the range.
+ *
+ * @return: the extent, or NULL if the offset is past the last extent.
+ */
+static uvm_uxu_extent_t *
+uxu_extent_find(uvm_va_range_t *range, NvU64 range_offset)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	NvU32	lo = 0, hi = uxu_rtn->nr_extents;
+
+	while (lo < hi) {
+		NvU32	mid = lo + (hi - lo) / 2;
+		uvm_uxu_extent_t	*extent = &uxu_rtn->extents[mid];
+
+		if (range_offset < extent->start)
+			hi = mid;
+		else if (range_offset >= extent->start + extent->length)
+			lo = mid + 1;
+		else
+			return extent;
+	}
+	return NULL;
+}
+
+/**
+ * Resolve a page of the range to the file page backing it.
+ *
+ * @param range: uxu va range.
+ * @param addr: page aligned address in the range.
+ * @param pgoff: page index in the file of the returned extent.
+ * @param nr_pages: if not NULL, number of readable pages following this page
+ * contiguously in the file, up to the end of the extent or of the stripe.
+ *
+ * @return: the extent backing the page, or NULL if the page is not backed by
+ * readable file data.
+ */
+static uvm_uxu_extent_t *
+uxu_range_page_lookup(uvm_va_range_t *range, NvU64 addr, pgoff_t *pgoff, unsigned long *nr_pages)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	NvU64	range_offset = addr - range->node.start;
+	uvm_uxu_extent_t	*extent;
+	NvU64	extent_offset, contiguous, readable;
+
+	if (uxu_rtn->stripe_unit == 0) {
+		extent = uxu_extent_find(range, range_offset);
+		if (extent == NULL)
+			return NULL;
+		extent_offset = range_offset - extent->start;
+		contiguous = extent->length - extent_offset;
+	}
+	else {
+		NvU64	stripe = range_offset / uxu_rtn->stripe_unit;
+		NvU64	stripe_offset = range_offset % uxu_rtn->stripe_unit;
+
+		if (range_offset >= uxu_rtn->size)
+			return NULL;
+		extent = &uxu_rtn->extents[stripe % uxu_rtn->nr_extents];
+		extent_offset = (stripe / uxu_rtn->nr_extents) * uxu_rtn->stripe_unit + stripe_offset;
+		contiguous = uxu_rtn->stripe_unit - stripe_offset;
+	}
+
+	// The file of a compressed range is larger or smaller than its data
+	if (uxu_rtn->container)
+		readable = min_t(NvU64, uxu_rtn->container->size, extent->length);
+	else
+		readable = uxu_extent_readable_length(extent);
+	if (extent_offset >= readable)
+		return NULL;
+	*pgoff = (extent->offset + extent_offset) >> PAGE_SHIFT;
+	if (nr_pages)
+		*nr_pages = (min(readable - extent_offset, contiguous) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	return extent;
+}
+
+/**
+ * Map a block of a file to its block on the device.
+ *
+ * @return: the block on the device, 0 for a hole or on error.
+ */
+static sector_t
+uxu_bmap(struct inode *inode, sector_t block)
+{
+#if defined(NV_BMAP_HAS_SECTOR_PTR_ARG)
+	if (bmap(inode, &block) != 0)
+		return 0;
+	return block;
+#else
+	return bmap(inode, block);
+#endif
+}
+
+/**
+ * Does block `probe` of a file continue the run of blocks starting at block
+ * `block`, which is at `physical` on the device, or a hole if 0?
+ */
+static inline bool
+uxu_bmap_continues(struct inode *inode, sector_t block, sector_t physical, sector_t probe)
+{
+	sector_t	p = uxu_bmap(inode, probe);
+
+	if (physical == 0)
+		return p == 0;
+	return p == physical + (probe - block);
+}
+
+/**
+ * Read the physical layout of a part of a file with bmap(), as the swap file
+ * setup does. The end of each run of contiguous blocks is found by probing
+ * blocks at doubling distances and halving the distance once a probe falls
+ * out of the run, so the blocks between two probes of a run are assumed to
+ * be contiguous too. The layout only orders and merges the I/O, a wrong
+ * guess costs a seek. Holes are left out, and only the first
+ * UXU_FIEMAP_MAX_EXTENTS runs with data are kept.
+ *
+ * @param filp: file to look up.
+ * @param start: start of the part of the file.
+ * @param len: length of the part of the file.
+ *
+ * @return: the layout, to be freed with uvm_kvfree(), or NULL if the file
+ * system does not report it.
+ */
+static uvm_uxu_fiemap_t *
+uxu_layout_read(struct file *filp, loff_t start, NvU64 len)
+{
+	struct inode	*inode = file_inode(filp);
+	unsigned int	blkbits = inode->i_blkbits;
+	loff_t	size = i_size_read(inode);
+	uvm_uxu_fiemap_t	*map, *shrunk;
+	sector_t	block, last;
+
+	if (!S_ISREG(inode->i_mode) || inode->i_mapping->a_ops->bmap == NULL || len == 0 || start >= size)
+		return NULL;
+	len = min_t(NvU64, len, size - start);
+
+	map = uvm_kvmalloc(sizeof(*map) + UXU_FIEMAP_MAX_EXTENTS * sizeof(map->extents[0]));
+	if (map == NULL)
+		return NULL;
+	map->nr_extents = 0;
+
+	block = start >> blkbits;
+	last = (start + len - 1) >> blkbits;
+	while (block <= last && map->nr_extents < UXU_FIEMAP_MAX_EXTENTS) {
+		sector_t	physical = uxu_bmap(inode, block);
+		sector_t	nr_blocks = 1;
+		sector_t	step = 1;
+
+		while (block + nr_blocks <= last) {
+			sector_t	probe = min(block + nr_blocks + step - 1, last);
+
+			if (uxu_bmap_continues(inode, block, physical, probe)) {
+				nr_blocks = probe - block + 1;
+				step <<= 1;
+			}
+			else if (step == 1) {
+				break;
+			}
+			else {
+				step >>= 1;
+			}
+			cond_resched();
+		}
+
+		if (physical != 0) {
+			uvm_uxu_fiemap_extent_t	*fe = &map->extents[map->nr_extents++];
+
+			fe->logical = (NvU64)block << blkbits;
+			fe->physical = (NvU64)physical << blkbits;
+			fe->length = (NvU64)nr_blocks << blkbits;
+		}
+		block += nr_blocks;
+	}
+
+	if (map->nr_extents == 0) {
+		uvm_kvfree(map);
+		return NULL;
+	}
+
+	// Keep the layout only as large as the runs found
+	shrunk = uvm_kvrealloc(map, sizeof(*map) + map->nr_extents * sizeof(map->extents[0]));
+	return shrunk ? shrunk : map;
+}
+
+/**
+ * Open a file of the user again, read-only, for UXU to seek in. Its file
+ * position is private, so SEEK_DATA and SEEK_HOLE never move the one of the
+ * user.
+ *
+ * @param filp: file of the user.
+ *
+ * @return: the new file, or NULL if it cannot be opened.
+ */
+static struct file *
+uxu_seek_file_open(struct file *filp)
+{
+	struct file	*seek_filp;
+
+	if (!S_ISREG(file_inode(filp)->i_mode))
+		return NULL;
+
+	seek_filp = dentry_open(&filp->f_path, O_RDONLY | O_LARGEFILE, filp->f_cred);
+	if (IS_ERR(seek_filp))
+		return NULL;
+	return seek_filp;
+}
+
+/**
+ * Drop the references to the files of the extents and free them.
+ *
+ * @param extents: extents of a range.
+ * @param nr_extents: number of extents holding a file reference.
+ */
+static void
+uxu_extents_put(uvm_uxu_extent_t *extents, NvU32 nr_extents)
+{
+	NvU32	i;
+
+	for (i = 0; i < nr_extents; i++) {
+		uvm_kvfree(extents[i].fiemap);
+		if (extents[i].seek_filp)
+			fput(extents[i].seek_filp);
+		fput(extents[i].filp);
+	}
+	uvm_kvfree(extents);
+}
+
+/**
+ * Build the extents of a range from the map parameters, taking a reference
+ * to each file. A range mapped from a single file gets one extent.
+ *
+ * @param params: map parameters.
+ * @param pextents: the extents, sorted by start.
+ * @param pnr_extents: the number of extents.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_extents_get(UVM_UXU_MAP_PARAMS *params, uvm_uxu_extent_t **pextents, NvU32 *pnr_extents)
+{
+	UVM_UXU_EXTENT	single;
+	UVM_UXU_EXTENT	*uextents = &single;
+	uvm_uxu_extent_t	*extents;
+	NvU32	nr_extents = params->nr_extents;
+	NvU64	start = 0;
+	NV_STATUS	status = NV_OK;
+	NvU32	i;
+
+	if (!PAGE_ALIGNED(params->stripe_unit) || (params->stripe_unit != 0 && nr_extents == 0)) {
+		printk(KERN_DEBUG "Error: invalid stripe unit 0x%llx\n", params->stripe_unit);
+		return NV_ERR_INVALID_ARGUMENT;
+	}
+
+	if (nr_extents == 0) {
+		single.backing_fd = params->backing_fd;
+		single.offset = params->offset;
+		single.length = params->size;
+		nr_extents = 1;
+	}
+	else {
+		if (nr_extents > UVM_UXU_MAX_EXTENTS) {
+			printk(KERN_DEBUG "Error: too many extents: %u\n", nr_extents);
+			return NV_ERR_INVALID_ARGUMENT;
+		}
+		uextents = uvm_kvmalloc(nr_extents * sizeof(*uextents));
+		if (uextents == NULL)
+			return NV_ERR_NO_MEMORY;
+		if (nv_copy_from_user(uextents, (void __user *)params->extents, nr_extents * sizeof(*uextents))) {
+			uvm_kvfree(uextents);
+			return NV_ERR_INVALID_ADDRESS;
+		}
+	}
+
+	extents = uvm_kvmalloc_zero(nr_extents * sizeof(*extents));
+	if (extents == NULL) {
+		status = NV_ERR_NO_MEMORY;
+		goto out;
+	}
+
+	for (i = 0; i < nr_extents; i++) {
+		// The page cache is indexed by page, so a page must not straddle
+		// two extents. Stripes are page aligned, so the length of the
+		// extents of a striped range does not matter.
+		if (!PAGE_ALIGNED(uextents[i].offset) || uextents[i].length == 0 ||
+		    (params->stripe_unit == 0 && i < nr_extents - 1 && !PAGE_ALIGNED(uextents[i].length))) {
+			printk(KERN_DEBUG "Error: extent %u is not page aligned\n", i);
+			status = NV_ERR_INVALID_ARGUMENT;
+			break;
+		}
+		if ((extents[i].filp = fget(uextents[i].backing_fd)) == NULL) {
+			printk(KERN_DEBUG "Cannot find the backing fd: %d\n", uextents[i].backing_fd);
+			status = NV_ERR_OPERATING_SYSTEM;
+			break;
+		}
+		extents[i].seek_filp = uxu_seek_file_open(extents[i].filp);
+		extents[i].start = start;
+		extents[i].offset = uextents[i].offset;
+		extents[i].length = uextents[i].length;
+		extents[i].fiemap = uxu_layout_read(extents[i].filp, extents[i].offset, extents[i].length);
+		file_ra_state_init(&extents[i].ra, extents[i].filp->f_mapping);
+		atomic64_set(&extents[i].read_bytes, 0);
+		atomic64_set(&extents[i].writeback_bytes, 0);
+		start += uextents[i].length;
+	}
+
+	if (status == NV_OK && start != params->size) {
+		printk(KERN_DEBUG "Error: extents cover 0x%llx bytes, not 0x%zx\n", start, params->size);
+		status = NV_ERR_INVALID_ARGUMENT;
+	}
+
+	if (status == NV_OK) {
+		*pextents = extents;
+		*pnr_extents = nr_extents;
+	}
+	else {
+		uxu_extents_put(extents, i);
+	}
+
+out:
+	if (uextents != &single)
+		uvm_kvfree(uextents);
+	return status;
+}
+
+static inline uvm_uxu_extent_t *
+uxu_block_page_lookup(uvm_va_block_t *block, uvm_page_index_t page_index, pgoff_t *pgoff, unsigned long *nr_pages)
+{
+	return uxu_range_page_lookup(block->va_range, block->start + ((NvU64)page_index << PAGE_SHIFT), pgoff, nr_pages);
+}
+
+/**
+ * Find the next data or hole in the file of an extent, without moving the
+ * file position of the user. Unwritten extents are holes for the file
+ * systems supporting SEEK_DATA, the others report the whole file as data.
+ *
+ * The seek runs on the private file of the extent. Concurrent seeks only
+ * race on its file position, which UXU never reads, so no lock is taken.
+ * Holes are only an optimization, the data is read when they cannot be
+ * looked for.
+ *
+ * @param extent: extent whose file is searched.
+ * @param pos: position in the file to search from.
+ * @param whence: SEEK_DATA or SEEK_HOLE.
+ *
+ * @return: the position of the next data or hole, LLONG_MAX if there is no
+ * data after `pos`, or a negative errno.
+ */
+static loff_t
+uxu_extent_seek(uvm_uxu_extent_t *extent, loff_t pos, int whence)
+{
+	loff_t	ret;
+
+	if (extent->seek_filp == NULL)
+		return -EBADF;
+	ret = vfs_llseek(extent->seek_filp, pos, whence);
+
+	// Past the end of the file, there is no data and everything is a hole
+	if (ret == -ENXIO)
+		ret = whence == SEEK_DATA ? LLONG_MAX : pos;
+	return ret;
+}
+
+/**
+ * Skip the leading hole of a run of pages of an extent, and stop the run at
+ * the following hole.
+ *
+ * @param extent: extent of the run.
+ * @param pgoff: first page of the run in the file, moved to the first page
+ * with data.
+ * @param nr_pages: number of pages of the run, reduced to the pages with
+ * data. 0 if the whole run is a hole.
+ *
+ * @return: the number of pages skipped at the start of the run.
+ */
+static unsigned long
+uxu_extent_skip_hole(uvm_uxu_extent_t *extent, pgoff_t *pgoff, unsigned long *nr_pages)
+{
+	loff_t	pos = (loff_t)*pgoff << PAGE_SHIFT;
+	loff_t	end = pos + ((loff_t)*nr_pages << PAGE_SHIFT);
+	loff_t	data, hole;
+	unsigned long	skipped;
+
+	data = uxu_extent_seek(extent, pos, SEEK_DATA);
+	if (data < 0)
+		return 0;
+	if (data >= end) {
+		skipped = *nr_pages;
+		*nr_pages = 0;
+		return skipped;
+	}
+
+	skipped = (data - pos) >> PAGE_SHIFT;
+	*pgoff += skipped;
+	*nr_pages -= skipped;
+
+	hole = uxu_extent_seek(extent, data, SEEK_HOLE);
+	if (hole > data && hole < end)
+		*nr_pages = (round_up(hole, PAGE_SIZE) >> PAGE_SHIFT) - *pgoff;
+	return skipped;
+}
+
+/**
+ * Get the location on the storage device of a position of the file of an
+ * extent, from the layout read when the range was mapped.
+ *
+ * @param extent: extent whose file is looked up.
+ * @param pos: position in the file.
+ *
+ * @return: the physical byte offset of `pos`, or UXU_PHYSICAL_UNKNOWN if the
+ * file system does not report it or the data was not allocated yet.
+ */
+static NvU64
+uxu_extent_physical(uvm_uxu_extent_t *extent, loff_t pos)
+{
+	uvm_uxu_fiemap_t	*map = extent->fiemap;
+	NvU32	lo = 0, hi;
+
+	if (map == NULL)
+		return UXU_PHYSICAL_UNKNOWN;
+
+	// Last extent starting at or before `pos`
+	hi = map->nr_extents;
+	while (lo < hi) {
+		NvU32	mid = lo + (hi - lo) / 2;
+
+		if (map->extents[mid].logical <= pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0 || pos >= map->extents[lo - 1].logical + map->extents[lo - 1].length)
+		return UXU_PHYSICAL_UNKNOWN;
+	return map->extents[lo - 1].physical + (pos - map->extents[lo - 1].logical);
+}
 
 struct proc_dir_entry	*procfs_entry_uxu;
 
-static atomic64_t	n_uxu_blks;
+static atomic64_t	n_uxu_blks;
+
+/* Queue warming up the page cache from recorded access profiles */
+static nv_kthread_q_t	uxu_warmup_q;
+
+/*
+ * Queue of the storage I/O done without the locks of the paths starting it:
+ * the read ahead of the blocks predicted by the prefetch heuristics, and the
+ * write-back of the blocks released by the reclaim service
+ */
+static nv_kthread_q_t	uxu_io_q;
+
+/* Read aheads queued on uxu_io_q and not done yet */
+static atomic_t	uxu_prefetch_pending = ATOMIC_INIT(0);
+
+/* Predictions are only hints, they are dropped beyond this many read aheads */
+#define UXU_PREFETCH_MAX_PENDING	256
+
+/* Thread reclaiming blocks for all the UXU va_spaces */
+static struct task_struct	*uxu_reclaimer;
+
+/* Woken up when memory runs short, with uxu_reclaim_pending set */
+static DECLARE_WAIT_QUEUE_HEAD(uxu_reclaim_wq);
+static atomic_t	uxu_reclaim_pending = ATOMIC_INIT(0);
+
+/* Woken up when the reclaim service drops its reference on a va_space */
+static DECLARE_WAIT_QUEUE_HEAD(uxu_reclaim_done_wq);
+
+/* Reclaim share of the va_spaces which do not ask for one */
+#define UXU_DEFAULT_RECLAIM_SHARE	100
+
+/* Maximum number of va_spaces swept each time the reclaim service wakes up */
+#define UXU_RECLAIM_MAX_SWEEPS	16
+
+/*
+ * Host memory used by UXU is charged to the memory cgroup of the process
+ * which initialized UXU, even when it is allocated by the fault servicing
+ * and reclaim threads: each allocation site sets the active memcg of the
+ * thread. This needs set_active_memcg(), or memalloc_use_memcg() before
+ * 5.10. Before 5.10 the active memcg only applies to __GFP_ACCOUNT
+ * allocations, the anonymous and host buffer pages, and the page cache read
+ * by the threads is charged to the root cgroup. Nothing is charged on
+ * kernels older than 4.19.
+ */
+#if defined(CONFIG_MEMCG) && (defined(NV_SET_ACTIVE_MEMCG_PRESENT) || defined(NV_MEMALLOC_USE_MEMCG_PRESENT))
+#include <linux/sched/mm.h>
+#define UXU_MEMCG_SUPPORTED	1
+#else
+#define UXU_MEMCG_SUPPORTED	0
+#endif
+
+/*
+ * Number of storage reads a fault batch queues before submitting them sorted
+ * by physical location. 0 submits every read as soon as it is known.
+ */
+static unsigned	uvm_uxu_io_batch_runs = 64;
+module_param(uvm_uxu_io_batch_runs, uint, S_IRUGO);
+
+/*
+ * Size limit of the pool of compressed blocks of each va_space, in MB. 0
+ * disables the pool. It needs LZ4 in the kernel.
+ */
+static unsigned	uvm_uxu_zpool_mb = 0;
+module_param(uvm_uxu_zpool_mb, uint, S_IRUGO);
+
+/* Reclaim from a va_space when its memory cgroup has less than this percentage of its limit left */
+static unsigned	uvm_uxu_memcg_headroom = 5;
+module_param(uvm_uxu_memcg_headroom, uint, S_IRUGO);
+
+/* Upper bound of the pinned host buffer pool of a va_space, in MB */
+static unsigned	uvm_uxu_hostbuf_pool_mb = 256;
+module_param(uvm_uxu_hostbuf_pool_mb, uint, S_IRUGO);
+
+#define UXU_PROFILE_XATTR_NAME	"user.uxu.access_profile"
+#define UXU_PROFILE_MAGIC	0x50555855	/* "UXUP" */
+
+/*
+ * Access profile as stored in the extended attribute of the backing file.
+ * It lists the first page offset of each block in the order the blocks have
+ * been loaded from storage.
+ */
+typedef struct {
+	NvU32	magic;
+	NvU32	nr_blocks;
+	NvU32	pgoff[0];
+} uxu_access_profile_t;
+
+#define UXU_PROFILE_MAX_BLOCKS	((XATTR_SIZE_MAX - sizeof(uxu_access_profile_t)) / sizeof(NvU32))
+
+typedef struct uvm_uxu_profile_struct {
+	/* Blocks already recorded, indexed by block index in the range */
+	unsigned long	*recorded;
+	atomic_t	nr_recorded;
+	/* Profile being recorded in this mapping */
+	uxu_access_profile_t	*data;
+
+	/* Profile recorded by a previous mapping, used for the warm up */
+	uxu_access_profile_t	*warmup;
+	struct file	*filp;
+	uvm_uxu_va_space_t	*uxu_va_space;
+	uvm_va_range_t	*range;
+	nv_kthread_q_item_t	warmup_q_item;
+	struct completion	warmup_done;
+	bool	warmup_scheduled;
+	bool	warmup_cancel;
+} uvm_uxu_profile_t;
+
+/*
+ * Statistics kept per va_space and per range. They are updated on the fault
+ * and reclaim paths, so they are per-CPU and only summed up by procfs.
+ */
+typedef enum {
+	UXU_STAT_READ_SYNC_BYTES,
+	UXU_STAT_READ_AHEAD_BYTES,
+	UXU_STAT_WRITEBACK_BYTES,
+	UXU_STAT_BLOCKS_LOADED,
+	UXU_STAT_BLOCKS_RELEASED,
+	UXU_STAT_BLOCKS_RELOADED,
+	UXU_STAT_REDUCER_SWEEPS,
+	UXU_STAT_REDUCER_NS,
+	UXU_STAT_EVICTION_COPY_BYTES,
+	UXU_STAT_DIRECT_READ_BYTES,
+	UXU_STAT_DIRECT_WRITE_BYTES,
+	UXU_STAT_COMPRESSED_READ_BYTES,
+	UXU_STAT_COMPRESSED_WRITE_BYTES,
+	UXU_STAT_HOLE_BYTES,
+	UXU_STAT_ZPOOL_STORED_BYTES,
+	UXU_STAT_ZPOOL_COMPRESSED_BYTES,
+	UXU_STAT_ZPOOL_REJECTED_BLOCKS,
+	UXU_STAT_ZPOOL_EVICTED_BLOCKS,
+	UXU_STAT_ZPOOL_HITS,
+	UXU_STAT_ZPOOL_MISSES,
+	UXU_STAT_ZPOOL_LOAD_BYTES,
+	UXU_STAT_COUNT
+} uxu_stat_t;
+
+static const char *uxu_stat_names[UXU_STAT_COUNT] = {
+	[UXU_STAT_READ_SYNC_BYTES]	= "read_sync_bytes",
+	[UXU_STAT_READ_AHEAD_BYTES]	= "read_ahead_bytes",
+	[UXU_STAT_WRITEBACK_BYTES]	= "writeback_bytes",
+	[UXU_STAT_BLOCKS_LOADED]	= "blocks_loaded",
+	[UXU_STAT_BLOCKS_RELEASED]	= "blocks_released",
+	[UXU_STAT_BLOCKS_RELOADED]	= "blocks_reloaded",
+	[UXU_STAT_REDUCER_SWEEPS]	= "reducer_sweeps",
+	[UXU_STAT_REDUCER_NS]	= "reducer_ns",
+	[UXU_STAT_EVICTION_COPY_BYTES]	= "eviction_copy_bytes",
+	[UXU_STAT_DIRECT_READ_BYTES]	= "direct_read_bytes",
+	[UXU_STAT_DIRECT_WRITE_BYTES]	= "direct_write_bytes",
+	[UXU_STAT_COMPRESSED_READ_BYTES]	= "compressed_read_bytes",
+	[UXU_STAT_COMPRESSED_WRITE_BYTES]	= "compressed_write_bytes",
+	[UXU_STAT_HOLE_BYTES]	= "hole_bytes",
+	[UXU_STAT_ZPOOL_STORED_BYTES]	= "zpool_stored_bytes",
+	[UXU_STAT_ZPOOL_COMPRESSED_BYTES]	= "zpool_compressed_bytes",
+	[UXU_STAT_ZPOOL_REJECTED_BLOCKS]	= "zpool_rejected_blocks",
+	[UXU_STAT_ZPOOL_EVICTED_BLOCKS]	= "zpool_evicted_blocks",
+	[UXU_STAT_ZPOOL_HITS]	= "zpool_hits",
+	[UXU_STAT_ZPOOL_MISSES]	= "zpool_misses",
+	[UXU_STAT_ZPOOL_LOAD_BYTES]	= "zpool_load_bytes",
+};
+
+/* Bucket i counts latencies in [2^i, 2^(i+1)) us, the last one everything above */
+#define UXU_STAT_LATENCY_BUCKETS	24
+
+typedef enum {
+	UXU_STAT_LATENCY_LOAD,
+	UXU_STAT_LATENCY_FLUSH,
+	UXU_STAT_LATENCY_COUNT
+} uxu_stat_latency_t;
+
+static const char *uxu_stat_latency_names[UXU_STAT_LATENCY_COUNT] = {
+	[UXU_STAT_LATENCY_LOAD]		= "block_load_latency_us",
+	[UXU_STAT_LATENCY_FLUSH]	= "block_flush_latency_us",
+};
+
+typedef struct uvm_uxu_stats_struct {
+	NvU64	counters[UXU_STAT_COUNT];
+	NvU64	latency[UXU_STAT_LATENCY_COUNT][UXU_STAT_LATENCY_BUCKETS];
+} uvm_uxu_stats_t;
+
+/**
+ * Account an event to the statistics of the range and of its va_space.
+ *
+ * @param range: uxu va range the event happened in.
+ * @param stat: counter to be updated.
+ * @param val: value to be added to the counter.
+ */
+static inline void
+uxu_stat_add(uvm_va_range_t *range, uxu_stat_t stat, NvU64 val)
+{
+	uvm_uxu_stats_t __percpu	*va_space_stats = range->va_space->uxu_va_space.stats;
+	uvm_uxu_stats_t __percpu	*range_stats = range->node.uxu_rtn.stats;
+
+	if (va_space_stats)
+		this_cpu_add(va_space_stats->counters[stat], val);
+	if (range_stats)
+		this_cpu_add(range_stats->counters[stat], val);
+}
+
+/**
+ * Account the latency of an operation started at `start` to the log2
+ * histograms of the range and of its va_space.
+ */
+static inline void
+uxu_stat_latency(uvm_va_range_t *range, uxu_stat_latency_t hist, NvU64 start)
+{
+	uvm_uxu_stats_t __percpu	*va_space_stats = range->va_space->uxu_va_space.stats;
+	uvm_uxu_stats_t __percpu	*range_stats = range->node.uxu_rtn.stats;
+	NvU64	us = (NV_GETTIME() - start) / NSEC_PER_USEC;
+	unsigned	bucket = us ? min((unsigned)ilog2(us), (unsigned)UXU_STAT_LATENCY_BUCKETS - 1) : 0;
+
+	if (va_space_stats)
+		this_cpu_inc(va_space_stats->latency[hist][bucket]);
+	if (range_stats)
+		this_cpu_inc(range_stats->latency[hist][bucket]);
+}
+
+/**
+ * Determine if we need to reclaim some blocks or not.
+ *
+ * @param reserved_nr_pages: number of pages to be kept free or in the page cache.
+ *
+ * @return: true if we need to reclaim, false otherwise.
+ */
+static inline bool
+uxu_has_to_reclaim_blocks(unsigned long reserved_nr_pages)
+{
+	unsigned long	freeram = global_zone_page_state(NR_FREE_PAGES);
+	unsigned long	pagecacheram = global_zone_page_state(NR_FILE_PAGES);
+	return freeram + pagecacheram < reserved_nr_pages;
+}
+
+/**
+ * Determine if the memory cgroup UXU charges the va_space to is close to its
+ * limit.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ *
+ * @return: true if blocks of this va_space have to be reclaimed, false otherwise.
+ */
+static bool
+uxu_memcg_under_pressure(uvm_uxu_va_space_t *uxu_va_space)
+{
+#if UXU_MEMCG_SUPPORTED && defined(NV_MEM_CGROUP_GET_MAX_PRESENT)
+	struct mem_cgroup	*memcg = uxu_va_space->memcg;
+	unsigned long	max;
+
+	if (memcg == NULL || mem_cgroup_is_root(memcg))
+		return false;
+
+	// The limit includes the swap the cgroup may use, if any
+	max = mem_cgroup_get_max(memcg);
+	if (max >= PAGE_COUNTER_MAX)
+		return false;
+
+	return page_counter_read(&memcg->memory) > max - max / 100 * min(uvm_uxu_memcg_headroom, 100u);
+#else
+	return false;
+#endif
+}
+
+/**
+ * Wake up the reclaim service if the system or the memory cgroup of the
+ * va_space is short of memory. Called whenever UXU allocates host memory.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ */
+static void
+uxu_reclaim_kick(uvm_uxu_va_space_t *uxu_va_space)
+{
+	if (!uxu_has_to_reclaim_blocks(uxu_va_space->reserved_nr_pages) &&
+	    !uxu_memcg_under_pressure(uxu_va_space))
+		return;
+
+	// Only the first kick of a burst pays for the wake up
+	if (atomic_xchg(&uxu_reclaim_pending, 1) == 0)
+		wake_up(&uxu_reclaim_wq);
+}
+
+/**
+ * Charge the host memory allocated from now on to the memory cgroup of the
+ * va_space. Must be paired with uxu_memcg_exit().
+ *
+ * @param va_space: va_space the memory is allocated for.
+ *
+ * @return: the memory cgroup to be restored by uxu_memcg_exit().
+ */
+static inline struct mem_cgroup *
+uxu_memcg_use(struct mem_cgroup *memcg)
+{
+#if UXU_MEMCG_SUPPORTED && defined(NV_SET_ACTIVE_MEMCG_PRESENT)
+	return set_active_memcg(memcg);
+#elif UXU_MEMCG_SUPPORTED
+	// The active memcg does not nest before 5.10, UXU never nests it
+	if (memcg)
+		memalloc_use_memcg(memcg);
+	return NULL;
+#else
+	return NULL;
+#endif
+}
+
+static inline struct mem_cgroup *
+uxu_memcg_enter(uvm_va_space_t *va_space)
+{
+	return uxu_memcg_use(va_space->uxu_va_space.memcg);
+}
+
+static inline void
+uxu_memcg_exit(struct mem_cgroup *old_memcg)
+{
+#if UXU_MEMCG_SUPPORTED && defined(NV_SET_ACTIVE_MEMCG_PRESENT)
+	set_active_memcg(old_memcg);
+#elif UXU_MEMCG_SUPPORTED
+	memalloc_unuse_memcg();
+#endif
+}
+
+/**
+ * Take a reference to the memory cgroup of a va_space, for work done on its
+ * behalf which may outlive it. Must be paired with uxu_memcg_put().
+ *
+ * @return: the memory cgroup, to be passed to uxu_memcg_use().
+ */
+static inline struct mem_cgroup *
+uxu_memcg_get(uvm_va_space_t *va_space)
+{
+#if UXU_MEMCG_SUPPORTED
+	struct mem_cgroup	*memcg = va_space->uxu_va_space.memcg;
+
+	if (memcg)
+		css_get(&memcg->css);
+	return memcg;
+#else
+	return NULL;
+#endif
+}
+
+static inline void
+uxu_memcg_put(struct mem_cgroup *memcg)
+{
+#if UXU_MEMCG_SUPPORTED
+	mem_cgroup_put(memcg);
+#endif
+}
+
+/* Number of LRU updates buffered per CPU before they are applied to the list */
+#define UXU_LRU_BATCH_SIZE	15
+
+/*
+ * Per-CPU buffer of blocks to be moved to the tail of the LRU list, in the
+ * manner of the kernel pagevecs. Touching a block only takes the per-CPU
+ * spinlock, and lock_blocks is taken once per UXU_LRU_BATCH_SIZE touches.
+ *
+ * Blocks are added to the buffers with the va_space lock held in read mode.
+ * Anything taking blocks off the LRU list drains all the buffers first with
+ * the va_space lock held in write mode, so the buffers never point to a
+ * released block.
+ */
+typedef struct uvm_uxu_lru_batch_struct {
+	uvm_spinlock_t	lock;
+	unsigned int	nr;
+	uvm_va_block_t	*blocks[UXU_LRU_BATCH_SIZE];
+} uvm_uxu_lru_batch_t;
+
+/**
+ * Move the blocks to the tail of the LRU list.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ * @param blocks: blocks to be moved, oldest touch first.
+ * @param nr: number of blocks.
+ */
+static void
+uxu_lru_apply(uvm_uxu_va_space_t *uxu_va_space, uvm_va_block_t **blocks, unsigned int nr)
+{
+	unsigned int	i;
+
+	uvm_mutex_lock(&uxu_va_space->lock_blocks);
+	for (i = 0; i < nr; i++)
+		list_move_tail(&blocks[i]->uxu_lru, &uxu_va_space->lru_head);
+	uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+}
+
+/**
+ * Apply the LRU updates buffered by all CPUs. Must be called before scanning
+ * the LRU list or taking blocks off it.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ */
+static void
+uxu_lru_drain(uvm_uxu_va_space_t *uxu_va_space)
+{
+	int	cpu;
+
+	if (!uxu_va_space->lru_batch)
+		return;
+
+	uvm_mutex_lock(&uxu_va_space->lock_blocks);
+	for_each_possible_cpu(cpu) {
+		uvm_uxu_lru_batch_t	*batch = per_cpu_ptr(uxu_va_space->lru_batch, cpu);
+		unsigned int	i;
+
+		uvm_spin_lock(&batch->lock);
+		for (i = 0; i < batch->nr; i++)
+			list_move_tail(&batch->blocks[i]->uxu_lru, &uxu_va_space->lru_head);
+		batch->nr = 0;
+		uvm_spin_unlock(&batch->lock);
+	}
+	uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+}
+
+/**
+ * Mark that we just touch this block, which has in-buffer data. The block
+ * is moved to the tail of the LRU list when the buffer of the current CPU
+ * fills up or when the list is drained.
+ *
+ * @param va_block: va_block to be marked.
+ */
+static void
+uxu_block_mark_recent_in_buffer(uvm_va_block_t *va_block)
+{
+	uvm_uxu_va_space_t	*uxu_va_space = &va_block->va_range->va_space->uxu_va_space;
+	uvm_va_block_t	*blocks[UXU_LRU_BATCH_SIZE];
+	uvm_uxu_lru_batch_t	*batch;
+	unsigned int	nr = 0;
+
+	// Compared across va_spaces by the reclaim service
+	WRITE_ONCE(va_block->uxu_lru_touched, jiffies);
+
+	// Without the buffers, update the list right away
+	if (!uxu_va_space->lru_batch) {
+		uxu_lru_apply(uxu_va_space, &va_block, 1);
+		return;
+	}
+
+	batch = get_cpu_ptr(uxu_va_space->lru_batch);
+	uvm_spin_lock(&batch->lock);
+	batch->blocks[batch->nr++] = va_block;
+	if (batch->nr == UXU_LRU_BATCH_SIZE) {
+		nr = batch->nr;
+		memcpy(blocks, batch->blocks, nr * sizeof(blocks[0]));
+		batch->nr = 0;
+	}
+	uvm_spin_unlock(&batch->lock);
+	put_cpu_ptr(uxu_va_space->lru_batch);
+
+	// lock_blocks is a mutex, so the full batch is applied out of the spinlock
+	if (nr)
+		uxu_lru_apply(uxu_va_space, blocks, nr);
+}
+
+/**
+ * Append the block to the access profile of its range, if it has not been
+ * recorded yet. Blocks can be loaded concurrently, so the profile is updated
+ * without locking.
+ *
+ * @param block: the block just loaded from storage.
+ */
+static void
+uxu_profile_record(uvm_va_block_t *block)
+{
+	uvm_uxu_profile_t	*profile = block->va_range->node.uxu_rtn.profile;
+	pgoff_t	pgoff;
+	int	idx;
+
+	if (profile == NULL)
+		return;
+	if (uxu_range_page_lookup(block->va_range, block->start, &pgoff, NULL) == NULL || pgoff > U32_MAX)
+		return;
+
+	if (test_and_set_bit(uvm_va_range_block_index(block->va_range, block->start), profile->recorded))
+		return;
+
+	idx = atomic_inc_return(&profile->nr_recorded) - 1;
+	if (idx < UXU_PROFILE_MAX_BLOCKS)
+		profile->data->pgoff[idx] = (NvU32)pgoff;
+}
+
+/**
+ * Read the blocks of a previously recorded profile into the page cache, in
+ * the recorded order. The warm up stops early on memory pressure, since the
+ * reducer would immediately reclaim what is read.
+ */
+static void
+uxu_profile_warmup(void *args)
+{
+	uvm_uxu_profile_t	*profile = (uvm_uxu_profile_t *)args;
+	struct address_space	*mapping = profile->filp->f_mapping;
+	uvm_uxu_extent_t	*extent = &profile->range->node.uxu_rtn.extents[0];
+	pgoff_t	pgoff_first = extent->offset >> PAGE_SHIFT;
+	pgoff_t	pgoff_eof = (extent->offset + uxu_extent_readable_length(extent) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	struct file_ra_state	ra;
+	struct mem_cgroup	*old_memcg;
+	NvU32	i;
+
+	file_ra_state_init(&ra, mapping);
+	ra.ra_pages = PAGES_PER_UVM_VA_BLOCK;
+
+	old_memcg = uxu_memcg_enter(profile->range->va_space);
+
+	for (i = 0; i < profile->warmup->nr_blocks; i++) {
+		pgoff_t	pgoff = profile->warmup->pgoff[i];
+
+		if (READ_ONCE(profile->warmup_cancel))
+			break;
+		if (uxu_has_to_reclaim_blocks(profile->uxu_va_space->reserved_nr_pages))
+			break;
+		// The profile may have been recorded by another range of a packed file
+		if (pgoff < pgoff_first || pgoff >= pgoff_eof)
+			continue;
+		page_cache_sync_readahead(mapping, &ra, profile->filp, pgoff, PAGES_PER_UVM_VA_BLOCK);
+		uxu_stat_add(profile->range, UXU_STAT_READ_AHEAD_BYTES,
+			     (NvU64)min((pgoff_t)PAGES_PER_UVM_VA_BLOCK, pgoff_eof - pgoff) << PAGE_SHIFT);
+		cond_resched();
+	}
+
+	uxu_memcg_exit(old_memcg);
+
+	complete(&profile->warmup_done);
+}
+
+static void
+uxu_profile_warmup_entry(void *args)
+{
+	UVM_ENTRY_VOID(uxu_profile_warmup(args));
+}
+
+/* vfs_getxattr() takes the idmap of the mount since 5.12 */
+static ssize_t
+uxu_profile_getxattr(struct file *filp, void *value, size_t size)
+{
+#if defined(NV_VFS_GETXATTR_HAS_MNT_IDMAP_ARG)
+	return vfs_getxattr(file_mnt_idmap(filp), file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size);
+#elif defined(NV_VFS_GETXATTR_HAS_USERNS_ARG)
+	return vfs_getxattr(file_mnt_user_ns(filp), file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size);
+#else
+	return vfs_getxattr(file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size);
+#endif
+}
+
+static int
+uxu_profile_setxattr(struct file *filp, const void *value, size_t size)
+{
+#if defined(NV_VFS_SETXATTR_HAS_MNT_IDMAP_ARG)
+	return vfs_setxattr(file_mnt_idmap(filp), file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size, 0);
+#elif defined(NV_VFS_SETXATTR_HAS_USERNS_ARG)
+	return vfs_setxattr(file_mnt_user_ns(filp), file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size, 0);
+#else
+	return vfs_setxattr(file_dentry(filp), UXU_PROFILE_XATTR_NAME, value, size, 0);
+#endif
+}
+
+/**
+ * Start recording the access profile of the range and, if the backing file
+ * holds a profile from a previous mapping, start warming up the page cache
+ * from it.
+ *
+ * @param range: va range just mapped with UVM_UXU_FLAG_PROFILE.
+ *
+ * @return: NV_OK on success, NV_ERR_NO_MEMORY otherwise.
+ */
+static NV_STATUS
+uxu_profile_create(uvm_va_range_t *range)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	uvm_uxu_profile_t	*profile;
+	ssize_t	len;
+
+	profile = uvm_kvmalloc_zero(sizeof(*profile));
+	if (profile == NULL)
+		return NV_ERR_NO_MEMORY;
+
+	profile->recorded = uvm_kvmalloc_zero(BITS_TO_LONGS(uvm_va_range_num_blocks(range)) * sizeof(unsigned long));
+	profile->data = uvm_kvmalloc(XATTR_SIZE_MAX);
+	profile->warmup = uvm_kvmalloc(XATTR_SIZE_MAX);
+	if (profile->recorded == NULL || profile->data == NULL || profile->warmup == NULL)
+		goto error;
+
+	atomic_set(&profile->nr_recorded, 0);
+	profile->filp = uxu_rtn->filp;
+	profile->uxu_va_space = &range->va_space->uxu_va_space;
+	profile->range = range;
+	init_completion(&profile->warmup_done);
+	uxu_rtn->profile = profile;
+
+	len = uxu_profile_getxattr(uxu_rtn->filp, profile->warmup, XATTR_SIZE_MAX);
+	if (len < (ssize_t)sizeof(uxu_access_profile_t) ||
+	    profile->warmup->magic != UXU_PROFILE_MAGIC ||
+	    len != sizeof(uxu_access_profile_t) + profile->warmup->nr_blocks * sizeof(NvU32))
+		return NV_OK;
+
+	nv_kthread_q_item_init(&profile->warmup_q_item, uxu_profile_warmup_entry, profile);
+	profile->warmup_scheduled = true;
+	nv_kthread_q_schedule_q_item(&uxu_warmup_q, &profile->warmup_q_item);
+
+	return NV_OK;
+
+error:
+	uvm_kvfree(profile->warmup);
+	uvm_kvfree(profile->data);
+	uvm_kvfree(profile->recorded);
+	uvm_kvfree(profile);
+	return NV_ERR_NO_MEMORY;
+}
+
+/**
+ * Has the recorded access profile changed from the one stored in the backing
+ * file? Unchanged profiles are not written again.
+ *
+ * @param profile: profile of a range being destroyed.
+ * @param nr_blocks: number of blocks recorded.
+ *
+ * @return: true if the profile has to be saved, false otherwise.
+ */
+static bool
+uxu_profile_changed(uvm_uxu_profile_t *profile, NvU32 nr_blocks)
+{
+	// The stored profile is only kept when it is valid
+	if (!profile->warmup_scheduled)
+		return nr_blocks > 0;
+
+	return profile->warmup->nr_blocks != nr_blocks ||
+	       memcmp(profile->warmup->pgoff, profile->data->pgoff, nr_blocks * sizeof(NvU32)) != 0;
+}
+
+/**
+ * Save the recorded access profile to the backing file, if it has changed,
+ * and free it. Filesystems limit the size of extended attributes differently,
+ * so the profile is truncated until it fits.
+ *
+ * @param range: va range being destroyed.
+ */
+static void
+uxu_profile_destroy(uvm_va_range_t *range)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	uvm_uxu_profile_t	*profile = uxu_rtn->profile;
+	NvU32	nr_blocks;
+
+	if (profile == NULL)
+		return;
+
+	if (profile->warmup_scheduled) {
+		WRITE_ONCE(profile->warmup_cancel, true);
+		wait_for_completion(&profile->warmup_done);
+	}
+
+	nr_blocks = min((NvU32)atomic_read(&profile->nr_recorded), (NvU32)UXU_PROFILE_MAX_BLOCKS);
+	if (!uxu_profile_changed(profile, nr_blocks))
+		nr_blocks = 0;
+	profile->data->magic = UXU_PROFILE_MAGIC;
+	while (nr_blocks > 0) {
+		int	ret;
+
+		profile->data->nr_blocks = nr_blocks;
+		ret = uxu_profile_setxattr(uxu_rtn->filp, profile->data,
+					   sizeof(uxu_access_profile_t) + nr_blocks * sizeof(NvU32));
+		if (ret != -E2BIG && ret != -ENOSPC && ret != -ERANGE) {
+			if (ret != 0)
+				printk(KERN_DEBUG "Cannot save the uxu access profile: %d\n", ret);
+			break;
+		}
+		nr_blocks /= 2;
+	}
+
+	uxu_rtn->profile = NULL;
+	uvm_kvfree(profile->warmup);
+	uvm_kvfree(profile->data);
+	uvm_kvfree(profile->recorded);
+	uvm_kvfree(profile);
+}
+
+static void
+uxu_unmap_page(uvm_va_block_t *va_block, int page_index)
+{
+	uvm_gpu_id_t	id;
+
+	for_each_gpu_id(id) {
+		uvm_gpu_t	*gpu;
+		uvm_va_block_gpu_state_t	*gpu_state = va_block->gpus[uvm_id_gpu_index(id)];
+
+		if (!gpu_state || !gpu_state->cpu_pages_dma_addrs)
+			continue;
+
+		if (gpu_state->cpu_pages_dma_addrs[page_index] == 0)
+			continue;
+
+		gpu = uvm_va_space_get_gpu(va_block->va_range->va_space, id);
+
+		uvm_gpu_unmap_cpu_page(gpu, gpu_state->cpu_pages_dma_addrs[page_index]);
+		gpu_state->cpu_pages_dma_addrs[page_index] = 0;
+	}
+}
+
+static NV_STATUS
+add_pagecache_to_block(uvm_va_block_t *block, int page_id, struct page *page)
+{
+	uvm_gpu_id_t	gpu_id;
+
+	UVM_ASSERT(block->cpu.pages[page_id] == NULL);
+
+	for_each_gpu_id(gpu_id) {
+		uvm_gpu_t	*gpu;
+		uvm_va_block_gpu_state_t	*gpu_state = block->gpus[uvm_id_gpu_index(gpu_id)];
+		NV_STATUS	status;
+
+		if (!gpu_state)
+			continue;
+
+		status = uvm_va_block_gpu_state_alloc_dma_addrs(block, gpu_state);
+		if (status != NV_OK) {
+			uxu_unmap_page(block, page_id);
+			return status;
+		}
+
+		UVM_ASSERT(gpu_state->cpu_pages_dma_addrs[page_id] == 0);
+
+		gpu = uvm_va_space_get_gpu(block->va_range->va_space, gpu_id);
+
+		status = uvm_gpu_map_cpu_pages(gpu, page, PAGE_SIZE, &gpu_state->cpu_pages_dma_addrs[page_id]);
+		if (status != NV_OK) {
+			printk(KERN_DEBUG "Cannot do uvm_gpu_map_cpu_pages\n");
+
+			uxu_unmap_page(block, page_id);
+
+			return status;
+		}
+	}
+	block->cpu.pages[page_id] = page;
+	uxu_host_pages_add(block, 1);
+	return NV_OK;
+}
+
+static struct page *
+assign_page(bool zero)
+{
+	struct page *page;
+	gfp_t gfp_flags;
+
+	gfp_flags = NV_UVM_GFP_FLAGS | GFP_HIGHUSER;
+	if (zero)
+		gfp_flags |= __GFP_ZERO;
+#if defined(__GFP_ACCOUNT)
+	// Charged to the active memory cgroup, see uxu_get_page()
+	gfp_flags |= __GFP_ACCOUNT;
+#endif
+
+	page = alloc_pages(gfp_flags, 0);
+	if (!page) {
+		return NULL;
+	}
+
+	// the kernel has 'written' zeros to this page, so it is dirty
+	if (zero)
+		SetPageDirty(page);
+
+	return page;
+}
+
+/**
+ * Raise the capacity of the host buffer pool of the va_space for a new
+ * USEHOSTBUF range, up to uvm_uxu_hostbuf_pool_mb. The pool is filled up to
+ * its capacity by uxu_hostbuf_fill().
+ *
+ * @param va_space: va_space the range is mapped in.
+ * @param nr_pages: number of pages of the range.
+ */
+static void
+uxu_hostbuf_reserve(uvm_va_space_t *va_space, unsigned long nr_pages)
+{
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	unsigned long	max_pages = (unsigned long)uvm_uxu_hostbuf_pool_mb << (20 - PAGE_SHIFT);
+
+	uvm_spin_lock(&uxu_va_space->hostbuf_lock);
+	if (uxu_va_space->hostbuf_nr_pages < max_pages)
+		uxu_va_space->hostbuf_nr_pages += min(nr_pages, max_pages - uxu_va_space->hostbuf_nr_pages);
+	uvm_spin_unlock(&uxu_va_space->hostbuf_lock);
+}
+
+/**
+ * Free the pages left in the host buffer pool of the va_space. All the
+ * blocks must have been killed.
+ *
+ * @param uxu_va_space: uxu state of the va_space being destroyed.
+ */
+static void
+uxu_hostbuf_drain(uvm_uxu_va_space_t *uxu_va_space)
+{
+	struct page	*page, *next;
+
+	list_for_each_entry_safe(page, next, &uxu_va_space->hostbuf_free, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+	uxu_va_space->hostbuf_nr_free = 0;
+	uxu_va_space->hostbuf_nr_pages = 0;
+}
+
+/**
+ * Take a page of the host buffer pool for a USEHOSTBUF block.
+ *
+ * @param va_space: va_space of the block.
+ * @param zero: whether the page has to be zeroed.
+ *
+ * @return: the page, or NULL if the pool is empty and no page can be allocated.
+ */
+static struct page *
+uxu_hostbuf_get(uvm_va_space_t *va_space, bool zero)
+{
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	struct page	*page = NULL;
+
+	uvm_spin_lock(&uxu_va_space->hostbuf_lock);
+	if (!list_empty(&uxu_va_space->hostbuf_free)) {
+		page = list_first_entry(&uxu_va_space->hostbuf_free, struct page, lru);
+		list_del(&page->lru);
+		uxu_va_space->hostbuf_nr_free--;
+	}
+	uvm_spin_unlock(&uxu_va_space->hostbuf_lock);
+
+	if (page == NULL)
+		return assign_page(zero);
+
+	if (zero) {
+		clear_highpage(page);
+		SetPageDirty(page);
+	}
+	return page;
+}
+
+/**
+ * Give a page of a killed USEHOSTBUF block back to the host buffer pool, or
+ * to the page allocator if the pool is full.
+ *
+ * @param va_space: va_space of the block.
+ * @param page: page which is not used by any processor anymore.
+ */
+void
+uxu_hostbuf_put(uvm_va_space_t *va_space, struct page *page)
+{
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	bool	pooled = false;
+
+	uvm_spin_lock(&uxu_va_space->hostbuf_lock);
+	if (uxu_va_space->hostbuf_nr_free < uxu_va_space->hostbuf_nr_pages) {
+		list_add(&page->lru, &uxu_va_space->hostbuf_free);
+		uxu_va_space->hostbuf_nr_free++;
+		pooled = true;
+	}
+	uvm_spin_unlock(&uxu_va_space->hostbuf_lock);
+
+	if (!pooled)
+		__free_page(page);
+}
+
+/**
+ * Fill the host buffer pool of the va_space up to its capacity, so that the
+ * blocks get pages allocated and charged in advance rather than on the fault
+ * path. This is best effort: the pool also fills up as the pages of the
+ * killed blocks are given back to it.
+ *
+ * @param va_space: va_space whose pool has been raised.
+ */
+static void
+uxu_hostbuf_fill(uvm_va_space_t *va_space)
+{
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	struct mem_cgroup	*old_memcg = uxu_memcg_enter(va_space);
+
+	while (READ_ONCE(uxu_va_space->hostbuf_nr_free) < READ_ONCE(uxu_va_space->hostbuf_nr_pages)) {
+		struct page	*page = assign_page(false);
+
+		if (page == NULL)
+			break;
+		uxu_hostbuf_put(va_space, page);
+		cond_resched();
+	}
+
+	uxu_memcg_exit(old_memcg);
+}
+
+static struct page *
+assign_pagecache(uvm_va_block_t *block, uvm_page_index_t page_index)
+{
+	uvm_uxu_extent_t	*extent;
+	pgoff_t	pgoff;
+	struct page	*page;
+
+	extent = uxu_block_page_lookup(block, page_index, &pgoff, NULL);
+	if (extent == NULL)
+		return NULL;
+	page = read_mapping_page(extent->filp->f_mapping, pgoff, NULL);
+	if (IS_ERR(page))
+		return NULL;
+	return page;
+}
+
+static inline bool
+uxu_is_pagecachable(uvm_va_block_t *block, uvm_page_index_t page_id)
+{
+	pgoff_t	pgoff;
+
+	if (uxu_is_volatile_block(block) || uxu_is_hostbuf_block(block))
+		return false;
+	// Holes are zero filled, they do not need page cache pages
+	if (uvm_page_mask_test(&block->uxu_holes, page_id))
+		return false;
+	return uxu_block_page_lookup(block, page_id, &pgoff, NULL) != NULL;
+}
+
+struct page *
+uxu_get_page(uvm_va_block_t *block, uvm_page_index_t page_index, bool zero)
+{
+	struct mem_cgroup	*old_memcg;
+	struct page	*page;
+
+	// Page cache and anonymous pages are charged to the process using UXU,
+	// not to the thread servicing the fault.
+	old_memcg = uxu_memcg_enter(block->va_range->va_space);
+
+	if (uxu_is_pagecachable(block, page_index)) {
+		page = assign_pagecache(block, page_index);
+		if (page != NULL) {
+			uvm_page_mask_set(&block->cpu.pagecached, page_index);
+			if (!page_has_buffers(page)) {
+				create_empty_buffers(page, page->mapping->host->i_sb->s_blocksize, BIT(BH_Dirty) | BIT(BH_Uptodate));
+			}
+			/* TODO: It seems to be natural that marking a mapped page as dirty. */
+			SetPageDirty(page);
+		}
+	}
+	else {
+		zero = zero || uvm_page_mask_test(&block->uxu_holes, page_index);
+		if (uxu_is_hostbuf_block(block))
+			page = uxu_hostbuf_get(block->va_range->va_space, zero);
+		else
+			page = assign_page(zero);
+		if (page)
+			uvm_page_mask_clear(&block->cpu.pagecached, page_index);
+	}
+
+	uxu_memcg_exit(old_memcg);
+
+	return page;
+}
+
+/**
+ * Get the region of the block up to its last page backed by readable file
+ * data. Files shorter than their extents or stripes leave holes in the
+ * region, which are not pagecachable.
+ */
+static void
+setup_block_readable_region(uvm_va_block_t *block, uvm_va_block_region_t *pregion)
+{
+	uvm_page_index_t	outer = ((block->end - block->start) >> PAGE_SHIFT) + 1;
+	pgoff_t	pgoff;
+
+	// The walk stops at once unless the block is at the end of the data
+	while (outer > 0 && uxu_block_page_lookup(block, outer - 1, &pgoff, NULL) == NULL)
+		outer--;
+
+	pregion->first = 0;
+	pregion->outer = outer;
+}
+
+/**
+ * Find the pages of the block lying entirely in holes or unwritten extents
+ * of the backing files, which are zero filled instead of read. Nothing is
+ * found in the file of a compressed range, its holes are not holes of the
+ * data.
+ *
+ * @param block: the block about to be loaded.
+ */
+static void
+uxu_block_find_holes(uvm_va_block_t *block)
+{
+	uvm_va_block_region_t	region;
+	uvm_page_index_t	page_id;
+	NvU64	hole_bytes = 0;
+
+	uvm_page_mask_zero(&block->uxu_holes);
+	if (block->va_range->node.uxu_rtn.container)
+		return;
+
+	setup_block_readable_region(block, &region);
+	page_id = region.first;
+	while (page_id < region.outer) {
+		uvm_uxu_extent_t	*extent;
+		pgoff_t	pgoff;
+		unsigned long	nr_pages;
+		loff_t	start, pos, end;
+
+		extent = uxu_block_page_lookup(block, page_id, &pgoff, &nr_pages);
+		if (extent == NULL) {
+			page_id++;
+			continue;
+		}
+		nr_pages = min(nr_pages, (unsigned long)(region.outer - page_id));
+		start = (loff_t)pgoff << PAGE_SHIFT;
+		end = start + ((loff_t)nr_pages << PAGE_SHIFT);
+
+		pos = start;
+		while (pos < end) {
+			loff_t	data = uxu_extent_seek(extent, pos, SEEK_DATA);
+			loff_t	first, outer;
+
+			if (data < 0)
+				break;
+			data = min(data, end);
+
+			// Pages partly in a hole are read
+			first = round_up(pos, PAGE_SIZE);
+			outer = round_down(data, PAGE_SIZE);
+			if (outer > first) {
+				uvm_page_mask_region_fill(&block->uxu_holes,
+							  uvm_va_block_region(page_id + ((first - start) >> PAGE_SHIFT),
+									      page_id + ((outer - start) >> PAGE_SHIFT)));
+				hole_bytes += outer - first;
+			}
+			if (data >= end)
+				break;
+			pos = uxu_extent_seek(extent, data, SEEK_HOLE);
+			if (pos <= data)
+				break;
+		}
+		page_id += nr_pages;
+	}
+
+	if (hole_bytes)
+		uxu_stat_add(block->va_range, UXU_STAT_HOLE_BYTES, hole_bytes);
+}
+
+static bool
+load_pagecaches_for_block(uvm_va_block_t *block, NvU64 *dma_map_ns)
+{
+	uvm_va_block_region_t	region;
+	int	page_id;
+
+	setup_block_readable_region(block, &region);
+	// Fill in page-cache pages to va_block
+	for_each_va_block_page_in_region(page_id, region) {
+		struct page	*page;
+		NvU64	dma_map_start;
+		int	ret;
+
+		// Kept from an attempt which failed part way
+		if (block->cpu.pages[page_id] != NULL)
+			continue;
+
+		page = uxu_get_page(block, page_id, false);
+		if (page == NULL) {
+			printk(KERN_DEBUG "failed to assign pagecache(block: %llx, page_id: %d\n", block->start, page_id);
+			return false;
+		}
+		dma_map_start = uvm_fault_phase_start();
+		ret = add_pagecache_to_block(block, page_id, page);
+		if (dma_map_start)
+			*dma_map_ns += NV_GETTIME() - dma_map_start;
+		if (ret != NV_OK)
+			put_page(page);
+		uvm_page_mask_set(&block->cpu.resident, page_id);
+	}
+
+	uvm_processor_mask_set(&block->resident, UVM_ID_CPU);
+	return true;
+}
+
+static inline bool
+uxu_file_can_direct_io(struct file *filp)
+{
+	return filp->f_mapping->a_ops && filp->f_mapping->a_ops->direct_IO;
+}
+
+/**
+ * Read or write pages of a file with a single synchronous request.
+ *
+ * @param filp: file to transfer from or to.
+ * @param bvec: the pages.
+ * @param nr_segs: number of pages.
+ * @param len: number of bytes to transfer, at most nr_segs pages.
+ * @param pos: position in the file.
+ * @param write: write the pages to the file instead of reading them.
+ * @param direct: bypass the page cache. The file must support direct I/O.
+ *
+ * @return: the number of bytes transferred, or a negative errno.
+ */
+static ssize_t
+uxu_file_rw(struct file *filp, struct bio_vec *bvec, unsigned long nr_segs, size_t len, loff_t pos, bool write,
+	    bool direct)
+{
+	struct kiocb	kiocb;
+	struct iov_iter	iter;
+	ssize_t	ret;
+
+	init_sync_kiocb(&kiocb, filp);
+	kiocb.ki_pos = pos;
+	if (direct)
+		kiocb.ki_flags |= IOCB_DIRECT;
+#if defined(NV_IOV_ITER_TYPE_PRESENT)
+	iov_iter_bvec(&iter, write ? WRITE : READ, bvec, nr_segs, len);
+#else
+	// Before 4.20 the type of the iterator is passed along with the direction
+	iov_iter_bvec(&iter, ITER_BVEC | (write ? WRITE : READ), bvec, nr_segs, len);
+#endif
+
+	if (write) {
+		file_start_write(filp);
+		ret = call_write_iter(filp, &kiocb, &iter);
+		file_end_write(filp);
+	}
+	else {
+		ret = call_read_iter(filp, &kiocb, &iter);
+	}
+	return ret;
+}
+
+#if UXU_LZ4_SUPPORTED
+#define UXU_LZ4_MEM_COMPRESS	LZ4_MEM_COMPRESS
+#define UXU_LZ4_BOUND(size)	LZ4_COMPRESSBOUND(size)
+
+static inline int
+uxu_lz4_compress(const void *src, void *dst, size_t len, size_t max_len, void *wrkmem)
+{
+	return LZ4_compress_default(src, dst, len, max_len, wrkmem);
+}
+
+static inline int
+uxu_lz4_decompress(const void *src, void *dst, size_t len, size_t max_len)
+{
+	return LZ4_decompress_safe(src, dst, len, max_len);
+}
+#else
+#define UXU_LZ4_MEM_COMPRESS	0
+#define UXU_LZ4_BOUND(size)	(size)
+
+static inline int
+uxu_lz4_compress(const void *src, void *dst, size_t len, size_t max_len, void *wrkmem)
+{
+	return 0;
+}
+
+static inline int
+uxu_lz4_decompress(const void *src, void *dst, size_t len, size_t max_len)
+{
+	return -1;
+}
+#endif
+
+static int
+uxu_container_space_cmp(const void *a, const void *b)
+{
+	const uvm_uxu_container_space_t	*sa = (const uvm_uxu_container_space_t *)a;
+	const uvm_uxu_container_space_t	*sb = (const uvm_uxu_container_space_t *)b;
+
+	if (sa->offset != sb->offset)
+		return sa->offset < sb->offset ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Give space of a container back, to be reused by the chunks written next.
+ * It is merged with the adjacent gaps, and lowers the end of the data if it
+ * is the last space used. Must be called with the lock of the container held.
+ *
+ * @param cz: container.
+ * @param offset: start of the space in the file.
+ * @param length: length of the space, nothing is done if it is 0.
+ */
+static void
+uxu_container_free_space(uvm_uxu_container_t *cz, loff_t offset, loff_t length)
+{
+	unsigned	i = 0;
+
+	uvm_assert_spinlock_locked(&cz->lock);
+
+	if (length == 0)
+		return;
+
+	while (i < cz->nr_free) {
+		uvm_uxu_container_space_t	*gap = &cz->free[i];
+
+		if (gap->offset + gap->length == offset || offset + length == gap->offset) {
+			offset = min(offset, gap->offset);
+			length += gap->length;
+			*gap = cz->free[--cz->nr_free];
+		}
+		else {
+			i++;
+		}
+	}
+
+	if (offset + length == cz->data_end) {
+		cz->data_end = offset;
+	}
+	else if (cz->nr_free < UXU_CONTAINER_MAX_FREE) {
+		cz->free[cz->nr_free].offset = offset;
+		cz->free[cz->nr_free].length = length;
+		cz->nr_free++;
+	}
+}
+
+/**
+ * Find space for a chunk in the container, in the first gap it fits in or at
+ * the end of the data.
+ *
+ * @param cz: container.
+ * @param length: length of the chunk data.
+ *
+ * @return: offset of the space in the file.
+ */
+static loff_t
+uxu_container_alloc_space(uvm_uxu_container_t *cz, loff_t length)
+{
+	loff_t	offset = -1;
+	unsigned	i;
+
+	uvm_spin_lock(&cz->lock);
+	for (i = 0; i < cz->nr_free; i++) {
+		uvm_uxu_container_space_t	*gap = &cz->free[i];
+
+		if (gap->length >= length) {
+			offset = gap->offset;
+			gap->offset += length;
+			gap->length -= length;
+			if (gap->length == 0)
+				*gap = cz->free[--cz->nr_free];
+			break;
+		}
+	}
+	if (offset < 0) {
+		offset = cz->data_end;
+		cz->data_end += length;
+	}
+	uvm_spin_unlock(&cz->lock);
+
+	return offset;
+}
+
+/**
+ * Check the index of a container being opened: every chunk has to lie within
+ * the file, after the index, and no two chunks may overlap. The gaps between
+ * the chunks and the end of their data are set up on the way, so that the
+ * space left by the chunks written back before, or written but not indexed
+ * when the system crashed, is reused.
+ *
+ * @param cz: container whose index has been read.
+ * @param file_size: size of the file of the container.
+ *
+ * @return: NV_OK on success, NV_ERR_INVALID_DATA if the index is corrupted,
+ * NV_ERR_NO_MEMORY otherwise.
+ */
+static NV_STATUS
+uxu_container_scan(uvm_uxu_container_t *cz, loff_t file_size)
+{
+	uvm_uxu_container_space_t	*used;
+	NvU64	nr_used = 0, i;
+	NV_STATUS	status = NV_OK;
+
+	used = uvm_kvmalloc(max_t(NvU64, cz->nr_chunks, 1) * sizeof(*used));
+	if (used == NULL)
+		return NV_ERR_NO_MEMORY;
+
+	for (i = 0; i < cz->nr_chunks; i++) {
+		if (cz->index[i].length == 0)
+			continue;
+		used[nr_used].offset = le64_to_cpu(cz->index[i].offset);
+		used[nr_used].length = le32_to_cpu(cz->index[i].length);
+		nr_used++;
+	}
+	sort(used, nr_used, sizeof(*used), uxu_container_space_cmp, NULL);
+
+	uvm_spin_lock(&cz->lock);
+	cz->data_end = cz->index_offset + cz->nr_chunks * sizeof(uxuz_chunk_t);
+	for (i = 0; i < nr_used; i++) {
+		if (used[i].offset < cz->data_end || used[i].length > (1LL << cz->chunk_shift) ||
+		    used[i].offset + used[i].length > file_size) {
+			status = NV_ERR_INVALID_DATA;
+			break;
+		}
+		uxu_container_free_space(cz, cz->data_end, used[i].offset - cz->data_end);
+		cz->data_end = used[i].offset + used[i].length;
+	}
+	uvm_spin_unlock(&cz->lock);
+
+	uvm_kvfree(used);
+	return status;
+}
+
+/**
+ * Read the header and the index of the container backing a COMPRESSED range.
+ * The range has to map a single file from its start, and to start on a chunk
+ * boundary so that no chunk straddles two blocks.
+ *
+ * @param range: COMPRESSED range being mapped.
+ * @param size: size of the mapping.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_container_open(uvm_va_range_t *range, size_t size)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	uvm_uxu_container_t	*cz;
+	uxuz_header_t	header;
+	size_t	index_size;
+	loff_t	pos = 0;
+	ssize_t	ret;
+	NV_STATUS	status = NV_ERR_INVALID_ARGUMENT;
+
+	if (uxu_rtn->nr_extents != 1 || uxu_rtn->extents[0].offset != 0 || uxu_rtn->stripe_unit != 0) {
+		printk(KERN_DEBUG "Error: a compressed range maps a single file from its start\n");
+		return NV_ERR_INVALID_ARGUMENT;
+	}
+
+	ret = kernel_read(uxu_rtn->filp, &header, sizeof(header), &pos);
+	if (ret != sizeof(header) || le32_to_cpu(header.magic) != UXUZ_MAGIC ||
+	    le16_to_cpu(header.version) != UXUZ_VERSION) {
+		printk(KERN_DEBUG "Error: not a uxu compressed container\n");
+		return NV_ERR_INVALID_ARGUMENT;
+	}
+	if (le16_to_cpu(header.algorithm) > UXUZ_ALGO_LZ4 ||
+	    (le16_to_cpu(header.algorithm) == UXUZ_ALGO_LZ4 && !UXU_LZ4_SUPPORTED)) {
+		printk(KERN_DEBUG "Error: unsupported compression algorithm %u\n", le16_to_cpu(header.algorithm));
+		return NV_ERR_NOT_SUPPORTED;
+	}
+
+	cz = uvm_kvmalloc_zero(sizeof(*cz));
+	if (cz == NULL)
+		return NV_ERR_NO_MEMORY;
+	cz->algorithm = le16_to_cpu(header.algorithm);
+	cz->chunk_shift = le32_to_cpu(header.chunk_shift);
+	cz->size = le64_to_cpu(header.size);
+	cz->nr_chunks = le64_to_cpu(header.nr_chunks);
+	cz->index_offset = le64_to_cpu(header.index_offset);
+	uvm_spin_lock_init(&cz->lock, UVM_LOCK_ORDER_LEAF);
+
+	if (cz->chunk_shift < PAGE_SHIFT || cz->chunk_shift > ilog2(UVM_VA_BLOCK_SIZE) ||
+	    cz->nr_chunks != DIV_ROUND_UP(cz->size, 1ULL << cz->chunk_shift) ||
+	    cz->nr_chunks > INT_MAX / sizeof(uxuz_chunk_t) || cz->index_offset < UXUZ_HEADER_SIZE) {
+		printk(KERN_DEBUG "Error: corrupted uxu compressed container\n");
+		goto error;
+	}
+	if (size > cz->size || !IS_ALIGNED(range->node.start, 1ULL << cz->chunk_shift)) {
+		printk(KERN_DEBUG "Error: the mapping does not fit the chunks of the container\n");
+		goto error;
+	}
+
+	status = NV_ERR_NO_MEMORY;
+	index_size = cz->nr_chunks * sizeof(uxuz_chunk_t);
+	cz->index = uvm_kvmalloc(index_size);
+	cz->sums = uvm_kvmalloc(cz->nr_chunks * sizeof(NvU32));
+	cz->summed = uvm_kvmalloc_zero(BITS_TO_LONGS(cz->nr_chunks) * sizeof(unsigned long));
+	cz->free = uvm_kvmalloc(UXU_CONTAINER_MAX_FREE * sizeof(*cz->free));
+	if (!cz->index || !cz->sums || !cz->summed || !cz->free)
+		goto error;
+
+	pos = cz->index_offset;
+	ret = kernel_read(uxu_rtn->filp, cz->index, index_size, &pos);
+	if (ret != (ssize_t)index_size) {
+		printk(KERN_DEBUG "Error: cannot read the index of the container: %zd\n", ret);
+		status = ret < 0 ? errno_to_nv_status(ret) : NV_ERR_INVALID_ARGUMENT;
+		goto error;
+	}
+
+	status = uxu_container_scan(cz, i_size_read(file_inode(uxu_rtn->filp)));
+	if (status == NV_ERR_INVALID_DATA)
+		printk(KERN_DEBUG "Error: corrupted index of uxu compressed container\n");
+	if (status != NV_OK)
+		goto error;
+
+	uxu_rtn->container = cz;
+	return NV_OK;
+
+error:
+	uvm_kvfree(cz->free);
+	uvm_kvfree(cz->summed);
+	uvm_kvfree(cz->sums);
+	uvm_kvfree(cz->index);
+	uvm_kvfree(cz);
+	return status;
+}
+
+static void
+uxu_container_destroy(uvm_va_range_t *range)
+{
+	uvm_uxu_container_t	*cz = range->node.uxu_rtn.container;
+
+	if (cz == NULL)
+		return;
+	uvm_kvfree(cz->free);
+	uvm_kvfree(cz->summed);
+	uvm_kvfree(cz->sums);
+	uvm_kvfree(cz->index);
+	uvm_kvfree(cz);
+	range->node.uxu_rtn.container = NULL;
+}
+
+/**
+ * Read a chunk of a container and decompress it.
+ *
+ * @param cz: container.
+ * @param filp: file of the container.
+ * @param chunk: index of the chunk.
+ * @param raw: buffer of the chunk size receiving the data, zero padded.
+ * @param packed: buffer of UXU_LZ4_BOUND(chunk size) bytes for the compressed data.
+ * @param read: number of bytes read from the file.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_container_read_chunk(uvm_uxu_container_t *cz, struct file *filp, NvU64 chunk, void *raw, void *packed,
+			 NvU64 *read)
+{
+	size_t	chunk_size = (size_t)1 << cz->chunk_shift;
+	uxuz_chunk_t	entry;
+	loff_t	pos;
+	size_t	len;
+	ssize_t	ret;
+	int	unpacked;
+
+	uvm_spin_lock(&cz->lock);
+	entry = cz->index[chunk];
+	uvm_spin_unlock(&cz->lock);
+
+	*read = 0;
+	pos = le64_to_cpu(entry.offset);
+	len = le32_to_cpu(entry.length);
+	if (len == 0) {
+		memset(raw, 0, chunk_size);
+		return NV_OK;
+	}
+	if (len > chunk_size) {
+		printk(KERN_DEBUG "uxu corrupted chunk %llu: length %zu\n", chunk, len);
+		return NV_ERR_INVALID_DATA;
+	}
+
+	ret = kernel_read(filp, (le32_to_cpu(entry.flags) & UXUZ_CHUNK_STORED) ? raw : packed, len, &pos);
+	if (ret != (ssize_t)len) {
+		printk(KERN_DEBUG "uxu read error of chunk %llu: %zd\n", chunk, ret);
+		return ret < 0 ? errno_to_nv_status(ret) : NV_ERR_INVALID_DATA;
+	}
+
+	if (le32_to_cpu(entry.flags) & UXUZ_CHUNK_STORED) {
+		unpacked = len;
+	}
+	else {
+		unpacked = cz->algorithm == UXUZ_ALGO_LZ4 ? uxu_lz4_decompress(packed, raw, len, chunk_size) : -1;
+		if (unpacked < 0) {
+			printk(KERN_DEBUG "uxu cannot decompress chunk %llu\n", chunk);
+			return NV_ERR_INVALID_DATA;
+		}
+	}
+	memset(raw + unpacked, 0, chunk_size - unpacked);
+
+	*read = len;
+	return NV_OK;
+}
+
+/**
+ * Compress a chunk and write it to free space of the container, never over
+ * the data the index points to. The index is updated afterwards by
+ * uxu_container_commit(). A chunk of zeros only gets an empty entry. It is
+ * stored uncompressed if compression does not make it smaller.
+ *
+ * @param cz: container.
+ * @param filp: file of the container.
+ * @param chunk: index of the chunk.
+ * @param raw: data of the chunk.
+ * @param len: length of the data, the chunk size but for the last chunk.
+ * @param packed: buffer of UXU_LZ4_BOUND(chunk size) bytes for the compressed data.
+ * @param wrkmem: LZ4 work memory of UXU_LZ4_MEM_COMPRESS bytes.
+ * @param entry: set to the index entry of the written chunk, in the byte order of the file.
+ * @param written: number of bytes written to the file.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_container_write_chunk(uvm_uxu_container_t *cz, struct file *filp, NvU64 chunk, void *raw, size_t len,
+			  void *packed, void *wrkmem, uxuz_chunk_t *entry, NvU64 *written)
+{
+	const void	*data = packed;
+	NvU32	flags = 0;
+	int	packed_len = 0;
+	size_t	data_len;
+	loff_t	pos;
+	ssize_t	ret;
+
+	memset(entry, 0, sizeof(*entry));
+	*written = 0;
+	if (!memchr_inv(raw, 0, len))
+		return NV_OK;
+
+	if (cz->algorithm == UXUZ_ALGO_LZ4)
+		packed_len = uxu_lz4_compress(raw, packed, len, len - 1, wrkmem);
+	data_len = packed_len;
+	if (packed_len <= 0) {
+		data = raw;
+		data_len = len;
+		flags = UXUZ_CHUNK_STORED;
+	}
+
+	pos = uxu_container_alloc_space(cz, data_len);
+	entry->offset = cpu_to_le64(pos);
+	entry->length = cpu_to_le32(data_len);
+	entry->flags = cpu_to_le32(flags);
+
+	ret = kernel_write(filp, data, data_len, &pos);
+	if (ret != (ssize_t)data_len) {
+		uvm_spin_lock(&cz->lock);
+		uxu_container_free_space(cz, le64_to_cpu(entry->offset), data_len);
+		uvm_spin_unlock(&cz->lock);
+		printk(KERN_DEBUG "uxu write error of chunk %llu: %zd\n", chunk, ret);
+		return ret < 0 ? errno_to_nv_status(ret) : NV_ERR_OPERATING_SYSTEM;
+	}
+
+	*written = data_len;
+	return NV_OK;
+}
+
+/* Chunk written back by a block, which the index does not point to yet */
+typedef struct {
+	NvU64	chunk;
+	NvU32	sum;
+	uxuz_chunk_t	entry;
+} uvm_uxu_container_pending_t;
+
+/**
+ * Free the space of chunk entries.
+ *
+ * @param cz: container.
+ * @param pending: the chunks.
+ * @param nr_pending: number of chunks in `pending`.
+ */
+static void
+uxu_container_free_entries(uvm_uxu_container_t *cz, uvm_uxu_container_pending_t *pending, unsigned nr_pending)
+{
+	unsigned	i;
+
+	uvm_spin_lock(&cz->lock);
+	for (i = 0; i < nr_pending; i++)
+		uxu_container_free_space(cz, le64_to_cpu(pending[i].entry.offset), le32_to_cpu(pending[i].entry.length));
+	uvm_spin_unlock(&cz->lock);
+}
+
+/**
+ * Point the index to the chunks written back by a block. The chunk data is
+ * flushed before the index entries are written, and the space of the
+ * replaced chunks is only freed once the entries are flushed, so that a crash
+ * leaves each chunk either old or new.
+ *
+ * @param cz: container.
+ * @param filp: file of the container.
+ * @param pending: the chunks written, in increasing chunk order. Their
+ * entries are swapped with the replaced ones.
+ * @param nr_pending: number of chunks in `pending`, at least 1.
+ * @param span: buffer of as many entries as there are chunks in a block.
+ * @param written: number of bytes of the index written to the file.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise. The index is then left
+ * unchanged.
+ */
+static NV_STATUS
+uxu_container_commit(uvm_uxu_container_t *cz, struct file *filp, uvm_uxu_container_pending_t *pending,
+		     unsigned nr_pending, uxuz_chunk_t *span, NvU64 *written)
+{
+	NvU64	first = pending[0].chunk;
+	size_t	span_size = (pending[nr_pending - 1].chunk - first + 1) * sizeof(uxuz_chunk_t);
+	loff_t	start = cz->index_offset + first * sizeof(uxuz_chunk_t);
+	loff_t	pos = start;
+	ssize_t	ret;
+	unsigned	i;
+	int	err;
+
+	*written = 0;
+	err = vfs_fsync(filp, 1);
+	if (err) {
+		// The index still points to the old chunks
+		uxu_container_free_entries(cz, pending, nr_pending);
+		return errno_to_nv_status(err);
+	}
+
+	uvm_spin_lock(&cz->lock);
+	for (i = 0; i < nr_pending; i++)
+		swap(cz->index[pending[i].chunk], pending[i].entry);
+	memcpy(span, &cz->index[first], span_size);
+	uvm_spin_unlock(&cz->lock);
+
+	ret = kernel_write(filp, span, span_size, &pos);
+	err = ret == (ssize_t)span_size ? vfs_fsync_range(filp, start, pos - 1, 1) : 0;
+	if (ret != (ssize_t)span_size || err) {
+		// The file may point to either chunk, neither is freed until the
+		// container is opened again
+		uvm_spin_lock(&cz->lock);
+		for (i = 0; i < nr_pending; i++)
+			swap(cz->index[pending[i].chunk], pending[i].entry);
+		uvm_spin_unlock(&cz->lock);
+		printk(KERN_DEBUG "uxu write error of the index: %zd %d\n", ret, err);
+		if (err)
+			return errno_to_nv_status(err);
+		return ret < 0 ? errno_to_nv_status(ret) : NV_ERR_OPERATING_SYSTEM;
+	}
+
+	// `pending` now holds the replaced chunks
+	uxu_container_free_entries(cz, pending, nr_pending);
+
+	*written = span_size;
+	return NV_OK;
+}
+
+static inline void
+uxu_copy_page(struct page *page, void *buf, bool to_page)
+{
+	void	*kaddr = kmap_atomic(page);
+
+	if (to_page)
+		memcpy(kaddr, buf, PAGE_SIZE);
+	else
+		memcpy(buf, kaddr, PAGE_SIZE);
+	kunmap_atomic(kaddr);
+}
+
+/**
+ * Read or write the host buffers of a block of a COMPRESSED range, chunk by
+ * chunk. On write, only the chunks with pages resident on the CPU are written,
+ * and not if their data is the same as when it was last read or written. The
+ * pages of a partly resident chunk are merged with the chunk in the file. The
+ * index is updated once all the chunks of the block are written.
+ *
+ * @param block: block of a COMPRESSED range.
+ * @param write: write the block back instead of reading it.
+ * @param bytes: number of bytes of uncompressed data transferred.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_container_block_io(uvm_va_block_t *block, bool write, NvU64 *bytes)
+{
+	uvm_va_range_t	*range = block->va_range;
+	uvm_uxu_container_t	*cz = range->node.uxu_rtn.container;
+	uvm_uxu_extent_t	*extent = &range->node.uxu_rtn.extents[0];
+	size_t	chunk_size = (size_t)1 << cz->chunk_shift;
+	uvm_page_index_t	chunk_pages = chunk_size >> PAGE_SHIFT;
+	size_t	block_chunks = UVM_VA_BLOCK_SIZE >> cz->chunk_shift;
+	uvm_va_block_region_t	region;
+	uvm_page_index_t	first;
+	void	*raw, *packed, *wrkmem = NULL;
+	uvm_uxu_container_pending_t	*pending = NULL;
+	uxuz_chunk_t	*span = NULL;
+	unsigned	nr_pending = 0, i;
+	bool	compress = write && cz->algorithm == UXUZ_ALGO_LZ4;
+	NV_STATUS	status = NV_OK;
+
+	*bytes = 0;
+	raw = uvm_kvmalloc(chunk_size);
+	packed = uvm_kvmalloc(UXU_LZ4_BOUND(chunk_size));
+	if (compress)
+		wrkmem = uvm_kvmalloc(UXU_LZ4_MEM_COMPRESS);
+	if (write) {
+		pending = uvm_kvmalloc(block_chunks * sizeof(*pending));
+		span = uvm_kvmalloc(block_chunks * sizeof(*span));
+	}
+	if (!raw || !packed || (compress && !wrkmem) || (write && (!pending || !span))) {
+		status = NV_ERR_NO_MEMORY;
+		goto out;
+	}
+
+	// The range starts on a chunk boundary, and so does every block
+	setup_block_readable_region(block, &region);
+	for (first = region.first; first < region.outer; first += chunk_pages) {
+		uvm_va_block_region_t	chunk_region;
+		uvm_page_index_t	page_id;
+		pgoff_t	pgoff;
+		NvU64	chunk, len, transferred;
+		NvU32	nr_resident = 0, sum;
+
+		chunk_region = uvm_va_block_region(first, min_t(uvm_page_index_t, first + chunk_pages, region.outer));
+		uxu_block_page_lookup(block, first, &pgoff, NULL);
+		chunk = pgoff >> (cz->chunk_shift - PAGE_SHIFT);
+		len = min_t(NvU64, chunk_size, cz->size - (chunk << cz->chunk_shift));
+
+		if (!write) {
+			status = uxu_container_read_chunk(cz, extent->filp, chunk, raw, packed, &transferred);
+			if (status != NV_OK)
+				break;
+			for_each_va_block_page_in_region(page_id, chunk_region)
+				uxu_copy_page(block->cpu.pages[page_id], raw + ((size_t)(page_id - first) << PAGE_SHIFT), true);
+			cz->sums[chunk] = crc32_le(~0, raw, len);
+			set_bit(chunk, cz->summed);
+		}
+		else {
+			for_each_va_block_page_in_region(page_id, chunk_region) {
+				if (block->cpu.pages[page_id] && uvm_page_mask_test(&block->cpu.resident, page_id))
+					nr_resident++;
+			}
+			if (nr_resident == 0)
+				continue;
+
+			transferred = 0;
+			if (nr_resident < uvm_va_block_region_num_pages(chunk_region)) {
+				status = uxu_container_read_chunk(cz, extent->filp, chunk, raw, packed, &transferred);
+				if (status != NV_OK)
+					break;
+				uxu_stat_add(range, UXU_STAT_COMPRESSED_READ_BYTES, transferred);
+			}
+			for_each_va_block_page_in_region(page_id, chunk_region) {
+				if (block->cpu.pages[page_id] && uvm_page_mask_test(&block->cpu.resident, page_id))
+					uxu_copy_page(block->cpu.pages[page_id],
+						      raw + ((size_t)(page_id - first) << PAGE_SHIFT), false);
+			}
+
+			sum = crc32_le(~0, raw, len);
+			if (test_bit(chunk, cz->summed) && cz->sums[chunk] == sum)
+				continue;
+			status = uxu_container_write_chunk(cz, extent->filp, chunk, raw, len, packed, wrkmem,
+							   &pending[nr_pending].entry, &transferred);
+			if (status != NV_OK)
+				break;
+			pending[nr_pending].chunk = chunk;
+			pending[nr_pending].sum = sum;
+			nr_pending++;
+		}
+
+		*bytes += len;
+		atomic64_add(transferred, write ? &extent->writeback_bytes : &extent->read_bytes);
+		uxu_stat_add(range, write ? UXU_STAT_COMPRESSED_WRITE_BYTES : UXU_STAT_COMPRESSED_READ_BYTES,
+			     transferred);
+	}
+
+	if (nr_pending > 0) {
+		NvU64	transferred;
+
+		if (status == NV_OK)
+			status = uxu_container_commit(cz, extent->filp, pending, nr_pending, span, &transferred);
+		else
+			uxu_container_free_entries(cz, pending, nr_pending);
+
+		if (status == NV_OK) {
+			for (i = 0; i < nr_pending; i++) {
+				cz->sums[pending[i].chunk] = pending[i].sum;
+				set_bit(pending[i].chunk, cz->summed);
+			}
+			atomic64_add(transferred, &extent->writeback_bytes);
+			uxu_stat_add(range, UXU_STAT_COMPRESSED_WRITE_BYTES, transferred);
+		}
+	}
+
+out:
+	uvm_kvfree(span);
+	uvm_kvfree(pending);
+	uvm_kvfree(wrkmem);
+	uvm_kvfree(packed);
+	uvm_kvfree(raw);
+	return status;
+}
+
+/* Compressed length of a page of a pool entry which is stored as is */
+#define UXU_ZPOOL_RAW	PAGE_SIZE
+/* The page is not stored in the pool entry */
+#define UXU_ZPOOL_ABSENT	((NvU32)~0)
+
+/*
+ * Compressed copy of a block released by the reclaim service. Each page
+ * resident on the CPU is compressed on its own, a page of zeros takes no space.
+ */
+typedef struct uvm_uxu_zentry_struct {
+	/* Entry of the pool LRU list */
+	struct list_head	lru;
+	uvm_va_range_t	*range;
+	size_t	block_index;
+	/* Uncompressed size of the pages stored */
+	size_t	orig_size;
+	/* Compressed length of each page: 0 for zeros, UXU_ZPOOL_RAW, or UXU_ZPOOL_ABSENT */
+	NvU32	lens[PAGES_PER_UVM_VA_BLOCK];
+	/* Size of data */
+	size_t	size;
+	NvU8	data[];
+} uvm_uxu_zentry_t;
+
+/*
+ * Pool of compressed blocks of a va_space, a tier between the host buffers
+ * and storage. The blocks of USEHOSTBUF ranges released by the reclaim service
+ * are compressed into it, and the next load of a block takes its entry out of
+ * the pool and decompresses it into its host buffers instead of reading
+ * storage. The oldest entries are dropped when the pool is full, their data
+ * is in the files.
+ *
+ * The pool never fills the page cache: a page cache page built from an entry
+ * could be older than the file and be written back over it. Host buffers are
+ * private to the range, like the entries.
+ */
+typedef struct uvm_uxu_zpool_struct {
+	/* Protects lru, size, orig_size, nr_entries and the zentries of the ranges */
+	uvm_spinlock_t	lock;
+	/* Entries, oldest first */
+	struct list_head	lru;
+	size_t	size;
+	size_t	orig_size;
+	unsigned long	nr_entries;
+	size_t	max_size;
+	/* Loads of blocks of READ ranges which found their entry or not */
+	atomic64_t	hits;
+	atomic64_t	misses;
+	/* Scratch buffers of the compression, used with the va_space lock held in write mode */
+	NvU32	lens[PAGES_PER_UVM_VA_BLOCK];
+	void	*buf;
+	void	*wrkmem;
+} uvm_uxu_zpool_t;
+
+static void
+uxu_zpool_destroy(uvm_uxu_va_space_t *uxu_va_space)
+{
+	uvm_uxu_zpool_t	*zpool = uxu_va_space->zpool;
+
+	if (zpool == NULL)
+		return;
+
+	// The ranges drop their entries when they are destroyed
+	UVM_ASSERT(list_empty(&zpool->lru));
+	uvm_kvfree(zpool->buf);
+	uvm_kvfree(zpool->wrkmem);
+	uvm_kvfree(zpool);
+	uxu_va_space->zpool = NULL;
+}
+
+/**
+ * Create the compressed block pool of a va_space if uvm_uxu_zpool_mb is set.
+ * The pool is best effort, UXU works without it.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ */
+static void
+uxu_zpool_create(uvm_uxu_va_space_t *uxu_va_space)
+{
+	uvm_uxu_zpool_t	*zpool;
+
+	uxu_va_space->zpool = NULL;
+	if (uvm_uxu_zpool_mb == 0 || !UXU_LZ4_SUPPORTED)
+		return;
+
+	zpool = uvm_kvmalloc_zero(sizeof(*zpool));
+	if (zpool == NULL)
+		return;
+	uvm_spin_lock_init(&zpool->lock, UVM_LOCK_ORDER_LEAF);
+	INIT_LIST_HEAD(&zpool->lru);
+	zpool->max_size = (size_t)uvm_uxu_zpool_mb << 20;
+	atomic64_set(&zpool->hits, 0);
+	atomic64_set(&zpool->misses, 0);
+	uxu_va_space->zpool = zpool;
+
+	zpool->buf = uvm_kvmalloc(PAGES_PER_UVM_VA_BLOCK * PAGE_SIZE);
+	zpool->wrkmem = uvm_kvmalloc(UXU_LZ4_MEM_COMPRESS);
+	if (zpool->buf == NULL || zpool->wrkmem == NULL) {
+		printk(KERN_DEBUG "Cannot allocate the uxu compressed block pool\n");
+		uxu_zpool_destroy(uxu_va_space);
+	}
+}
+
+/**
+ * Find the slot of the entry of a block in the table of its range. The table
+ * is allocated in chunks of UVM_VA_RANGE_BLOCKS_PER_CHUNK slots, like the
+ * block table of the range, the chunks when the first entry of their blocks
+ * is stored. The pool lock must be held.
+ *
+ * @param range: uxu va range with a zentries table.
+ * @param block_index: index of the block in the range.
+ *
+ * @return: the slot, or NULL if its chunk is not allocated.
+ */
+static uvm_uxu_zentry_t **
+uxu_zpool_slot(uvm_va_range_t *range, size_t block_index)
+{
+	uvm_uxu_zentry_t	**chunk = range->node.uxu_rtn.zentries[block_index >> UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT];
+
+	if (chunk == NULL)
+		return NULL;
+	return &chunk[block_index & (UVM_VA_RANGE_BLOCKS_PER_CHUNK - 1)];
+}
+
+/* Unlink an entry from the pool and its range. The pool lock must be held. */
+static void
+uxu_zpool_unlink(uvm_uxu_zpool_t *zpool, uvm_uxu_zentry_t *entry)
+{
+	*uxu_zpool_slot(entry->range, entry->block_index) = NULL;
+	list_del(&entry->lru);
+	zpool->size -= entry->size;
+	zpool->orig_size -= entry->orig_size;
+	zpool->nr_entries--;
+}
+
+/**
+ * Take the entry of a block out of the pool.
+ *
+ * @param block: block about to be loaded.
+ *
+ * @return: the entry, to be freed by the caller, or NULL if the block is not
+ * in the pool.
+ */
+static uvm_uxu_zentry_t *
+uxu_zpool_take(uvm_va_block_t *block)
+{
+	uvm_va_range_t	*range = block->va_range;
+	uvm_uxu_zpool_t	*zpool = range->va_space->uxu_va_space.zpool;
+	uvm_uxu_zentry_t	**slot;
+	uvm_uxu_zentry_t	*entry = NULL;
+
+	if (zpool == NULL || range->node.uxu_rtn.zentries == NULL)
+		return NULL;
+
+	uvm_spin_lock(&zpool->lock);
+	slot = uxu_zpool_slot(range, uvm_va_range_block_index(range, block->start));
+	if (slot)
+		entry = *slot;
+	if (entry)
+		uxu_zpool_unlink(zpool, entry);
+	uvm_spin_unlock(&zpool->lock);
+
+	if (entry) {
+		atomic64_inc(&zpool->hits);
+		uxu_stat_add(range, UXU_STAT_ZPOOL_HITS, 1);
+	}
+	else {
+		atomic64_inc(&zpool->misses);
+		uxu_stat_add(range, UXU_STAT_ZPOOL_MISSES, 1);
+	}
+	return entry;
+}
+
+/**
+ * Drop the entries of a range from the pool, when its data may change
+ * behind the pool or the range goes away. The chunks of the table are kept.
+ *
+ * @param range: uxu va range.
+ */
+static void
+uxu_zpool_drop_range(uvm_va_range_t *range)
+{
+	uvm_uxu_zpool_t	*zpool = range->va_space->uxu_va_space.zpool;
+	uvm_uxu_zentry_t	***zentries = range->node.uxu_rtn.zentries;
+	uvm_uxu_zentry_t	*entry, *next;
+	LIST_HEAD(dropped);
+	size_t	i, j;
+
+	if (zpool == NULL || zentries == NULL)
+		return;
+
+	uvm_spin_lock(&zpool->lock);
+	for (i = 0; i < uvm_va_range_num_block_chunks(range); i++) {
+		if (zentries[i] == NULL)
+			continue;
+		for (j = 0; j < UVM_VA_RANGE_BLOCKS_PER_CHUNK; j++) {
+			entry = zentries[i][j];
+			if (entry == NULL)
+				continue;
+			uxu_zpool_unlink(zpool, entry);
+			list_add(&entry->lru, &dropped);
+		}
+	}
+	uvm_spin_unlock(&zpool->lock);
+
+	list_for_each_entry_safe(entry, next, &dropped, lru)
+		uvm_kvfree(entry);
+}
+
+/**
+ * Free the table of the pool entries of a range, once they are dropped.
+ *
+ * @param range: uxu va range.
+ */
+static void
+uxu_zpool_free_table(uvm_va_range_t *range)
+{
+	uvm_uxu_zentry_t	***zentries = range->node.uxu_rtn.zentries;
+	size_t	i;
+
+	if (zentries == NULL)
+		return;
+
+	for (i = 0; i < uvm_va_range_num_block_chunks(range); i++)
+		uvm_kvfree(zentries[i]);
+	uvm_kvfree(zentries);
+	range->node.uxu_rtn.zentries = NULL;
+}
+
+/**
+ * Compress the pages of a block released by the reclaim service into the pool
+ * of its va_space. Dirty blocks have been written back already, the pool only
+ * holds clean copies. Blocks which do not compress to less than three
+ * quarters of their size are not stored.
+ *
+ * @param block: block of a USEHOSTBUF range being released, whose data is
+ * resident on the CPU.
+ */
+static void
+uxu_zpool_store(uvm_va_block_t *block)
+{
+	uvm_va_range_t	*range = block->va_range;
+	uvm_va_space_t	*va_space = range->va_space;
+	uvm_uxu_zpool_t	*zpool = va_space->uxu_va_space.zpool;
+	uvm_uxu_zentry_t	***zentries = range->node.uxu_rtn.zentries;
+	uvm_uxu_zentry_t	*entry, *next, **chunk = NULL, **slot;
+	uvm_page_index_t	page_index;
+	NvU32	*lens;
+	size_t	size = 0, orig_size = 0, block_index, chunk_index;
+	LIST_HEAD(evicted);
+
+	// Volatile data is not reloaded, and remapping may make a range volatile
+	// or move it to the page cache
+	if (zpool == NULL || zentries == NULL || uxu_is_volatile_range(range) || !uxu_is_hostbuf_range(range))
+		return;
+	uvm_assert_rwsem_locked_write(&va_space->lock);
+
+	lens = zpool->lens;
+	for (page_index = 0; page_index < PAGES_PER_UVM_VA_BLOCK; page_index++)
+		lens[page_index] = UXU_ZPOOL_ABSENT;
+
+	for_each_va_block_page_in_mask(page_index, &block->cpu.resident, block) {
+		struct page	*page = block->cpu.pages[page_index];
+		NvU8	*dst = (NvU8 *)zpool->buf + size;
+		void	*kaddr;
+		int	len;
+
+		if (page == NULL)
+			continue;
+		kaddr = kmap_atomic(page);
+		if (memchr_inv(kaddr, 0, PAGE_SIZE) == NULL) {
+			len = 0;
+		}
+		else {
+			// A page which does not shrink is stored as is
+			len = uxu_lz4_compress(kaddr, dst, PAGE_SIZE, PAGE_SIZE - 1, zpool->wrkmem);
+			if (len <= 0) {
+				memcpy(dst, kaddr, PAGE_SIZE);
+				len = UXU_ZPOOL_RAW;
+			}
+		}
+		kunmap_atomic(kaddr);
+		lens[page_index] = len;
+		size += len;
+		orig_size += PAGE_SIZE;
+	}
+
+	if (orig_size == 0)
+		return;
+	if (size * 4 > orig_size * 3 || size + sizeof(*entry) > zpool->max_size) {
+		uxu_stat_add(range, UXU_STAT_ZPOOL_REJECTED_BLOCKS, 1);
+		return;
+	}
+
+	block_index = uvm_va_range_block_index(range, block->start);
+	chunk_index = block_index >> UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT;
+	// The chunks are only added with the va_space lock held in write mode
+	if (zentries[chunk_index] == NULL) {
+		chunk = uvm_kvmalloc_zero(UVM_VA_RANGE_BLOCKS_PER_CHUNK * sizeof(*chunk));
+		if (chunk == NULL)
+			return;
+	}
+
+	entry = uvm_kvmalloc(sizeof(*entry) + size);
+	if (entry == NULL) {
+		uvm_kvfree(chunk);
+		return;
+	}
+	entry->range = range;
+	entry->block_index = block_index;
+	entry->orig_size = orig_size;
+	entry->size = sizeof(*entry) + size;
+	memcpy(entry->lens, lens, sizeof(entry->lens));
+	memcpy(entry->data, zpool->buf, size);
+
+	uvm_spin_lock(&zpool->lock);
+	if (chunk)
+		zentries[chunk_index] = chunk;
+	slot = uxu_zpool_slot(range, block_index);
+	// A block is taken out of the pool when it is loaded, so it has no
+	// entry unless it was released without being loaded
+	if (*slot) {
+		next = *slot;
+		uxu_zpool_unlink(zpool, next);
+		list_add(&next->lru, &evicted);
+	}
+	while (zpool->size + entry->size > zpool->max_size && !list_empty(&zpool->lru)) {
+		next = list_first_entry(&zpool->lru, uvm_uxu_zentry_t, lru);
+		uxu_zpool_unlink(zpool, next);
+		list_add(&next->lru, &evicted);
+	}
+	*slot = entry;
+	list_add_tail(&entry->lru, &zpool->lru);
+	zpool->size += entry->size;
+	zpool->orig_size += entry->orig_size;
+	zpool->nr_entries++;
+	uvm_spin_unlock(&zpool->lock);
+
+	uxu_stat_add(range, UXU_STAT_ZPOOL_STORED_BYTES, orig_size);
+	uxu_stat_add(range, UXU_STAT_ZPOOL_COMPRESSED_BYTES, size);
+
+	list_for_each_entry_safe(entry, next, &evicted, lru) {
+		uxu_stat_add(entry->range, UXU_STAT_ZPOOL_EVICTED_BLOCKS, 1);
+		uvm_kvfree(entry);
+	}
+}
+
+/**
+ * Decompress a page of a pool entry.
+ *
+ * @return: true on success, false if the entry is corrupted.
+ */
+static bool
+uxu_zpool_decompress_page(uvm_uxu_zentry_t *entry, uvm_page_index_t page_index, size_t offset, struct page *page)
+{
+	NvU32	len = entry->lens[page_index];
+	void	*kaddr = kmap_atomic(page);
+	bool	ok = true;
+
+	if (len == 0)
+		memset(kaddr, 0, PAGE_SIZE);
+	else if (len == UXU_ZPOOL_RAW)
+		memcpy(kaddr, entry->data + offset, PAGE_SIZE);
+	else
+		ok = uxu_lz4_decompress(entry->data + offset, kaddr, len, PAGE_SIZE) == PAGE_SIZE;
+	kunmap_atomic(kaddr);
+	return ok;
+}
 
 /**
- * Determine if we need to reclaim some blocks or not.
+ * Fill the host buffers of a block being loaded from its pool entry.
  *
- * @param uxu_va_space: the va_space information related to UXU.
+ * @param block: USEHOSTBUF block whose pages have been allocated.
+ * @param mask: pages to be read, the pages filled from the pool are cleared.
  *
- * @return: true if we need to reclaim, false otherwise.
+ * @return: the number of bytes decompressed.
  */
-static inline bool
-uxu_has_to_reclaim_blocks(uvm_uxu_va_space_t *uxu_va_space)
+static NvU64
+uxu_zpool_load_hostbufs(uvm_va_block_t *block, uvm_page_mask_t *mask)
 {
-	unsigned long	freeram = global_zone_page_state(NR_FREE_PAGES);
-	unsigned long	pagecacheram = global_zone_page_state(NR_FILE_PAGES);
-	return freeram + pagecacheram < uxu_va_space->reserved_nr_pages;
+	uvm_uxu_zentry_t	*entry = uxu_zpool_take(block);
+	uvm_page_index_t	page_index;
+	size_t	offset = 0;
+	NvU64	bytes = 0;
+
+	if (entry == NULL)
+		return 0;
+
+	for (page_index = 0; page_index < PAGES_PER_UVM_VA_BLOCK; page_index++) {
+		NvU32	len = entry->lens[page_index];
+		struct page	*page = block->cpu.pages[page_index];
+
+		if (len == UXU_ZPOOL_ABSENT)
+			continue;
+		if (page != NULL && uvm_page_mask_test(mask, page_index) &&
+		    uxu_zpool_decompress_page(entry, page_index, offset, page)) {
+			uvm_page_mask_clear(mask, page_index);
+			bytes += PAGE_SIZE;
+		}
+		offset += len;
+	}
+
+	uvm_kvfree(entry);
+	uxu_stat_add(block->va_range, UXU_STAT_ZPOOL_LOAD_BYTES, bytes);
+	return bytes;
 }
 
 /**
- * Mark that we just touch this block, which has in-buffer data.
+ * Read or write the pages of a block which are not in the page cache from or
+ * to its files: the host buffers of a USEHOSTBUF block, or the pages of any
+ * block loaded from holes. The pages are transferred in runs contiguous in a
+ * file, one request per run, with direct I/O for host buffers if the file
+ * supports it. On read, what lies past the end of the file data is zeroed.
+ * No page is written past the end of the file data.
  *
- * @param va_block: va_block to be marked.
+ * @param block: the block.
+ * @param write: write the block back instead of reading it.
+ * @param mask: pages to transfer.
+ * @param bytes: number of bytes of file data transferred.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
  */
-static inline void
-uxu_block_mark_recent_in_buffer(uvm_va_block_t *va_block)
+static NV_STATUS
+uxu_hostbuf_block_io(uvm_va_block_t *block, bool write, const uvm_page_mask_t *mask, NvU64 *bytes)
+{
+	uvm_va_range_t	*range = block->va_range;
+	uvm_va_block_region_t	region;
+	uvm_page_index_t	page_id;
+	struct bio_vec	*bvec;
+	struct mem_cgroup	*old_memcg;
+	NV_STATUS	status = NV_OK;
+
+	// The page cache used by buffered I/O and by the containers is charged
+	// to the process using UXU, like the pages of the block
+	old_memcg = uxu_memcg_enter(range->va_space);
+
+	if (range->node.uxu_rtn.container) {
+		status = uxu_container_block_io(block, write, bytes);
+		uxu_memcg_exit(old_memcg);
+		return status;
+	}
+
+	*bytes = 0;
+	bvec = uvm_kvmalloc(PAGES_PER_UVM_VA_BLOCK * sizeof(*bvec));
+	if (bvec == NULL) {
+		uxu_memcg_exit(old_memcg);
+		return NV_ERR_NO_MEMORY;
+	}
+
+	setup_block_readable_region(block, &region);
+	page_id = region.first;
+	while (page_id < region.outer) {
+		uvm_uxu_extent_t	*extent;
+		pgoff_t	pgoff;
+		unsigned long	nr_pages, i;
+		loff_t	pos;
+		size_t	len, direct_len;
+		ssize_t	ret;
+		bool	direct;
+
+		extent = uxu_block_page_lookup(block, page_id, &pgoff, &nr_pages);
+		nr_pages = extent ? min(nr_pages, (unsigned long)(region.outer - page_id)) : 0;
+		for (i = 0; i < nr_pages; i++) {
+			struct page	*page = block->cpu.pages[page_id + i];
+
+			if (page == NULL || !uvm_page_mask_test(mask, page_id + i))
+				break;
+			bvec[i].bv_page = page;
+			bvec[i].bv_len = PAGE_SIZE;
+			bvec[i].bv_offset = 0;
+		}
+		if (i == 0) {
+			page_id++;
+			continue;
+		}
+		nr_pages = i;
+
+		pos = (loff_t)pgoff << PAGE_SHIFT;
+		len = min_t(NvU64, (NvU64)nr_pages << PAGE_SHIFT,
+			    extent->offset + uxu_extent_readable_length(extent) - pos);
+		direct = uxu_is_hostbuf_block(block) && uxu_file_can_direct_io(extent->filp);
+
+		if (write) {
+			// Direct writes are done in whole pages so that they do not
+			// extend the file. The partial last page of the file data
+			// goes through the page cache.
+			direct_len = direct ? round_down(len, PAGE_SIZE) : 0;
+			ret = direct_len ? uxu_file_rw(extent->filp, bvec, nr_pages, direct_len, pos, true, true) : 0;
+			if (ret == (ssize_t)direct_len && len > direct_len) {
+				unsigned long	first = direct_len >> PAGE_SHIFT;
+				ssize_t	tail = uxu_file_rw(extent->filp, &bvec[first], nr_pages - first,
+							  len - direct_len, pos + direct_len, true, false);
+
+				ret = tail < 0 ? tail : ret + tail;
+			}
+			if (ret == (ssize_t)len)
+				atomic64_add(len, &extent->writeback_bytes);
+		}
+		else {
+			// Direct reads past the end of the file are short, so whole
+			// pages are read either way.
+			direct_len = len;
+			ret = uxu_file_rw(extent->filp, bvec, nr_pages, (size_t)nr_pages << PAGE_SHIFT, pos, false, direct);
+			if (ret >= (ssize_t)len) {
+				size_t	zeroed = ret;
+
+				while (zeroed < (size_t)nr_pages << PAGE_SHIFT) {
+					zero_user_segment(bvec[zeroed >> PAGE_SHIFT].bv_page, offset_in_page(zeroed), PAGE_SIZE);
+					zeroed = round_down(zeroed, PAGE_SIZE) + PAGE_SIZE;
+				}
+				atomic64_add(len, &extent->read_bytes);
+				ret = len;
+			}
+		}
+
+		if (ret != (ssize_t)len) {
+			printk(KERN_DEBUG "uxu %s error at 0x%llx of block %llx: %zd\n", write ? "write" : "read",
+			       (NvU64)pos, block->start, ret);
+			status = ret < 0 ? errno_to_nv_status(ret) : NV_ERR_OPERATING_SYSTEM;
+			break;
+		}
+
+		*bytes += len;
+		if (direct)
+			uxu_stat_add(range, write ? UXU_STAT_DIRECT_WRITE_BYTES : UXU_STAT_DIRECT_READ_BYTES,
+				     direct_len);
+		page_id += nr_pages;
+	}
+
+	uvm_kvfree(bvec);
+	uxu_memcg_exit(old_memcg);
+	return status;
+}
+
+/**
+ * Load a USEHOSTBUF block: give it pages of the host buffer pool and read
+ * them from the backing files with direct I/O. The I/O is synchronous, there
+ * is no page cache to wait for on a retry.
+ *
+ * @param block: the block to be loaded.
+ * @param dma_map_ns: time spent mapping the pages for the GPUs.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+load_hostbufs_for_block(uvm_va_block_t *block, NvU64 *dma_map_ns)
+{
+	uvm_va_block_region_t	region;
+	uvm_page_mask_t	mask;
+	NvU64	bytes = 0;
+	NV_STATUS	status = NV_OK;
+
+	if (!load_pagecaches_for_block(block, dma_map_ns))
+		return NV_ERR_NO_MEMORY;
+
+	// The pages of holes are zero filled already, the pages in the pool
+	// are decompressed
+	uvm_page_mask_andnot(&mask, &block->cpu.resident, &block->uxu_holes);
+	uxu_zpool_load_hostbufs(block, &mask);
+	if (!uvm_page_mask_empty(&mask))
+		status = uxu_hostbuf_block_io(block, false, &mask, &bytes);
+	if (status != NV_OK) {
+		printk(KERN_DEBUG "failed to read the host buffers of block %llx: %s\n", block->start,
+		       nvstatusToString(status));
+		return status;
+	}
+
+	setup_block_readable_region(block, &region);
+	block->uxu_pages_missed = uvm_va_block_region_num_pages(region) - uvm_page_mask_weight(&block->uxu_holes);
+	uvm_tools_record_uxu_page_cache(block, 0, block->uxu_pages_missed);
+	uxu_stat_add(block->va_range, UXU_STAT_READ_SYNC_BYTES, bytes);
+	return NV_OK;
+}
+
+/* Readahead of a run of pages contiguous in a file, queued in an I/O batch */
+typedef struct {
+	uvm_va_space_t	*va_space;
+	uvm_uxu_extent_t	*extent;
+	pgoff_t	pgoff;
+	unsigned long	nr_pages;
+	/* Location of the first page on the device, set on submission */
+	NvU64	physical;
+} uxu_io_run_t;
+
+/*
+ * Reads queued by the blocks of a fault batch. They are submitted together,
+ * sorted by location on the device, so that the reads of fragmented files
+ * and of several blocks reach the device in order and merged.
+ */
+struct uvm_uxu_io_batch_struct {
+	NvU32	nr_runs;
+	NvU32	max_runs;
+	uxu_io_run_t	runs[];
+};
+
+/**
+ * Allocate an I/O batch for a fault servicing context.
+ *
+ * @param pbatch: the batch, NULL if uvm_uxu_io_batch_runs is 0.
+ *
+ * @return: NV_OK on success, NV_ERR_NO_MEMORY otherwise.
+ */
+NV_STATUS
+uxu_io_batch_create(uvm_uxu_io_batch_t **pbatch)
+{
+	uvm_uxu_io_batch_t	*batch;
+
+	*pbatch = NULL;
+	if (uvm_uxu_io_batch_runs == 0)
+		return NV_OK;
+
+	batch = uvm_kvmalloc(sizeof(*batch) + uvm_uxu_io_batch_runs * sizeof(batch->runs[0]));
+	if (batch == NULL)
+		return NV_ERR_NO_MEMORY;
+	batch->nr_runs = 0;
+	batch->max_runs = uvm_uxu_io_batch_runs;
+	*pbatch = batch;
+	return NV_OK;
+}
+
+void
+uxu_io_batch_destroy(uvm_uxu_io_batch_t *batch)
+{
+	uvm_kvfree(batch);
+}
+
+static int
+uxu_io_run_cmp(const void *a, const void *b)
 {
-	uvm_uxu_va_space_t *uxu_va_space = &va_block->va_range->va_space->uxu_va_space;
+	const uxu_io_run_t	*ra = (const uxu_io_run_t *)a;
+	const uxu_io_run_t	*rb = (const uxu_io_run_t *)b;
+
+	// Runs of unknown location go last, in file order
+	if (ra->physical != rb->physical)
+		return ra->physical < rb->physical ? -1 : 1;
+	if (ra->extent->filp != rb->extent->filp)
+		return (unsigned long)ra->extent->filp < (unsigned long)rb->extent->filp ? -1 : 1;
+	if (ra->pgoff != rb->pgoff)
+		return ra->pgoff < rb->pgoff ? -1 : 1;
+	return 0;
+}
 
-	// Move this block to the tail of the LRU list.
-	// mutex locking is commented out. It has been already held.
-        uvm_mutex_lock(&uxu_va_space->lock_blocks);
-	if (!list_empty(&va_block->uxu_lru))
-		list_move_tail(&va_block->uxu_lru, &uxu_va_space->lru_head);
-        uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+/**
+ * Does `next` continue the run starting at `run` and `nr_pages` long, both
+ * in the file and on the device?
+ */
+static inline bool
+uxu_io_run_continues(const uxu_io_run_t *run, unsigned long nr_pages, const uxu_io_run_t *next)
+{
+	if (next->extent->filp != run->extent->filp || next->pgoff != run->pgoff + nr_pages ||
+	    next->va_space != run->va_space)
+		return false;
+	if (run->physical == UXU_PHYSICAL_UNKNOWN)
+		return next->physical == UXU_PHYSICAL_UNKNOWN;
+	return next->physical == run->physical + ((NvU64)nr_pages << PAGE_SHIFT);
 }
 
+/**
+ * Start the reads queued in the batch, sorted by location on the device and
+ * merged when they are contiguous. The reads are plugged so that the block
+ * layer merges and sorts the requests of different runs too. This function
+ * does not wait for the I/O to complete.
+ *
+ * @param batch: the batch, may be NULL. It is empty on return.
+ */
 void
-stop_pagecache_reducer(uvm_va_space_t *va_space)
+uxu_io_batch_submit(uvm_uxu_io_batch_t *batch)
 {
-	uvm_uxu_va_space_t *uxu_va_space = &va_space->uxu_va_space;
-	if (uxu_va_space->reducer) {
-		kthread_stop(uxu_va_space->reducer);
-		uxu_va_space->reducer = NULL;
+	struct blk_plug	plug;
+	NvU32	i, j;
+
+	if (batch == NULL || batch->nr_runs == 0)
+		return;
+
+	for (i = 0; i < batch->nr_runs; i++) {
+		uxu_io_run_t	*run = &batch->runs[i];
+
+		run->physical = uxu_extent_physical(run->extent, (loff_t)run->pgoff << PAGE_SHIFT);
+	}
+	sort(batch->runs, batch->nr_runs, sizeof(batch->runs[0]), uxu_io_run_cmp, NULL);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < batch->nr_runs; i = j) {
+		uxu_io_run_t	*run = &batch->runs[i];
+		struct file	*filp = run->extent->filp;
+		unsigned long	nr_pages = run->nr_pages;
+		struct mem_cgroup	*old_memcg;
+
+		for (j = i + 1; j < batch->nr_runs && uxu_io_run_continues(run, nr_pages, &batch->runs[j]); j++)
+			nr_pages += batch->runs[j].nr_pages;
+
+		old_memcg = uxu_memcg_enter(run->va_space);
+		page_cache_sync_readahead(filp->f_mapping, &run->extent->ra, filp, run->pgoff, nr_pages);
+		uxu_memcg_exit(old_memcg);
 	}
+	blk_finish_plug(&plug);
+
+	batch->nr_runs = 0;
 }
 
+/**
+ * Queue the readahead of a run of pages of a block in the batch, submitting
+ * the batch first if it is full.
+ */
 static void
-uxu_unmap_page(uvm_va_block_t *va_block, int page_index)
+uxu_io_batch_add(uvm_uxu_io_batch_t *batch, uvm_va_block_t *block, uvm_uxu_extent_t *extent, pgoff_t pgoff,
+		 unsigned long nr_pages)
 {
-	uvm_gpu_id_t	id;
+	uxu_io_run_t	*run;
 
-	for_each_gpu_id(id) {
-		uvm_gpu_t	*gpu;
-		uvm_va_block_gpu_state_t	*gpu_state = va_block->gpus[uvm_id_gpu_index(id)];
+	if (batch->nr_runs == batch->max_runs)
+		uxu_io_batch_submit(batch);
 
-		if (!gpu_state)
-			continue;
+	run = &batch->runs[batch->nr_runs++];
+	run->va_space = block->va_range->va_space;
+	run->extent = extent;
+	run->pgoff = pgoff;
+	run->nr_pages = nr_pages;
+	run->physical = UXU_PHYSICAL_UNKNOWN;
+}
 
-		if (gpu_state->cpu_pages_dma_addrs[page_index] == 0)
+/**
+ * Start reading the pages of the block which are not in the page cache yet.
+ * This function does not wait for the I/O to complete. The number of pages
+ * missing from the page cache is recorded in the block.
+ *
+ * @param block: the block to be read.
+ * @param io: if not NULL, the reads are queued in this batch instead of being
+ * submitted at once.
+ *
+ * @return: true if some pages are not up to date yet, false if every
+ * readable page of the block is already in the page cache.
+ */
+static bool
+uxu_start_block_io(uvm_va_block_t *block, uvm_uxu_io_batch_t *io)
+{
+	uvm_va_block_region_t	region;
+	int	page_id;
+	NvU32	pages_missed = 0;
+
+	setup_block_readable_region(block, &region);
+	for_each_va_block_page_in_region(page_id, region) {
+		uvm_uxu_extent_t	*extent;
+		struct page	*page;
+		pgoff_t	pgoff;
+		unsigned long	nr_pages, i;
+
+		if (uvm_page_mask_test(&block->uxu_holes, page_id))
+			continue;
+		extent = uxu_block_page_lookup(block, page_id, &pgoff, &nr_pages);
+		if (extent == NULL)
 			continue;
 
-		gpu = uvm_va_space_get_gpu(va_block->va_range->va_space, id);
+		page = find_get_page(extent->filp->f_mapping, pgoff);
+		if (page == NULL) {
+			// Readahead adds locked pages to the page cache for the
+			// window it reads, so the following pages of this window
+			// are found by find_get_page() above. The window stops at
+			// the end of the extent or at the next hole.
+			nr_pages = min(nr_pages, (unsigned long)(region.outer - page_id));
+			i = 1;
+			while (i < nr_pages && !uvm_page_mask_test(&block->uxu_holes, page_id + i))
+				i++;
+			nr_pages = i;
+			uxu_stat_add(block->va_range, UXU_STAT_READ_SYNC_BYTES, (NvU64)nr_pages << PAGE_SHIFT);
+			atomic64_add((NvU64)nr_pages << PAGE_SHIFT, &extent->read_bytes);
 
-		uvm_gpu_unmap_cpu_page(gpu, gpu_state->cpu_pages_dma_addrs[page_index]);
-		gpu_state->cpu_pages_dma_addrs[page_index] = 0;
+			if (io == NULL) {
+				struct mem_cgroup	*old_memcg = uxu_memcg_enter(block->va_range->va_space);
+
+				page_cache_sync_readahead(extent->filp->f_mapping, &extent->ra, extent->filp, pgoff,
+							  nr_pages);
+				uxu_memcg_exit(old_memcg);
+				pages_missed++;
+				continue;
+			}
+
+			// The queued pages are not in the page cache yet, skip
+			// the rest of the window
+			uxu_io_batch_add(io, block, extent, pgoff, nr_pages);
+			pages_missed += nr_pages;
+			page_id += nr_pages - 1;
+			continue;
+		}
+		if (!PageUptodate(page))
+			pages_missed++;
+		put_page(page);
 	}
+
+	block->uxu_pages_missed = pages_missed;
+	uvm_tools_record_uxu_page_cache(block, uvm_va_block_region_num_pages(region) - pages_missed, pages_missed);
+
+	return pages_missed > 0;
 }
 
-static NV_STATUS
-add_pagecache_to_block(uvm_va_block_t *block, int page_id, struct page *page)
+/**
+ * Wait for the storage I/O started by uxu_try_load_block() to complete.
+ * The block lock must not be held.
+ *
+ * @param block: the block whose I/O has been started.
+ */
+void
+uxu_wait_block_io(uvm_va_block_t *block)
 {
-	uvm_gpu_id_t	gpu_id;
+	uvm_va_block_region_t	region;
+	int	page_id;
 
-	UVM_ASSERT(block->cpu.pages[page_id] == NULL);
+	if (!block->uxu_io_pending)
+		return;
 
-	for_each_gpu_id(gpu_id) {
-		uvm_gpu_t	*gpu;
-		uvm_va_block_gpu_state_t	*gpu_state = block->gpus[uvm_id_gpu_index(gpu_id)];
-		NV_STATUS	status;
+	setup_block_readable_region(block, &region);
+	for_each_va_block_page_in_region(page_id, region) {
+		uvm_uxu_extent_t	*extent;
+		struct page	*page;
+		pgoff_t	pgoff;
 
-		if (!gpu_state)
+		extent = uxu_block_page_lookup(block, page_id, &pgoff, NULL);
+		if (extent == NULL)
 			continue;
+		page = find_get_page(extent->filp->f_mapping, pgoff);
+		if (page == NULL)
+			continue;
+		wait_on_page_locked(page);
+		put_page(page);
+	}
+}
 
-		UVM_ASSERT(gpu_state->cpu_pages_dma_addrs[page_id] == 0);
+/* Read ahead of a run of a file, queued on uxu_io_q */
+typedef struct {
+	nv_kthread_q_item_t	q_item;
+	struct file	*filp;
+	struct mem_cgroup	*memcg;
+	pgoff_t	pgoff;
+	unsigned long	nr_pages;
+} uvm_uxu_prefetch_t;
 
-		gpu = uvm_va_space_get_gpu(block->va_range->va_space, gpu_id);
+static void
+uxu_prefetch_run(uvm_uxu_prefetch_t *prefetch)
+{
+	struct file_ra_state	ra;
+	struct mem_cgroup	*old_memcg;
 
-		status = uvm_gpu_map_cpu_pages(gpu, page, PAGE_SIZE, &gpu_state->cpu_pages_dma_addrs[page_id]);
-		if (status != NV_OK) {
-			printk(KERN_DEBUG "Cannot do uvm_gpu_map_cpu_pages\n");
+	// The read ahead state of the user's file is left alone
+	file_ra_state_init(&ra, prefetch->filp->f_mapping);
+	ra.ra_pages = PAGES_PER_UVM_VA_BLOCK;
 
-			uxu_unmap_page(block, page_id);
+	old_memcg = uxu_memcg_use(prefetch->memcg);
+	page_cache_sync_readahead(prefetch->filp->f_mapping, &ra, prefetch->filp, prefetch->pgoff,
+				  prefetch->nr_pages);
+	uxu_memcg_exit(old_memcg);
 
-			return status;
+	uxu_memcg_put(prefetch->memcg);
+	fput(prefetch->filp);
+	uvm_kvfree(prefetch);
+	atomic_dec(&uxu_prefetch_pending);
+}
+
+static void
+uxu_prefetch_run_entry(void *args)
+{
+	UVM_ENTRY_VOID(uxu_prefetch_run(args));
+}
+
+/**
+ * Queue the read ahead of a run of pages of an extent on uxu_io_q. The run
+ * is dropped if too many are queued already.
+ *
+ * @return: true if the read ahead is queued, false otherwise.
+ */
+static bool
+uxu_prefetch_queue(uvm_va_range_t *range, uvm_uxu_extent_t *extent, pgoff_t pgoff, unsigned long nr_pages)
+{
+	uvm_uxu_prefetch_t	*prefetch = NULL;
+
+	if (atomic_inc_return(&uxu_prefetch_pending) <= UXU_PREFETCH_MAX_PENDING)
+		prefetch = uvm_kvmalloc(sizeof(*prefetch));
+	if (prefetch == NULL) {
+		atomic_dec(&uxu_prefetch_pending);
+		return false;
+	}
+
+	get_file(extent->filp);
+	prefetch->filp = extent->filp;
+	prefetch->memcg = uxu_memcg_get(range->va_space);
+	prefetch->pgoff = pgoff;
+	prefetch->nr_pages = nr_pages;
+	nv_kthread_q_item_init(&prefetch->q_item, uxu_prefetch_run_entry, prefetch);
+	nv_kthread_q_schedule_q_item(&uxu_io_q, &prefetch->q_item);
+	return true;
+}
+
+/**
+ * Start reading the block containing the given address into the page cache.
+ * This is a hint from the prefetch heuristics, which hold the block lock of
+ * the faulting block, so the reads are queued on uxu_io_q instead of being
+ * issued here. Nothing is done for ranges whose content is not read from
+ * storage.
+ *
+ * @param range: uxu va range containing the address.
+ * @param address: predicted address of a future access.
+ */
+void
+uxu_prefetch_address(uvm_va_range_t *range, NvU64 address)
+{
+	NvU64	start = max(UVM_VA_BLOCK_ALIGN_DOWN(address), range->node.start);
+	NvU64	end = min(start + UVM_VA_BLOCK_SIZE - 1, range->node.end);
+	NvU64	addr;
+
+	if (!uxu_check_range_flag(range, UVM_UXU_FLAG_READ) || uxu_check_range_flag(range, UVM_UXU_FLAG_VOLATILE) ||
+	    uxu_is_hostbuf_range(range))
+		return;
+
+	for (addr = start; addr <= end; addr += PAGE_SIZE) {
+		uvm_uxu_extent_t	*extent;
+		struct page	*page;
+		pgoff_t	pgoff;
+		unsigned long	nr_pages;
+
+		extent = uxu_range_page_lookup(range, addr, &pgoff, &nr_pages);
+		if (extent == NULL)
+			continue;
+
+		page = find_get_page(extent->filp->f_mapping, pgoff);
+		if (page == NULL) {
+			unsigned long	skipped;
+
+			nr_pages = min(nr_pages, (unsigned long)((end - addr) >> PAGE_SHIFT) + 1);
+			skipped = uxu_extent_skip_hole(extent, &pgoff, &nr_pages);
+			if (nr_pages > 0 && uxu_prefetch_queue(range, extent, pgoff, nr_pages)) {
+				uxu_stat_add(range, UXU_STAT_READ_AHEAD_BYTES, (NvU64)nr_pages << PAGE_SHIFT);
+				atomic64_add((NvU64)nr_pages << PAGE_SHIFT, &extent->read_bytes);
+			}
+
+			// Continue after the hole and the pages read, with the next
+			// data or extent of the block, if any
+			addr += (NvU64)(skipped + nr_pages - 1) << PAGE_SHIFT;
+			continue;
 		}
+		put_page(page);
 	}
-	block->cpu.pages[page_id] = page;
-	return NV_OK;
 }
 
-static struct page *
-assign_page(uvm_va_block_t *block, bool zero)
+/**
+ * Load the block from the backing file if it has not been loaded yet.
+ *
+ * On the replayable fault path, the storage I/O is only started the first
+ * time and NV_ERR_BUSY_RETRY is returned, so that the fault handler can drop
+ * the block lock and service other blocks of the batch in the meantime. The
+ * next call loads the block from the page cache. USEHOSTBUF blocks are read
+ * synchronously.
+ *
+ * @return: NV_OK if the block can be serviced, NV_ERR_BUSY_RETRY if the
+ * storage I/O is in flight.
+ */
+NV_STATUS
+uxu_try_load_block(uvm_va_block_t *block, uvm_va_block_retry_t *block_retry, uvm_service_block_context_t *service_context, uvm_processor_id_t processor_id)
 {
-	struct page *page;
-	gfp_t gfp_flags;
+	uvm_va_space_t	*va_space = block->va_range->va_space;
+	NvU64	phase_start;
+	NvU64	dma_map_ns = 0;
+	NV_STATUS	status;
 
-	gfp_flags = NV_UVM_GFP_FLAGS | GFP_HIGHUSER;
-	if (zero)
-		gfp_flags |= __GFP_ZERO;
+	if (block->is_loaded)
+		return NV_OK;
+	if (uxu_is_volatile_block(block))
+		return NV_OK;
 
-	page = alloc_pages(gfp_flags, 0);
-	if (!page) {
-		return NULL;
+	phase_start = uvm_fault_phase_start();
+	if (!block->uxu_io_pending) {
+		block->uxu_load_start = NV_GETTIME();
+		// Also for write-only blocks, whose pages of holes are not
+		// written back while they stay zero
+		uxu_block_find_holes(block);
+	}
+	if (uxu_is_read_block(block)) {
+		if (uxu_is_hostbuf_block(block)) {
+			uvm_tools_record_uxu_block_load_start(block);
+			// The pages already given to the block are filled again on
+			// the next attempt
+			status = load_hostbufs_for_block(block, &dma_map_ns);
+			if (status != NV_OK)
+				return status;
+		}
+		else {
+			if (!block->uxu_io_pending) {
+				// Other paths wait for the I/O in load_pagecaches_for_block().
+				// The reads of the blocks of a fault batch are queued and
+				// submitted together before the blocks are serviced again.
+				bool	deferred = service_context->operation == UVM_SERVICE_OPERATION_REPLAYABLE_FAULTS;
+
+				uvm_tools_record_uxu_block_load_start(block);
+				if (uxu_start_block_io(block, deferred ? service_context->uxu_io_batch : NULL) && deferred) {
+					block->uxu_io_pending = true;
+					uvm_fault_phase_end_id(va_space, processor_id, UVM_FAULT_PHASE_IO, phase_start);
+					return NV_ERR_BUSY_RETRY;
+				}
+			}
+
+			block->uxu_io_pending = false;
+			if (!load_pagecaches_for_block(block, &dma_map_ns))
+				return NV_ERR_NO_MEMORY;
+		}
+
+		if (phase_start) {
+			uvm_fault_phase_record_id(va_space, processor_id, UVM_FAULT_PHASE_DMA_MAP, dma_map_ns);
+			uvm_fault_phase_record_id(va_space, processor_id, UVM_FAULT_PHASE_IO,
+						  NV_GETTIME() - phase_start - dma_map_ns);
+		}
 	}
 
-	// the kernel has 'written' zeros to this page, so it is dirty
-	if (zero)
-		SetPageDirty(page);
+	if (uxu_is_read_block(block)) {
+		uvm_va_range_t	*range = block->va_range;
+		unsigned long	*loaded_blocks = range->node.uxu_rtn.loaded_blocks;
+
+		uxu_profile_record(block);
 
-	return page;
+		uxu_stat_add(range, UXU_STAT_BLOCKS_LOADED, 1);
+		if (loaded_blocks && test_and_set_bit(uvm_va_range_block_index(range, block->start), loaded_blocks))
+			uxu_stat_add(range, UXU_STAT_BLOCKS_RELOADED, 1);
+		uxu_stat_latency(range, UXU_STAT_LATENCY_LOAD, block->uxu_load_start);
+		uvm_tools_record_uxu_block_load_end(block,
+						    uvm_page_mask_weight(&block->cpu.pagecached),
+						    (NvU64)block->uxu_pages_missed << PAGE_SHIFT,
+						    block->uxu_load_start);
+	}
+
+	block->is_loaded = TRUE;
+	uxu_block_mark_recent_in_buffer(block);
+	uxu_reclaim_kick(&va_space->uxu_va_space);
+	return NV_OK;
 }
 
-static struct page *
-assign_pagecache(uvm_va_block_t *block, uvm_page_index_t page_index)
+/**
+ * Account the page cache pages of the block, which are written back to
+ * storage by the kernel.
+ *
+ * @param block: block whose pages are written back.
+ * @param cause: why the pages are written back.
+ */
+static void
+uxu_account_writeback(uvm_va_block_t *block, UvmEventUxuWritebackCause cause)
 {
-	struct file	*uxu_file;
-	pgoff_t	pgoff_block;
-	struct page	*page;
+	uvm_va_range_t	*range = block->va_range;
+	NvU64	written = (NvU64)uvm_page_mask_weight(&block->cpu.pagecached) << PAGE_SHIFT;
+	uvm_page_index_t	page_index;
 
-	uxu_file = UXU_FILE_FROM_BLOCK(block);
-	pgoff_block = BLOCK_START_OFFSET(block) >> PAGE_SHIFT;
-	page = read_mapping_page(uxu_file->f_mapping, pgoff_block + page_index, NULL);
-	if (IS_ERR(page))
-		return NULL;
-	return page;
+	uxu_stat_add(range, UXU_STAT_WRITEBACK_BYTES, written);
+	uvm_tools_record_uxu_writeback(block, written, cause);
+
+	// The per-file counters are only reported for striped ranges
+	if (range->node.uxu_rtn.stripe_unit == 0)
+		return;
+
+	for_each_va_block_page_in_mask(page_index, &block->cpu.pagecached, block) {
+		uvm_uxu_extent_t	*extent;
+		pgoff_t	pgoff;
+
+		extent = uxu_block_page_lookup(block, page_index, &pgoff, NULL);
+		if (extent != NULL)
+			atomic64_add(PAGE_SIZE, &extent->writeback_bytes);
+	}
 }
 
-static inline bool
-uxu_is_pagecachable(uvm_va_block_t *block, uvm_page_index_t page_id)
+/**
+ * Drop from the mask the pages of the block loaded from holes which are
+ * still zero, so that writing the block back keeps the holes of the files.
+ *
+ * @param block: block whose data is resident on the CPU.
+ * @param mask: pages to be written back.
+ */
+static void
+uxu_block_clear_zero_holes(uvm_va_block_t *block, uvm_page_mask_t *mask)
 {
-	struct inode *inode;
-	uvm_page_index_t	outer_max;
-	loff_t len_remain;
+	uvm_page_index_t	page_index;
 
-	if (uxu_is_volatile_block(block))
-		return false;
-	inode = block->va_range->node.uxu_rtn.filp->f_mapping->host;
-	len_remain = i_size_read(inode) - (block->start - block->va_range->node.start);
-	outer_max = (len_remain + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	if (page_id >= outer_max)
-		return false;
-	return true;
+	for_each_va_block_page_in_mask(page_index, &block->uxu_holes, block) {
+		struct page	*page = block->cpu.pages[page_index];
+		void	*addr;
+		bool	zero;
+
+		if (page == NULL || !uvm_page_mask_test(mask, page_index))
+			continue;
+		addr = kmap_atomic(page);
+		zero = memchr_inv(addr, 0, PAGE_SIZE) == NULL;
+		kunmap_atomic(addr);
+		if (zero)
+			uvm_page_mask_clear(mask, page_index);
+	}
 }
 
-struct page *
-uxu_get_page(uvm_va_block_t *block, uvm_page_index_t page_index, bool zero)
+/**
+ * Write the pages of the block which are not in the page cache back to its
+ * files: the host buffers of a USEHOSTBUF block, and the pages loaded from
+ * holes. The kernel does not write them back. A failure is recorded in the
+ * files of the range too, so that the next fsync() of the user reports it,
+ * as for the pages the kernel writes back.
+ *
+ * @param block: block whose data is resident on the CPU.
+ * @param cause: why the block is written back.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_private_writeback(uvm_va_block_t *block, UvmEventUxuWritebackCause cause)
 {
-	struct page	*page;
+	uvm_page_mask_t	mask;
+	NvU64	written;
+	NV_STATUS	status;
 
-	if (uxu_is_pagecachable(block, page_index)) {
-		page = assign_pagecache(block, page_index);
-		if (!IS_ERR(page)) {
-			uvm_page_mask_set(&block->cpu.pagecached, page_index);
-			if (!page_has_buffers(page)) {
-				create_empty_buffers(page, block->va_range->node.uxu_rtn.filp->f_mapping->host->i_sb->s_blocksize, BIT(BH_Dirty) | BIT(BH_Uptodate));
-			}
-			/* TODO: It seems to be natural that marking a mapped page as dirty. */
-			SetPageDirty(page);
-		}
-		else {
-			page = NULL;
-		}
+	uvm_page_mask_andnot(&mask, &block->cpu.resident, &block->cpu.pagecached);
+	uxu_block_clear_zero_holes(block, &mask);
+	if (uvm_page_mask_empty(&mask))
+		return NV_OK;
+
+	status = uxu_hostbuf_block_io(block, true, &mask, &written);
+	// The pages written are data of the files now, they are written back
+	// even if they are zeroed again
+	if (status == NV_OK) {
+		uvm_page_mask_andnot(&block->uxu_holes, &block->uxu_holes, &mask);
 	}
 	else {
-		page = assign_page(block, zero);
-		if (page)
-			uvm_page_mask_clear(&block->cpu.pagecached, page_index);
-	}
+		uvm_uxu_range_tree_node_t	*uxu_rtn = &block->va_range->node.uxu_rtn;
+		NvU32	i;
 
-	return page;
+		for (i = 0; i < uxu_rtn->nr_extents; i++)
+			mapping_set_error(uxu_rtn->extents[i].filp->f_mapping, -EIO);
+	}
+	uxu_stat_add(block->va_range, UXU_STAT_WRITEBACK_BYTES, written);
+	uvm_tools_record_uxu_writeback(block, written, cause);
+	return status;
 }
 
-static void
-setup_block_readable_region(uvm_va_block_t *block, uvm_va_block_region_t *pregion)
+/**
+ * Write the pages of the block the kernel does not write back, and account
+ * for the page cache pages it does.
+ *
+ * @param block: block whose data is resident on the CPU.
+ * @param cause: why the block is written back.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_block_writeback(uvm_va_block_t *block, UvmEventUxuWritebackCause cause)
 {
-	struct file	*uxu_file;
-	struct inode	*inode;
-	uvm_page_index_t	outer, outer_readable;
-	loff_t	len_remain;
-
-	uxu_file = UXU_FILE_FROM_BLOCK(block);
-	inode = uxu_file->f_mapping->host;
-	len_remain = i_size_read(inode) - (block->start - block->va_range->node.start);
+	NV_STATUS	status = uxu_private_writeback(block, cause);
 
-	outer = ((block->end - block->start) >> PAGE_SHIFT) + 1;
-	outer_readable = (len_remain + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	if (outer > outer_readable)
-		pregion->outer = outer_readable;
-	else
-		pregion->outer = outer;
-	pregion->first = 0;
+	if (!uxu_is_hostbuf_block(block))
+		uxu_account_writeback(block, cause);
+	return status;
 }
 
-static bool
-load_pagecaches_for_block(uvm_va_block_t *block)
-{
-	uvm_va_block_region_t	region;
-	int	page_id;
+/* Block of a flush, sorted by the location of its data on the device */
+typedef struct {
+	uvm_va_block_t	*block;
+	NvU64	physical;
+} uxu_block_order_t;
 
-	setup_block_readable_region(block, &region);
-	// Fill in page-cache pages to va_block
-	for_each_va_block_page_in_region(page_id, region) {
-		struct page	*page;
-		int	ret;
+/* Maximum number of blocks a flush sorts and writes back at a time */
+#define UXU_FLUSH_BATCH_BLOCKS	1024
 
-		page = uxu_get_page(block, page_id, false);
-		if (page == NULL) {
-			printk(KERN_DEBUG "failed to assign pagecache(block: %llx, page_id: %d\n", block->start, page_id);
-			return false;
-		}
-		ret = add_pagecache_to_block(block, page_id, page);
-		if (ret != NV_OK)
-			put_page(page);
-		uvm_page_mask_set(&block->cpu.resident, page_id);
-	}
+static int
+uxu_block_order_cmp(const void *a, const void *b)
+{
+	const uxu_block_order_t	*oa = (const uxu_block_order_t *)a;
+	const uxu_block_order_t	*ob = (const uxu_block_order_t *)b;
 
-	uvm_processor_mask_set(&block->resident, UVM_ID_CPU);
-	return true;
+	if (oa->physical != ob->physical)
+		return oa->physical < ob->physical ? -1 : 1;
+	if (oa->block->start != ob->block->start)
+		return oa->block->start < ob->block->start ? -1 : 1;
+	return 0;
 }
 
-void
-uxu_try_load_block(uvm_va_block_t *block, uvm_va_block_retry_t *block_retry, uvm_service_block_context_t *service_context, uvm_processor_id_t processor_id)
+/**
+ * Get the location on the device of the first page of the block.
+ *
+ * @return: the physical byte offset, or UXU_PHYSICAL_UNKNOWN.
+ */
+static NvU64
+uxu_block_physical(uvm_va_block_t *block)
 {
-	if (block->is_loaded)
-		return;
-	if (uxu_is_volatile_block(block))
-		return;
-	if (uxu_is_read_block(block)) {
-		if (!load_pagecaches_for_block(block))
-			return;
-	}
+	uvm_uxu_extent_t	*extent;
+	pgoff_t	pgoff;
 
-	block->is_loaded = TRUE;
-	uxu_block_mark_recent_in_buffer(block);
+	extent = uxu_block_page_lookup(block, 0, &pgoff, NULL);
+	if (extent == NULL)
+		return UXU_PHYSICAL_UNKNOWN;
+	return uxu_extent_physical(extent, (loff_t)pgoff << PAGE_SHIFT);
 }
 
 /**
@@ -292,10 +3512,12 @@ uxu_try_load_block(uvm_va_block_t *block, uvm_va_block_retry_t *block_retry, uvm
  *
  * @param va_block: the block to be evicted.
  *
+ * @param block_context: scratch context, shared by all the blocks of a flush.
+ *
  * @return: NV_OK on success. NV_ERR_* otherwise.
  */
 static NV_STATUS
-uxu_flush_block(uvm_va_block_t *block)
+uxu_flush_block(uvm_va_block_t *block, uvm_va_block_context_t *block_context)
 {
 	if (!uxu_is_write_block(block))
 		return NV_OK;
@@ -303,21 +3525,19 @@ uxu_flush_block(uvm_va_block_t *block)
 	// Move data from GPU to CPU
 	if (uvm_processor_mask_get_gpu_count(&block->resident) > 0) {
 		uvm_va_block_region_t	region = uvm_va_block_region_from_block(block);
-		uvm_va_block_context_t	*block_context = uvm_va_block_context_alloc();
+		NvU64	start = NV_GETTIME();
+		NvU64	copied;
+		NvU32	cpu_pages;
 		NV_STATUS	status;
 
-		if (!block_context) {
-			printk(KERN_DEBUG "NV_ERR_NO_MEMORY\n");
-			return NV_ERR_NO_MEMORY;
-		}
-
 		uvm_mutex_lock(&block->lock);
+		cpu_pages = uvm_page_mask_weight(&block->cpu.resident);
 		// Move data resided on the GPU to host.
 		status = uvm_va_block_migrate_locked(block, NULL, block_context, region, UVM_ID_CPU, UVM_MIGRATE_MODE_MAKE_RESIDENT, NULL);
+		copied = (NvU64)(uvm_page_mask_weight(&block->cpu.resident) - cpu_pages) << PAGE_SHIFT;
+		uxu_stat_add(block->va_range, UXU_STAT_EVICTION_COPY_BYTES, copied);
 		uvm_mutex_unlock(&block->lock);
 
-		uvm_va_block_context_free(block_context);
-
 		if (status != NV_OK) {
 			printk(KERN_DEBUG "NOT NV_OK\n");
 			return status;
@@ -330,6 +3550,35 @@ uxu_flush_block(uvm_va_block_t *block)
 			printk(KERN_DEBUG "NOT NV_OK\n");
 			return status;
 		}
+
+		uxu_stat_latency(block->va_range, UXU_STAT_LATENCY_FLUSH, start);
+		uvm_tools_record_uxu_flush(block, copied, start);
+	}
+
+	return NV_OK;
+}
+
+/**
+ * Write back a batch of flushed blocks in the order of their location on the
+ * device.
+ *
+ * @param order: the blocks, sorted in place.
+ * @param nr_blocks: number of blocks in `order`.
+ *
+ * @return: NV_OK on success, the status of the first failed write-back
+ * otherwise.
+ */
+static NV_STATUS
+uxu_flush_writeback_ordered(uxu_block_order_t *order, size_t nr_blocks)
+{
+	NV_STATUS	status;
+	size_t	i;
+
+	sort(order, nr_blocks, sizeof(*order), uxu_block_order_cmp, NULL);
+	for (i = 0; i < nr_blocks; i++) {
+		status = uxu_block_writeback(order[i].block, UvmEventUxuWritebackCauseUnmap);
+		if (status != NV_OK)
+			return status;
 	}
 
 	return NV_OK;
@@ -346,29 +3595,101 @@ static NV_STATUS
 uxu_flush(uvm_va_range_t *va_range)
 {
 	NV_STATUS	status = NV_OK;
+	NV_STATUS	writeback_status;
 	uvm_va_block_t	*block, *block_next;
+	uvm_va_block_context_t	*block_context = uvm_va_block_context_alloc();
+	uxu_block_order_t	*order = NULL;
+	size_t	max_nr_blocks = 0, nr_blocks = 0;
+
+	if (!block_context) {
+		printk(KERN_DEBUG "NV_ERR_NO_MEMORY\n");
+		return NV_ERR_NO_MEMORY;
+	}
+
+	// The host buffers are written with synchronous requests, block by
+	// block. They are written in the order of their location on the device,
+	// UXU_FLUSH_BATCH_BLOCKS at a time, so that the write-back of a
+	// fragmented file does not seek back and forth. The file of a compressed
+	// range has no such order. The blocks are written in address order if
+	// there is no memory to sort them.
+	if (uxu_is_hostbuf_range(va_range) && va_range->node.uxu_rtn.container == NULL) {
+		max_nr_blocks = min_t(size_t, uvm_va_range_num_blocks(va_range), UXU_FLUSH_BATCH_BLOCKS);
+		order = uvm_kvmalloc(max_nr_blocks * sizeof(*order));
+	}
 
 	// Evict blocks one by one.
 	for_each_va_block_in_va_range_safe(va_range, block, block_next) {
-		if ((status = uxu_flush_block(block)) != NV_OK) {
+		if ((status = uxu_flush_block(block, block_context)) != NV_OK) {
 			printk(KERN_DEBUG "Encountered a problem with uxu_flush_block\n");
 			break;
 		}
+		if (order) {
+			order[nr_blocks].block = block;
+			order[nr_blocks].physical = uxu_block_physical(block);
+			if (++nr_blocks == max_nr_blocks) {
+				status = uxu_flush_writeback_ordered(order, nr_blocks);
+				nr_blocks = 0;
+				if (status != NV_OK)
+					break;
+			}
+		}
+		else if ((status = uxu_block_writeback(block, UvmEventUxuWritebackCauseUnmap)) != NV_OK) {
+			break;
+		}
+	}
+
+	// The blocks flushed before an error are written back, like they are
+	// when written in address order
+	if (order) {
+		writeback_status = uxu_flush_writeback_ordered(order, nr_blocks);
+		if (status == NV_OK)
+			status = writeback_status;
+		uvm_kvfree(order);
 	}
 
+	uvm_va_block_context_free(block_context);
+
 	return status;
 }
 
+/**
+ * Write back and sync the files of the extents of a range.
+ *
+ * @param extents: extents of a range.
+ * @param nr_extents: number of extents.
+ *
+ * @return: 0 on success, the first error of fsync() otherwise.
+ */
+static int
+uxu_extents_sync(uvm_uxu_extent_t *extents, NvU32 nr_extents)
+{
+	struct blk_plug	plug;
+	int	err = 0;
+	NvU32	i;
+
+	// Start writing back every file before waiting for any, so that the
+	// files of a striped range are written in parallel. The plug lets the
+	// block layer sort and merge the requests of all files.
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_extents; i++)
+		filemap_fdatawrite(extents[i].filp->f_mapping);
+	blk_finish_plug(&plug);
+	for (i = 0; i < nr_extents; i++) {
+		int	ret = vfs_fsync(extents[i].filp, 1);
+
+		if (err == 0)
+			err = ret;
+	}
+	return err;
+}
+
 void
 uxu_block_created(uvm_va_range_t *range, uvm_va_block_t *block)
 {
 	INIT_LIST_HEAD(&block->uxu_lru);
 	if (uvm_is_uxu_range(range)) {
-		uvm_uxu_va_space_t	*uxu_va_space = &range->va_space->uxu_va_space;
-
-                uvm_mutex_lock(&uxu_va_space->lock_blocks);
-                list_move_tail(&block->uxu_lru, &uxu_va_space->lru_head);
-                uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+		uxu_block_mark_recent_in_buffer(block);
+		atomic64_inc(&range->va_space->uxu_va_space.nr_blocks);
 		atomic64_inc(&n_uxu_blks);
 	}
 }
@@ -383,20 +3704,30 @@ uxu_block_created(uvm_va_range_t *range, uvm_va_block_t *block)
 void
 uxu_range_destroyed(uvm_va_range_t *range)
 {
-	struct file	*filp = UXU_FILE_FROM_RANGE(range);
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	NvU32	i;
 
 	if (uxu_is_write_range(range) && !uxu_is_volatile_range(range)) {
 		uxu_flush(range);
-		vfs_fsync(filp, 1);
+		uxu_extents_sync(uxu_rtn->extents, uxu_rtn->nr_extents);
 	}
 
-	fput(filp);
+	uxu_profile_destroy(range);
+	uxu_container_destroy(range);
+	uxu_zpool_drop_range(range);
+	uxu_zpool_free_table(range);
 
-	if (range->blocks) {
+	uxu_extents_put(uxu_rtn->extents, uxu_rtn->nr_extents);
+	uxu_rtn->extents = NULL;
+	uxu_rtn->nr_extents = 0;
+
+	if (range->block_chunks) {
 		uvm_uxu_va_space_t	*uxu_va_space = &range->va_space->uxu_va_space;
 		uvm_va_block_t	*block, *block_tmp;
 		int	n_blks = 0;
 
+		uxu_lru_drain(uxu_va_space);
+
                 uvm_mutex_lock(&uxu_va_space->lock_blocks);
 		for_each_va_block_in_va_range_safe(range, block, block_tmp) {
 			list_del_init(&block->uxu_lru);
@@ -404,69 +3735,260 @@ uxu_range_destroyed(uvm_va_range_t *range)
 		}
                 uvm_mutex_unlock(&uxu_va_space->lock_blocks);
 
+		atomic64_sub(n_blks, &uxu_va_space->nr_blocks);
 		atomic64_sub(n_blks, &n_uxu_blks);
 	}
+
+	free_percpu(range->node.uxu_rtn.stats);
+	range->node.uxu_rtn.stats = NULL;
+	uvm_kvfree(range->node.uxu_rtn.loaded_blocks);
+	range->node.uxu_rtn.loaded_blocks = NULL;
 }
 
 /**
- * Free memory associated with the `va_block`.
+ * Release the UXU state that outlives the ranges of `va_space`.
  *
- * @param va_block: va_block to be freed.
- *
- * @return: always NV_OK;
+ * @param va_space: va_space being destroyed.
  */
-static NV_STATUS
-uxu_release_block(uvm_va_block_t *block)
+void
+uxu_va_space_destroyed(uvm_va_space_t *va_space)
 {
-	uvm_va_block_t	*old;
-	size_t	index;
-	uvm_va_range_t	*range = block->va_range;
+	// The va_space has left the va_spaces list, so no new reference can be
+	// taken. Wait for the reclaim service to be done with it.
+	wait_event(uxu_reclaim_done_wq, atomic_read(&va_space->uxu_va_space.reclaim_refs) == 0);
 
-	if (range == NULL) {
-		/* maybe already destroyed ?? */
-		return NV_OK;
+#if UXU_MEMCG_SUPPORTED
+	if (va_space->uxu_va_space.memcg) {
+		mem_cgroup_put(va_space->uxu_va_space.memcg);
+		va_space->uxu_va_space.memcg = NULL;
+	}
+#endif
+	if (va_space->uxu_va_space.kill_batch) {
+		uvm_va_block_kill_batch_deinit(va_space->uxu_va_space.kill_batch);
+		uvm_kvfree(va_space->uxu_va_space.kill_batch);
+		va_space->uxu_va_space.kill_batch = NULL;
 	}
+	free_percpu(va_space->uxu_va_space.lru_batch);
+	va_space->uxu_va_space.lru_batch = NULL;
+	free_percpu(va_space->uxu_va_space.stats);
+	va_space->uxu_va_space.stats = NULL;
+	uxu_zpool_destroy(&va_space->uxu_va_space);
+	if (va_space->uxu_va_space.is_initailized)
+		uxu_hostbuf_drain(&va_space->uxu_va_space);
+}
+
+/**
+ * Free a block whose data has been written back, see uxu_release_block().
+ * The va_space lock must be held in write mode.
+ */
+static void
+uxu_free_block(uvm_va_block_t *block, uvm_va_block_kill_batch_t *kill_batch, UvmEventUxuBlockReleaseCause cause)
+{
+	uvm_va_block_t	*old;
+	uvm_va_range_t	*range = block->va_range;
+	atomic_long_t	*slot = uvm_va_range_block_slot(range, uvm_va_range_block_index(range, block->start));
 
 	// Remove the block from the list.
-	index = uvm_va_range_block_index(range, block->start);
-	old = (uvm_va_block_t *)nv_atomic_long_cmpxchg(&range->blocks[index], (long)block, (long)NULL);
+	old = (uvm_va_block_t *)nv_atomic_long_cmpxchg(slot, (long)block, (long)NULL);
 
 	// Free the block.
 	if (old == block) {
 		uvm_uxu_va_space_t	*uxu_va_space = &range->va_space->uxu_va_space;
 
+		uxu_stat_add(range, UXU_STAT_BLOCKS_RELEASED, 1);
+		uvm_tools_record_uxu_block_release(block, cause);
+		// Only the blocks whose data is in the files can be reloaded from
+		// the pool
+		if (cause == UvmEventUxuBlockReleaseCauseReclaim)
+			uxu_zpool_store(block);
+
 		uvm_mutex_lock(&uxu_va_space->lock_blocks);
 		list_del_init(&block->uxu_lru);
 		uvm_mutex_unlock(&uxu_va_space->lock_blocks);
 
+		atomic64_dec(&uxu_va_space->nr_blocks);
 		atomic64_dec(&n_uxu_blks);
 
-		uvm_va_block_kill(block);
+		if (kill_batch)
+			uvm_va_block_kill_batch_add(kill_batch, block);
+		else
+			uvm_va_block_kill(block);
+	}
+}
+
+/**
+ * Free memory associated with the `va_block`.
+ *
+ * @param va_block: va_block to be freed.
+ *
+ * @param kill_batch: if not NULL, the block is killed when the batch ends.
+ * The va_space lock must then be held in write mode.
+ *
+ * @param cause: why the block is released, reported to the tools.
+ *
+ * @return: NV_OK on success. NV_ERR_* if the block could not be written
+ * back, it is kept then, since it holds the only copy of its data.
+ */
+static NV_STATUS
+uxu_release_block(uvm_va_block_t *block, uvm_va_block_kill_batch_t *kill_batch, UvmEventUxuBlockReleaseCause cause)
+{
+	atomic_long_t	*slot;
+	uvm_va_range_t	*range = block->va_range;
+	NV_STATUS	status;
+
+	if (range == NULL) {
+		/* maybe already destroyed ?? */
+		return NV_OK;
+	}
+
+	slot = uvm_va_range_block_slot(range, uvm_va_range_block_index(range, block->start));
+	if ((uvm_va_block_t *)atomic_long_read(slot) != block)
+		return NV_OK;
+
+	// Dirty page cache pages are written back by the kernel from now on,
+	// the host buffers and the pages of holes have to be written back
+	// before they are freed.
+	if (uxu_is_write_range(range) && !uxu_is_volatile_range(range)) {
+		status = uxu_block_writeback(block, UvmEventUxuWritebackCauseRelease);
+		if (status != NV_OK) {
+			printk(KERN_DEBUG "Cannot write back the private pages of block %llx\n", block->start);
+			return status;
+		}
 	}
 
+	uxu_free_block(block, kill_batch, cause);
 	return NV_OK;
 }
 
+/* Write-back and release of a reclaimed block, queued on uxu_io_q */
+typedef struct {
+	nv_kthread_q_item_t	q_item;
+	uvm_va_space_t	*va_space;
+	uvm_va_block_t	*block;
+} uvm_uxu_release_t;
+
+/**
+ * Does the block have pages which have to be written back by UXU before it
+ * is freed?
+ */
+static bool
+uxu_block_has_private_writeback(uvm_va_block_t *block)
+{
+	uvm_page_mask_t	mask;
+
+	if (!uxu_is_write_block(block) || uxu_is_volatile_block(block))
+		return false;
+	return uvm_page_mask_andnot(&mask, &block->cpu.resident, &block->cpu.pagecached);
+}
+
+/**
+ * Write back a reclaimed block with the va_space lock held in read mode
+ * only, then release it with the lock held in write mode. The block is
+ * kept if the write-back fails, or if it has been used again in the
+ * meantime: it is back on the LRU list then, and a later sweep reclaims it.
+ *
+ * @param release: the queued release, freed here.
+ */
+static void
+uxu_release_run(uvm_uxu_release_t *release)
+{
+	uvm_va_space_t	*va_space = release->va_space;
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	uvm_va_block_t	*block = release->block;
+	NV_STATUS	status = NV_OK;
+
+	// The block lock keeps the pages of the block from moving during the I/O
+	uvm_va_space_down_read(va_space);
+	if (block->va_range) {
+		uvm_mutex_lock(&block->lock);
+		status = uxu_block_writeback(block, UvmEventUxuWritebackCauseRelease);
+		uvm_mutex_unlock(&block->lock);
+		if (status != NV_OK)
+			printk(KERN_DEBUG "Cannot write back the private pages of block %llx\n", block->start);
+	}
+	uvm_va_space_up_read(va_space);
+
+	uvm_va_space_down_write(va_space);
+	uxu_lru_drain(uxu_va_space);
+	// A block touched since it was queued is back on the LRU list
+	if (block->va_range && list_empty(&block->uxu_lru)) {
+		if (status == NV_OK && uvm_processor_mask_get_gpu_count(&block->resident) == 0) {
+			uxu_free_block(block, NULL, UvmEventUxuBlockReleaseCauseReclaim);
+		}
+		else {
+			uvm_mutex_lock(&uxu_va_space->lock_blocks);
+			list_add(&block->uxu_lru, &uxu_va_space->lru_head);
+			uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+		}
+	}
+	uvm_va_space_up_write(va_space);
+
+	uvm_va_block_release(block);
+	uvm_kvfree(release);
+
+	// As uxu_reclaim_put_victim()
+	if (atomic_dec_and_test(&uxu_va_space->reclaim_refs))
+		wake_up_all(&uxu_reclaim_done_wq);
+}
+
+static void
+uxu_release_run_entry(void *args)
+{
+	UVM_ENTRY_VOID(uxu_release_run(args));
+}
+
+/**
+ * Queue the write-back and the release of a reclaimed block on uxu_io_q,
+ * so that the storage I/O is not done with the va_space lock held in write
+ * mode. The block is taken off the LRU list until then, and the queued
+ * release holds a reclaim reference on the va_space. Must be called with
+ * the va_space lock held in write mode.
+ *
+ * @return: true if the release is queued, false if it has to be done now.
+ */
+static bool
+uxu_release_queue(uvm_va_block_t *block)
+{
+	uvm_va_space_t	*va_space = block->va_range->va_space;
+	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	uvm_uxu_release_t	*release;
+
+	release = uvm_kvmalloc(sizeof(*release));
+	if (release == NULL)
+		return false;
+
+	uvm_mutex_lock(&uxu_va_space->lock_blocks);
+	list_del_init(&block->uxu_lru);
+	uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+
+	uvm_va_block_retain(block);
+	atomic_inc(&uxu_va_space->reclaim_refs);
+	release->va_space = va_space;
+	release->block = block;
+	nv_kthread_q_item_init(&release->q_item, uxu_release_run_entry, release);
+	nv_kthread_q_schedule_q_item(&uxu_io_q, &release->q_item);
+	return true;
+}
+
 /**
- * Automatically reduce memory usage if we need to.
- *
- * @param va_space: va_space that governs this operation.
- * @param force: if true, we will evict some blocks without checking for the memory pressure.
+ * Reclaim the least recently used blocks of `va_space`.
  *
- * @return: NV_OK on success, NV_ERR_* otherwise.
+ * @param va_space: va_space to reclaim blocks from.
  */
 static void
 uxu_reduce_memory_consumption(uvm_va_space_t *va_space)
 {
-	/*
-	 * TODO: locking assertion failed. write lock is required.
-	 */
 	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+	uvm_va_block_kill_batch_t	*kill_batch = uxu_va_space->kill_batch;
 	struct list_head	*lp, *next;
 	unsigned long	n_swapped;
+	NvU64	start = NV_GETTIME();
 
 	uvm_va_space_down_write(va_space);
 
+	// Apply the pending touches so that the scan sees the actual LRU order
+	uxu_lru_drain(uxu_va_space);
+
 	// Reclaim blocks based on least recent transfer.
 
 	n_swapped = 0;
@@ -483,26 +4005,216 @@ uxu_reduce_memory_consumption(uvm_va_space_t *va_space)
 			continue;
 		}
 
-		uxu_release_block(block);
-		n_swapped++;
+		// The private pages are written back without the va_space lock,
+		// the block is released once they are
+		if (uxu_block_has_private_writeback(block) && uxu_release_queue(block)) {
+			n_swapped++;
+			continue;
+		}
+
+		// A block which cannot be written back stays on the list, so that
+		// the write-back is tried again by a later sweep
+		if (uxu_release_block(block, kill_batch, UvmEventUxuBlockReleaseCauseReclaim) == NV_OK)
+			n_swapped++;
 	}
 
+	// One TLB invalidate and wait per GPU for the whole sweep
+	if (kill_batch)
+		uvm_va_block_kill_batch_end(kill_batch);
+
 	uvm_va_space_up_write(va_space);
+
+	if (uxu_va_space->stats) {
+		this_cpu_inc(uxu_va_space->stats->counters[UXU_STAT_REDUCER_SWEEPS]);
+		this_cpu_add(uxu_va_space->stats->counters[UXU_STAT_REDUCER_NS], NV_GETTIME() - start);
+	}
+}
+
+/**
+ * Get the last touch time of the least recently used block of the va_space.
+ *
+ * @param uxu_va_space: the va_space information related to UXU.
+ * @param touched: set to the time (jiffies) the block was last touched.
+ *
+ * @return: false if the va_space has no block on its LRU list.
+ */
+static bool
+uxu_lru_oldest_touch(uvm_uxu_va_space_t *uxu_va_space, unsigned long *touched)
+{
+	bool	found = false;
+
+	uvm_mutex_lock(&uxu_va_space->lock_blocks);
+	if (!list_empty(&uxu_va_space->lru_head)) {
+		*touched = list_first_entry(&uxu_va_space->lru_head, uvm_va_block_t, uxu_lru)->uxu_lru_touched;
+		found = true;
+	}
+	uvm_mutex_unlock(&uxu_va_space->lock_blocks);
+
+	return found;
+}
+
+/**
+ * Pick the va_space to reclaim blocks from, if the system or the memory
+ * cgroup of a va_space is short of memory.
+ *
+ * A va_space whose memory cgroup is close to its limit is reclaimed from
+ * first, since only its own blocks relieve that cgroup. Otherwise, on global
+ * memory pressure, every va_space is entitled to a part of the UXU blocks
+ * proportional to its reclaim share. Among the va_spaces holding more than
+ * their part, the one whose least recently used block is the oldest is
+ * picked, so that the reclaim follows the LRU order across processes. If
+ * none is above its part, the oldest block of all is reclaimed.
+ *
+ * Must be called with g_uvm_global.va_spaces.lock held. The picked va_space
+ * is returned with a reclaim reference, to be dropped with
+ * uxu_reclaim_put_victim().
+ *
+ * @return: the va_space to reclaim from, or NULL if there is nothing to do.
+ */
+static uvm_va_space_t *
+uxu_reclaim_pick_victim(void)
+{
+	uvm_va_space_t	*va_space;
+	uvm_va_space_t	*victim = NULL;
+	bool	victim_memcg_pressure = false;
+	bool	victim_over_share = false;
+	unsigned long	victim_touched = 0;
+	unsigned long	reserved_nr_pages = 0;
+	NvU64	total_blocks = 0;
+	NvU64	total_shares = 0;
+	bool	memcg_pressure = false;
+	bool	global_pressure;
+
+	uvm_assert_mutex_locked(&g_uvm_global.va_spaces.lock);
+
+	list_for_each_entry(va_space, &g_uvm_global.va_spaces.list, list_node) {
+		uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+		NvU64	nr_blocks;
+
+		if (!uxu_va_space->is_initailized)
+			continue;
+
+		nr_blocks = atomic64_read(&uxu_va_space->nr_blocks);
+		reserved_nr_pages = max(reserved_nr_pages, uxu_va_space->reserved_nr_pages);
+		total_blocks += nr_blocks;
+		total_shares += uxu_va_space->reclaim_share;
+		if (nr_blocks > 0 && uxu_memcg_under_pressure(uxu_va_space))
+			memcg_pressure = true;
+	}
+
+	if (total_blocks == 0)
+		return NULL;
+
+	global_pressure = uxu_has_to_reclaim_blocks(reserved_nr_pages);
+	if (!global_pressure && !memcg_pressure)
+		return NULL;
+
+	list_for_each_entry(va_space, &g_uvm_global.va_spaces.list, list_node) {
+		uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+		NvU64	nr_blocks;
+		unsigned long	touched;
+		bool	pressure;
+		bool	over_share;
+
+		if (!uxu_va_space->is_initailized)
+			continue;
+
+		nr_blocks = atomic64_read(&uxu_va_space->nr_blocks);
+		if (nr_blocks == 0)
+			continue;
+
+		pressure = uxu_memcg_under_pressure(uxu_va_space);
+		if (!pressure && !global_pressure)
+			continue;
+
+		if (!uxu_lru_oldest_touch(uxu_va_space, &touched))
+			continue;
+
+		// nr_blocks / total_blocks > reclaim_share / total_shares
+		over_share = nr_blocks * total_shares > total_blocks * uxu_va_space->reclaim_share;
+
+		if (victim == NULL ||
+		    (pressure && !victim_memcg_pressure) ||
+		    (pressure == victim_memcg_pressure && over_share && !victim_over_share) ||
+		    (pressure == victim_memcg_pressure && over_share == victim_over_share &&
+		     time_before(touched, victim_touched))) {
+			victim = va_space;
+			victim_memcg_pressure = pressure;
+			victim_over_share = over_share;
+			victim_touched = touched;
+		}
+	}
+
+	if (victim)
+		atomic_inc(&victim->uxu_va_space.reclaim_refs);
+
+	return victim;
+}
+
+/**
+ * Drop the reclaim reference taken on `victim` by uxu_reclaim_pick_victim().
+ *
+ * @param victim: va_space blocks were reclaimed from.
+ */
+static void
+uxu_reclaim_put_victim(uvm_va_space_t *victim)
+{
+	if (atomic_dec_and_test(&victim->uxu_va_space.reclaim_refs))
+		wake_up_all(&uxu_reclaim_done_wq);
+}
+
+/**
+ * Reclaim blocks from the registered va_spaces until the system is no
+ * longer short of memory, or UXU_RECLAIM_MAX_SWEEPS sweeps have been done.
+ *
+ * The va_spaces list lock is only held to pick each victim. The reference
+ * taken on the victim keeps it from being torn down while its blocks are
+ * reclaimed.
+ *
+ * @return: true if the sweeps ran out while memory may still be short.
+ */
+static bool
+uxu_reclaim(void)
+{
+	uvm_va_space_t	*victim;
+	unsigned int	n_sweeps;
+
+	for (n_sweeps = 0; n_sweeps < UXU_RECLAIM_MAX_SWEEPS; n_sweeps++) {
+		uvm_mutex_lock(&g_uvm_global.va_spaces.lock);
+		victim = uxu_reclaim_pick_victim();
+		uvm_mutex_unlock(&g_uvm_global.va_spaces.lock);
+
+		if (victim == NULL)
+			return false;
+
+		uxu_reduce_memory_consumption(victim);
+		uxu_reclaim_put_victim(victim);
+	}
+
+	return true;
 }
 
+/**
+ * Node-wide reclaim service. A single thread reclaims for all the UXU
+ * va_spaces, instead of one per process competing for the same memory.
+ * It sleeps until uxu_reclaim_kick() reports a shortage.
+ */
 static int
-pagecache_reducer(void *ctx)
+uxu_reclaim_service(void *ctx)
 {
-	uvm_va_space_t	*va_space = (uvm_va_space_t *)ctx;
-	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
 	uvm_thread_context_wrapper_t	thread_context;
 
 	uvm_thread_context_add(&thread_context.context);
 
 	while (!kthread_should_stop()) {
-		if (uxu_has_to_reclaim_blocks(uxu_va_space))
-			uxu_reduce_memory_consumption(va_space);
-		schedule_timeout_idle(10);
+		wait_event_interruptible(uxu_reclaim_wq,
+					 atomic_xchg(&uxu_reclaim_pending, 0) || kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		// Keep going without waiting for a new kick while memory is short
+		while (uxu_reclaim() && !kthread_should_stop())
+			cond_resched();
 	}
 
 	uvm_thread_context_remove(&thread_context.context);
@@ -526,11 +4238,16 @@ pagecache_reducer(void *ctx)
  * @param flags: the flags that dictate the optimization behaviors. See
  * UVM_UXU_INIT_* for more details.
  *
+ * @param reclaim_share: relative part of the UXU blocks this va_space is
+ * entitled to when the reclaim service has to free memory. 0 selects
+ * UXU_DEFAULT_RECLAIM_SHARE.
+ *
  * @return: NV_ERR_INVALID_OPERATION if `va_space` has been initialized already,
  * otherwise NV_OK.
  */
 static NV_STATUS
-uxu_initialize(uvm_va_space_t *va_space, unsigned long swapout_nr_blocks, unsigned long reserved_nr_pages, unsigned short flags)
+uxu_initialize(uvm_va_space_t *va_space, unsigned long swapout_nr_blocks, unsigned long reserved_nr_pages, unsigned short flags,
+	       unsigned int reclaim_share)
 {
 	uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
 
@@ -544,15 +4261,97 @@ uxu_initialize(uvm_va_space_t *va_space, unsigned long swapout_nr_blocks, unsign
 		uxu_va_space->swapout_nr_blocks = swapout_nr_blocks;
 		uxu_va_space->reserved_nr_pages = reserved_nr_pages;
 		uxu_va_space->flags = flags;
+		uxu_va_space->reclaim_share = reclaim_share ? reclaim_share : UXU_DEFAULT_RECLAIM_SHARE;
+		atomic64_set(&uxu_va_space->nr_blocks, 0);
+		atomic64_set(&uxu_va_space->nr_host_pages, 0);
+#if UXU_MEMCG_SUPPORTED
+		uxu_va_space->memcg = get_mem_cgroup_from_mm(current->mm);
+#endif
+		uxu_va_space->pid = task_tgid_nr(current);
+		uvm_spin_lock_init(&uxu_va_space->hostbuf_lock, UVM_LOCK_ORDER_LEAF);
+		INIT_LIST_HEAD(&uxu_va_space->hostbuf_free);
+		// Without the per-CPU buffers the LRU list is updated on every touch
+		uxu_va_space->lru_batch = alloc_percpu(uvm_uxu_lru_batch_t);
+		if (uxu_va_space->lru_batch) {
+			int	cpu;
+
+			for_each_possible_cpu(cpu)
+				uvm_spin_lock_init(&per_cpu_ptr(uxu_va_space->lru_batch, cpu)->lock, UVM_LOCK_ORDER_LEAF);
+		}
+		// Statistics are best effort. UXU works without them.
+		uxu_va_space->stats = alloc_percpu(uvm_uxu_stats_t);
+		uxu_zpool_create(uxu_va_space);
+
+		// Without a batch, the reclaimed blocks are simply killed one by one
+		uxu_va_space->kill_batch = uvm_kvmalloc(sizeof(*uxu_va_space->kill_batch));
+		if (uxu_va_space->kill_batch &&
+		    uvm_va_block_kill_batch_init(uxu_va_space->kill_batch, va_space, swapout_nr_blocks) != NV_OK) {
+			uvm_va_block_kill_batch_deinit(uxu_va_space->kill_batch);
+			uvm_kvfree(uxu_va_space->kill_batch);
+			uxu_va_space->kill_batch = NULL;
+		}
+
+		// From now on the reclaim service takes this va_space into account
+		uvm_mutex_lock(&g_uvm_global.va_spaces.lock);
 		uxu_va_space->is_initailized = true;
+		uvm_mutex_unlock(&g_uvm_global.va_spaces.lock);
 
-		uxu_va_space->reducer = kthread_run(pagecache_reducer, va_space, "reducer");
 		return NV_OK;
 	}
 	else
 		return NV_ERR_INVALID_OPERATION;
 }
 
+/**
+ * Duplicate the data of a read-only range on every processor reading it, and
+ * collapse the copies back once the range is mapped for writing. Each GPU then
+ * serves its faults from its own copy while the pages on the CPU remain the
+ * source of all of them.
+ *
+ * mmap_sem is taken before the va_space lock, so the range is looked up
+ * again once both are held: it may have been unmapped since its flags were
+ * set.
+ *
+ * @param va_space: va_space of the range.
+ * @param address: start of the uxu va range whose flags have been set.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static NV_STATUS
+uxu_range_update_read_duplication(uvm_va_space_t *va_space, NvU64 address)
+{
+	uvm_va_range_t	*range;
+	uvm_read_duplication_policy_t	policy;
+	NV_STATUS	status = NV_OK;
+
+	// CPU mappings may be created while the copies are set up
+	uvm_down_read_mmap_sem(&current->mm->mmap_sem);
+	uvm_va_space_down_write(va_space);
+
+	range = uvm_va_range_find(va_space, address);
+	if (!range || !uvm_is_uxu_range(range)) {
+		status = NV_ERR_INVALID_ADDRESS;
+		goto out;
+	}
+
+	policy = uxu_is_write_range(range) ? UVM_READ_DUPLICATION_DISABLED : UVM_READ_DUPLICATION_ENABLED;
+	if (range->read_duplication != policy) {
+		if (uvm_va_space_can_read_duplicate(va_space, NULL)) {
+			if (policy == UVM_READ_DUPLICATION_ENABLED)
+				status = uvm_va_range_set_read_duplication(range);
+			else
+				(void)uvm_va_range_unset_read_duplication(range);
+		}
+		if (status == NV_OK)
+			range->read_duplication = policy;
+	}
+
+out:
+	uvm_va_space_up_write(va_space);
+	uvm_up_read_mmap_sem(&current->mm->mmap_sem);
+	return status;
+}
+
 /**
  * Register a file to this `va_space`.
  * UXU will start tracking this UVM region if this function return success.
@@ -571,6 +4370,8 @@ uxu_map(uvm_va_space_t *va_space, UVM_UXU_MAP_PARAMS *params)
 	NvU64	expected_start_addr = (NvU64)params->uvm_addr;
 	NvU64	expected_end_addr = expected_start_addr + params->size - 1;
 	size_t	max_nr_blocks;
+	unsigned short	flags = params->flags;
+	NV_STATUS	status;
 
 	// Make sure that uxu_initialize is called before this function.
 	if (!va_space->uxu_va_space.is_initailized) {
@@ -593,28 +4394,153 @@ uxu_map(uvm_va_space_t *va_space, UVM_UXU_MAP_PARAMS *params)
 
 	uxu_rtn = &node->uxu_rtn;
 
-	// Get the struct file from the input file descriptor.
-	if ((uxu_rtn->filp = fget(params->backing_fd)) == NULL) {
-		printk(KERN_DEBUG "Cannot find the backing fd: %d\n", params->backing_fd);
-		return NV_ERR_OPERATING_SYSTEM;
+	// Chunks are decompressed into host buffers, never into the page cache
+	if (flags & UVM_UXU_FLAG_COMPRESSED)
+		flags |= UVM_UXU_FLAG_USEHOSTBUF;
+
+	// Get the files backing the range.
+	status = uxu_extents_get(params, &uxu_rtn->extents, &uxu_rtn->nr_extents);
+	if (status != NV_OK)
+		return status;
+	uxu_rtn->filp = uxu_rtn->extents[0].filp;
+	uxu_rtn->stripe_unit = params->stripe_unit;
+
+	// The host buffers are transferred with the I/O methods of the files
+	if (flags & UVM_UXU_FLAG_USEHOSTBUF) {
+		NvU32	i;
+
+		for (i = 0; i < uxu_rtn->nr_extents; i++) {
+			struct file	*filp = uxu_rtn->extents[i].filp;
+
+			if (!filp->f_op->read_iter || ((flags & UVM_UXU_FLAG_WRITE) && !filp->f_op->write_iter)) {
+				printk(KERN_DEBUG "Error: extent %u cannot back a host buffer\n", i);
+				uxu_extents_put(uxu_rtn->extents, uxu_rtn->nr_extents);
+				uxu_rtn->extents = NULL;
+				uxu_rtn->nr_extents = 0;
+				uxu_rtn->filp = NULL;
+				return NV_ERR_NOT_SUPPORTED;
+			}
+		}
+		if (flags & UVM_UXU_FLAG_COMPRESSED) {
+			status = uxu_container_open(container_of(node, uvm_va_range_t, node), params->size);
+			if (status != NV_OK) {
+				uxu_extents_put(uxu_rtn->extents, uxu_rtn->nr_extents);
+				uxu_rtn->extents = NULL;
+				uxu_rtn->nr_extents = 0;
+				uxu_rtn->filp = NULL;
+				return status;
+			}
+		}
+		uxu_hostbuf_reserve(va_space, (params->size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+		uxu_hostbuf_fill(va_space);
 	}
 
 	// Record the flags and the file size.
-	uxu_rtn->flags = params->flags;
+	uxu_rtn->flags = flags;
 	uxu_rtn->size = params->size;
 
 	// Calculate the number of blocks associated with this UVM range.
 	max_nr_blocks = uvm_va_range_num_blocks(container_of(node, uvm_va_range_t, node));
 
+	// Statistics are best effort. Mapping works without them.
+	uxu_rtn->stats = alloc_percpu(uvm_uxu_stats_t);
+	uxu_rtn->loaded_blocks = uvm_kvmalloc_zero(BITS_TO_LONGS(max_nr_blocks) * sizeof(unsigned long));
+
+	// The compressed block pool is best effort too. Only the blocks read
+	// from storage into host buffers are worth keeping, the chunks of the
+	// table are allocated by uxu_zpool_store().
+	if (va_space->uxu_va_space.zpool && (flags & UVM_UXU_FLAG_READ) && (flags & UVM_UXU_FLAG_USEHOSTBUF) &&
+	    !(flags & UVM_UXU_FLAG_VOLATILE))
+		uxu_rtn->zentries = uvm_kvmalloc_zero(DIV_ROUND_UP(max_nr_blocks, UVM_VA_RANGE_BLOCKS_PER_CHUNK) *
+						      sizeof(*uxu_rtn->zentries));
+
+	// Recording a profile is best effort. Mapping works without it. The
+	// profile is kept in the backing file, so it needs a single one. Its
+	// warm up fills the page cache, which host buffers do not use.
+	if ((flags & UVM_UXU_FLAG_PROFILE) &&
+	    !(flags & (UVM_UXU_FLAG_VOLATILE | UVM_UXU_FLAG_USEHOSTBUF)) &&
+	    uxu_rtn->nr_extents == 1) {
+		if (uxu_profile_create(container_of(node, uvm_va_range_t, node)) != NV_OK)
+			printk(KERN_DEBUG "Cannot record the uxu access profile\n");
+	}
+
+	// Read duplication only spreads the faults over the GPUs. Mapping works
+	// without it.
+	if (uxu_range_update_read_duplication(va_space, node->start) != NV_OK)
+		printk(KERN_DEBUG "Cannot read duplicate the uxu range\n");
+
 	return NV_OK;
 }
 
+/**
+ * Read the physical layout of the files of a range again, since the remapped
+ * files may have been rewritten. The layouts are read without the va_space
+ * lock, since bmap() may write back dirty data, from a copy of the extents
+ * holding their own file references. They are swapped in only if the range
+ * still has the same extents once the lock is taken again.
+ *
+ * @param va_space: va_space of the range.
+ * @param address: start of the remapped uxu range.
+ */
+static void
+uxu_range_refresh_layout(uvm_va_space_t *va_space, NvU64 address)
+{
+	uvm_va_range_t	*va_range;
+	uvm_uxu_range_tree_node_t	*uxu_rtn;
+	uvm_uxu_extent_t	*extents = NULL;
+	NvU32	nr_extents = 0;
+	NvU32	i;
+
+	uvm_va_space_down_read(va_space);
+	va_range = uvm_va_range_find(va_space, address);
+	if (va_range && uvm_is_uxu_range(va_range)) {
+		uxu_rtn = &va_range->node.uxu_rtn;
+		extents = uvm_kvmalloc(uxu_rtn->nr_extents * sizeof(*extents));
+		if (extents) {
+			nr_extents = uxu_rtn->nr_extents;
+			memcpy(extents, uxu_rtn->extents, nr_extents * sizeof(*extents));
+			for (i = 0; i < nr_extents; i++) {
+				get_file(extents[i].filp);
+				extents[i].seek_filp = NULL;
+			}
+		}
+	}
+	uvm_va_space_up_read(va_space);
+
+	if (extents == NULL)
+		return;
+
+	for (i = 0; i < nr_extents; i++)
+		extents[i].fiemap = uxu_layout_read(extents[i].filp, extents[i].offset, extents[i].length);
+
+	uvm_va_space_down_write(va_space);
+	va_range = uvm_va_range_find(va_space, address);
+	if (va_range && uvm_is_uxu_range(va_range) && va_range->node.uxu_rtn.nr_extents == nr_extents) {
+		uxu_rtn = &va_range->node.uxu_rtn;
+		for (i = 0; i < nr_extents; i++) {
+			if (uxu_rtn->extents[i].filp != extents[i].filp ||
+			    uxu_rtn->extents[i].offset != extents[i].offset ||
+			    uxu_rtn->extents[i].length != extents[i].length)
+				break;
+		}
+		if (i == nr_extents) {
+			for (i = 0; i < nr_extents; i++)
+				swap(uxu_rtn->extents[i].fiemap, extents[i].fiemap);
+		}
+	}
+	uvm_va_space_up_write(va_space);
+
+	// Drops the old layouts, or the new ones if the range has changed
+	uxu_extents_put(extents, nr_extents);
+}
+
 static NV_STATUS
 uxu_remap(uvm_va_space_t *va_space, UVM_UXU_REMAP_PARAMS *params)
 {
-	uvm_va_range_t	*va_range = uvm_va_range_find(va_space, (NvU64)params->uvm_addr);
+	uvm_va_range_t	*va_range;
 	uvm_va_block_t	*block, *block_next;
 	NvU64	expected_start_addr = (NvU64)params->uvm_addr;
+	NV_STATUS	status = NV_OK;
 
 	// Make sure that uxu_initialize is called before this function.
 	if (!va_space->uxu_va_space.is_initailized) {
@@ -622,18 +4548,35 @@ uxu_remap(uvm_va_space_t *va_space, UVM_UXU_REMAP_PARAMS *params)
 		return NV_ERR_INVALID_OPERATION;
 	}
 
+	// Blocks are taken off the LRU list, which needs the drain and the
+	// releases to exclude the fault paths
+	uvm_va_space_down_write(va_space);
+
+	va_range = uvm_va_range_find(va_space, expected_start_addr);
 	if (!va_range || va_range->node.start != expected_start_addr) {
 		printk(KERN_DEBUG "Cannot find uvm whose address starts from 0x%llx\n", expected_start_addr);
 		if (va_range)
 			printk(KERN_DEBUG "Closet uvm range 0x%llx - 0x%llx\n", va_range->node.start, va_range->node.end);
+		uvm_va_space_up_write(va_space);
 		return NV_ERR_OPERATING_SYSTEM;
 	}
 
-	if (uxu_is_write_block(block)) {
-		// Volatile data is simply discarded even though it has been remapped with non-volatile
+	// The data of the range may be changed behind the pool from now on
+	uxu_zpool_drop_range(va_range);
+
+	if (uxu_is_write_range(va_range)) {
+		uxu_lru_drain(&va_space->uxu_va_space);
+
+		// Volatile data is simply discarded even though it has been remapped with non-volatile.
+		// The blocks which cannot be written back keep their data, and the
+		// first failure is reported.
 		for_each_va_block_in_va_range_safe(va_range, block, block_next) {
+			NV_STATUS	block_status;
+
 			block->is_dirty = false;
-			uxu_release_block(block);
+			block_status = uxu_release_block(block, NULL, UvmEventUxuBlockReleaseCauseRemap);
+			if (status == NV_OK)
+				status = block_status;
 		}
 	}
 	else {
@@ -641,16 +4584,100 @@ uxu_remap(uvm_va_space_t *va_space, UVM_UXU_REMAP_PARAMS *params)
 			block->is_dirty = false;
 	}
 
-	va_range->node.uxu_rtn.flags = params->flags;
+	// The pages of the blocks are freed according to the mapping mode, and
+	// the file of a compressed range cannot be read as is, so neither can be
+	// changed.
+	va_range->node.uxu_rtn.flags = (params->flags & ~(UVM_UXU_FLAG_USEHOSTBUF | UVM_UXU_FLAG_COMPRESSED)) |
+				       (va_range->node.uxu_rtn.flags & (UVM_UXU_FLAG_USEHOSTBUF | UVM_UXU_FLAG_COMPRESSED));
 
-	return NV_OK;
+	uvm_va_space_up_write(va_space);
+
+	// The range may be unmapped as soon as the va_space lock is dropped, so
+	// it is only known by its address from now on
+	uxu_range_refresh_layout(va_space, expected_start_addr);
+
+	// mmap_sem is taken before the va_space lock
+	if (uxu_range_update_read_duplication(va_space, expected_start_addr) != NV_OK)
+		printk(KERN_DEBUG "Cannot read duplicate the uxu range\n");
+
+	return status;
+}
+
+/**
+ * Write the data of a writable range back to its files, as when it is
+ * unmapped, without unmapping it. The blocks resident on the GPUs are
+ * migrated to the CPU, so the GPUs have to be done with the range. The
+ * files are synced without the va_space lock, with references taken on
+ * them, since the range may be unmapped once the lock is dropped.
+ *
+ * @param va_space: va_space of the range.
+ * @param address: start of the range.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise. Write-back errors recorded
+ * in the files, by UXU or by the kernel, are reported too.
+ */
+static NV_STATUS
+uxu_flush_range(uvm_va_space_t *va_space, NvU64 address)
+{
+	uvm_va_range_t	*va_range;
+	uvm_uxu_range_tree_node_t	*uxu_rtn;
+	uvm_uxu_extent_t	*extents = NULL;
+	NvU32	nr_extents = 0;
+	NvU32	i;
+	NV_STATUS	status = NV_OK;
+	int	err;
+
+	if (!va_space->uxu_va_space.is_initailized) {
+		printk(KERN_DEBUG "Error: Call uxu_flush before uxu_initialize\n");
+		return NV_ERR_INVALID_OPERATION;
+	}
+
+	uvm_va_space_down_write(va_space);
+
+	va_range = uvm_va_range_find(va_space, address);
+	if (!va_range || !uvm_is_uxu_range(va_range) || va_range->node.start != address) {
+		printk(KERN_DEBUG "Cannot find uxu range whose address starts from 0x%llx\n", address);
+		uvm_va_space_up_write(va_space);
+		return NV_ERR_INVALID_ADDRESS;
+	}
+
+	uxu_rtn = &va_range->node.uxu_rtn;
+	if (uxu_is_write_range(va_range) && !uxu_is_volatile_range(va_range)) {
+		status = uxu_flush(va_range);
+
+		extents = uvm_kvmalloc(uxu_rtn->nr_extents * sizeof(*extents));
+		if (extents) {
+			nr_extents = uxu_rtn->nr_extents;
+			memcpy(extents, uxu_rtn->extents, nr_extents * sizeof(*extents));
+			for (i = 0; i < nr_extents; i++) {
+				get_file(extents[i].filp);
+				extents[i].seek_filp = NULL;
+				extents[i].fiemap = NULL;
+			}
+		}
+		else if (status == NV_OK) {
+			status = NV_ERR_NO_MEMORY;
+		}
+	}
+
+	uvm_va_space_up_write(va_space);
+
+	if (extents == NULL)
+		return status;
+
+	err = uxu_extents_sync(extents, nr_extents);
+	if (status == NV_OK && err != 0)
+		status = errno_to_nv_status(err);
+	uxu_extents_put(extents, nr_extents);
+	return status;
 }
 
 NV_STATUS
 uvm_api_uxu_initialize(UVM_UXU_INITIALIZE_PARAMS *params, struct file *filp)
 {
 	uvm_va_space_t *va_space = uvm_va_space_get(filp);
-	return uxu_initialize(va_space, params->swapout_nr_blocks, params->reserved_nr_pages, params->flags);
+	return uxu_initialize(va_space, params->swapout_nr_blocks, params->reserved_nr_pages, params->flags,
+			      params->reclaim_share);
 }
 
 NV_STATUS
@@ -670,13 +4697,178 @@ uvm_api_uxu_remap(UVM_UXU_REMAP_PARAMS *params, struct file *filp)
 	return uxu_remap(va_space, params);
 }
 
+NV_STATUS
+uvm_api_uxu_flush(UVM_UXU_FLUSH_PARAMS *params, struct file *filp)
+{
+	uvm_va_space_t *va_space = uvm_va_space_get(filp);
+	return uxu_flush_range(va_space, (NvU64)params->uvm_addr);
+}
+
+/**
+ * Print the I/O of every file of a striped range, so that an imbalance
+ * between the devices is visible.
+ *
+ * @param s: seq_file to print to.
+ *
+ * @param range: uxu va range. Nothing is printed if it is not striped.
+ */
+static void
+uxu_stripes_print(struct seq_file *s, uvm_va_range_t *range)
+{
+	uvm_uxu_range_tree_node_t	*uxu_rtn = &range->node.uxu_rtn;
+	NvU32	i;
+
+	if (uxu_rtn->stripe_unit == 0)
+		return;
+
+	UVM_SEQ_OR_DBG_PRINT(s, "    stripe_unit %llu\n", uxu_rtn->stripe_unit);
+	for (i = 0; i < uxu_rtn->nr_extents; i++) {
+		uvm_uxu_extent_t	*extent = &uxu_rtn->extents[i];
+		dev_t	dev = extent->filp->f_mapping->host->i_sb->s_dev;
+
+		UVM_SEQ_OR_DBG_PRINT(s, "    stripe %u dev %u:%u read_bytes %lld writeback_bytes %lld\n",
+				     i, MAJOR(dev), MINOR(dev),
+				     (long long)atomic64_read(&extent->read_bytes),
+				     (long long)atomic64_read(&extent->writeback_bytes));
+	}
+}
+
+/**
+ * Print the per-cpu `stats` summed over all cpus.
+ *
+ * @param s: seq_file to print to.
+ *
+ * @param stats: per-cpu statistics. Nothing is printed if NULL.
+ *
+ * @param indent: prefix of every printed line.
+ */
+static void
+uxu_stats_print(struct seq_file *s, uvm_uxu_stats_t __percpu *stats, const char *indent)
+{
+	uvm_uxu_stats_t	sum;
+	int	cpu, i, j;
+
+	if (stats == NULL)
+		return;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		uvm_uxu_stats_t	*cpu_stats = per_cpu_ptr(stats, cpu);
+
+		for (i = 0; i < UXU_STAT_COUNT; i++)
+			sum.counters[i] += cpu_stats->counters[i];
+		for (i = 0; i < UXU_STAT_LATENCY_COUNT; i++)
+			for (j = 0; j < UXU_STAT_LATENCY_BUCKETS; j++)
+				sum.latency[i][j] += cpu_stats->latency[i][j];
+	}
+
+	for (i = 0; i < UXU_STAT_COUNT; i++)
+		UVM_SEQ_OR_DBG_PRINT(s, "%s%-24s %llu\n", indent, uxu_stat_names[i], sum.counters[i]);
+
+	for (i = 0; i < UXU_STAT_LATENCY_COUNT; i++) {
+		UVM_SEQ_OR_DBG_PRINT(s, "%s%s\n", indent, uxu_stat_latency_names[i]);
+		for (j = 0; j < UXU_STAT_LATENCY_BUCKETS; j++) {
+			if (sum.latency[i][j] == 0)
+				continue;
+			UVM_SEQ_OR_DBG_PRINT(s, "%s    <%-10llu %llu\n", indent, 1ULL << (j + 1), sum.latency[i][j]);
+		}
+	}
+}
+
+/**
+ * Print the occupancy, compression ratio and hit rate of a compressed block
+ * pool.
+ *
+ * @param s: seq_file to print to.
+ * @param zpool: pool of a va_space, may be NULL.
+ */
+static void
+uxu_zpool_print(struct seq_file *s, uvm_uxu_zpool_t *zpool)
+{
+	size_t	size, orig_size;
+	unsigned long	nr_entries;
+	NvU64	hits, misses;
+
+	if (zpool == NULL)
+		return;
+
+	uvm_spin_lock(&zpool->lock);
+	size = zpool->size;
+	orig_size = zpool->orig_size;
+	nr_entries = zpool->nr_entries;
+	uvm_spin_unlock(&zpool->lock);
+	hits = atomic64_read(&zpool->hits);
+	misses = atomic64_read(&zpool->misses);
+
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_max_bytes %zu\n", zpool->max_size);
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_bytes %zu\n", size);
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_orig_bytes %zu\n", orig_size);
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_blocks %lu\n", nr_entries);
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_ratio_pct %llu\n", size ? (NvU64)orig_size * 100 / size : 0);
+	UVM_SEQ_OR_DBG_PRINT(s, "  zpool_hit_pct %llu\n", hits + misses ? hits * 100 / (hits + misses) : 0);
+}
+
 static int
 nv_procfs_read_uxu_stats(struct seq_file *s, void *v)
 {
+	uvm_va_space_t	*va_space;
+
 	if (!uvm_down_read_trylock(&g_uvm_global.pm.lock))
 		return -EAGAIN;
 
-	UVM_SEQ_OR_DBG_PRINT(s, "cezanne     %llu\n", (NvU64)atomic64_read(&n_uxu_blks));
+	UVM_SEQ_OR_DBG_PRINT(s, "blocks     %llu\n", (NvU64)atomic64_read(&n_uxu_blks));
+
+	uvm_mutex_lock(&g_uvm_global.va_spaces.lock);
+
+	list_for_each_entry(va_space, &g_uvm_global.va_spaces.list, list_node) {
+		uvm_uxu_va_space_t	*uxu_va_space = &va_space->uxu_va_space;
+		uvm_va_range_t	*va_range;
+
+		if (!uxu_va_space->is_initailized)
+			continue;
+
+		UVM_SEQ_OR_DBG_PRINT(s, "va_space pid %d\n", uxu_va_space->pid);
+		UVM_SEQ_OR_DBG_PRINT(s, "  reclaim_share %u\n", uxu_va_space->reclaim_share);
+		UVM_SEQ_OR_DBG_PRINT(s, "  resident_blocks %lld\n", (long long)atomic64_read(&uxu_va_space->nr_blocks));
+		UVM_SEQ_OR_DBG_PRINT(s, "  host_pages %lld\n", (long long)atomic64_read(&uxu_va_space->nr_host_pages));
+		UVM_SEQ_OR_DBG_PRINT(s, "  hostbuf_pool_pages %lu\n", READ_ONCE(uxu_va_space->hostbuf_nr_pages));
+		UVM_SEQ_OR_DBG_PRINT(s, "  hostbuf_free_pages %lu\n", READ_ONCE(uxu_va_space->hostbuf_nr_free));
+		uxu_zpool_print(s, uxu_va_space->zpool);
+#if UXU_MEMCG_SUPPORTED
+		if (uxu_va_space->memcg) {
+			struct mem_cgroup	*memcg = uxu_va_space->memcg;
+
+			UVM_SEQ_OR_DBG_PRINT(s, "  memcg_id %u\n", (unsigned)mem_cgroup_id(memcg));
+			UVM_SEQ_OR_DBG_PRINT(s, "  memcg_usage_pages %lu\n", page_counter_read(&memcg->memory));
+#if defined(NV_MEM_CGROUP_GET_MAX_PRESENT)
+			UVM_SEQ_OR_DBG_PRINT(s, "  memcg_max_pages %lu\n", mem_cgroup_get_max(memcg));
+#endif
+			UVM_SEQ_OR_DBG_PRINT(s, "  memcg_pressure %u\n", uxu_memcg_under_pressure(uxu_va_space) ? 1 : 0);
+		}
+#endif
+		uxu_stats_print(s, uxu_va_space->stats, "  ");
+
+		uvm_va_space_down_read(va_space);
+
+		uvm_for_each_va_range(va_range, va_space) {
+			NvU64	predictions, hits, prefetch_pages;
+
+			if (!uvm_is_uxu_range(va_range))
+				continue;
+
+			UVM_SEQ_OR_DBG_PRINT(s, "  range 0x%llx-0x%llx\n", va_range->node.start, va_range->node.end);
+			uxu_stats_print(s, va_range->node.uxu_rtn.stats, "    ");
+			uvm_perf_stride_range_stats(va_range, &predictions, &hits, &prefetch_pages);
+			UVM_SEQ_OR_DBG_PRINT(s, "    %-24s %llu\n", "stride_predictions", predictions);
+			UVM_SEQ_OR_DBG_PRINT(s, "    %-24s %llu\n", "stride_hits", hits);
+			UVM_SEQ_OR_DBG_PRINT(s, "    %-24s %llu\n", "stride_prefetch_pages", prefetch_pages);
+			uxu_stripes_print(s, va_range);
+		}
+
+		uvm_va_space_up_read(va_space);
+	}
+
+	uvm_mutex_unlock(&g_uvm_global.va_spaces.lock);
 
 	uvm_up_read(&g_uvm_global.pm.lock);
 
@@ -697,15 +4889,45 @@ NV_STATUS
 uxu_init(void)
 {
 	struct proc_dir_entry	*cpu_base_dir_entry = uvm_procfs_get_cpu_base_dir();
+	NV_STATUS	status;
 
         procfs_entry_uxu = NV_CREATE_PROC_FILE(UXU_STATS_PROC_ENTRY_NAME, cpu_base_dir_entry, uxu_stats_entry, NULL);
         if (procfs_entry_uxu == NULL)
 		return NV_ERR_OPERATING_SYSTEM;
+
+	status = errno_to_nv_status(nv_kthread_q_init(&uxu_warmup_q, "UVM UXU warmup"));
+	if (status != NV_OK) {
+		uvm_procfs_destroy_entry(procfs_entry_uxu);
+		return status;
+	}
+
+	status = errno_to_nv_status(nv_kthread_q_init(&uxu_io_q, "UVM UXU I/O"));
+	if (status != NV_OK) {
+		nv_kthread_q_stop(&uxu_warmup_q);
+		uvm_procfs_destroy_entry(procfs_entry_uxu);
+		return status;
+	}
+
+	uxu_reclaimer = kthread_run(uxu_reclaim_service, NULL, "UVM UXU reclaim");
+	if (IS_ERR(uxu_reclaimer)) {
+		status = errno_to_nv_status(PTR_ERR(uxu_reclaimer));
+		uxu_reclaimer = NULL;
+		nv_kthread_q_stop(&uxu_io_q);
+		nv_kthread_q_stop(&uxu_warmup_q);
+		uvm_procfs_destroy_entry(procfs_entry_uxu);
+		return status;
+	}
 	return NV_OK;
 }
 
 void
 uxu_exit(void)
 {
+	if (uxu_reclaimer) {
+		kthread_stop(uxu_reclaimer);
+		uxu_reclaimer = NULL;
+	}
+	nv_kthread_q_stop(&uxu_io_q);
+	nv_kthread_q_stop(&uxu_warmup_q);
 	uvm_procfs_destroy_entry(procfs_entry_uxu);
 }
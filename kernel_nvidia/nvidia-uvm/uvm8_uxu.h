@@ -11,23 +11,32 @@
 #define UVM_UXU_FLAG_CREATE      0x04
 #define UVM_UXU_FLAG_DONTTRASH   0x08
 #define UVM_UXU_FLAG_VOLATILE    0x10
-/* Not used. UXU always uses host buffer(page cache). */
+/* Back the blocks with private pinned pages filled and drained with direct I/O instead of the page cache. */
 #define UVM_UXU_FLAG_USEHOSTBUF  0x20
+/* Record the block access order in the backing file and warm up from it on the next map. */
+#define UVM_UXU_FLAG_PROFILE     0x40
+/* The file is a container of compressed chunks, decompressed into host buffers. Implies USEHOSTBUF. */
+#define UVM_UXU_FLAG_COMPRESSED  0x80
 
 NV_STATUS uxu_init(void);
 void uxu_exit(void);
 
 void uxu_block_created(uvm_va_range_t *range, uvm_va_block_t *block);
 void uxu_range_destroyed(uvm_va_range_t *range);
+void uxu_va_space_destroyed(uvm_va_space_t *va_space);
 
-void uxu_try_load_block(uvm_va_block_t *block,
-			uvm_va_block_retry_t *block_retry,
-			uvm_service_block_context_t *service_context,
-			uvm_processor_id_t processor_id);
+NV_STATUS uxu_try_load_block(uvm_va_block_t *block,
+			     uvm_va_block_retry_t *block_retry,
+			     uvm_service_block_context_t *service_context,
+			     uvm_processor_id_t processor_id);
+void uxu_wait_block_io(uvm_va_block_t *block);
+NV_STATUS uxu_io_batch_create(uvm_uxu_io_batch_t **pbatch);
+void uxu_io_batch_destroy(uvm_uxu_io_batch_t *batch);
+void uxu_io_batch_submit(uvm_uxu_io_batch_t *batch);
+void uxu_prefetch_address(uvm_va_range_t *range, NvU64 address);
 
 struct page *uxu_get_page(uvm_va_block_t *block, uvm_page_index_t page_index, bool zero);
-
-void stop_pagecache_reducer(uvm_va_space_t *va_space);
+void uxu_hostbuf_put(uvm_va_space_t *va_space, struct page *page);
 
 /**
  * Is this va_range managed by uxu driver?
@@ -66,8 +75,22 @@ uxu_check_block_flag(uvm_va_block_t *block, unsigned short flag)
 #define uxu_is_read_block(block)	uxu_check_block_flag(block, UVM_UXU_FLAG_READ)
 #define uxu_is_write_block(block)	uxu_check_block_flag(block, UVM_UXU_FLAG_WRITE)
 #define uxu_is_volatile_block(block)	uxu_check_block_flag(block, UVM_UXU_FLAG_VOLATILE)
+#define uxu_is_hostbuf_block(block)	uxu_check_block_flag(block, UVM_UXU_FLAG_USEHOSTBUF)
+
+/**
+ * Account host pages added to or removed from a uxu block.
+ *
+ * @param block: uxu block the pages belong to.
+ * @param nr_pages: number of pages added, negative when they are removed.
+ */
+static inline void
+uxu_host_pages_add(uvm_va_block_t *block, long nr_pages)
+{
+	atomic64_add(nr_pages, &block->va_range->va_space->uxu_va_space.nr_host_pages);
+}
 
 #define uxu_is_write_range(range)	uxu_check_range_flag(range, UVM_UXU_FLAG_WRITE)
 #define uxu_is_volatile_range(block)	uxu_check_range_flag(range, UVM_UXU_FLAG_VOLATILE)
+#define uxu_is_hostbuf_range(range)	uxu_check_range_flag(range, UVM_UXU_FLAG_USEHOSTBUF)
 
 #endif
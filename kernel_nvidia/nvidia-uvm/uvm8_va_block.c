@@ -38,6 +38,7 @@
 #include "uvm8_mem.h"
 #include "uvm8_gpu_access_counters.h"
 #include "uvm8_test_ioctl.h"
+#include "uvm8_procfs.h"
 #include "uvm8_va_block_uxu.h"
 
 typedef enum
@@ -49,10 +50,16 @@ typedef enum
 
 static NvU64 uvm_perf_authorized_cpu_fault_tracking_window_ns = 300000;
 
-static struct kmem_cache *g_uvm_va_block_cache __read_mostly;
+// VA blocks, their CPU page arrays and block contexts are allocated and freed
+// at a high rate when UXU reclaims blocks and they fault back in, so they come
+// from dedicated pools. CPU page arrays are only pooled for full-size blocks,
+// and they are kept zeroed while in the pool: block_kill clears each entry as
+// it frees the page.
+static uvm_kvmalloc_pool_t g_uvm_va_block_pool;
+static uvm_kvmalloc_pool_t g_uvm_va_block_cpu_pages_pool;
+static uvm_kvmalloc_pool_t g_uvm_va_block_context_pool;
 static struct kmem_cache *g_uvm_va_block_gpu_state_cache __read_mostly;
 static struct kmem_cache *g_uvm_page_mask_cache __read_mostly;
-static struct kmem_cache *g_uvm_va_block_context_cache __read_mostly;
 
 static int uvm_fault_force_sysmem __read_mostly = 0;
 module_param(uvm_fault_force_sysmem, int, S_IRUGO|S_IWUSR);
@@ -213,15 +220,106 @@ static block_phys_page_t block_phys_page(uvm_processor_id_t processor, uvm_page_
     return (block_phys_page_t){ processor, page_index };
 }
 
+// Report of the host memory used to track VA blocks
+static struct proc_dir_entry *g_va_block_memory_procfs_file;
+
+static int nv_procfs_read_va_block_memory(struct seq_file *s, void *v)
+{
+    uvm_va_block_memory_usage_t usage;
+    uvm_va_space_t *va_space;
+    NvU64 metadata_bytes;
+    NvU64 ratio_ppm = 0;
+
+    if (!uvm_down_read_trylock(&g_uvm_global.pm.lock))
+        return -EAGAIN;
+
+    memset(&usage, 0, sizeof(usage));
+
+    uvm_mutex_lock(&g_uvm_global.va_spaces.lock);
+
+    list_for_each_entry(va_space, &g_uvm_global.va_spaces.list, list_node) {
+        uvm_va_range_t *va_range;
+
+        uvm_va_space_down_read(va_space);
+
+        uvm_for_each_va_range(va_range, va_space) {
+            uvm_va_block_t *va_block;
+
+            if (va_range->type != UVM_VA_RANGE_TYPE_MANAGED)
+                continue;
+
+            usage.block_table_bytes += uvm_va_range_block_table_size(va_range);
+
+            for_each_va_block_in_va_range(va_range, va_block) {
+                uvm_mutex_lock(&va_block->lock);
+                uvm_va_block_add_memory_usage(va_block, &usage);
+                uvm_mutex_unlock(&va_block->lock);
+            }
+        }
+
+        uvm_va_space_up_read(va_space);
+    }
+
+    uvm_mutex_unlock(&g_uvm_global.va_spaces.lock);
+
+    metadata_bytes = usage.block_bytes +
+                     usage.cpu_pages_bytes +
+                     usage.gpu_state_bytes +
+                     usage.dma_addrs_bytes +
+                     usage.perf_bytes +
+                     usage.block_table_bytes;
+
+    if (usage.data_bytes)
+        ratio_ppm = div64_u64(metadata_bytes * 1000000, usage.data_bytes);
+
+    UVM_SEQ_OR_DBG_PRINT(s, "blocks                %llu\n", usage.num_blocks);
+    UVM_SEQ_OR_DBG_PRINT(s, "data_bytes            %llu\n", usage.data_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "metadata_bytes        %llu\n", metadata_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  block               %llu\n", usage.block_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  cpu_pages           %llu\n", usage.cpu_pages_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  gpu_state           %llu\n", usage.gpu_state_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  dma_addrs           %llu\n", usage.dma_addrs_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  perf                %llu\n", usage.perf_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "  block_tables        %llu\n", usage.block_table_bytes);
+    UVM_SEQ_OR_DBG_PRINT(s, "metadata_per_data     %llu.%06llu\n", ratio_ppm / 1000000, ratio_ppm % 1000000);
+
+    uvm_kvmalloc_pools_print(s);
+
+    uvm_up_read(&g_uvm_global.pm.lock);
+
+    return 0;
+}
+
+static int nv_procfs_read_va_block_memory_entry(struct seq_file *s, void *v)
+{
+    UVM_ENTRY_RET(nv_procfs_read_va_block_memory(s, v));
+}
+
+UVM_DEFINE_SINGLE_PROCFS_FILE(va_block_memory_entry);
+
+static void block_cpu_pages_ctor(void *p)
+{
+    memset(p, 0, PAGES_PER_UVM_VA_BLOCK * sizeof(struct page *));
+}
+
 NV_STATUS uvm_va_block_init(void)
 {
+    NV_STATUS status;
+
     if (uvm_enable_builtin_tests)
-        g_uvm_va_block_cache = NV_KMEM_CACHE_CREATE("uvm_va_block_wrapper_t", uvm_va_block_wrapper_t);
+        status = uvm_kvmalloc_pool_create(&g_uvm_va_block_pool, "uvm_va_block_wrapper_t", sizeof(uvm_va_block_wrapper_t), NULL);
     else
-        g_uvm_va_block_cache = NV_KMEM_CACHE_CREATE("uvm_va_block_t", uvm_va_block_t);
+        status = uvm_kvmalloc_pool_create(&g_uvm_va_block_pool, "uvm_va_block_t", sizeof(uvm_va_block_t), NULL);
 
-    if (!g_uvm_va_block_cache)
-        return NV_ERR_NO_MEMORY;
+    if (status != NV_OK)
+        return status;
+
+    status = uvm_kvmalloc_pool_create(&g_uvm_va_block_cpu_pages_pool,
+                                      "uvm_va_block_cpu_pages",
+                                      PAGES_PER_UVM_VA_BLOCK * sizeof(struct page *),
+                                      block_cpu_pages_ctor);
+    if (status != NV_OK)
+        return status;
 
     g_uvm_va_block_gpu_state_cache = NV_KMEM_CACHE_CREATE("uvm_va_block_gpu_state_t", uvm_va_block_gpu_state_t);
     if (!g_uvm_va_block_gpu_state_cache)
@@ -231,24 +329,38 @@ NV_STATUS uvm_va_block_init(void)
     if (!g_uvm_page_mask_cache)
         return NV_ERR_NO_MEMORY;
 
-    g_uvm_va_block_context_cache = NV_KMEM_CACHE_CREATE("uvm_va_block_context_t", uvm_va_block_context_t);
-    if (!g_uvm_va_block_context_cache)
-        return NV_ERR_NO_MEMORY;
+    status = uvm_kvmalloc_pool_create(&g_uvm_va_block_context_pool,
+                                      "uvm_va_block_context_t",
+                                      sizeof(uvm_va_block_context_t),
+                                      NULL);
+    if (status != NV_OK)
+        return status;
+
+    g_va_block_memory_procfs_file = NV_CREATE_PROC_FILE("va_block_memory",
+                                                        uvm_procfs_get_cpu_base_dir(),
+                                                        va_block_memory_entry,
+                                                        NULL);
+    if (!g_va_block_memory_procfs_file)
+        return NV_ERR_OPERATING_SYSTEM;
 
     return NV_OK;
 }
 
 void uvm_va_block_exit(void)
 {
-    kmem_cache_destroy_safe(&g_uvm_va_block_context_cache);
+    uvm_procfs_destroy_entry(g_va_block_memory_procfs_file);
+    g_va_block_memory_procfs_file = NULL;
+
+    uvm_kvmalloc_pool_destroy(&g_uvm_va_block_context_pool);
     kmem_cache_destroy_safe(&g_uvm_page_mask_cache);
     kmem_cache_destroy_safe(&g_uvm_va_block_gpu_state_cache);
-    kmem_cache_destroy_safe(&g_uvm_va_block_cache);
+    uvm_kvmalloc_pool_destroy(&g_uvm_va_block_cpu_pages_pool);
+    uvm_kvmalloc_pool_destroy(&g_uvm_va_block_pool);
 }
 
 uvm_va_block_context_t *uvm_va_block_context_alloc(void)
 {
-    uvm_va_block_context_t *block_context = kmem_cache_alloc(g_uvm_va_block_context_cache, NV_UVM_GFP_FLAGS);
+    uvm_va_block_context_t *block_context = uvm_kvmalloc_pool_alloc(&g_uvm_va_block_context_pool);
     if (block_context)
         uvm_va_block_context_init(block_context);
 
@@ -257,8 +369,33 @@ uvm_va_block_context_t *uvm_va_block_context_alloc(void)
 
 void uvm_va_block_context_free(uvm_va_block_context_t *va_block_context)
 {
-    if (va_block_context)
-        kmem_cache_free(g_uvm_va_block_context_cache, va_block_context);
+    uvm_kvmalloc_pool_free(&g_uvm_va_block_context_pool, va_block_context);
+}
+
+// Allocate a zeroed CPU page array for a block of the given size
+static struct page **block_cpu_pages_alloc(uvm_va_block_t *block, NvU64 size)
+{
+    if (size == UVM_VA_BLOCK_SIZE) {
+        block->cpu.pages_pooled = 1;
+        return uvm_kvmalloc_pool_alloc(&g_uvm_va_block_cpu_pages_pool);
+    }
+
+    block->cpu.pages_pooled = 0;
+    return uvm_kvmalloc_zero((size / PAGE_SIZE) * sizeof(block->cpu.pages[0]));
+}
+
+// Pooled arrays must be returned with all their entries cleared
+static void block_cpu_pages_free(uvm_va_block_t *block)
+{
+    if (block->cpu.pages_pooled) {
+        UVM_ASSERT(!memchr_inv(block->cpu.pages, 0, PAGES_PER_UVM_VA_BLOCK * sizeof(block->cpu.pages[0])));
+        uvm_kvmalloc_pool_free(&g_uvm_va_block_cpu_pages_pool, block->cpu.pages);
+    }
+    else {
+        uvm_kvfree(block->cpu.pages);
+    }
+
+    block->cpu.pages = NULL;
 }
 
 static uvm_va_block_gpu_state_t *block_gpu_state_get(uvm_va_block_t *block, uvm_gpu_id_t gpu_id)
@@ -483,6 +620,50 @@ uvm_gpu_chunk_t *uvm_va_block_lookup_gpu_chunk(uvm_va_block_t *va_block, uvm_gpu
     return gpu_state->chunks[chunk_index];
 }
 
+void uvm_va_block_add_memory_usage(uvm_va_block_t *va_block, uvm_va_block_memory_usage_t *usage)
+{
+    uvm_page_index_t page_index;
+    uvm_gpu_id_t id;
+
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    ++usage->num_blocks;
+    usage->block_bytes += uvm_enable_builtin_tests ? sizeof(uvm_va_block_wrapper_t) : sizeof(uvm_va_block_t);
+
+    if (va_block->cpu.pages) {
+        usage->cpu_pages_bytes += uvm_va_block_num_cpu_pages(va_block) * sizeof(va_block->cpu.pages[0]);
+
+        for_each_va_block_page(page_index, va_block) {
+            if (va_block->cpu.pages[page_index])
+                usage->data_bytes += PAGE_SIZE;
+        }
+    }
+
+    for_each_gpu_id(id) {
+        uvm_va_block_gpu_state_t *gpu_state = block_gpu_state_get(va_block, id);
+        uvm_gpu_t *gpu;
+        size_t i, num_chunks;
+
+        if (!gpu_state)
+            continue;
+
+        gpu = block_get_gpu(va_block, id);
+        num_chunks = block_num_gpu_chunks(va_block, gpu);
+
+        usage->gpu_state_bytes += sizeof(*gpu_state) + num_chunks * sizeof(gpu_state->chunks[0]);
+        if (gpu_state->cpu_pages_dma_addrs)
+            usage->dma_addrs_bytes += uvm_va_block_num_cpu_pages(va_block) * sizeof(gpu_state->cpu_pages_dma_addrs[0]);
+
+        for (i = 0; i < num_chunks; i++) {
+            if (gpu_state->chunks[i])
+                usage->data_bytes += uvm_gpu_chunk_get_size(gpu_state->chunks[i]);
+        }
+    }
+
+    usage->perf_bytes += uvm_perf_prefetch_block_memory_usage(va_block);
+    usage->perf_bytes += uvm_perf_thrashing_block_memory_usage(va_block);
+}
+
 NV_STATUS uvm_va_block_create(uvm_va_range_t *va_range,
                               NvU64 start,
                               NvU64 end,
@@ -505,13 +686,13 @@ NV_STATUS uvm_va_block_create(uvm_va_range_t *va_range,
     UVM_ASSERT(UVM_VA_BLOCK_ALIGN_DOWN(start) == UVM_VA_BLOCK_ALIGN_DOWN(end));
 
     if (uvm_enable_builtin_tests) {
-        uvm_va_block_wrapper_t *block_wrapper = nv_kmem_cache_zalloc(g_uvm_va_block_cache, NV_UVM_GFP_FLAGS);
+        uvm_va_block_wrapper_t *block_wrapper = uvm_kvmalloc_pool_alloc_zero(&g_uvm_va_block_pool);
 
         if (block_wrapper)
             block = &block_wrapper->block;
     }
     else {
-        block = nv_kmem_cache_zalloc(g_uvm_va_block_cache, NV_UVM_GFP_FLAGS);
+        block = uvm_kvmalloc_pool_alloc_zero(&g_uvm_va_block_pool);
     }
 
     if (!block) {
@@ -528,7 +709,7 @@ NV_STATUS uvm_va_block_create(uvm_va_range_t *va_range,
 
     nv_kthread_q_item_init(&block->eviction_mappings_q_item, block_deferred_eviction_mappings_entry, block);
 
-    block->cpu.pages = uvm_kvmalloc_zero((size / PAGE_SIZE) * sizeof(block->cpu.pages[0]));
+    block->cpu.pages = block_cpu_pages_alloc(block, size);
     if (!block->cpu.pages) {
         status = NV_ERR_NO_MEMORY;
         goto error;
@@ -542,11 +723,27 @@ error:
     return status;
 }
 
+NV_STATUS uvm_va_block_gpu_state_alloc_dma_addrs(uvm_va_block_t *block, uvm_va_block_gpu_state_t *gpu_state)
+{
+    if (gpu_state->cpu_pages_dma_addrs)
+        return NV_OK;
+
+    gpu_state->cpu_pages_dma_addrs = uvm_kvmalloc_zero(uvm_va_block_num_cpu_pages(block) *
+                                                       sizeof(gpu_state->cpu_pages_dma_addrs[0]));
+    if (!gpu_state->cpu_pages_dma_addrs)
+        return NV_ERR_NO_MEMORY;
+
+    return NV_OK;
+}
+
 static void block_gpu_unmap_phys_all_cpu_pages(uvm_va_block_t *block, uvm_gpu_t *gpu)
 {
     uvm_page_index_t page_index;
     uvm_va_block_gpu_state_t *gpu_state = block_gpu_state_get(block, gpu->id);
 
+    if (!gpu_state->cpu_pages_dma_addrs)
+        return;
+
     for_each_va_block_page(page_index, block) {
         if (gpu_state->cpu_pages_dma_addrs[page_index] == 0)
             continue;
@@ -569,6 +766,10 @@ static NV_STATUS block_gpu_map_phys_all_cpu_pages(uvm_va_block_t *block, uvm_gpu
         if (!block->cpu.pages[page_index])
             continue;
 
+        status = uvm_va_block_gpu_state_alloc_dma_addrs(block, gpu_state);
+        if (status != NV_OK)
+            goto error;
+
         status = uvm_gpu_map_cpu_page(gpu, block->cpu.pages[page_index], &gpu_state->cpu_pages_dma_addrs[page_index]);
         if (status != NV_OK)
             goto error;
@@ -701,10 +902,6 @@ static uvm_va_block_gpu_state_t *block_gpu_state_get_alloc(uvm_va_block_t *block
     if (!gpu_state->chunks)
         goto error;
 
-    gpu_state->cpu_pages_dma_addrs = uvm_kvmalloc_zero(uvm_va_block_num_cpu_pages(block) * sizeof(gpu_state->cpu_pages_dma_addrs[0]));
-    if (!gpu_state->cpu_pages_dma_addrs)
-        goto error;
-
     block->gpus[uvm_id_gpu_index(gpu->id)] = gpu_state;
 
     status = block_gpu_map_phys_all_cpu_pages(block, gpu);
@@ -717,6 +914,7 @@ error:
     if (gpu_state) {
         if (gpu_state->chunks)
             uvm_kvfree(gpu_state->chunks);
+        uvm_kvfree(gpu_state->cpu_pages_dma_addrs);
         kmem_cache_free(g_uvm_va_block_gpu_state_cache, gpu_state);
     }
     block->gpus[uvm_id_gpu_index(gpu->id)] = NULL;
@@ -731,7 +929,7 @@ static void block_unmap_phys_cpu_page_on_gpus(uvm_va_block_t *block, uvm_page_in
     for_each_gpu_id(id) {
         uvm_gpu_t *gpu;
         uvm_va_block_gpu_state_t *gpu_state = block_gpu_state_get(block, id);
-        if (!gpu_state)
+        if (!gpu_state || !gpu_state->cpu_pages_dma_addrs)
             continue;
 
         if (gpu_state->cpu_pages_dma_addrs[page_index] == 0)
@@ -762,6 +960,10 @@ static NV_STATUS block_map_phys_cpu_page_on_gpus(uvm_va_block_t *block, uvm_page
         if (!gpu_state)
             continue;
 
+        status = uvm_va_block_gpu_state_alloc_dma_addrs(block, gpu_state);
+        if (status != NV_OK)
+            goto error;
+
         UVM_ASSERT(gpu_state->cpu_pages_dma_addrs[page_index] == 0);
 
         gpu = block_get_gpu(block, id);
@@ -1980,10 +2182,12 @@ static uvm_gpu_phys_address_t block_phys_page_address(uvm_va_block_t *block,
     UVM_ASSERT(accessing_gpu_state);
 
     if (UVM_ID_IS_CPU(block_page.processor)) {
-        NvU64 dma_addr = accessing_gpu_state->cpu_pages_dma_addrs[block_page.page_index];
+        NvU64 dma_addr;
 
         // The page should be mapped for physical access already as we do that
         // eagerly on CPU page population and GPU state alloc.
+        UVM_ASSERT(accessing_gpu_state->cpu_pages_dma_addrs);
+        dma_addr = accessing_gpu_state->cpu_pages_dma_addrs[block_page.page_index];
         UVM_ASSERT(dma_addr != 0);
 
         return uvm_gpu_phys_address(UVM_APERTURE_SYS, dma_addr);
@@ -4463,6 +4667,33 @@ static void block_gpu_pte_finish_split_2m(uvm_va_block_t *block,
     uvm_tlb_batch_end(tlb_batch, push, UVM_MEMBAR_NONE);
 }
 
+// Ends the TLB batch of an unmap of the whole block. If the unmap is part of a
+// kill batch, the invalidates are deferred to uvm_va_block_kill_batch_end and
+// true is returned.
+static bool block_unmap_tlb_batch_end(uvm_va_block_context_t *block_context,
+                                      uvm_gpu_t *gpu,
+                                      uvm_push_t *push,
+                                      uvm_membar_t tlb_membar)
+{
+    uvm_va_block_kill_batch_t *kill_batch = block_context->mapping.kill_batch;
+    uvm_tlb_batch_t *tlb_batch = &block_context->mapping.tlb_batch;
+    uvm_tlb_batch_t *deferred_batch;
+
+    if (!kill_batch) {
+        uvm_tlb_batch_end(tlb_batch, push, tlb_membar);
+        return false;
+    }
+
+    deferred_batch = &kill_batch->tlb_batches[uvm_id_gpu_index(gpu->id)];
+    if (!uvm_processor_mask_test(&kill_batch->tlb_pending, gpu->id)) {
+        uvm_tlb_batch_begin(tlb_batch->tree, deferred_batch);
+        uvm_processor_mask_set(&kill_batch->tlb_pending, gpu->id);
+    }
+
+    uvm_tlb_batch_merge(deferred_batch, tlb_batch, tlb_membar);
+    return true;
+}
+
 // Switches any mix of valid or invalid 4k or 64k PTEs to an invalid 2M PTE.
 // Any lower PTEs are invalidated with the specified membar.
 static void block_gpu_pte_merge_2m(uvm_va_block_t *block,
@@ -4505,7 +4736,12 @@ static void block_gpu_pte_merge_2m(uvm_va_block_t *block,
 
     uvm_tlb_batch_begin(tree, tlb_batch);
     uvm_tlb_batch_invalidate(tlb_batch, block->start, UVM_PAGE_SIZE_2M, tlb_inval_sizes, UVM_MEMBAR_NONE);
-    uvm_tlb_batch_end(tlb_batch, push, tlb_membar);
+
+    // Blocks being killed in a batch are not poisoned, since the poisoning
+    // would have to wait for the deferred TLB invalidate. Their page tables
+    // are freed right after it.
+    if (block_unmap_tlb_batch_end(block_context, gpu, push, tlb_membar))
+        return;
 
     // As a guard against bad PTE writes/TLB invalidates, fill the now-unused
     // PTEs with a pattern which will trigger fatal faults on access. We have to
@@ -5087,7 +5323,7 @@ static void block_gpu_unmap_to_2m(uvm_va_block_t *block,
         block_gpu_pte_clear_2m(block, gpu, pte_batch, tlb_batch);
 
         uvm_pte_batch_end(pte_batch);
-        uvm_tlb_batch_end(tlb_batch, push, tlb_membar);
+        block_unmap_tlb_batch_end(block_context, gpu, push, tlb_membar);
     }
     else {
         // Otherwise we have a mix of big and 4K PTEs which need to be merged
@@ -7712,7 +7948,10 @@ void uvm_va_block_unregister_gpu(uvm_va_block_t *va_block, uvm_gpu_t *gpu)
 // the initial kill itself, then again when the block's ref count is eventually
 // destroyed. block->va_range is used to track whether the block has already
 // been killed.
-static void block_kill(uvm_va_block_t *block)
+//
+// If kill_batch is not NULL, the CPU pages are handed over to the batch to be
+// released later, as long as it has room for them.
+static void block_kill(uvm_va_block_t *block, uvm_va_block_kill_batch_t *kill_batch)
 {
     uvm_va_range_t *va_range = block->va_range;
     uvm_va_space_t *va_space;
@@ -7757,29 +7996,51 @@ static void block_kill(uvm_va_block_t *block)
     // Free CPU pages
     if (block->cpu.pages) {
         uvm_page_index_t page_index;
+        long num_pages_freed = 0;
+
         for_each_va_block_page(page_index, block) {
-            if (block->cpu.pages[page_index]) {
+            struct page *page = block->cpu.pages[page_index];
+
+            if (page) {
+                bool pagecached = uvm_page_mask_test(&block->cpu.pagecached, page_index);
+
+                num_pages_freed++;
+
                 // be conservative.
                 // Tell the OS we wrote to the page because we sometimes clear the dirty bit after writing to it.
-                if (uvm_page_mask_test(&block->cpu.pagecached, page_index)) {
-                    put_page(block->cpu.pages[page_index]);
-                    continue;
-                }
-                SetPageDirty(block->cpu.pages[page_index]);
-                __free_page(block->cpu.pages[page_index]);
+                if (!pagecached)
+                    SetPageDirty(page);
+
+                // Page cache references and our own pages are both dropped
+                // with put_page by the deferred release. The GPUs are done
+                // with the pages at this point, so the private host buffers
+                // of UXU can be reused right away.
+                if (!pagecached && uvm_is_uxu_range(va_range) && uxu_is_hostbuf_range(va_range))
+                    uxu_hostbuf_put(va_space, page);
+                else if (kill_batch && kill_batch->num_pages < kill_batch->max_pages)
+                    kill_batch->pages[kill_batch->num_pages++] = page;
+                else if (pagecached)
+                    put_page(page);
+                else
+                    __free_page(page);
+
+                block->cpu.pages[page_index] = NULL;
             }
             else {
                 UVM_ASSERT(!uvm_page_mask_test(&block->cpu.resident, page_index));
             }
         }
 
+        if (uvm_is_uxu_range(va_range))
+            uxu_host_pages_add(block, -num_pages_freed);
+
         // Clearing the resident bit isn't strictly necessary since this block
         // is getting destroyed, but it keeps state consistent for assertions.
         uvm_page_mask_zero(&block->cpu.resident);
         uvm_page_mask_zero(&block->cpu.pagecached);
         block_clear_resident_processor(block, UVM_ID_CPU);
 
-        uvm_kvfree(block->cpu.pages);
+        block_cpu_pages_free(block);
     }
     else {
         UVM_ASSERT(!uvm_processor_mask_test(&block->resident, UVM_ID_CPU));
@@ -7797,29 +8058,225 @@ void uvm_va_block_destroy(nv_kref_t *nv_kref)
     uvm_assert_mutex_unlocked(&block->lock);
 
     uvm_mutex_lock(&block->lock);
-    block_kill(block);
+    block_kill(block, NULL);
     uvm_mutex_unlock(&block->lock);
 
     if (uvm_enable_builtin_tests) {
         uvm_va_block_wrapper_t *block_wrapper = container_of(block, uvm_va_block_wrapper_t, block);
 
-        kmem_cache_free(g_uvm_va_block_cache, block_wrapper);
+        uvm_kvmalloc_pool_free(&g_uvm_va_block_pool, block_wrapper);
     }
     else {
-        kmem_cache_free(g_uvm_va_block_cache, block);
+        uvm_kvmalloc_pool_free(&g_uvm_va_block_pool, block);
     }
 }
 
 void uvm_va_block_kill(uvm_va_block_t *va_block)
 {
     uvm_mutex_lock(&va_block->lock);
-    block_kill(va_block);
+    block_kill(va_block, NULL);
     uvm_mutex_unlock(&va_block->lock);
 
     // May call block_kill again
     uvm_va_block_release(va_block);
 }
 
+NV_STATUS uvm_va_block_kill_batch_init(uvm_va_block_kill_batch_t *batch, uvm_va_space_t *va_space, size_t max_blocks)
+{
+    memset(batch, 0, sizeof(*batch));
+
+    batch->va_space = va_space;
+    uvm_tracker_init(&batch->tracker);
+
+    batch->blocks = uvm_kvmalloc(max_blocks * sizeof(batch->blocks[0]));
+    if (!batch->blocks)
+        return NV_ERR_NO_MEMORY;
+
+    batch->max_blocks = max_blocks;
+
+    return NV_OK;
+}
+
+void uvm_va_block_kill_batch_deinit(uvm_va_block_kill_batch_t *batch)
+{
+    UVM_ASSERT(batch->num_blocks == 0);
+    UVM_ASSERT(batch->num_pages == 0);
+
+    uvm_tracker_deinit(&batch->tracker);
+    uvm_kvfree(batch->blocks);
+    uvm_kvfree(batch->pages);
+}
+
+// Make room for all the CPU pages of the block in the batch. On failure the
+// pages are simply freed by block_kill.
+static void block_kill_batch_reserve_pages(uvm_va_block_kill_batch_t *batch, uvm_va_block_t *va_block)
+{
+    size_t needed = batch->num_pages + uvm_va_block_num_cpu_pages(va_block);
+    size_t new_max;
+    struct page **new_pages;
+
+    if (needed <= batch->max_pages)
+        return;
+
+    new_max = max(needed, 2 * batch->max_pages);
+    new_pages = uvm_kvrealloc(batch->pages, new_max * sizeof(batch->pages[0]));
+    if (!new_pages)
+        return;
+
+    batch->pages = new_pages;
+    batch->max_pages = new_max;
+}
+
+void uvm_va_block_kill_batch_add(uvm_va_block_kill_batch_t *batch, uvm_va_block_t *va_block)
+{
+    uvm_va_block_context_t *block_context = uvm_va_space_block_context(batch->va_space);
+    NV_STATUS status;
+
+    uvm_assert_rwsem_locked_write(&batch->va_space->lock);
+
+    if (batch->num_blocks == batch->max_blocks) {
+        uvm_va_block_kill(va_block);
+        return;
+    }
+
+    block_kill_batch_reserve_pages(batch, va_block);
+
+    uvm_mutex_lock(&va_block->lock);
+
+    if (va_block->va_range && !uvm_processor_mask_empty(&va_block->mapped)) {
+        UVM_ASSERT(va_block->va_range->va_space == batch->va_space);
+
+        // Same as in block_kill, but the TLB invalidates are deferred to
+        // uvm_va_block_kill_batch_end.
+        block_context->mapping.kill_batch = batch;
+        status = uvm_va_block_unmap_mask(va_block,
+                                         block_context,
+                                         &va_block->mapped,
+                                         uvm_va_block_region_from_block(va_block),
+                                         NULL);
+        block_context->mapping.kill_batch = NULL;
+        UVM_ASSERT(status == uvm_global_get_status());
+    }
+
+    // This only fails on allocation failures, in which case the block's
+    // tracker has already been waited on.
+    (void)uvm_tracker_add_tracker_safe(&batch->tracker, &va_block->tracker);
+
+    uvm_mutex_unlock(&va_block->lock);
+
+    batch->blocks[batch->num_blocks++] = va_block;
+}
+
+typedef struct
+{
+    nv_kthread_q_item_t q_item;
+
+    struct page **pages;
+    size_t num_pages;
+} block_deferred_page_release_t;
+
+static void block_release_pages(struct page **pages, size_t num_pages)
+{
+    size_t i;
+
+    for (i = 0; i < num_pages; i++)
+        put_page(pages[i]);
+}
+
+static void block_deferred_page_release_entry(void *args)
+{
+    block_deferred_page_release_t *release = (block_deferred_page_release_t *)args;
+
+    block_release_pages(release->pages, release->num_pages);
+
+    uvm_kvfree(release->pages);
+    uvm_kvfree(release);
+}
+
+// Hand the CPU pages of the killed blocks over to the global queue. If that's
+// not possible, they are released right away.
+static void block_kill_batch_release_pages(uvm_va_block_kill_batch_t *batch)
+{
+    block_deferred_page_release_t *release;
+
+    if (batch->num_pages == 0)
+        return;
+
+    release = uvm_kvmalloc(sizeof(*release));
+    if (!release) {
+        block_release_pages(batch->pages, batch->num_pages);
+        batch->num_pages = 0;
+        return;
+    }
+
+    release->pages = batch->pages;
+    release->num_pages = batch->num_pages;
+
+    batch->pages = NULL;
+    batch->num_pages = 0;
+    batch->max_pages = 0;
+
+    nv_kthread_q_item_init(&release->q_item, block_deferred_page_release_entry, release);
+    nv_kthread_q_schedule_q_item(&g_uvm_global.global_q, &release->q_item);
+}
+
+void uvm_va_block_kill_batch_end(uvm_va_block_kill_batch_t *batch)
+{
+    uvm_gpu_id_t id;
+    NV_STATUS status;
+    size_t i;
+
+    uvm_assert_rwsem_locked_write(&batch->va_space->lock);
+
+    // One TLB invalidate per GPU for all the blocks, ordered after all their
+    // PTE clears.
+    for_each_gpu_id_in_mask(id, &batch->tlb_pending) {
+        uvm_gpu_t *gpu = uvm_va_space_get_gpu(batch->va_space, id);
+        uvm_push_t push;
+
+        status = uvm_push_begin_acquire(gpu->channel_manager,
+                                        UVM_CHANNEL_TYPE_MEMOPS,
+                                        &batch->tracker,
+                                        &push,
+                                        "Invalidating TLBs for %zu killed blocks",
+                                        batch->num_blocks);
+        if (status != NV_OK) {
+            UVM_ASSERT(status == uvm_global_get_status());
+            break;
+        }
+
+        uvm_tlb_batch_end(&batch->tlb_batches[uvm_id_gpu_index(id)], &push, UVM_MEMBAR_NONE);
+        uvm_push_end(&push);
+
+        (void)uvm_tracker_add_push_safe(&batch->tracker, &push);
+    }
+
+    uvm_processor_mask_zero(&batch->tlb_pending);
+
+    status = uvm_tracker_wait(&batch->tracker);
+    if (status != NV_OK)
+        UVM_ASSERT(status == uvm_global_get_status());
+
+    uvm_tracker_clear(&batch->tracker);
+
+    // The blocks are all unmapped, so killing them doesn't push any more TLB
+    // invalidates.
+    for (i = 0; i < batch->num_blocks; i++) {
+        uvm_va_block_t *va_block = batch->blocks[i];
+
+        uvm_mutex_lock(&va_block->lock);
+        block_kill(va_block, batch);
+        uvm_mutex_unlock(&va_block->lock);
+
+        // May call block_kill again
+        uvm_va_block_release(va_block);
+    }
+
+    batch->num_blocks = 0;
+
+    block_kill_batch_release_pages(batch);
+}
+
 // Deswizzle the split point, if it's covered and populated by a big page on
 // this gpu.
 static NV_STATUS block_split_presplit_deswizzle_gpu(uvm_va_block_t *existing,
@@ -8149,7 +8606,10 @@ static NV_STATUS block_split_preallocate_no_retry(uvm_va_block_t *existing, uvm_
     // Blocks don't have any CPU state to pre-allocate
 
     for_each_gpu_id(id) {
-        if (!block_gpu_state_get(existing, id))
+        uvm_va_block_gpu_state_t *existing_gpu_state = block_gpu_state_get(existing, id);
+        uvm_va_block_gpu_state_t *new_gpu_state;
+
+        if (!existing_gpu_state)
             continue;
 
         gpu = block_get_gpu(existing, id);
@@ -8158,10 +8618,17 @@ static NV_STATUS block_split_preallocate_no_retry(uvm_va_block_t *existing, uvm_
         if (status != NV_OK)
             goto error;
 
-        if (!block_gpu_state_get_alloc(new, gpu)) {
+        new_gpu_state = block_gpu_state_get_alloc(new, gpu);
+        if (!new_gpu_state) {
             status = NV_ERR_NO_MEMORY;
             goto error;
         }
+
+        if (existing_gpu_state->cpu_pages_dma_addrs) {
+            status = uvm_va_block_gpu_state_alloc_dma_addrs(new, new_gpu_state);
+            if (status != NV_OK)
+                goto error;
+        }
     }
 
     if (existing_va_range->inject_split_error) {
@@ -8308,9 +8775,25 @@ static void block_split_cpu(uvm_va_block_t *existing, uvm_va_block_t *new)
 
     // Attempt to shrink existing's pages allocation. If the realloc fails, just
     // keep on using the old larger one.
-    temp_pages = uvm_kvrealloc(existing->cpu.pages, existing_pages * sizeof(existing->cpu.pages[0]));
-    if (temp_pages)
-        existing->cpu.pages = temp_pages;
+    if (existing->cpu.pages_pooled) {
+        // The pages moved to new must be cleared so the array goes back to
+        // the pool zeroed.
+        memset(&existing->cpu.pages[existing_pages], 0, new_pages * sizeof(existing->cpu.pages[0]));
+
+        temp_pages = uvm_kvmalloc(existing_pages * sizeof(existing->cpu.pages[0]));
+        if (temp_pages) {
+            memcpy(temp_pages, existing->cpu.pages, existing_pages * sizeof(existing->cpu.pages[0]));
+            memset(existing->cpu.pages, 0, existing_pages * sizeof(existing->cpu.pages[0]));
+            uvm_kvmalloc_pool_free(&g_uvm_va_block_cpu_pages_pool, existing->cpu.pages);
+            existing->cpu.pages = temp_pages;
+            existing->cpu.pages_pooled = 0;
+        }
+    }
+    else {
+        temp_pages = uvm_kvrealloc(existing->cpu.pages, existing_pages * sizeof(existing->cpu.pages[0]));
+        if (temp_pages)
+            existing->cpu.pages = temp_pages;
+    }
 
     block_split_page_mask(&existing->cpu.resident, existing_pages, &new->cpu.resident, new_pages);
 
@@ -8460,29 +8943,34 @@ static void block_split_gpu(uvm_va_block_t *existing, uvm_va_block_t *new, uvm_g
     UVM_ASSERT(PAGE_ALIGNED(existing->start));
     existing_pages = (new->start - existing->start) / PAGE_SIZE;
 
-    // Move DMA addresses from the top of existing down into new
-    memcpy(&new_gpu_state->cpu_pages_dma_addrs[0],
-           &existing_gpu_state->cpu_pages_dma_addrs[existing_pages],
-           uvm_va_block_num_cpu_pages(new) * sizeof(new_gpu_state->cpu_pages_dma_addrs[0]));
+    if (existing_gpu_state->cpu_pages_dma_addrs) {
+        // new's array was allocated by block_split_preallocate
+        UVM_ASSERT(new_gpu_state->cpu_pages_dma_addrs);
 
-    // Reparent pages in the new VA block
-    for_each_va_block_page(page_index, new) {
-        if (!new_gpu_state->cpu_pages_dma_addrs[page_index])
-            continue;
+        // Move DMA addresses from the top of existing down into new
+        memcpy(&new_gpu_state->cpu_pages_dma_addrs[0],
+               &existing_gpu_state->cpu_pages_dma_addrs[existing_pages],
+               uvm_va_block_num_cpu_pages(new) * sizeof(new_gpu_state->cpu_pages_dma_addrs[0]));
 
-        // TODO: Bug 1995015: coalesce calls for physically-contiguous sysmem
-        // allocations
-        uvm_pmm_sysmem_mappings_reparent_gpu_mapping(&gpu->pmm_sysmem_mappings,
-                                                     new_gpu_state->cpu_pages_dma_addrs[page_index],
-                                                     new);
-    }
+        // Reparent pages in the new VA block
+        for_each_va_block_page(page_index, new) {
+            if (!new_gpu_state->cpu_pages_dma_addrs[page_index])
+                continue;
+
+            // TODO: Bug 1995015: coalesce calls for physically-contiguous sysmem
+            // allocations
+            uvm_pmm_sysmem_mappings_reparent_gpu_mapping(&gpu->pmm_sysmem_mappings,
+                                                         new_gpu_state->cpu_pages_dma_addrs[page_index],
+                                                         new);
+        }
 
-    // Attempt to shrink existing's allocation. If the realloc fails, just keep
-    // on using the old larger one.
-    shrunk_dma_addrs = uvm_kvrealloc(existing_gpu_state->cpu_pages_dma_addrs,
-                                     existing_pages * sizeof(existing_gpu_state->cpu_pages_dma_addrs[0]));
-    if (shrunk_dma_addrs)
-        existing_gpu_state->cpu_pages_dma_addrs = shrunk_dma_addrs;
+        // Attempt to shrink existing's allocation. If the realloc fails, just keep
+        // on using the old larger one.
+        shrunk_dma_addrs = uvm_kvrealloc(existing_gpu_state->cpu_pages_dma_addrs,
+                                         existing_pages * sizeof(existing_gpu_state->cpu_pages_dma_addrs[0]));
+        if (shrunk_dma_addrs)
+            existing_gpu_state->cpu_pages_dma_addrs = shrunk_dma_addrs;
+    }
 
     block_copy_split_gpu_chunks(existing, new, gpu);
 
@@ -9431,6 +9919,7 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
     uvm_va_space_t *va_space = va_range->va_space;
     uvm_perf_prefetch_hint_t prefetch_hint = UVM_PERF_PREFETCH_HINT_NONE();
     uvm_processor_mask_t processors_involved_in_cpu_migration;
+    NvU64 phase_start;
 
     uvm_assert_mutex_locked(&va_block->lock);
     UVM_ASSERT(va_range->type == UVM_VA_RANGE_TYPE_MANAGED);
@@ -9446,6 +9935,16 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
     else
         uvm_assert_rwsem_locked_read(&va_space->lock);
 
+    // Populate UXU blocks from storage before any page is migrated, including
+    // read-duplicated ones which are copied from the CPU. On the replayable
+    // fault path this may only start the I/O, in which case nothing has been
+    // changed yet and the caller comes back later.
+    if (uvm_is_uxu_block(va_block) && !uvm_processor_mask_empty(&service_context->resident_processors)) {
+        status = uxu_try_load_block(va_block, block_retry, service_context, processor_id);
+        if (status != NV_OK)
+            return status;
+    }
+
     // Performance heuristics policy: we only consider prefetching when there
     // are migrations to a single processor, only.
     if (uvm_processor_mask_get_count(&service_context->resident_processors) == 1) {
@@ -9527,13 +10026,12 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
             uvm_page_mask_or(new_residency_mask, new_residency_mask, prefetch_hint.prefetch_pages_mask);
         }
 
+        phase_start = uvm_fault_phase_start();
+
         if (service_context->read_duplicate_count == 0 ||
             uvm_page_mask_andnot(&service_context->block_context.caller_page_mask,
                                  new_residency_mask,
                                  &service_context->read_duplicate_mask)) {
-            if (uvm_is_uxu_block(va_block))
-                uxu_try_load_block(va_block, block_retry, service_context, processor_id);
-
             status = uvm_va_block_make_resident(va_block,
                                                 block_retry,
                                                 &service_context->block_context,
@@ -9564,6 +10062,8 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
                 return status;
         }
 
+        uvm_fault_phase_end_id(va_space, processor_id, UVM_FAULT_PHASE_COPY, phase_start);
+
         if (UVM_ID_IS_CPU(new_residency)) {
             // Save all the processors involved in migrations to the CPU for
             // an ECC check before establishing the CPU mappings.
@@ -9710,6 +10210,8 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
     }
 
     // 3- Map requesting processor with the necessary privileges
+    phase_start = uvm_fault_phase_start();
+
     for (new_prot = UVM_PROT_READ_ONLY; new_prot <= UVM_PROT_READ_WRITE_ATOMIC; ++new_prot) {
         const uvm_page_mask_t *map_prot_mask = &service_context->mappings_by_prot[new_prot-1].page_mask;
 
@@ -9781,6 +10283,8 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
             return status;
     }
 
+    uvm_fault_phase_end_id(va_space, processor_id, UVM_FAULT_PHASE_PTE, phase_start);
+
     // 4- If pages did migrate, map SetAccessedBy processors, except for UVM-Lite
     for_each_id_in_mask(new_residency, &service_context->resident_processors) {
         const uvm_page_mask_t *new_residency_mask;
@@ -10393,6 +10897,11 @@ NV_STATUS uvm_va_block_evict_chunks(uvm_va_block_t *va_block,
     // Only move pages resident on the GPU
     uvm_page_mask_and(pages_to_evict, pages_to_evict, uvm_va_block_resident_mask_get(va_block, gpu->id));
 
+    // Read-only uxu data stays on the CPU, so its duplicates are just dropped
+    status = uxubk_evict_read_duplicates(va_block, block_context, gpu, pages_to_evict);
+    if (status != NV_OK)
+        goto out;
+
     // TODO: Bug 1765193: make_resident() breaks read-duplication, but it's not
     // necessary to do so for eviction. Add a version that unmaps only the
     // processors that have mappings to the pages being evicted.
@@ -123,8 +123,10 @@ typedef struct
     // The CPU pages are mapped eagerly on the GPU whenever a new CPU page is
     // allocated and whenever a new GPU state is allocated.
     //
-    // The size of this array is always the same as the uvm_va_block::cpu.pages
-    // array.
+    // The array is allocated by uvm_va_block_gpu_state_alloc_dma_addrs when
+    // the first CPU page is mapped, so it is NULL for blocks which have never
+    // had CPU pages. When present, its size is always the same as the
+    // uvm_va_block::cpu.pages array.
     NvU64 *cpu_pages_dma_addrs;
 
     // Array of naturally-aligned chunks. Each chunk has the largest possible
@@ -384,6 +386,10 @@ struct uvm_va_block_struct
         // pre_populate_gpu_pde1 in uvm8_va_block.c for more information.
         NvU8 ever_mapped        : 1;
 
+        // Whether the pages array was allocated from the pool of arrays for
+        // full-size blocks, see block_cpu_pages_alloc in uvm8_va_block.c.
+        NvU8 pages_pooled       : 1;
+
         // We can get "unexpected" faults if multiple CPU threads fault on the
         // same address simultaneously and race to create the mapping. Since
         // our CPU fault handler always unmaps to handle the case where the
@@ -458,7 +464,22 @@ struct uvm_va_block_struct
 
     // A loaded block means that it has been loaded from storage by UXU.
     bool is_loaded;
+    // Storage I/O for the block has been issued by the GPU fault path but the
+    // pages have not been added to the block yet.
+    bool uxu_io_pending;
     bool is_dirty;
+    // Time at which UXU started loading the block, for the load latency stats
+    // and the tools events
+    NvU64 uxu_load_start;
+    // Pages of the block that were not in the page cache when the load started
+    NvU16 uxu_pages_missed;
+    // Pages of the block in holes of the backing files when the block was
+    // loaded. They are zero filled instead of read, and not written back
+    // while they stay zero.
+    uvm_page_mask_t uxu_holes;
+    // Last time (jiffies) the block was touched, to compare the LRU lists of
+    // different va_spaces
+    unsigned long uxu_lru_touched;
     struct list_head uxu_lru;
 };
 
@@ -955,6 +976,55 @@ void uvm_va_block_unregister_gpu(uvm_va_block_t *va_block, uvm_gpu_t *gpu);
 // This performs a uvm_va_block_release.
 void uvm_va_block_kill(uvm_va_block_t *va_block);
 
+// Batch used to kill many blocks of a VA space at once, for example when UXU
+// reclaims blocks. Instead of unmapping, invalidating and waiting for each
+// block separately like uvm_va_block_kill does, the GPU unmaps of all the
+// blocks are pushed first, then a single TLB invalidate is issued per GPU and
+// waited for once. The CPU pages of the killed blocks are released by a worker
+// thread afterwards.
+struct uvm_va_block_kill_batch_struct
+{
+    uvm_va_space_t *va_space;
+
+    // Blocks unmapped but not killed yet. The batch owns the reference the
+    // caller passed in with each block.
+    uvm_va_block_t **blocks;
+    size_t num_blocks;
+    size_t max_blocks;
+
+    // Unmaps of all the blocks in the batch
+    uvm_tracker_t tracker;
+
+    // TLB invalidates deferred by the unmaps, per GPU
+    uvm_processor_mask_t tlb_pending;
+    uvm_tlb_batch_t tlb_batches[UVM_ID_MAX_GPUS];
+
+    // CPU pages of the killed blocks, to be released after the wait
+    struct page **pages;
+    size_t num_pages;
+    size_t max_pages;
+};
+
+// Initialize a batch which can hold up to max_blocks blocks of va_space
+NV_STATUS uvm_va_block_kill_batch_init(uvm_va_block_kill_batch_t *batch, uvm_va_space_t *va_space, size_t max_blocks);
+
+void uvm_va_block_kill_batch_deinit(uvm_va_block_kill_batch_t *batch);
+
+// Unmap the block from all processors and queue it for destruction in
+// uvm_va_block_kill_batch_end. If the batch is full the block is killed right
+// away with uvm_va_block_kill.
+//
+// The VA space lock must be held in write mode until the batch is ended, and
+// the block must already be unreachable from its VA range. The caller should
+// not lock the block before calling this function.
+//
+// This consumes the caller's reference on the block.
+void uvm_va_block_kill_batch_add(uvm_va_block_kill_batch_t *batch, uvm_va_block_t *va_block);
+
+// Issue the deferred TLB invalidates, wait for all the unmaps and kill all the
+// blocks in the batch. The batch can be reused afterwards.
+void uvm_va_block_kill_batch_end(uvm_va_block_kill_batch_t *batch);
+
 // Exactly the same split semantics as uvm_va_range_split, including error
 // handling. See that function's comments for details.
 //
@@ -1002,6 +1072,11 @@ NV_STATUS uvm_va_block_cpu_fault(uvm_va_block_t *va_block,
 //
 // NV_WARN_MORE_PROCESSING_REQUIRED indicates that thrashing has been detected
 // and the performance heuristics logic decided to throttle execution.
+//
+// NV_ERR_BUSY_RETRY is only returned for UXU blocks on the replayable fault
+// path. It indicates that storage I/O for the block has been started but not
+// completed and nothing has been serviced. The caller is expected to drop the
+// block's lock, wait with uxu_wait_block_io() and service the block again.
 // Any other error code different than NV_OK indicates OOM or a global fatal
 // error.
 NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id, uvm_va_block_t *va_block,
@@ -1096,6 +1171,41 @@ NV_STATUS uvm_va_block_find_create(uvm_va_space_t *va_space, NvU64 addr, uvm_va_
 // Look up a chunk backing a specific address within the VA block. Returns NULL if none.
 uvm_gpu_chunk_t *uvm_va_block_lookup_gpu_chunk(uvm_va_block_t *va_block, uvm_gpu_t *gpu, NvU64 address);
 
+// Allocate the cpu_pages_dma_addrs array of gpu_state if it does not exist
+// yet. The block lock must be held.
+NV_STATUS uvm_va_block_gpu_state_alloc_dma_addrs(uvm_va_block_t *block, uvm_va_block_gpu_state_t *gpu_state);
+
+// Host memory used by the driver to track VA blocks, and memory holding their
+// data. Reported by the va_block_memory procfs file.
+typedef struct
+{
+    NvU64 num_blocks;
+
+    // uvm_va_block_t structs
+    NvU64 block_bytes;
+
+    // uvm_va_block_t::cpu.pages arrays
+    NvU64 cpu_pages_bytes;
+
+    // uvm_va_block_gpu_state_t structs and their chunks arrays
+    NvU64 gpu_state_bytes;
+
+    // uvm_va_block_gpu_state_t::cpu_pages_dma_addrs arrays
+    NvU64 dma_addrs_bytes;
+
+    // Per-block state of the performance heuristics
+    NvU64 perf_bytes;
+
+    // VA range block tables
+    NvU64 block_table_bytes;
+
+    // CPU pages and GPU chunks owned by the blocks
+    NvU64 data_bytes;
+} uvm_va_block_memory_usage_t;
+
+// Add the memory used by the block to usage. The block lock must be held.
+void uvm_va_block_add_memory_usage(uvm_va_block_t *va_block, uvm_va_block_memory_usage_t *usage);
+
 typedef enum
 {
     UVM_MIGRATE_MODE_MAKE_RESIDENT,
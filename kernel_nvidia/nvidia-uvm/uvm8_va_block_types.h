@@ -232,6 +232,10 @@ typedef struct
         uvm_pte_batch_t pte_batch;
         uvm_tlb_batch_t tlb_batch;
 
+        // If set, the TLB invalidates of unmaps of whole blocks are deferred
+        // to this batch. See uvm_va_block_kill_batch_add.
+        uvm_va_block_kill_batch_t *kill_batch;
+
         // Event that triggered the call to the mapping function
         UvmEventMapRemoteCause cause;
     } mapping;
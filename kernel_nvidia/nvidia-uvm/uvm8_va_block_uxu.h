@@ -9,6 +9,8 @@ static NV_STATUS block_populate_page_cpu(uvm_va_block_t *block, uvm_page_index_t
 
 static NV_STATUS block_map_phys_cpu_page_on_gpus(uvm_va_block_t *block, uvm_page_index_t page_index, struct page *page);
 
+static void block_clear_resident_processor(uvm_va_block_t *block, uvm_processor_id_t id);
+
 static NV_STATUS block_copy_resident_pages_mask(uvm_va_block_t *block,
 						uvm_va_block_context_t *block_context,
 						uvm_processor_id_t dst_id,
@@ -42,10 +44,14 @@ uxu_block_populate_page_cpu(uvm_va_block_t *block, uvm_page_index_t page_index,
 		goto error;
 
 	block->cpu.pages[page_index] = page;
+	uxu_host_pages_add(block, 1);
 	return NV_OK;
 
 error:
-	__free_page(page);
+	if (uxu_is_hostbuf_block(block) && !uvm_page_mask_test(&block->cpu.pagecached, page_index))
+		uxu_hostbuf_put(block->va_range->va_space, page);
+	else
+		__free_page(page);
 	return status;
 }
 
@@ -90,4 +96,66 @@ uxubk_copy_resident_pages_mask(uvm_va_block_t *block,
 					      migrated_pages, copied_pages_out, tracker_out);
 }
 
+/**
+ * Drop the read-duplicated copies of a read-only uxu block from a GPU being
+ * evicted. The CPU keeps the data, so unlike a move the copies of the other
+ * GPUs are left alone and nothing is transferred.
+ *
+ * @param block: block whose chunks are evicted.
+ * @param block_context: context of the eviction.
+ * @param gpu: GPU the chunks are evicted from.
+ * @param pages_to_evict: pages resident on the GPU. The dropped ones are removed.
+ *
+ * @return: NV_OK on success, NV_ERR_* otherwise.
+ */
+static inline NV_STATUS
+uxubk_evict_read_duplicates(uvm_va_block_t *block,
+			    uvm_va_block_context_t *block_context,
+			    uvm_gpu_t *gpu,
+			    uvm_page_mask_t *pages_to_evict)
+{
+	uvm_va_block_region_t	region = uvm_va_block_region_from_block(block);
+	uvm_tracker_t	local_tracker = UVM_TRACKER_INIT();
+	uvm_page_mask_t	drop_mask, unmap_mask;
+	uvm_page_mask_t	*resident_mask;
+	uvm_processor_id_t	id;
+	NV_STATUS	status = NV_OK, tracker_status;
+
+	if (!uvm_is_uxu_block(block) || uxu_is_write_block(block))
+		return NV_OK;
+
+	if (!uvm_page_mask_and(&drop_mask, pages_to_evict, &block->read_duplicated_pages) ||
+	    !uvm_page_mask_and(&drop_mask, &drop_mask, &block->cpu.resident))
+		return NV_OK;
+
+	// The processors without a copy of their own may map the one of the GPU
+	for_each_id_in_mask(id, &block->mapped) {
+		if (uvm_processor_mask_test(&block->va_range->uvm_lite_gpus, id))
+			continue;
+		if (uvm_id_equal(id, gpu->id) || !uvm_processor_mask_test(&block->resident, id))
+			uvm_page_mask_copy(&unmap_mask, &drop_mask);
+		else if (!uvm_page_mask_andnot(&unmap_mask, &drop_mask, uvm_va_block_resident_mask_get(block, id)))
+			continue;
+
+		status = uvm_va_block_unmap(block, block_context, id, region, &unmap_mask, &local_tracker);
+		if (status != NV_OK)
+			goto out;
+	}
+
+	resident_mask = uvm_va_block_resident_mask_get(block, gpu->id);
+	if (!uvm_page_mask_andnot(resident_mask, resident_mask, &drop_mask))
+		block_clear_resident_processor(block, gpu->id);
+	uvm_page_mask_andnot(pages_to_evict, pages_to_evict, &drop_mask);
+
+	// The pages stay duplicated where another GPU still has a copy
+	for_each_gpu_id_in_mask(id, &block->resident)
+		uvm_page_mask_andnot(&drop_mask, &drop_mask, uvm_va_block_resident_mask_get(block, id));
+	uvm_page_mask_andnot(&block->read_duplicated_pages, &block->read_duplicated_pages, &drop_mask);
+
+out:
+	tracker_status = uvm_tracker_add_tracker_safe(&block->tracker, &local_tracker);
+	uvm_tracker_deinit(&local_tracker);
+	return status == NV_OK ? tracker_status : status;
+}
+
 #endif
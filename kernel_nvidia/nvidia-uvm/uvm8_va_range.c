@@ -74,38 +74,53 @@ static NvU64 block_calc_end(uvm_va_range_t *va_range, size_t index)
     return end;
 }
 
-// Called before the range's bounds have been adjusted. This may not actually
-// shrink the blocks array. For example, if the shrink attempt fails then
-// va_range's old array is left intact. This may waste memory, but it means this
-// function cannot fail.
-static void blocks_array_shrink(uvm_va_range_t *va_range, size_t new_num_blocks)
+static void block_chunks_free(uvm_va_range_t *va_range, size_t first_chunk)
 {
-    size_t new_size = new_num_blocks * sizeof(va_range->blocks[0]);
-    atomic_long_t *new_blocks;
+    size_t i;
+
+    for (i = first_chunk; i < uvm_kvsize(va_range->block_chunks) / sizeof(va_range->block_chunks[0]); i++) {
+        atomic_long_t *chunk = (atomic_long_t *)atomic_long_read(&va_range->block_chunks[i]);
+
+        uvm_kvfree(chunk);
+        atomic_long_set(&va_range->block_chunks[i], (long)NULL);
+    }
+}
+
+// Called before the range's bounds have been adjusted. The chunks beyond the
+// new end of the range are freed, and they must not contain any blocks. This
+// may not actually shrink the chunks array. For example, if the shrink attempt
+// fails then va_range's old array is left intact. This may waste memory, but
+// it means this function cannot fail.
+static void block_chunks_shrink(uvm_va_range_t *va_range, size_t new_num_blocks)
+{
+    size_t new_num_chunks = DIV_ROUND_UP(new_num_blocks, UVM_VA_RANGE_BLOCKS_PER_CHUNK);
+    size_t new_size = new_num_chunks * sizeof(va_range->block_chunks[0]);
+    atomic_long_t *new_block_chunks;
 
     UVM_ASSERT(va_range->type == UVM_VA_RANGE_TYPE_MANAGED);
-    UVM_ASSERT(va_range->blocks);
-    UVM_ASSERT(uvm_kvsize(va_range->blocks) >= uvm_va_range_num_blocks(va_range) * sizeof(va_range->blocks[0]));
+    UVM_ASSERT(va_range->block_chunks);
+    UVM_ASSERT(uvm_kvsize(va_range->block_chunks) >=
+               uvm_va_range_num_block_chunks(va_range) * sizeof(va_range->block_chunks[0]));
     UVM_ASSERT(new_num_blocks);
     UVM_ASSERT(new_num_blocks <= uvm_va_range_num_blocks(va_range));
 
-    // TODO: Bug 1766579: This could be optimized by only shrinking the array
-    //       when the new size is half of the old size or some similar
-    //       threshold. Need to profile this on real apps to see if that's worth
-    //       doing.
+    block_chunks_free(va_range, new_num_chunks);
+
+    if (new_num_chunks == uvm_va_range_num_block_chunks(va_range))
+        return;
 
-    new_blocks = uvm_kvrealloc(va_range->blocks, new_size);
-    if (!new_blocks) {
+    new_block_chunks = uvm_kvrealloc(va_range->block_chunks, new_size);
+    if (!new_block_chunks) {
         // If we failed to allocate a smaller array, just leave the old one as-is
-        UVM_DBG_PRINT("Failed to shrink range [0x%llx, 0x%llx] from %zu blocks to %zu blocks\n",
+        UVM_DBG_PRINT("Failed to shrink range [0x%llx, 0x%llx] from %zu block chunks to %zu block chunks\n",
                       va_range->node.start,
                       va_range->node.end,
-                      uvm_kvsize(va_range->blocks) / sizeof(va_range->blocks[0]),
-                      new_num_blocks);
+                      uvm_kvsize(va_range->block_chunks) / sizeof(va_range->block_chunks[0]),
+                      new_num_chunks);
         return;
     }
 
-    va_range->blocks = new_blocks;
+    va_range->block_chunks = new_block_chunks;
 }
 
 static uvm_va_range_t *uvm_va_range_alloc(uvm_va_space_t *va_space, NvU64 start, NvU64 end)
@@ -141,9 +156,10 @@ static uvm_va_range_t *uvm_va_range_alloc_managed(uvm_va_space_t *va_space, NvU6
     va_range->read_duplication = UVM_READ_DUPLICATION_UNSET;
     va_range->preferred_location = UVM_ID_INVALID;
 
-    va_range->blocks = uvm_kvmalloc_zero(uvm_va_range_num_blocks(va_range) * sizeof(va_range->blocks[0]));
-    if (!va_range->blocks) {
-        UVM_DBG_PRINT("Failed to allocate %zu blocks\n", uvm_va_range_num_blocks(va_range));
+    va_range->block_chunks = uvm_kvmalloc_zero(uvm_va_range_num_block_chunks(va_range) *
+                                               sizeof(va_range->block_chunks[0]));
+    if (!va_range->block_chunks) {
+        UVM_DBG_PRINT("Failed to allocate %zu block chunks\n", uvm_va_range_num_block_chunks(va_range));
         goto error;
     }
 
@@ -367,12 +383,13 @@ static void uvm_va_range_destroy_managed(uvm_va_range_t *va_range)
     if (uvm_is_uxu_range(va_range))
         uxu_range_destroyed(va_range);
 
-    if (va_range->blocks) {
+    if (va_range->block_chunks) {
         // Unmap and drop our ref count on each block
         for_each_va_block_in_va_range_safe(va_range, block, block_tmp)
             uvm_va_block_kill(block);
 
-        uvm_kvfree(va_range->blocks);
+        block_chunks_free(va_range, 0);
+        uvm_kvfree(va_range->block_chunks);
     }
 
     event_data.range_destroy.range = va_range;
@@ -915,7 +932,34 @@ void uvm_va_range_unregister_gpu(uvm_va_range_t *va_range, uvm_gpu_t *gpu, struc
     }
 }
 
-// Split existing's blocks into new. new's blocks array has already been
+// Returns the first populated VA block at or after *index, updating *index to
+// its index, or NULL if none. Unallocated chunks are skipped as a whole.
+static uvm_va_block_t *block_next_from_index(uvm_va_range_t *va_range, size_t *index)
+{
+    size_t num_blocks = uvm_va_range_num_blocks(va_range);
+    size_t i = *index;
+
+    while (i < num_blocks) {
+        uvm_va_block_t *va_block;
+
+        if (!uvm_va_range_block_slot(va_range, i)) {
+            i = (i | (UVM_VA_RANGE_BLOCKS_PER_CHUNK - 1)) + 1;
+            continue;
+        }
+
+        va_block = uvm_va_range_block(va_range, i);
+        if (va_block) {
+            *index = i;
+            return va_block;
+        }
+
+        i++;
+    }
+
+    return NULL;
+}
+
+// Split existing's blocks into new. new's chunks array has already been
 // allocated. This is called before existing's range node is split, so it
 // overlaps new. new is always in the upper region of existing.
 //
@@ -925,7 +969,7 @@ void uvm_va_range_unregister_gpu(uvm_va_range_t *va_range, uvm_gpu_t *gpu, struc
 static NV_STATUS uvm_va_range_split_blocks(uvm_va_range_t *existing, uvm_va_range_t *new)
 {
     uvm_va_block_t *old_block, *block = NULL;
-    size_t existing_blocks, split_index, new_index = 0;
+    size_t existing_blocks, split_index, new_index = 0, i;
     NV_STATUS status;
 
     UVM_ASSERT(new->node.start >  existing->node.start);
@@ -933,6 +977,19 @@ static NV_STATUS uvm_va_range_split_blocks(uvm_va_range_t *existing, uvm_va_rang
 
     split_index = uvm_va_range_block_index(existing, new->node.start);
 
+    // Allocate new's chunks for all blocks moving to new up front, so that
+    // moving them below cannot fail. The block at index i in existing has
+    // index i - split_index in new, including a block spanning the split
+    // point. Chunks allocated here are freed with new on failure.
+    for (i = split_index; (block = block_next_from_index(existing, &i)) != NULL; i++) {
+        atomic_long_t *slot;
+
+        status = uvm_va_range_block_slot_create(new, i - split_index, &slot);
+        if (status != NV_OK)
+            return status;
+    }
+    block = NULL;
+
     // Handle a block spanning the split point
     if (block_calc_start(existing, split_index) != new->node.start) {
         // If a populated block actually spans the split point, we have to split
@@ -945,8 +1002,8 @@ static NV_STATUS uvm_va_range_split_blocks(uvm_va_range_t *existing, uvm_va_rang
                 return status;
 
             // No memory barrier is needed since we're holding the va_space lock in
-            // write mode, so no other thread can access the blocks array.
-            atomic_long_set(&new->blocks[0], (long)block);
+            // write mode, so no other thread can access the block table.
+            atomic_long_set(uvm_va_range_block_slot(new, 0), (long)block);
         }
 
         new_index = 1;
@@ -982,16 +1039,14 @@ static NV_STATUS uvm_va_range_split_blocks(uvm_va_range_t *existing, uvm_va_rang
     //  existing (before) [----- A ----][----- B ----][----- C ----]
     //  existing (after   [----- A ----][- B -]
     //  new                                    [- N -][----- C ----]
-    //                                            ^new->blocks[0]
+    //                                            ^new block 0
 
     // Note, if we split the last block of existing, this won't iterate at all.
-    for (; new_index < uvm_va_range_num_blocks(new); new_index++) {
-        block = uvm_va_range_block(existing, split_index + new_index);
-        if (!block) {
-            // new's array was cleared at allocation
-            UVM_ASSERT(uvm_va_range_block(new, new_index) == NULL);
-            continue;
-        }
+    for (i = split_index + new_index; (block = block_next_from_index(existing, &i)) != NULL; i++) {
+        new_index = i - split_index;
+
+        // new's chunks were cleared at allocation
+        UVM_ASSERT(uvm_va_range_block(new, new_index) == NULL);
 
         // As soon as we make this assignment and drop the lock, the reverse
         // mapping code can start looking at new, so new must be ready to go.
@@ -1001,12 +1056,12 @@ static NV_STATUS uvm_va_range_split_blocks(uvm_va_range_t *existing, uvm_va_rang
         uvm_mutex_unlock(&block->lock);
 
         // No memory barrier is needed since we're holding the va_space lock in
-        // write mode, so no other thread can access the blocks array.
-        atomic_long_set(&new->blocks[new_index], (long)block);
-        atomic_long_set(&existing->blocks[split_index + new_index], (long)NULL);
+        // write mode, so no other thread can access the block table.
+        atomic_long_set(uvm_va_range_block_slot(new, new_index), (long)block);
+        atomic_long_set(uvm_va_range_block_slot(existing, i), (long)NULL);
     }
 
-    blocks_array_shrink(existing, existing_blocks);
+    block_chunks_shrink(existing, existing_blocks);
 
     return NV_OK;
 }
@@ -1126,13 +1181,67 @@ size_t uvm_va_range_block_index(uvm_va_range_t *va_range, NvU64 addr)
     return index;
 }
 
+NV_STATUS uvm_va_range_block_slot_create(uvm_va_range_t *va_range, size_t index, atomic_long_t **out_slot)
+{
+    size_t chunk_index = index >> UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT;
+    size_t chunk_entries;
+    atomic_long_t *chunk, *old;
+
+    *out_slot = uvm_va_range_block_slot(va_range, index);
+    if (*out_slot)
+        return NV_OK;
+
+    // The last chunk only needs to cover the end of the range, which keeps
+    // small ranges as cheap as with a flat array.
+    chunk_entries = min(uvm_va_range_num_blocks(va_range) - (chunk_index << UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT),
+                        (size_t)UVM_VA_RANGE_BLOCKS_PER_CHUNK);
+    chunk = uvm_kvmalloc_zero(chunk_entries * sizeof(chunk[0]));
+    if (!chunk)
+        return NV_ERR_NO_MEMORY;
+
+    old = (atomic_long_t *)nv_atomic_long_cmpxchg(&va_range->block_chunks[chunk_index], (long)NULL, (long)chunk);
+    if (old) {
+        // Someone else beat us on the insert
+        uvm_kvfree(chunk);
+        chunk = old;
+    }
+
+    *out_slot = &chunk[index & (UVM_VA_RANGE_BLOCKS_PER_CHUNK - 1)];
+    return NV_OK;
+}
+
+size_t uvm_va_range_block_table_size(uvm_va_range_t *va_range)
+{
+    size_t i, size;
+
+    UVM_ASSERT(va_range->type == UVM_VA_RANGE_TYPE_MANAGED);
+
+    if (!va_range->block_chunks)
+        return 0;
+
+    size = uvm_kvsize(va_range->block_chunks);
+    for (i = 0; i < uvm_va_range_num_block_chunks(va_range); i++) {
+        atomic_long_t *chunk = (atomic_long_t *)atomic_long_read(&va_range->block_chunks[i]);
+
+        if (chunk)
+            size += uvm_kvsize(chunk);
+    }
+
+    return size;
+}
+
 NV_STATUS uvm_va_range_block_create(uvm_va_range_t *va_range, size_t index, uvm_va_block_t **out_block)
 {
     uvm_va_block_t *block, *old;
+    atomic_long_t *slot;
     NV_STATUS status;
 
     block = uvm_va_range_block(va_range, index);
     if (!block) {
+        status = uvm_va_range_block_slot_create(va_range, index, &slot);
+        if (status != NV_OK)
+            return status;
+
         // No block has been created here yet, so allocate one and attempt to
         // insert it. Note that this runs the risk of an out-of-memory error
         // when multiple threads race and all concurrently allocate a block for
@@ -1147,7 +1256,7 @@ NV_STATUS uvm_va_range_block_create(uvm_va_range_t *va_range, size_t index, uvm_
             return status;
 
         // Try to insert it
-        old = (uvm_va_block_t *)nv_atomic_long_cmpxchg(&va_range->blocks[index],
+        old = (uvm_va_block_t *)nv_atomic_long_cmpxchg(slot,
                                                       (long)NULL,
                                                       (long)block);
         if (old) {
@@ -1175,16 +1284,13 @@ uvm_va_block_t *uvm_va_range_block_next(uvm_va_range_t *va_range, uvm_va_block_t
     if (va_block)
         i = uvm_va_range_block_index(va_range, va_block->start) + 1;
 
-    for (; i < uvm_va_range_num_blocks(va_range); i++) {
-        va_block = uvm_va_range_block(va_range, i);
-        if (va_block) {
-            UVM_ASSERT(va_block->va_range == va_range);
-            UVM_ASSERT(uvm_va_range_block_index(va_range, va_block->start) == i);
-            return va_block;
-        }
+    va_block = block_next_from_index(va_range, &i);
+    if (va_block) {
+        UVM_ASSERT(va_block->va_range == va_range);
+        UVM_ASSERT(uvm_va_range_block_index(va_range, va_block->start) == i);
     }
 
-    return NULL;
+    return va_block;
 }
 
 static NV_STATUS range_unmap_mask(uvm_va_range_t *va_range, const uvm_processor_mask_t *mask)
@@ -362,25 +362,26 @@ struct uvm_va_range_struct
     // location is changed or a GPU stops being a UVM-Lite GPU.
     uvm_processor_mask_t uvm_lite_gpus;
 
-    // This is a uvm_va_block_t ** array of all VA block pointers under this
-    // range. The pointers can be accessed using the functions
-    // uvm_va_range_block() and uvm_va_range_block_create(). The latter
-    // allocates the block if it doesn't already exist. Once allocated, the
-    // blocks persist in the array until the parent VA range is destroyed.
+    // Table of all VA block pointers under this range. The pointers can be
+    // accessed using the functions uvm_va_range_block() and
+    // uvm_va_range_block_create(). The latter allocates the block if it
+    // doesn't already exist. Once allocated, the blocks persist in the table
+    // until the parent VA range is destroyed.
+    //
+    // The table has two levels so that its memory scales with the number of
+    // populated blocks rather than with the size of the range, which matters
+    // for file mappings of several TBs. block_chunks is an array of pointers
+    // to chunks of UVM_VA_RANGE_BLOCKS_PER_CHUNK uvm_va_block_t pointers.
+    // Chunks are allocated on demand when the first block within them is
+    // created, and persist until the range is destroyed or shrunk.
     //
     // Concurrent on-demand allocation requires the use of either atomics or a
     // spin lock. Given that we don't want to take a spin lock for every lookup,
-    // and that the blocks are persistent, atomics are preferred.
+    // and that the blocks and chunks are persistent, atomics are preferred.
     //
     // The number of blocks is calculated from the range size using
     // uvm_va_range_num_blocks().
-    //
-    // TODO: Bug 1766585: Compare perf of up-front allocation and demand-
-    //       allocation of blocks in the common case (lots of accessed blocks)
-    //       and the sparse case. If the common case is hurt by demand-
-    //       allocation, or if the sparse case isn't helped much, just allocate
-    //       them all at range allocation.
-    atomic_long_t *blocks;
+    atomic_long_t *block_chunks;
 
     uvm_va_range_type_t type;
     union
@@ -728,33 +729,77 @@ static struct vm_area_struct *uvm_va_range_vma_current(uvm_va_range_t *va_range)
     return uvm_va_range_vma_check(va_range, current->mm);
 }
 
+// Number of VA block pointers in each chunk of the va_range->block_chunks
+// table. A chunk of pointers fits in a 4K page and covers 1GB of VA space.
+#define UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT 9
+#define UVM_VA_RANGE_BLOCKS_PER_CHUNK   (1UL << UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT)
+
 // Returns the maximum number of VA blocks which could be contained with the
-// given va_range (number of elements in the va_range->blocks array).
-// va_range->node.start and .end must be set.
+// given va_range. va_range->node.start and .end must be set.
 //
 // The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
 size_t uvm_va_range_num_blocks(uvm_va_range_t *va_range);
 
-// Get the index within the va_range->blocks array of the VA block
+// Returns the number of elements in the va_range->block_chunks array.
+static size_t uvm_va_range_num_block_chunks(uvm_va_range_t *va_range)
+{
+    return DIV_ROUND_UP(uvm_va_range_num_blocks(va_range), UVM_VA_RANGE_BLOCKS_PER_CHUNK);
+}
+
+// Get the index within the va_range block table of the VA block
 // corresponding to addr. The block pointer is not guaranteed to be valid. Use
 // either uvm_va_range_block or uvm_va_range_block_create to look up the block.
 //
 // The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
 size_t uvm_va_range_block_index(uvm_va_range_t *va_range, NvU64 addr);
 
-// Looks up the VA block at va_range->blocks[index]. If no block is present at
-// that index, NULL is returned.
+// Looks up the entry of the block table holding the VA block at the given
+// index. If the chunk containing that entry has not been allocated, NULL is
+// returned.
+//
+// The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
+static atomic_long_t *uvm_va_range_block_slot(uvm_va_range_t *va_range, size_t index)
+{
+    atomic_long_t *chunk;
+    UVM_ASSERT(va_range->type == UVM_VA_RANGE_TYPE_MANAGED);
+    UVM_ASSERT(index < uvm_va_range_num_blocks(va_range));
+    chunk = (atomic_long_t *)atomic_long_read(&va_range->block_chunks[index >> UVM_VA_RANGE_BLOCKS_CHUNK_SHIFT]);
+    if (!chunk)
+        return NULL;
+
+    // The chunk may have just been allocated by another thread. See
+    // uvm_va_range_block for the reason of the barrier.
+    smp_read_barrier_depends();
+    return &chunk[index & (UVM_VA_RANGE_BLOCKS_PER_CHUNK - 1)];
+}
+
+// Same as uvm_va_range_block_slot except that the chunk is allocated if not
+// already present.
 //
-// This will reduce down to a single read and a compiler barrier on x86 release
+// The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
+NV_STATUS uvm_va_range_block_slot_create(uvm_va_range_t *va_range, size_t index, atomic_long_t **out_slot);
+
+// Returns the host memory in bytes currently used by the block table of the
+// range, including the chunks allocated so far.
+//
+// The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
+size_t uvm_va_range_block_table_size(uvm_va_range_t *va_range);
+
+// Looks up the VA block at the given index of the block table. If no block is
+// present at that index, NULL is returned.
+//
+// This will reduce down to two reads and a compiler barrier on x86 release
 // builds.
 //
 // The va_range must have type UVM_VA_RANGE_TYPE_MANAGED.
 static uvm_va_block_t *uvm_va_range_block(uvm_va_range_t *va_range, size_t index)
 {
     uvm_va_block_t *block;
-    UVM_ASSERT(va_range->type == UVM_VA_RANGE_TYPE_MANAGED);
-    UVM_ASSERT(index < uvm_va_range_num_blocks(va_range));
-    block = (uvm_va_block_t *)atomic_long_read(&va_range->blocks[index]);
+    atomic_long_t *slot = uvm_va_range_block_slot(va_range, index);
+    if (!slot)
+        return NULL;
+
+    block = (uvm_va_block_t *)atomic_long_read(slot);
 
     // Later accesses in this thread will read state out of block, potentially
     // as soon as the block pointer is updated by another thread. We have to
@@ -358,8 +358,6 @@ void uvm_va_space_destroy(uvm_va_space_t *va_space)
     uvm_global_processor_mask_t retained_gpus;
     LIST_HEAD(deferred_free_list);
 
-    stop_pagecache_reducer(va_space);
-
     // Remove the VA space from the global list before we start tearing things
     // down so other threads can't see the VA space in a partially-valid state.
     uvm_mutex_lock(&g_uvm_global.va_spaces.lock);
@@ -509,6 +507,8 @@ void uvm_va_space_destroy(uvm_va_space_t *va_space)
 
     uvm_mutex_unlock(&g_uvm_global.global_lock);
 
+    uxu_va_space_destroyed(va_space);
+
     uvm_kvfree(va_space);
 }
 
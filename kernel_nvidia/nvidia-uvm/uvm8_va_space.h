@@ -54,12 +54,54 @@ typedef struct uvm_uxu_va_space_t
     unsigned long reserved_nr_pages;
     // init flags that dictate the optimization behaviors
     unsigned short flags;
+    // part of the UXU blocks this va_space is entitled to, relative to the
+    // shares of the other va_spaces, when the reclaim service frees memory
+    unsigned int reclaim_share;
+    // number of UXU blocks currently allocated in this va_space
+    atomic64_t nr_blocks;
+    // number of host pages (page cache or anonymous) held by the UXU blocks
+    atomic64_t nr_host_pages;
+    // memory cgroup the UXU host memory is charged to, the one of the process
+    // which initialized UXU. NULL without memory cgroup support.
+    struct mem_cgroup *memcg;
+    // batch used by the reclaim service to tear down the blocks of a sweep
+    // together. NULL if it could not be allocated.
+    uvm_va_block_kill_batch_t *kill_batch;
+    // number of references the reclaim service holds on the va_space while it
+    // reclaims from it without the va_spaces list lock. The va_space is not
+    // torn down until it drops to 0.
+    atomic_t reclaim_refs;
 
-    struct task_struct *reducer;
     uvm_mutex_t lock;
     uvm_mutex_t lock_blocks;
 
     struct list_head lru_head;
+
+    // Per-CPU buffers of pending moves to the tail of lru_head. NULL if they
+    // could not be allocated, lru_head is then updated on every touch.
+    struct uvm_uxu_lru_batch_struct __percpu *lru_batch;
+
+    // Process which initialized UXU in this va_space
+    pid_t pid;
+
+    // Per-CPU statistics of all the UXU ranges of the va_space, reported in
+    // procfs. NULL if they could not be allocated.
+    struct uvm_uxu_stats_struct __percpu *stats;
+
+    // Pool of pinned host pages backing the blocks of the ranges mapped with
+    // UVM_UXU_FLAG_USEHOSTBUF. Mapping such a range raises hostbuf_nr_pages
+    // and fills the pool up to it. The pages of the killed blocks go back to
+    // it, up to hostbuf_nr_pages free pages.
+    uvm_spinlock_t hostbuf_lock;
+    struct list_head hostbuf_free;
+    unsigned long hostbuf_nr_free;
+    unsigned long hostbuf_nr_pages;
+
+    // Pool of compressed copies of the blocks of USEHOSTBUF ranges released by
+    // the reclaim service, which the next load of a block decompresses into
+    // its host buffers instead of reading storage. NULL
+    // if uvm_uxu_zpool_mb is 0 or the pool could not be allocated.
+    struct uvm_uxu_zpool_struct *zpool;
 } uvm_uxu_va_space_t;
 
 // uvm_deferred_free_object provides a mechanism for building and later freeing
@@ -1064,6 +1064,7 @@ typedef struct
     unsigned long    reserved_nr_pages;         // IN
     unsigned short   flags;                     // IN
     NV_STATUS        rmStatus;                  // OUT
+    unsigned int     reclaim_share;             // IN
 } UVM_UXU_INITIALIZE_PARAMS;
 
 //
@@ -1071,11 +1072,32 @@ typedef struct
 //
 #define UVM_UXU_MAP                                                   UVM_IOCTL_BASE(1001)
 
+// Maximum number of extents of a UVM_UXU_MAP
+#define UVM_UXU_MAX_EXTENTS                                           (64 * 1024)
+
+// Part of a file backing a UXU range. The extents of a range are concatenated
+// in order. The offset is page aligned, and so is the length of every extent
+// but the last one.
+typedef struct
+{
+    int             backing_fd;
+    NvU64           offset;
+    NvU64           length;
+} UVM_UXU_EXTENT;
+
 typedef struct
 {
     int             backing_fd;         // IN
     void            *uvm_addr;          // IN
     size_t          size;               // IN
+    NvU64           offset;             // IN
+    UVM_UXU_EXTENT  *extents;           // IN, replaces backing_fd and offset
+                                        // if nr_extents is not 0
+    NvU32           nr_extents;         // IN
+    NvU64           stripe_unit;        // IN, if not 0, the range is striped
+                                        // over the files of the extents
+                                        // round robin, in units of
+                                        // stripe_unit bytes
     unsigned short  flags;              // IN
     NV_STATUS       rmStatus;           // OUT
 } UVM_UXU_MAP_PARAMS;
@@ -1090,10 +1112,29 @@ typedef struct
     int             backing_fd;         // IN
     void            *uvm_addr;          // IN
     size_t          size;               // IN
+    NvU64           offset;             // IN, ignored
+    UVM_UXU_EXTENT  *extents;           // IN, ignored
+    NvU32           nr_extents;         // IN, ignored
+    NvU64           stripe_unit;        // IN, ignored
     unsigned short  flags;              // IN
     NV_STATUS       rmStatus;           // OUT
 } UVM_UXU_REMAP_PARAMS;
 
+//
+// UvmUxuFlush
+//
+// Write the data of a writable UXU range back to its files: the blocks
+// resident on the GPUs are migrated to the CPU, the host buffers are written
+// and the files are synced.
+//
+#define UVM_UXU_FLUSH                                                 UVM_IOCTL_BASE(1005)
+
+typedef struct
+{
+    void            *uvm_addr;          // IN, start of the range
+    NV_STATUS       rmStatus;           // OUT
+} UVM_UXU_FLUSH_PARAMS;
+
 //
 // Temporary ioctls which should be removed before UVM 8 release
 // Number backwards from 2047 - highest custom ioctl function number
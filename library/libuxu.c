@@ -17,6 +17,7 @@
 #include <cuda_runtime.h>
 
 #include "libuxu.h"
+#include "uxuz.h"
 
 #define PSF_DIR		"/proc/self/fd"
 #define NVIDIA_UVM_PATH	"/dev/nvidia-uvm"
@@ -24,6 +25,7 @@
 #define UXU_IOCTL_INIT				1000
 #define UXU_IOCTL_MAP				1001
 #define UXU_IOCTL_REMAP				1004
+#define UXU_IOCTL_FLUSH				1005
 
 /* Default # of pages when starting to reduce host pages of blocks */
 #define DEFAULT_NR_RESERVED_PAGES		((((unsigned long)1 << 21) / 4096) * 32 * 4)
@@ -32,6 +34,7 @@
 
 #define UXU_ENVNAME_READAHEAD_TYPE	"UXU_READAHEAD_TYPE"
 #define UXU_ENVNAME_NR_RESERVED_PAGES	"UXU_NR_RESERVED_PAGES"
+#define UXU_ENVNAME_RECLAIM_SHARE	"UXU_RECLAIM_SHARE"
 
 static int	fadvice = -1;
 static int	fd_uvm = -1;
@@ -47,16 +50,37 @@ typedef struct {
 	/* currently, not used */
 	unsigned short	flags;
 	unsigned int	status;
+	/* relative share of the host buffer when reclaiming; 0 for the default */
+	unsigned int	reclaim_share;
 } uxu_ioctl_init_t;
 
+typedef struct {
+	int backing_fd;
+	uint64_t offset;
+	uint64_t length;
+} uxu_ioctl_extent_t;
+
 typedef struct {
 	int backing_fd;
 	void *uvm_addr;
 	size_t size;
+	/* page aligned offset of the mapping in the file */
+	uint64_t offset;
+	/* files concatenated in the mapping, including the single file of uxu_map() */
+	uxu_ioctl_extent_t *extents;
+	unsigned int nr_extents;
+	/* if not 0, the mapping is striped over the files of the extents */
+	uint64_t stripe_unit;
 	unsigned short flags;
 	unsigned int status;
 } uxu_ioctl_map_t;
 
+typedef struct {
+	/* start of the mapping */
+	void *uvm_addr;
+	unsigned int status;
+} uxu_ioctl_flush_t;
+
 static int
 open_uvm_dev(void)
 {
@@ -128,6 +152,7 @@ init_module(void)
 {
 	uxu_ioctl_init_t	request;
 	long	nr_pages;
+	long	share;
 	char	*env_val;
 	char	*endptr;
 	int	status;
@@ -154,6 +179,7 @@ init_module(void)
 	request.swapout_nr_blocks = DEFAULT_SWAPOUT_NR_BLOCKS;
 	request.reserved_nr_pages = DEFAULT_NR_RESERVED_PAGES;
 	request.flags = 0;
+	request.reclaim_share = 0;
 
 	env_val = secure_getenv(UXU_ENVNAME_NR_RESERVED_PAGES);
 	if (env_val && (nr_pages = strtol(env_val, &endptr, 10)) >= 0) {
@@ -161,6 +187,12 @@ init_module(void)
 			request.reserved_nr_pages = (unsigned long)nr_pages;
 	}
 
+	env_val = secure_getenv(UXU_ENVNAME_RECLAIM_SHARE);
+	if (env_val && (share = strtol(env_val, &endptr, 10)) > 0) {
+		if (*env_val != '\0' && *endptr == '\0' && share <= UINT32_MAX)
+			request.reclaim_share = (unsigned int)share;
+	}
+
 	env_val = secure_getenv(UXU_ENVNAME_READAHEAD_TYPE);
 	if (env_val && strncasecmp(env_val, "agg", 3) == 0) {
 		fadvice = POSIX_FADV_SEQUENTIAL;
@@ -187,59 +219,102 @@ init_module(void)
 
 #define BUFSIZE	(1024 * 4)
 
+/* Copy `size` bytes between the mapping and a file, without UXU */
 static uxu_err_t
-fillup_from_file(uxu_ioctl_map_t *request)
+copy_file(int fd, off_t offset, unsigned char *addr, size_t size, int to_file)
 {
-	size_t	size;
-	unsigned char	*addr;
+	while (size > 0) {
+		ssize_t	ret;
+
+		if (to_file)
+			ret = pwrite(fd, addr, size, offset);
+		else
+			ret = pread(fd, addr, size, offset);
+		if (ret < 0)
+			return UXU_ERR_FILE;
+		/* the rest of a short file is left as is */
+		if (ret == 0)
+			break;
+		addr += ret;
+		offset += ret;
+		size -= ret;
+	}
 
-	if (!(request->flags & UXU_FLAGS_READ))
-		return UXU_OK;
+	return UXU_OK;
+}
 
-	addr = (unsigned char *)request->uvm_addr;
-	size = request->size;
-	while (size > 0) {
-		char buf[BUFSIZE];
-		int nread = BUFSIZE;
+/*
+ * Copy the whole mapping from or to its files, extent by extent, or stripe
+ * by stripe for striped mappings.
+ */
+static uxu_err_t
+copy_files(uxu_ioctl_map_t *request, int to_file)
+{
+	unsigned char	*addr = (unsigned char *)request->uvm_addr;
+	size_t	pos = 0;
+	unsigned int	i = 0;
+
+	while (pos < request->size) {
+		uxu_ioctl_extent_t	*extent;
+		off_t	offset;
+		size_t	len;
+		uxu_err_t	err;
+
+		if (request->stripe_unit == 0) {
+			extent = &request->extents[i++];
+			offset = extent->offset;
+			len = extent->length;
+		}
+		else {
+			size_t	stripe = pos / request->stripe_unit;
+
+			extent = &request->extents[stripe % request->nr_extents];
+			offset = extent->offset + (stripe / request->nr_extents) * request->stripe_unit;
+			len = request->size - pos;
+			if (len > request->stripe_unit)
+				len = request->stripe_unit;
+		}
 
-		if (nread > size)
-			nread = size;
-		nread = read(request->backing_fd, buf, nread);
-		if (nread == 0)
-			break;
-		memcpy(addr, buf, nread);
-		addr += nread;
-		size -= nread;
+		if ((err = copy_file(extent->backing_fd, offset, addr + pos, len, to_file)) != UXU_OK)
+			return err;
+		pos += len;
 	}
 
 	return UXU_OK;
 }
 
-static void
-flush_to_file(uxu_ioctl_map_t *request)
+static uxu_err_t
+fillup_from_file(uxu_ioctl_map_t *request)
 {
-	size_t	size;
-	unsigned char	*addr;
+	if (!(request->flags & UXU_FLAGS_READ))
+		return UXU_OK;
+	if (request->flags & UXU_FLAGS_COMPRESSED)
+		return uxuz_read(request->backing_fd, request->uvm_addr, request->size);
+	return copy_files(request, 0);
+}
 
+static uxu_err_t
+flush_to_file(uxu_ioctl_map_t *request)
+{
 	if (!(request->flags & UXU_FLAGS_WRITE))
-		return;
-
-	addr = (unsigned char *)request->uvm_addr;
-	size = request->size;
-	while (size > 0) {
-		char	buf[BUFSIZE];
-		int	nwrite = BUFSIZE;
+		return UXU_OK;
+	if (request->flags & UXU_FLAGS_COMPRESSED)
+		return uxuz_write(request->backing_fd, request->uvm_addr, request->size);
+	return copy_files(request, 1);
+}
 
-		if (nwrite > size)
-			nwrite = size;
+/* Write back the files of a writable mapping */
+static uxu_err_t
+sync_files(uxu_ioctl_map_t *request)
+{
+	uxu_err_t	err = UXU_OK;
+	unsigned int	i;
 
-		memcpy(buf, addr, nwrite);
-		nwrite = write(request->backing_fd, buf, nwrite);
-		if (nwrite == 0)
-			break;
-		addr += nwrite;
-		size -= nwrite;
+	for (i = 0; i < request->nr_extents; i++) {
+		if (fsync(request->extents[i].backing_fd) != 0)
+			err = UXU_ERR_FILE;
 	}
+	return err;
 }
 
 static uxu_err_t
@@ -248,11 +323,19 @@ do_uxu_map(uxu_ioctl_map_t *request)
 	int	status;
 	uxu_err_t	err = UXU_OK;
 
-	if ((request->flags & UXU_FLAGS_READ) && !(request->flags & UXU_FLAGS_VOLATILE)) {
-		if ((status = posix_fadvise(request->backing_fd, 0, 0, fadvice)) != 0)
-			fprintf(stderr, "fadvise error: %d\n", status);
-		if ((fadvice == POSIX_FADV_SEQUENTIAL) && readahead(request->backing_fd, 0, request->size) != 0)
-			fprintf(stderr, "readahead error.\n");
+	/* host buffers are read with direct I/O, bypassing the page cache */
+	if ((request->flags & UXU_FLAGS_READ) &&
+	    !(request->flags & (UXU_FLAGS_VOLATILE | UXU_FLAGS_USEHOSTBUF | UXU_FLAGS_COMPRESSED))) {
+		unsigned int	i;
+
+		for (i = 0; i < request->nr_extents; i++) {
+			uxu_ioctl_extent_t	*extent = &request->extents[i];
+
+			if ((status = posix_fadvise(extent->backing_fd, extent->offset, extent->length, fadvice)) != 0)
+				fprintf(stderr, "fadvise error: %d\n", status);
+			if ((fadvice == POSIX_FADV_SEQUENTIAL) && readahead(extent->backing_fd, extent->offset, extent->length) != 0)
+				fprintf(stderr, "readahead error.\n");
+		}
 	}
 
 	if ((status = ioctl(fd_uvm, UXU_IOCTL_MAP, request)) != 0) {
@@ -266,19 +349,77 @@ do_uxu_map(uxu_ioctl_map_t *request)
 static void
 free_request(uxu_ioctl_map_t *request)
 {
-	close(request->backing_fd);
+	unsigned int	i;
+
+	for (i = 0; i < request->nr_extents; i++)
+		close(request->extents[i].backing_fd);
+	free(request->extents);
 	free(request);
 }
 
+/* Make the file at least `size` bytes long */
+static int
+extend_file(int fd, off_t size)
+{
+	struct stat	st;
+
+	if (fstat(fd, &st) != 0)
+		return 0;
+	if (st.st_size >= size)
+		return 1;
+	return ftruncate(fd, size) == 0;
+}
+
 #define ALIGN_UP(addr, size)	(((addr)+((size)-1))&(~((typeof(addr))(size)-1)))
 
-uxu_err_t
-uxu_map(const char *filename, size_t size, unsigned short flags, void **paddr)
+/*
+ * Open the file of an extent. With UXU_FLAGS_CREATE, a file mapped from its
+ * start is truncated, otherwise it is only extended, so that the other arrays
+ * packed in it are kept. A compressed file is created as an empty container.
+ */
+static int
+open_extent_file(const uxu_extent_t *extent, unsigned short flags)
 {
-	int	f_flags = 0;
 	int	f_fd;
+
+	if (flags & UXU_FLAGS_CREATE) {
+		if (extent->offset == 0)
+			f_fd = creat(extent->filename, S_IRUSR | S_IWUSR);
+		else
+			f_fd = open(extent->filename, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+		if (f_fd >= 0)
+			close(f_fd);
+	}
+
+	if ((f_fd = open(extent->filename, O_RDWR | O_LARGEFILE)) < 0) {
+		fprintf(stderr, "Cannot open the file %s\n", extent->filename);
+		return -1;
+	}
+
+	if ((flags & (UXU_FLAGS_CREATE | UXU_FLAGS_COMPRESSED)) == (UXU_FLAGS_CREATE | UXU_FLAGS_COMPRESSED)) {
+		if (uxuz_create(f_fd, extent->length, UXUZ_DEFAULT_CHUNK_SHIFT) != UXU_OK) {
+			fprintf(stderr, "Cannot create the container %s\n", extent->filename);
+			close(f_fd);
+			return -1;
+		}
+	}
+	else if ((flags & UXU_FLAGS_CREATE) && !extend_file(f_fd, extent->offset + extent->length)) {
+		fprintf(stderr, "Cannot truncate the file %s\n", extent->filename);
+		close(f_fd);
+		return -1;
+	}
+
+	return f_fd;
+}
+
+static uxu_err_t
+map_extents(const uxu_extent_t *extents, unsigned int nr_extents, size_t stripe_unit, unsigned short flags, void **paddr)
+{
 	uxu_ioctl_map_t	*request;
 	cudaError_t	error;
+	long	pagesize = sysconf(_SC_PAGESIZE);
+	size_t	size = 0;
+	unsigned int	i;
 	int		ret = UXU_OK;
 
 	if (!initialized) {
@@ -287,41 +428,50 @@ uxu_map(const char *filename, size_t size, unsigned short flags, void **paddr)
 			return ret;
 	}
 
-	if ((request = (uxu_ioctl_map_t *)calloc(1, sizeof(uxu_ioctl_map_t))) == NULL) {
-		fprintf(stderr, "Cannot calloc uxu_ioctl_map_t\n");
-		return UXU_ERR_MEM;
-	}
-
-	f_flags = O_RDWR | O_LARGEFILE;
-	if (flags & UXU_FLAGS_CREATE) {
-		f_fd = creat(filename, S_IRUSR | S_IWUSR);
-		if (f_fd >= 0)
-			close(f_fd);
+	if (nr_extents == 0)
+		return UXU_ERR_INTVAL;
+	for (i = 0; i < nr_extents; i++) {
+		if (extents[i].offset < 0 || extents[i].offset % pagesize != 0 || extents[i].length == 0 ||
+		    (stripe_unit == 0 && i < nr_extents - 1 && extents[i].length % pagesize != 0)) {
+			fprintf(stderr, "extent %u of %s is not page aligned\n", i, extents[i].filename);
+			return UXU_ERR_INTVAL;
+		}
+		size += extents[i].length;
 	}
+	/* the chunks of a container are indexed from the start of its single file */
+	if ((flags & UXU_FLAGS_COMPRESSED) && (nr_extents != 1 || extents[0].offset != 0 || stripe_unit != 0))
+		return UXU_ERR_INTVAL;
 
-	if ((f_fd = open(filename, f_flags)) < 0) {
-		fprintf(stderr, "Cannot open the file %s\n", filename);
+	if ((request = (uxu_ioctl_map_t *)calloc(1, sizeof(uxu_ioctl_map_t))) == NULL ||
+	    (request->extents = (uxu_ioctl_extent_t *)calloc(nr_extents, sizeof(uxu_ioctl_extent_t))) == NULL) {
+		fprintf(stderr, "Cannot calloc uxu_ioctl_map_t\n");
 		free(request);
-		return UXU_ERR_FILE;
+		return UXU_ERR_MEM;
 	}
 
-	if ((flags & UXU_FLAGS_CREATE) && ftruncate(f_fd, size) != 0) {
-		fprintf(stderr, "Cannot truncate the file %s\n", filename);
-		close(f_fd);
-		free(request);
-		return UXU_ERR_FILE;
+	for (i = 0; i < nr_extents; i++) {
+		uxu_ioctl_extent_t	*extent = &request->extents[i];
+
+		if ((extent->backing_fd = open_extent_file(&extents[i], flags)) < 0) {
+			free_request(request);
+			return UXU_ERR_FILE;
+		}
+		extent->offset = extents[i].offset;
+		extent->length = extents[i].length;
+		request->nr_extents++;
 	}
 
 	error = cudaMallocManaged(&request->uvm_addr, ALIGN_UP(size, 0x1000), cudaMemAttachGlobal);
 	if (error != cudaSuccess) {
 		fprintf(stderr, "failed to cudaMallocManaged: %s %s\n", cudaGetErrorName(error), cudaGetErrorString(error));
-		close(f_fd);
-		free(request);
+		free_request(request);
 		return UXU_ERR_UVM;
 	}
 
-	request->backing_fd = f_fd;
+	request->backing_fd = request->extents[0].backing_fd;
+	request->offset = request->extents[0].offset;
 	request->size = size;
+	request->stripe_unit = stripe_unit;
 	request->flags = flags;
 
 	if (disabled_uxu)
@@ -333,12 +483,84 @@ uxu_map(const char *filename, size_t size, unsigned short flags, void **paddr)
 		*paddr = request->uvm_addr;
 		g_hash_table_insert(addr_map, request->uvm_addr, request);
 	}
-	else
+	else {
+		cudaFree(request->uvm_addr);
 		free_request(request);
+	}
 
 	return ret;
 }
 
+/*
+ * Map the extents, in order, as one contiguous array. Every offset has to be
+ * page aligned, and so has every length but the last one.
+ */
+uxu_err_t
+uxu_map_extents(const uxu_extent_t *extents, unsigned int nr_extents, unsigned short flags, void **paddr)
+{
+	return map_extents(extents, nr_extents, 0, flags, paddr);
+}
+
+/*
+ * Map `size` bytes striped over the files, round robin in units of
+ * `stripe_unit` bytes. With files on different devices, the blocks of the
+ * mapping are read and written back from all the devices in parallel.
+ * `stripe_unit` has to be page aligned. A multiple of the 2MB UVM block size
+ * keeps every block on one device.
+ */
+uxu_err_t
+uxu_map_striped(const char **filenames, unsigned int nr_files, size_t stripe_unit, size_t size,
+		unsigned short flags, void **paddr)
+{
+	uxu_extent_t	*extents;
+	size_t	nr_stripes;
+	unsigned int	i;
+	uxu_err_t	err;
+
+	if (nr_files == 0 || stripe_unit == 0 || stripe_unit % sysconf(_SC_PAGESIZE) != 0 || size == 0)
+		return UXU_ERR_INTVAL;
+
+	if ((extents = (uxu_extent_t *)calloc(nr_files, sizeof(uxu_extent_t))) == NULL)
+		return UXU_ERR_MEM;
+
+	/* Each file stores its share of the stripes from its start */
+	nr_stripes = size / stripe_unit;
+	for (i = 0; i < nr_files; i++) {
+		extents[i].filename = filenames[i];
+		extents[i].offset = 0;
+		extents[i].length = (nr_stripes / nr_files + (i < nr_stripes % nr_files ? 1: 0)) * stripe_unit;
+		if (i == nr_stripes % nr_files)
+			extents[i].length += size % stripe_unit;
+	}
+
+	/* The files holding no data are not needed */
+	while (nr_files > 1 && extents[nr_files - 1].length == 0)
+		nr_files--;
+
+	err = map_extents(extents, nr_files, stripe_unit, flags, paddr);
+	free(extents);
+
+	return err;
+}
+
+/*
+ * Map `size` bytes of the file from `offset`, which has to be page aligned.
+ * Several arrays can be packed in one file and mapped separately.
+ */
+uxu_err_t
+uxu_map_offset(const char *filename, off_t offset, size_t size, unsigned short flags, void **paddr)
+{
+	uxu_extent_t	extent = { filename, offset, size };
+
+	return map_extents(&extent, 1, 0, flags, paddr);
+}
+
+uxu_err_t
+uxu_map(const char *filename, size_t size, unsigned short flags, void **paddr)
+{
+	return uxu_map_offset(filename, 0, size, flags, paddr);
+}
+
 uxu_err_t
 uxu_remap(void *addr, unsigned short flags)
 {
@@ -382,10 +604,37 @@ uxu_trash_set_num_reserved_sys_cache_pages(unsigned long nrpages)
 	return UXU_ERR_NOT_IMPLEMENTED;
 }
 
+/*
+ * Write the data of a writable mapping back to its file, including the data
+ * resident on the GPU. The GPU has to be done with the mapping, callers
+ * synchronize with it first.
+ */
 uxu_err_t
 uxu_flush(void *addr)
 {
-	return UXU_ERR_NOT_IMPLEMENTED;
+	uxu_ioctl_map_t	*request = g_hash_table_lookup(addr_map, addr);
+	uxu_ioctl_flush_t	flush;
+	int	status;
+
+	if (request == NULL) {
+		fprintf(stderr, "%p is not mapped via uxu_map\n", addr);
+		return UXU_ERR_INTVAL;
+	}
+
+	if (!(request->flags & UXU_FLAGS_WRITE) || (request->flags & UXU_FLAGS_VOLATILE))
+		return UXU_OK;
+
+	if (disabled_uxu)
+		return flush_to_file(request);
+
+	/* the driver migrates the blocks back from the GPU and syncs the files */
+	memset(&flush, 0, sizeof(flush));
+	flush.uvm_addr = request->uvm_addr;
+	if ((status = ioctl(fd_uvm, UXU_IOCTL_FLUSH, &flush)) != 0 || flush.status != 0) {
+		fprintf(stderr, "ioctl flush error: %d %u\n", status, flush.status);
+		return UXU_ERR_IOCTL;
+	}
+	return UXU_OK;
 }
 
 uxu_err_t
@@ -403,7 +652,7 @@ uxu_unmap(void *addr)
 	}
 	else {
 		if ((request->flags & UXU_FLAGS_WRITE) && !(request->flags & UXU_FLAGS_VOLATILE))
-			fsync(request->backing_fd);
+			sync_files(request);
 	}
 
 	cudaFree(request->uvm_addr);
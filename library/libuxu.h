@@ -2,6 +2,7 @@
 #define _LIBUXU_H_
 
 #include <stdio.h>
+#include <sys/types.h>
 
 /* Flags for uxu_map */
 #define UXU_FLAGS_READ		0x01
@@ -10,6 +11,18 @@
 #define UXU_FLAGS_DONTTRASH	0x08
 #define UXU_FLAGS_VOLATILE	0x10
 #define UXU_FLAGS_USEHOSTBUF	0x20
+#define UXU_FLAGS_PROFILE	0x40
+/* the file is a compressed container of uxuz.h, implies UXU_FLAGS_USEHOSTBUF */
+#define UXU_FLAGS_COMPRESSED	0x80
+
+/* Part of a file mapped by uxu_map_extents */
+typedef struct {
+	const char	*filename;
+	/* page aligned offset in the file */
+	off_t	offset;
+	/* page aligned, but for the last extent */
+	size_t	length;
+} uxu_extent_t;
 
 /* Errors */
 typedef enum {
@@ -27,6 +40,10 @@ extern "C"
 {
 #endif
 	uxu_err_t uxu_map(const char *filename, size_t size, unsigned short flags, void **addr);
+	uxu_err_t uxu_map_offset(const char *filename, off_t offset, size_t size, unsigned short flags, void **addr);
+	uxu_err_t uxu_map_extents(const uxu_extent_t *extents, unsigned int nr_extents, unsigned short flags, void **addr);
+	uxu_err_t uxu_map_striped(const char **filenames, unsigned int nr_files, size_t stripe_unit, size_t size,
+				  unsigned short flags, void **addr);
 	uxu_err_t uxu_remap(void *addr, unsigned short flags);
 	uxu_err_t uxu_trash_set_num_blocks(unsigned long nrblocks);
 	uxu_err_t uxu_trash_set_num_reserved_sys_cache_pages(unsigned long nrpages);
@@ -0,0 +1,461 @@
+#ifndef _LIBUXU_HPP_
+#define _LIBUXU_HPP_
+
+/*
+ * C++ interface of libuxu. It is header only and built on top of the C
+ * interface of libuxu.h:
+ *
+ * - uxu::mapping<T> owns a file mapped with uxu_map(). It is move-only, and
+ *   its destructor waits for the GPU and unmaps the file, which writes back
+ *   the data of writable mappings.
+ * - uxu::view<T> is a non-owning typed view of a mapping, or of a part of it.
+ * - uxu::prefetch(), uxu::advise() and uxu::sync() return futures, so that
+ *   the transfers can be overlapped with the computation.
+ * - uxu::map_all() and uxu::unmap_all() map and unmap many files at once.
+ *
+ * Errors are reported with uxu::error exceptions.
+ */
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+#include "libuxu.h"
+
+namespace uxu {
+
+/* Error of the C interface, or of the CUDA runtime for UXU_ERR_UVM */
+class error : public std::runtime_error {
+public:
+	error(uxu_err_t err, const std::string &what)
+		: std::runtime_error(what), err_(err)
+	{
+	}
+
+	uxu_err_t
+	code() const noexcept
+	{
+		return err_;
+	}
+
+private:
+	uxu_err_t	err_;
+};
+
+namespace detail {
+
+inline void
+check(uxu_err_t err, const char *what)
+{
+	if (err != UXU_OK)
+		throw error(err, std::string(what) + " failed: " + std::to_string(err));
+}
+
+inline void
+check_cuda(cudaError_t err, const char *what)
+{
+	if (err != cudaSuccess)
+		throw error(UXU_ERR_UVM, std::string(what) + " failed: " + cudaGetErrorString(err));
+}
+
+/* CUDA event destroyed with the last future waiting for it */
+typedef std::shared_ptr<CUevent_st>	event_ptr;
+
+inline event_ptr
+record_event(cudaStream_t stream)
+{
+	cudaEvent_t	event;
+
+	check_cuda(cudaEventCreateWithFlags(&event, cudaEventDisableTiming), "cudaEventCreate");
+	event_ptr	ptr(event, cudaEventDestroy);
+	check_cuda(cudaEventRecord(event, stream), "cudaEventRecord");
+	return ptr;
+}
+
+inline std::future<void>
+ready_future()
+{
+	std::promise<void>	promise;
+
+	promise.set_value();
+	return promise.get_future();
+}
+
+} /* namespace detail */
+
+/*
+ * Typed view of `size()` elements of a mapping. A view does not own the
+ * memory, it must not outlive the mapping it comes from.
+ */
+template <typename T>
+class view {
+public:
+	typedef T	element_type;
+	typedef T	*iterator;
+
+	view() noexcept
+		: data_(nullptr), size_(0)
+	{
+	}
+
+	view(T *data, size_t size) noexcept
+		: data_(data), size_(size)
+	{
+	}
+
+	T *
+	data() const noexcept
+	{
+		return data_;
+	}
+
+	size_t
+	size() const noexcept
+	{
+		return size_;
+	}
+
+	size_t
+	size_bytes() const noexcept
+	{
+		return size_ * sizeof(T);
+	}
+
+	bool
+	empty() const noexcept
+	{
+		return size_ == 0;
+	}
+
+	T &
+	operator[](size_t idx) const noexcept
+	{
+		return data_[idx];
+	}
+
+	iterator
+	begin() const noexcept
+	{
+		return data_;
+	}
+
+	iterator
+	end() const noexcept
+	{
+		return data_ + size_;
+	}
+
+	/* View of `count` elements from `offset` */
+	view
+	subview(size_t offset, size_t count) const
+	{
+		if (offset > size_ || count > size_ - offset)
+			throw error(UXU_ERR_INTVAL, "uxu::view::subview out of range");
+		return view(data_ + offset, count);
+	}
+
+	/* View of the elements from `offset` to the end */
+	view
+	subview(size_t offset) const
+	{
+		if (offset > size_)
+			throw error(UXU_ERR_INTVAL, "uxu::view::subview out of range");
+		return view(data_ + offset, size_ - offset);
+	}
+
+	view
+	first(size_t count) const
+	{
+		return subview(0, count);
+	}
+
+	view
+	last(size_t count) const
+	{
+		if (count > size_)
+			throw error(UXU_ERR_INTVAL, "uxu::view::last out of range");
+		return subview(size_ - count, count);
+	}
+
+private:
+	T	*data_;
+	size_t	size_;
+};
+
+/*
+ * File mapped in unified memory with uxu_map(). The mapping holds `size()`
+ * elements of type T, that is size() * sizeof(T) bytes of the file.
+ */
+template <typename T>
+class mapping {
+public:
+	mapping() noexcept
+		: data_(nullptr), size_(0), flags_(0)
+	{
+	}
+
+	/*
+	 * Map `count` elements of the file `path` from the page aligned
+	 * `offset`. `flags` are the UXU_FLAGS_* of uxu_map().
+	 */
+	mapping(const std::string &path, size_t count, unsigned short flags, off_t offset = 0)
+		: data_(nullptr), size_(count), flags_(flags)
+	{
+		void	*addr;
+
+		detail::check(uxu_map_offset(path.c_str(), offset, count * sizeof(T), flags, &addr), "uxu_map");
+		data_ = static_cast<T *>(addr);
+	}
+
+	mapping(const mapping &) = delete;
+	mapping &operator=(const mapping &) = delete;
+
+	mapping(mapping &&other) noexcept
+		: data_(other.data_), size_(other.size_), flags_(other.flags_)
+	{
+		other.data_ = nullptr;
+		other.size_ = 0;
+	}
+
+	mapping &
+	operator=(mapping &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			data_ = other.data_;
+			size_ = other.size_;
+			flags_ = other.flags_;
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+		return *this;
+	}
+
+	/* Errors cannot be reported from here. Call unmap() to get them. */
+	~mapping()
+	{
+		reset();
+	}
+
+	/*
+	 * Wait for the GPU and unmap the file. The data of writable mappings
+	 * is written back to the file.
+	 */
+	void
+	unmap()
+	{
+		T	*data = data_;
+
+		if (data == nullptr)
+			return;
+		data_ = nullptr;
+		size_ = 0;
+		detail::check_cuda(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+		detail::check(uxu_unmap(data), "uxu_unmap");
+	}
+
+	/*
+	 * Give up the ownership of the mapping without unmapping it. The
+	 * returned address must be unmapped with uxu_unmap().
+	 */
+	T *
+	release() noexcept
+	{
+		T	*data = data_;
+
+		data_ = nullptr;
+		size_ = 0;
+		return data;
+	}
+
+	/* Change the flags of the mapping with uxu_remap() */
+	void
+	remap(unsigned short flags)
+	{
+		detail::check(uxu_remap(data_, flags), "uxu_remap");
+		flags_ = flags;
+	}
+
+	T *
+	data() const noexcept
+	{
+		return data_;
+	}
+
+	size_t
+	size() const noexcept
+	{
+		return size_;
+	}
+
+	size_t
+	size_bytes() const noexcept
+	{
+		return size_ * sizeof(T);
+	}
+
+	unsigned short
+	flags() const noexcept
+	{
+		return flags_;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return data_ != nullptr;
+	}
+
+	T &
+	operator[](size_t idx) const noexcept
+	{
+		return data_[idx];
+	}
+
+	uxu::view<T>
+	view() const noexcept
+	{
+		return uxu::view<T>(data_, size_);
+	}
+
+	operator uxu::view<T>() const noexcept
+	{
+		return view();
+	}
+
+	uxu::view<T>
+	subview(size_t offset, size_t count) const
+	{
+		return view().subview(offset, count);
+	}
+
+private:
+	void
+	reset() noexcept
+	{
+		if (data_ == nullptr)
+			return;
+		cudaDeviceSynchronize();
+		uxu_unmap(data_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	T	*data_;
+	size_t	size_;
+	unsigned short	flags_;
+};
+
+/*
+ * Start moving `v` to `device`, or to the host with cudaCpuDeviceId, on
+ * `stream`. The future becomes ready when the pages have been migrated.
+ */
+template <typename T>
+inline std::future<void>
+prefetch(const view<T> &v, int device, cudaStream_t stream = 0)
+{
+	detail::event_ptr	event;
+
+	if (v.empty())
+		return detail::ready_future();
+
+	detail::check_cuda(cudaMemPrefetchAsync(v.data(), v.size_bytes(), device, stream), "cudaMemPrefetchAsync");
+	event = detail::record_event(stream);
+
+	return std::async(std::launch::deferred, [event]() {
+		detail::check_cuda(cudaEventSynchronize(event.get()), "cudaEventSynchronize");
+	});
+}
+
+/*
+ * Set the `advice` of cudaMemAdvise() on `v` for `device`. The advice is
+ * applied when the call returns, the future is only returned for
+ * uniformity with prefetch() and sync().
+ */
+template <typename T>
+inline std::future<void>
+advise(const view<T> &v, cudaMemoryAdvise advice, int device)
+{
+	if (!v.empty())
+		detail::check_cuda(cudaMemAdvise(v.data(), v.size_bytes(), advice, device), "cudaMemAdvise");
+	return detail::ready_future();
+}
+
+/*
+ * Write the data of `m` back to its file, including the data resident on
+ * the GPU, once the work queued on `stream` so far has completed. The
+ * mapping must stay mapped until the future is ready.
+ */
+template <typename T>
+inline std::future<void>
+sync(const mapping<T> &m, cudaStream_t stream = 0)
+{
+	detail::event_ptr	event = detail::record_event(stream);
+	T	*data = m.data();
+
+	return std::async(std::launch::deferred, [event, data]() {
+		detail::check_cuda(cudaEventSynchronize(event.get()), "cudaEventSynchronize");
+		detail::check(uxu_flush(data), "uxu_flush");
+	});
+}
+
+/* File to be mapped by map_all() */
+struct map_request {
+	std::string	path;
+	/* Number of elements to map */
+	size_t	count;
+	unsigned short	flags;
+	/* Page aligned offset in the file, 0 if omitted */
+	off_t	offset;
+};
+
+/*
+ * Map all the requested files. Either all of them are mapped, or none: the
+ * mappings already done are unmapped if one of them fails.
+ */
+template <typename T>
+inline std::vector<mapping<T> >
+map_all(const std::vector<map_request> &requests)
+{
+	std::vector<mapping<T> >	mappings;
+
+	mappings.reserve(requests.size());
+	for (const map_request &request : requests)
+		mappings.emplace_back(request.path, request.count, request.flags, request.offset);
+	return mappings;
+}
+
+/*
+ * Unmap all the mappings, waiting for the GPU only once. Every mapping is
+ * unmapped even if some of them fail, and the first error is thrown.
+ */
+template <typename T>
+inline void
+unmap_all(std::vector<mapping<T> > &mappings)
+{
+	uxu_err_t	err = UXU_OK;
+
+	detail::check_cuda(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+	for (mapping<T> &m : mappings) {
+		// The GPU is idle already, no need to wait for it for each mapping
+		T	*data = m.release();
+		uxu_err_t	ret;
+
+		if (data == nullptr)
+			continue;
+		ret = uxu_unmap(data);
+		if (err == UXU_OK)
+			err = ret;
+	}
+	mappings.clear();
+	detail::check(err, "uxu_unmap");
+}
+
+} /* namespace uxu */
+
+#endif
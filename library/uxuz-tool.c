@@ -0,0 +1,108 @@
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "uxuz.h"
+
+/* Create, unpack and inspect the compressed containers of UXU_FLAGS_COMPRESSED */
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"usage: uxuz pack [-c <chunk shift>] <file> <container>\n"
+		"       uxuz unpack <container> <file>\n"
+		"       uxuz info <container>\n");
+	exit(2);
+}
+
+static int
+open_or_die(const char *path, int flags)
+{
+	int	fd = open(path, flags | O_LARGEFILE, S_IRUSR | S_IWUSR);
+
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	return fd;
+}
+
+static int
+do_info(const char *path)
+{
+	uxuz_header_t	header;
+	struct stat	st;
+	int	fd = open_or_die(path, O_RDONLY);
+
+	if (uxuz_read_header(fd, &header) != UXU_OK || fstat(fd, &st) != 0) {
+		fprintf(stderr, "%s is not a uxuz container\n", path);
+		close(fd);
+		return 1;
+	}
+	printf("size       %llu\n", (unsigned long long)header.size);
+	printf("chunk_size %llu\n", 1ULL << header.chunk_shift);
+	printf("nr_chunks  %llu\n", (unsigned long long)header.nr_chunks);
+	printf("algorithm  %s\n", header.algorithm == UXUZ_ALGO_LZ4 ? "lz4" : "none");
+	printf("file_size  %llu\n", (unsigned long long)st.st_size);
+	if (st.st_size > 0)
+		printf("ratio      %.2f\n", (double)header.size / st.st_size);
+	close(fd);
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	chunk_shift = UXUZ_DEFAULT_CHUNK_SHIFT;
+	int	fd_in, fd_out;
+	int	opt;
+	uxu_err_t	err;
+
+	if (argc < 2)
+		usage();
+
+	if (strcmp(argv[1], "info") == 0) {
+		if (argc != 3)
+			usage();
+		return do_info(argv[2]);
+	}
+
+	optind = 2;
+	while ((opt = getopt(argc, argv, "c:")) != -1) {
+		if (opt == 'c')
+			chunk_shift = (unsigned int)strtoul(optarg, NULL, 10);
+		else
+			usage();
+	}
+	if (argc - optind != 2)
+		usage();
+
+	fd_in = open_or_die(argv[optind], O_RDONLY);
+	fd_out = open_or_die(argv[optind + 1], O_RDWR | O_CREAT);
+
+	if (strcmp(argv[1], "pack") == 0)
+		err = uxuz_pack(fd_in, fd_out, chunk_shift);
+	else if (strcmp(argv[1], "unpack") == 0)
+		err = uxuz_unpack(fd_in, fd_out);
+	else
+		usage();
+
+	if (err == UXU_OK && fsync(fd_out) != 0)
+		err = UXU_ERR_FILE;
+	close(fd_in);
+	close(fd_out);
+
+	if (err != UXU_OK) {
+		fprintf(stderr, "uxuz %s failed: %d\n", argv[1], err);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,558 @@
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "uxuz.h"
+
+/*
+ * LZ4 block format, as decompressed by the kernel: a sequence is a token,
+ * literals and a match. The token holds the literal length in its high
+ * nibble and the match length minus 4 in its low one, 15 meaning that the
+ * length goes on in the following bytes. The match is a 2 bytes offset
+ * back in the output. The last sequence has no match and the last 5 bytes
+ * are always literals.
+ */
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5
+#define LZ4_MF_LIMIT		12
+#define LZ4_MAX_DISTANCE	65535
+#define LZ4_HASH_BITS		16
+
+#define LZ4_BOUND(size)		((size) + (size) / 255 + 16)
+
+static inline uint32_t
+read32(const uint8_t *p)
+{
+	uint32_t	v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t
+lz4_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/* Length past the 15 of a token, or NULL if it does not fit in the output */
+static uint8_t *
+lz4_put_length(uint8_t *op, uint8_t *oend, size_t len)
+{
+	for (; len >= 255; len -= 255) {
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/* Write a sequence, with no match if `mlen` is 0 */
+static uint8_t *
+lz4_put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t lit_len, size_t offset, size_t mlen)
+{
+	uint8_t	*token;
+
+	if (op >= oend)
+		return NULL;
+	token = op++;
+	*token = (lit_len >= 15 ? 15 : lit_len) << 4;
+	if (lit_len >= 15 && (op = lz4_put_length(op, oend, lit_len - 15)) == NULL)
+		return NULL;
+	if ((size_t)(oend - op) < lit_len)
+		return NULL;
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if (mlen == 0)
+		return op;
+	mlen -= LZ4_MIN_MATCH;
+	if (oend - op < 2)
+		return NULL;
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	*token |= mlen >= 15 ? 15 : mlen;
+	if (mlen >= 15)
+		op = lz4_put_length(op, oend, mlen - 15);
+	return op;
+}
+
+/* Compress `len` bytes, return the compressed length or 0 if it is over `max_len` */
+static size_t
+lz4_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t max_len, uint32_t *table)
+{
+	const uint8_t	*ip = src, *anchor = src, *iend = src + len;
+	uint8_t	*op = dst, *oend = dst + max_len;
+
+	memset(table, 0, sizeof(uint32_t) << LZ4_HASH_BITS);
+	if (len > LZ4_MF_LIMIT) {
+		const uint8_t	*mflimit = iend - LZ4_MF_LIMIT;
+		const uint8_t	*matchlimit = iend - LZ4_LAST_LITERALS;
+
+		while (ip < mflimit) {
+			uint32_t	seq = read32(ip);
+			uint32_t	h = lz4_hash(seq);
+			const uint8_t	*ref = src + table[h];
+			const uint8_t	*mp;
+
+			table[h] = ip - src;
+			if (ref >= ip || ip - ref > LZ4_MAX_DISTANCE || read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			for (mp = ip + LZ4_MIN_MATCH, ref += LZ4_MIN_MATCH; mp < matchlimit && *mp == *ref; mp++, ref++)
+				;
+			op = lz4_put_sequence(op, oend, anchor, ip - anchor, mp - ref, mp - ip);
+			if (op == NULL)
+				return 0;
+			ip = anchor = mp;
+		}
+	}
+
+	op = lz4_put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+	return op ? (size_t)(op - dst) : 0;
+}
+
+/* Decompress `len` bytes, return the decompressed length or -1 if the data is corrupted */
+static ssize_t
+lz4_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t max_len)
+{
+	const uint8_t	*ip = src, *iend = src + len;
+	uint8_t	*op = dst, *oend = dst + max_len;
+
+	while (ip < iend) {
+		unsigned int	token = *ip++;
+		size_t	n = token >> 4;
+		size_t	offset;
+		const uint8_t	*ref;
+		uint8_t	b;
+
+		if (n == 15) {
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				n += b;
+			} while (b == 255);
+		}
+		if (n > (size_t)(iend - ip) || n > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, n);
+		op += n;
+		ip += n;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return -1;
+
+		n = token & 15;
+		if (n == 15) {
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				n += b;
+			} while (b == 255);
+		}
+		n += LZ4_MIN_MATCH;
+		if (n > (size_t)(oend - op))
+			return -1;
+		/* the match may overlap the output, copy byte by byte */
+		for (ref = op - offset; n > 0; n--)
+			*op++ = *ref++;
+	}
+
+	return op - dst;
+}
+
+static int
+pread_full(int fd, void *buf, size_t len, off_t offset)
+{
+	while (len > 0) {
+		ssize_t	ret = pread(fd, buf, len, offset);
+
+		if (ret <= 0)
+			return 0;
+		buf = (uint8_t *)buf + ret;
+		offset += ret;
+		len -= ret;
+	}
+	return 1;
+}
+
+static int
+pwrite_full(int fd, const void *buf, size_t len, off_t offset)
+{
+	while (len > 0) {
+		ssize_t	ret = pwrite(fd, buf, len, offset);
+
+		if (ret <= 0)
+			return 0;
+		buf = (const uint8_t *)buf + ret;
+		offset += ret;
+		len -= ret;
+	}
+	return 1;
+}
+
+/* Open container, with its index in the host byte order */
+typedef struct {
+	int	fd;
+	uxuz_header_t	header;
+	uxuz_chunk_t	*index;
+	size_t	chunk_size;
+	/* where the chunks not fitting their slot are appended */
+	off_t	data_end;
+	uint8_t	*raw;
+	uint8_t	*packed;
+	uint32_t	*table;
+} uxuz_t;
+
+static void
+uxuz_close(uxuz_t *z)
+{
+	free(z->index);
+	free(z->raw);
+	free(z->packed);
+	free(z->table);
+}
+
+static uxu_err_t
+uxuz_alloc_buffers(uxuz_t *z)
+{
+	z->chunk_size = (size_t)1 << z->header.chunk_shift;
+	z->raw = (uint8_t *)malloc(z->chunk_size);
+	z->packed = (uint8_t *)malloc(LZ4_BOUND(z->chunk_size));
+	z->table = (uint32_t *)malloc(sizeof(uint32_t) << LZ4_HASH_BITS);
+	if (z->raw == NULL || z->packed == NULL || z->table == NULL)
+		return UXU_ERR_MEM;
+	return UXU_OK;
+}
+
+uxu_err_t
+uxuz_read_header(int fd, uxuz_header_t *header)
+{
+	if (!pread_full(fd, header, sizeof(*header), 0))
+		return UXU_ERR_INTVAL;
+
+	header->magic = le32toh(header->magic);
+	header->version = le16toh(header->version);
+	header->algorithm = le16toh(header->algorithm);
+	header->chunk_shift = le32toh(header->chunk_shift);
+	header->size = le64toh(header->size);
+	header->nr_chunks = le64toh(header->nr_chunks);
+	header->index_offset = le64toh(header->index_offset);
+
+	if (header->magic != UXUZ_MAGIC || header->version != UXUZ_VERSION || header->algorithm > UXUZ_ALGO_LZ4 ||
+	    header->chunk_shift < UXUZ_MIN_CHUNK_SHIFT || header->chunk_shift > UXUZ_MAX_CHUNK_SHIFT ||
+	    header->nr_chunks != (header->size + ((uint64_t)1 << header->chunk_shift) - 1) >> header->chunk_shift ||
+	    header->index_offset < UXUZ_HEADER_SIZE)
+		return UXU_ERR_INTVAL;
+	return UXU_OK;
+}
+
+static uxu_err_t
+uxuz_open(uxuz_t *z, int fd)
+{
+	struct stat	st;
+	uint64_t	i;
+	uxu_err_t	err;
+
+	memset(z, 0, sizeof(*z));
+	z->fd = fd;
+	if ((err = uxuz_read_header(fd, &z->header)) != UXU_OK)
+		return err;
+	if (fstat(fd, &st) != 0)
+		return UXU_ERR_FILE;
+	z->data_end = st.st_size;
+
+	if ((err = uxuz_alloc_buffers(z)) != UXU_OK)
+		goto error;
+	z->index = (uxuz_chunk_t *)malloc(z->header.nr_chunks * sizeof(uxuz_chunk_t));
+	if (z->index == NULL && z->header.nr_chunks > 0) {
+		err = UXU_ERR_MEM;
+		goto error;
+	}
+	if (!pread_full(fd, z->index, z->header.nr_chunks * sizeof(uxuz_chunk_t), z->header.index_offset)) {
+		err = UXU_ERR_FILE;
+		goto error;
+	}
+	for (i = 0; i < z->header.nr_chunks; i++) {
+		z->index[i].offset = le64toh(z->index[i].offset);
+		z->index[i].length = le32toh(z->index[i].length);
+		z->index[i].flags = le32toh(z->index[i].flags);
+	}
+	return UXU_OK;
+
+error:
+	uxuz_close(z);
+	return err;
+}
+
+/* Length of the data of a chunk */
+static size_t
+uxuz_chunk_len(uxuz_t *z, uint64_t chunk)
+{
+	uint64_t	start = chunk << z->header.chunk_shift;
+
+	return z->header.size - start < z->chunk_size ? z->header.size - start : z->chunk_size;
+}
+
+/* Read and decompress a chunk to z->raw, zero padded to the chunk size */
+static uxu_err_t
+uxuz_read_chunk(uxuz_t *z, uint64_t chunk)
+{
+	uxuz_chunk_t	*entry = &z->index[chunk];
+	ssize_t	len;
+
+	if (entry->length == 0) {
+		memset(z->raw, 0, z->chunk_size);
+		return UXU_OK;
+	}
+	if (entry->length > z->chunk_size)
+		return UXU_ERR_INTVAL;
+
+	if ((entry->flags & UXUZ_CHUNK_STORED) || z->header.algorithm == UXUZ_ALGO_NONE) {
+		if (!pread_full(z->fd, z->raw, entry->length, entry->offset))
+			return UXU_ERR_FILE;
+		len = entry->length;
+	}
+	else {
+		if (!pread_full(z->fd, z->packed, entry->length, entry->offset))
+			return UXU_ERR_FILE;
+		len = lz4_decompress(z->packed, entry->length, z->raw, z->chunk_size);
+		if (len < 0)
+			return UXU_ERR_INTVAL;
+	}
+	memset(z->raw + len, 0, z->chunk_size - len);
+	return UXU_OK;
+}
+
+/* Compress and write a chunk, in its slot if it fits. The index is written by uxuz_write_index(). */
+static uxu_err_t
+uxuz_write_chunk(uxuz_t *z, uint64_t chunk, const uint8_t *data, size_t len)
+{
+	uxuz_chunk_t	*entry = &z->index[chunk];
+	const uint8_t	*out = z->packed;
+	size_t	out_len = 0;
+	uint32_t	flags = 0;
+	size_t	i;
+
+	for (i = 0; i < len && data[i] == 0; i++)
+		;
+	if (i == len) {
+		memset(entry, 0, sizeof(*entry));
+		return UXU_OK;
+	}
+
+	/* compression has to save a byte at least */
+	if (z->header.algorithm == UXUZ_ALGO_LZ4)
+		out_len = lz4_compress(data, len, z->packed, len - 1, z->table);
+	if (out_len == 0) {
+		out = data;
+		out_len = len;
+		flags = UXUZ_CHUNK_STORED;
+	}
+
+	if (entry->length < out_len) {
+		entry->offset = z->data_end;
+		z->data_end += out_len;
+	}
+	entry->length = out_len;
+	entry->flags = flags;
+	if (!pwrite_full(z->fd, out, out_len, entry->offset))
+		return UXU_ERR_FILE;
+	return UXU_OK;
+}
+
+static uxu_err_t
+uxuz_write_index(uxuz_t *z)
+{
+	uxuz_chunk_t	*index;
+	uint64_t	i;
+	int	ok;
+
+	index = (uxuz_chunk_t *)malloc(z->header.nr_chunks * sizeof(uxuz_chunk_t));
+	if (index == NULL && z->header.nr_chunks > 0)
+		return UXU_ERR_MEM;
+	for (i = 0; i < z->header.nr_chunks; i++) {
+		index[i].offset = htole64(z->index[i].offset);
+		index[i].length = htole32(z->index[i].length);
+		index[i].flags = htole32(z->index[i].flags);
+	}
+	ok = pwrite_full(z->fd, index, z->header.nr_chunks * sizeof(uxuz_chunk_t), z->header.index_offset);
+	free(index);
+	return ok ? UXU_OK : UXU_ERR_FILE;
+}
+
+uxu_err_t
+uxuz_create(int fd, size_t size, unsigned int chunk_shift)
+{
+	uint8_t	block[UXUZ_HEADER_SIZE];
+	uxuz_header_t	header;
+	uint64_t	nr_chunks, pos;
+	off_t	end;
+
+	if (chunk_shift < UXUZ_MIN_CHUNK_SHIFT || chunk_shift > UXUZ_MAX_CHUNK_SHIFT)
+		return UXU_ERR_INTVAL;
+	nr_chunks = (size + ((size_t)1 << chunk_shift) - 1) >> chunk_shift;
+	end = UXUZ_HEADER_SIZE + nr_chunks * sizeof(uxuz_chunk_t);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = htole32(UXUZ_MAGIC);
+	header.version = htole16(UXUZ_VERSION);
+	header.algorithm = htole16(UXUZ_ALGO_LZ4);
+	header.chunk_shift = htole32(chunk_shift);
+	header.size = htole64(size);
+	header.nr_chunks = htole64(nr_chunks);
+	header.index_offset = htole64(UXUZ_HEADER_SIZE);
+
+	/* an index of zeros is an index of chunks of zeros */
+	if (ftruncate(fd, 0) != 0 || ftruncate(fd, end) != 0)
+		return UXU_ERR_FILE;
+	memset(block, 0, sizeof(block));
+	memcpy(block, &header, sizeof(header));
+	for (pos = 0; pos < UXUZ_HEADER_SIZE; pos += sizeof(block)) {
+		if (!pwrite_full(fd, block, sizeof(block), pos))
+			return UXU_ERR_FILE;
+	}
+	return UXU_OK;
+}
+
+uxu_err_t
+uxuz_pack(int fd_in, int fd_out, unsigned int chunk_shift)
+{
+	struct stat	st;
+	uxuz_t	z;
+	uint64_t	chunk;
+	uxu_err_t	err;
+
+	if (fstat(fd_in, &st) != 0)
+		return UXU_ERR_FILE;
+	if ((err = uxuz_create(fd_out, st.st_size, chunk_shift)) != UXU_OK)
+		return err;
+	if ((err = uxuz_open(&z, fd_out)) != UXU_OK)
+		return err;
+
+	for (chunk = 0; chunk < z.header.nr_chunks; chunk++) {
+		size_t	len = uxuz_chunk_len(&z, chunk);
+
+		if (!pread_full(fd_in, z.raw, len, chunk << z.header.chunk_shift)) {
+			err = UXU_ERR_FILE;
+			break;
+		}
+		if ((err = uxuz_write_chunk(&z, chunk, z.raw, len)) != UXU_OK)
+			break;
+	}
+	if (err == UXU_OK)
+		err = uxuz_write_index(&z);
+
+	uxuz_close(&z);
+	return err;
+}
+
+uxu_err_t
+uxuz_unpack(int fd_in, int fd_out)
+{
+	uxuz_t	z;
+	uint64_t	chunk;
+	uxu_err_t	err;
+
+	if ((err = uxuz_open(&z, fd_in)) != UXU_OK)
+		return err;
+
+	if (ftruncate(fd_out, 0) != 0 || ftruncate(fd_out, z.header.size) != 0)
+		err = UXU_ERR_FILE;
+	for (chunk = 0; err == UXU_OK && chunk < z.header.nr_chunks; chunk++) {
+		/* chunks of zeros are left as holes */
+		if (z.index[chunk].length == 0)
+			continue;
+		if ((err = uxuz_read_chunk(&z, chunk)) != UXU_OK)
+			break;
+		if (!pwrite_full(fd_out, z.raw, uxuz_chunk_len(&z, chunk), chunk << z.header.chunk_shift))
+			err = UXU_ERR_FILE;
+	}
+
+	uxuz_close(&z);
+	return err;
+}
+
+uxu_err_t
+uxuz_read(int fd, void *buf, size_t size)
+{
+	uxuz_t	z;
+	uint64_t	chunk;
+	size_t	pos;
+	uxu_err_t	err;
+
+	if ((err = uxuz_open(&z, fd)) != UXU_OK)
+		return err;
+	if (size > z.header.size) {
+		uxuz_close(&z);
+		return UXU_ERR_INTVAL;
+	}
+
+	for (chunk = 0, pos = 0; pos < size; chunk++, pos += z.chunk_size) {
+		size_t	len = size - pos < z.chunk_size ? size - pos : z.chunk_size;
+
+		if ((err = uxuz_read_chunk(&z, chunk)) != UXU_OK)
+			break;
+		memcpy((uint8_t *)buf + pos, z.raw, len);
+	}
+
+	uxuz_close(&z);
+	return err;
+}
+
+uxu_err_t
+uxuz_write(int fd, const void *buf, size_t size)
+{
+	uxuz_t	z;
+	uint64_t	chunk;
+	size_t	pos;
+	uxu_err_t	err;
+
+	if ((err = uxuz_open(&z, fd)) != UXU_OK)
+		return err;
+	if (size > z.header.size) {
+		uxuz_close(&z);
+		return UXU_ERR_INTVAL;
+	}
+
+	for (chunk = 0, pos = 0; pos < size; chunk++, pos += z.chunk_size) {
+		size_t	len = uxuz_chunk_len(&z, chunk);
+		const uint8_t	*data = (const uint8_t *)buf + pos;
+
+		/* the end of the last chunk written is kept */
+		if (size - pos < len) {
+			if ((err = uxuz_read_chunk(&z, chunk)) != UXU_OK)
+				break;
+			memcpy(z.raw, data, size - pos);
+			data = z.raw;
+		}
+		if ((err = uxuz_write_chunk(&z, chunk, data, len)) != UXU_OK)
+			break;
+	}
+	if (err == UXU_OK)
+		err = uxuz_write_index(&z);
+
+	uxuz_close(&z);
+	return err;
+}
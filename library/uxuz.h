@@ -0,0 +1,31 @@
+#ifndef _UXUZ_H_
+#define _UXUZ_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "libuxu.h"
+/* The format of the container, shared with the kernel module */
+#include "../kernel_nvidia/common/inc/uxuz_format.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+	/* Read the header of a container, UXU_ERR_INTVAL if `fd` is not one */
+	uxu_err_t uxuz_read_header(int fd, uxuz_header_t *header);
+	/* Make `fd` an empty container of `size` bytes of zeros */
+	uxu_err_t uxuz_create(int fd, size_t size, unsigned int chunk_shift);
+	/* Compress the whole file `fd_in` to the container `fd_out` */
+	uxu_err_t uxuz_pack(int fd_in, int fd_out, unsigned int chunk_shift);
+	/* Decompress the container `fd_in` to the file `fd_out` */
+	uxu_err_t uxuz_unpack(int fd_in, int fd_out);
+	/* Decompress the first `size` bytes of the container to `buf` */
+	uxu_err_t uxuz_read(int fd, void *buf, size_t size);
+	/* Replace the content of the container with `size` bytes of `buf`, keeping its chunk size */
+	uxu_err_t uxuz_write(int fd, const void *buf, size_t size);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+#include "unit_test.h"
+#include "libuxu.hpp"
+
+static void
+unit_test_cxx_read(unsigned long size)
+{
+	prepare_d_result();
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+
+	try {
+		uxu::mapping<uint8_t>	m(fpath_tmpfile, size, UXU_FLAGS_READ);
+		uxu::view<uint8_t>	v = m.view();
+
+		uxu::prefetch(v.first(size / 2), 0).get();
+
+		buf_uxu = m.data();
+		RUN_READ_KERNEL(size);
+		check_read_result();
+
+		if (v.subview(size / 2)[0] != (is_ascending_order ? (uint8_t)(size / 2): (uint8_t)(255 - (uint8_t)(size / 2))))
+			FAIL("wrong data in the subview");
+	}
+	catch (const uxu::error &e) {
+		FAIL("%s", e.what());
+	}
+
+	cleanup();
+
+	pass("c++ read (%dKB)", size / 1024);
+}
+
+static void
+unit_test_cxx_write(unsigned long size)
+{
+	if (!create_tmpfile_for_write(size))
+		FAIL("cannot create file");
+
+	try {
+		uxu::mapping<uint8_t>	m(fpath_tmpfile, size, UXU_FLAGS_WRITE | UXU_FLAGS_CREATE);
+
+		RUN_WRITE_MEM_KERNEL(m.data(), size);
+		uxu::sync(m).get();
+
+		if (!check_tmpfile(size))
+			FAIL("invalid file after sync");
+	}
+	catch (const uxu::error &e) {
+		FAIL("%s", e.what());
+	}
+
+	drop_caches();
+
+	if (!check_tmpfile(size))
+		FAIL("invalid written file");
+
+	cleanup();
+
+	pass("c++ write (%dKB)", size / 1024);
+}
+
+static void
+unit_test_cxx_batch(unsigned long size)
+{
+	std::vector<uxu::map_request>	requests;
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+
+	try {
+		std::vector<uxu::mapping<uint8_t> >	mappings;
+
+		requests.push_back({ fpath_tmpfile, size, UXU_FLAGS_READ });
+		requests.push_back({ fpath_tmpfile, size / 2, UXU_FLAGS_READ });
+		mappings = uxu::map_all<uint8_t>(requests);
+
+		if (mappings.size() != 2 || mappings[1].size() != size / 2)
+			FAIL("unexpected batch mappings");
+
+		uxu::unmap_all(mappings);
+		if (!mappings.empty())
+			FAIL("mappings left after unmap_all");
+	}
+	catch (const uxu::error &e) {
+		FAIL("%s", e.what());
+	}
+
+	// No mapping is left behind when one of the files cannot be mapped
+	requests.push_back({ "/nonexistent/uxu/file", size, UXU_FLAGS_READ });
+	try {
+		uxu::map_all<uint8_t>(requests);
+		FAIL("map_all succeeded with a missing file");
+	}
+	catch (const uxu::error &e) {
+		if (e.code() != UXU_ERR_FILE)
+			FAIL("unexpected error: %s", e.what());
+	}
+
+	cleanup();
+
+	pass("c++ batch map (%dKB)", size / 1024);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unit_test_cxx_read(4 * MB);
+	unit_test_cxx_write(4 * MB);
+	unit_test_cxx_batch(64 * KB);
+
+	return 0;
+}
@@ -1,4 +1,7 @@
+#include <fcntl.h>
+
 #include "unit_test.h"
+#include "uxuz.h"
 
 static void
 unit_test_read(unsigned long size)
@@ -76,6 +79,179 @@ unit_test_multi_read(unsigned long size)
 	pass("multiple reads(%dMB)", size / 1024 / 1024);
 }
 
+static void
+unit_test_read_offset(unsigned long size, unsigned long offset)
+{
+	int	err;
+
+	prepare_d_result();
+
+	// Another array follows the mapped one in the packed file
+	if (!create_tmpfile_for_read(offset + size + 1 * MB))
+		FAIL("cannot create file");
+	if ((err = uxu_map_offset(fpath_tmpfile, offset, size, UXU_FLAGS_READ, (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map for read at offset: err: %d", err);
+
+	RUN_READ_KERNEL(size);
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly at offset (%dKB at %dKB)", size / 1024, offset / 1024);
+}
+
+static void
+unit_test_read_extents(unsigned long size)
+{
+	uxu_extent_t	extents[3];
+	int	err;
+
+	prepare_d_result();
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+
+	// Shards of the file are concatenated out of order. Their lengths are
+	// multiples of 256, so the concatenation keeps the pattern of the file.
+	extents[0].filename = fpath_tmpfile;
+	extents[0].offset = size / 2;
+	extents[0].length = size / 2;
+	extents[1].filename = fpath_tmpfile;
+	extents[1].offset = 0;
+	extents[1].length = size / 4;
+	extents[2].filename = fpath_tmpfile;
+	extents[2].offset = 0;
+	extents[2].length = size;
+	if ((err = uxu_map_extents(extents, 3, UXU_FLAGS_READ, (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map extents for read: err: %d", err);
+
+	RUN_READ_KERNEL(size / 2 + size / 4 + size);
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly extents (%dKB)", size / 1024);
+}
+
+static void
+unit_test_read_striped(unsigned long size, unsigned long stripe_unit)
+{
+	const char	*fpaths[3];
+	int	err;
+
+	prepare_d_result();
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+
+	// Every stripe reads the file from a multiple of the stripe unit, which
+	// keeps the pattern of the file if the stripe unit is a multiple of 256.
+	fpaths[0] = fpaths[1] = fpaths[2] = fpath_tmpfile;
+	if ((err = uxu_map_striped(fpaths, 3, stripe_unit, size, UXU_FLAGS_READ, (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map stripes for read: err: %d", err);
+
+	RUN_READ_KERNEL(size);
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly striped (%dKB, %dKB stripes)", size / 1024, stripe_unit / 1024);
+}
+
+static void
+unit_test_read_hostbuf(unsigned long size)
+{
+	int	err;
+
+	prepare_d_result();
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+	if ((err = uxu_map(fpath_tmpfile, size, UXU_FLAGS_READ | UXU_FLAGS_USEHOSTBUF, (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map host buffers for read: err: %d", err);
+
+	RUN_READ_KERNEL(size);
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly host buffers (%dKB)", size / 1024);
+}
+
+static void
+unit_test_read_compressed(unsigned long size)
+{
+	char	fpath_container[] = ".basictest.uxuz.XXXXXX";
+	int	fd_in, fd_out;
+	int	err;
+
+	prepare_d_result();
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+	if ((fd_out = mkstemp(fpath_container)) < 0)
+		FAIL("cannot create container");
+	if ((fd_in = open(fpath_tmpfile, O_RDONLY)) < 0)
+		FAIL("cannot open file");
+	if ((err = uxuz_pack(fd_in, fd_out, UXUZ_DEFAULT_CHUNK_SHIFT)) != UXU_OK)
+		FAIL("failed to pack: err: %d", err);
+	close(fd_in);
+	close(fd_out);
+	unlink(fpath_tmpfile);
+	strcpy(fpath_tmpfile, fpath_container);
+	drop_caches();
+
+	if ((err = uxu_map(fpath_tmpfile, size, UXU_FLAGS_READ | UXU_FLAGS_COMPRESSED, (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map compressed file for read: err: %d", err);
+
+	RUN_READ_KERNEL(size);
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly compressed (%dKB)", size / 1024);
+}
+
+static void
+unit_test_read_sparse(unsigned long size, unsigned long hole_offset, unsigned long hole_size)
+{
+	unsigned long	i, data_offset;
+	int	fd;
+
+	prepare_d_result();
+
+	if (!create_tmpfile_for_read(size))
+		FAIL("cannot create file");
+	if ((fd = open(fpath_tmpfile, O_RDWR)) < 0)
+		FAIL("cannot open file");
+	if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, hole_offset, hole_size) != 0)
+		FAIL("cannot punch a hole");
+	close(fd);
+	do_map_for_read(size);
+
+	RUN_READ_KERNEL(hole_offset);
+	for (i = hole_offset; i < hole_offset + hole_size; i++) {
+		if (buf_uxu[i] != 0)
+			FAIL("non-zero byte in the hole at %lu", i);
+	}
+	// The hole ends on a multiple of 256, so the data after it starts the
+	// pattern of the file again
+	data_offset = hole_offset + hole_size;
+	RUN_KERNEL((kernel_read<<<8, 32>>>(buf_uxu + data_offset, size - data_offset, d_read_result,
+					   is_ascending_order)));
+
+	do_unmap_for_read();
+
+	cleanup();
+
+	pass("readonly sparse (%dKB, %dKB hole)", size / 1024, hole_size / 1024);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -91,5 +267,22 @@ main(int argc, char *argv[])
 
 	unit_test_multi_read(5 * MB);
 
+	unit_test_read_offset(5 * MB, 4 * KB);
+	unit_test_read_offset(8000, 3 * MB);
+
+	unit_test_read_extents(4 * MB);
+
+	unit_test_read_striped(8 * MB, 2 * MB);
+	unit_test_read_striped(5 * MB + 8000, 64 * KB);
+
+	unit_test_read_hostbuf(8 * MB);
+	unit_test_read_hostbuf(5 * MB + 8000);
+
+	unit_test_read_compressed(8 * MB);
+	unit_test_read_compressed(5 * MB + 8000);
+
+	unit_test_read_sparse(8 * MB, 2 * MB, 4 * MB);
+	unit_test_read_sparse(5 * MB, 64 * KB, 1 * MB + 12 * KB);
+
 	return 0;
 }
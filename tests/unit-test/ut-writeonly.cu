@@ -1,4 +1,7 @@
+#include <fcntl.h>
+
 #include "unit_test.h"
+#include "uxuz.h"
 
 static void
 unit_test_write(unsigned long size)
@@ -90,6 +93,68 @@ unit_test_multiple_writes(unsigned long size)
 	pass("multiple writes (%dMB)", size / 1024 / 1024);
 }
 
+static void
+unit_test_write_hostbuf(unsigned long size)
+{
+	int	err;
+
+	if (!create_tmpfile_for_write(size))
+		FAIL("cannot create file");
+	if ((err = uxu_map(fpath_tmpfile, size, UXU_FLAGS_WRITE | UXU_FLAGS_CREATE | UXU_FLAGS_USEHOSTBUF,
+			   (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map host buffers for write: err: %d", err);
+
+	RUN_WRITE_KERNEL(size);
+
+	do_unmap_for_write();
+
+	drop_caches();
+
+	if (!check_tmpfile(size))
+		FAIL("invalid file written from host buffers");
+
+	cleanup();
+
+	pass("write host buffers (%dKB)", size / 1024);
+}
+
+static void
+unit_test_write_compressed(unsigned long size)
+{
+	char	fpath_unpacked[] = ".basictest.unpacked.XXXXXX";
+	int	fd_in, fd_out;
+	int	err;
+
+	if (!create_tmpfile_for_write(size))
+		FAIL("cannot create file");
+	if ((err = uxu_map(fpath_tmpfile, size, UXU_FLAGS_WRITE | UXU_FLAGS_CREATE | UXU_FLAGS_COMPRESSED,
+			   (void **)&buf_uxu)) != UXU_OK)
+		FAIL("failed to map compressed file for write: err: %d", err);
+
+	RUN_WRITE_KERNEL(size);
+
+	do_unmap_for_write();
+
+	drop_caches();
+
+	if ((fd_out = mkstemp(fpath_unpacked)) < 0)
+		FAIL("cannot create file");
+	if ((fd_in = open(fpath_tmpfile, O_RDONLY)) < 0)
+		FAIL("cannot open container");
+	if ((err = uxuz_unpack(fd_in, fd_out)) != UXU_OK)
+		FAIL("failed to unpack: err: %d", err);
+	close(fd_in);
+	close(fd_out);
+	rename(fpath_unpacked, fpath_tmpfile);
+
+	if (!check_tmpfile(size))
+		FAIL("invalid compressed file written");
+
+	cleanup();
+
+	pass("write compressed (%dKB)", size / 1024);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -101,5 +166,9 @@ main(int argc, char *argv[])
 
 	unit_test_multiple_writes(18 * MB);
 
+	unit_test_write_hostbuf(8 * MB + 8000);
+
+	unit_test_write_compressed(8 * MB + 8000);
+
 	return 0;
 }